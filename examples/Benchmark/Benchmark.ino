@@ -0,0 +1,364 @@
+/*
+ *  Benchmark.cpp
+ *  Measures the CPU cycles of the hot paths of the library, which are called in every loop,
+ *  under representative states of a drive, to see how much of a 1 ms loop / IMU budget they require.
+ *
+ *  The car drives a distance, rotates and drives back, with a loop period of 1 ms.
+ *  Every call is assigned to the state of the right motor (stopped, start, ramp_up, drive, ramp_down)
+ *  or to imu_rotation, if an IMU rotation is running.
+ *  For USE_ENCODER_MOTOR_CONTROL, encoder interrupts are generated by the program according to the current PWM,
+ *  so this program gives reasonable results on a bare Arduino or a simulator without motors and encoders attached.
+ *
+ *  On AVR, cycles are counted by Timer1 with prescaler 1, which excludes the use of Timer1 PWM (pin 9 and 10 on an UNO).
+ *  Calls are measured with interrupts enabled, so cycles_max contains the Timer0 millis() and the Serial interrupts.
+ *  On other platforms micros() is used and the unit is us.
+ *  Output is one line of key=value pairs per function and state, to be easily processed by scripts.
+ *  It is the AVR counterpart of extras/HostSimulation/Benchmark.cpp.
+ *
+ *  Copyright (C) 2022  Armin Joachimsmeyer
+ *  armin.joachimsmeyer@gmail.com
+ *
+ *  This file is part of Arduino-RobotCar https://github.com/ArminJo/PWMMotorControl.
+ *
+ *  PWMMotorControl is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/gpl.html>.
+ *
+ */
+
+#include <Arduino.h>
+
+/*
+ * You will need to change these values according to your motor, H-bridge and motor supply voltage.
+ * You must specify this before the include of "CarPWMMotorControl.hpp"
+ */
+//#define USE_ENCODER_MOTOR_CONTROL  // Activate this if you have encoder interrupts attached at pin 2 and 3 and want to use the methods of the EncoderMotor class.
+//#define USE_MPU6050_IMU  // Activate this if you use GY-521 MPU6050 breakout board for precise turning and speed / distance movement. Connectors point to the rear.
+//#define USE_ADAFRUIT_MOTOR_SHIELD  // Activate this if you use Adafruit Motor Shield v2 connected by I2C instead of TB6612 or L298 breakout board.
+//#define USE_STANDARD_LIBRARY_FOR_ADAFRUIT_MOTOR_SHIELD  // Activate this to force using of Adafruit library. Requires 694 bytes program memory.
+#define VIN_2_LIPO                 // Activate this, if you use 2 LiPo Cells (around 7.4 volt) as Motor supply.
+//#define VIN_1_LIPO                 // Or if you use a Mosfet bridge, 1 LIPO (around 3.7 volt) may be sufficient.
+//#define FULL_BRIDGE_INPUT_MILLIVOLT   6000  // Default. For 4 x AA batteries (6 volt).
+//#define MOSFET_BRIDGE_USED  // Activate this, if you use a (recommended) mosfet bridge instead of a L298 bridge, which has higher losses.
+//#define DEFAULT_DRIVE_MILLIVOLT       2000 // Drive voltage -motors default speed- is 2.0 volt
+#include "CarPWMMotorControl.hpp"
+
+#include "RobotCarPinDefinitionsAndMore.h"
+
+#define BENCHMARK_LOOP_PERIOD_MILLIS        1
+#define BENCHMARK_DRIVE_SPEED_PWM           ((MAX_SPEED_PWM * 3) / 4) // greater than RAMP_VALUE_OFFSET_SPEED_PWM, to get ramps
+#define BENCHMARK_MANEUVER_TIMEOUT_MILLIS   5000
+
+#if defined(__AVR__)
+#define BENCHMARK_TICKS_PER_MILLISECOND     (F_CPU / 1000)
+#define BENCHMARK_TICKS_NAME                "cycles"
+#define getBenchmarkTicks()                 TCNT1
+#else
+#define BENCHMARK_TICKS_PER_MILLISECOND     1000
+#define BENCHMARK_TICKS_NAME                "us"
+#define getBenchmarkTicks()                 ((uint16_t) micros())
+#endif
+
+/*
+ * Indexes for sBuckets
+ */
+#define BENCHMARK_UPDATE_MOTORS             0
+#define BENCHMARK_ENCODER_UPDATE_MOTOR      1
+#define BENCHMARK_GET_AVERAGE_SPEED         2
+#define BENCHMARK_READ_IMU_FIFO             3
+#define BENCHMARK_ENCODER_INTERRUPT         4
+#define NUMBER_OF_BENCHMARK_FUNCTIONS       5
+
+#define BENCHMARK_STATE_IMU_ROTATION        (MOTOR_STATE_RAMP_DOWN + 1)
+#define NUMBER_OF_BENCHMARK_STATES          (BENCHMARK_STATE_IMU_ROTATION + 1)
+
+struct BenchmarkBucket {
+    uint32_t TicksSum;
+    uint16_t Calls;
+    uint16_t TicksMin;
+    uint16_t TicksMax;
+};
+BenchmarkBucket sBuckets[NUMBER_OF_BENCHMARK_FUNCTIONS][NUMBER_OF_BENCHMARK_STATES];
+uint16_t sMeasurementOverheadTicks;
+uint16_t sManeuvers;
+uint16_t sManeuverTimeouts;
+
+/*
+ * Measures the ticks of aCall and adds it to the bucket of aFunctionIndex and aState
+ */
+#define MEASURE(aFunctionIndex, aState, aCall) do { \
+    uint16_t tStartTicks = getBenchmarkTicks(); \
+    aCall; \
+    uint16_t tTicks = getBenchmarkTicks() - tStartTicks; \
+    addToBucket(aFunctionIndex, aState, tTicks); \
+} while (0)
+
+void addToBucket(uint8_t aFunctionIndex, uint8_t aState, uint16_t aTicks) {
+    if (aTicks > sMeasurementOverheadTicks) {
+        aTicks -= sMeasurementOverheadTicks;
+    } else {
+        aTicks = 0;
+    }
+    BenchmarkBucket *tBucket = &sBuckets[aFunctionIndex][aState];
+    if (tBucket->Calls == 0 || aTicks < tBucket->TicksMin) {
+        tBucket->TicksMin = aTicks;
+    }
+    if (aTicks > tBucket->TicksMax) {
+        tBucket->TicksMax = aTicks;
+    }
+    tBucket->TicksSum += aTicks;
+    tBucket->Calls++;
+}
+
+void initBenchmarkTicks() {
+#if defined(__AVR__)
+    TCCR1A = 0;
+    TCCR1B = _BV(CS10); // normal mode, prescaler 1
+    TIMSK1 = 0;
+#endif
+    sMeasurementOverheadTicks = 0xFFFF;
+    for (uint_fast8_t i = 0; i < 100; ++i) {
+        uint16_t tStartTicks = getBenchmarkTicks();
+        uint16_t tTicks = getBenchmarkTicks() - tStartTicks;
+        if (tTicks < sMeasurementOverheadTicks) {
+            sMeasurementOverheadTicks = tTicks;
+        }
+    }
+}
+
+uint8_t getBenchmarkState() {
+#if defined(USE_MPU6050_IMU)
+    if (RobotCarPWMMotorControl.CarRequestedRotationDegrees != 0) {
+        return BENCHMARK_STATE_IMU_ROTATION;
+    }
+#endif
+    return RobotCarPWMMotorControl.rightCarMotor.MotorRampState;
+}
+
+#if defined(USE_ENCODER_MOTOR_CONTROL)
+/*
+ * Call the encoder interrupt handler with the rate a motor running with CurrentSpeedPWM would generate.
+ * A running motor keeps turning down to around half of DEFAULT_START_SPEED_PWM, below the simulated motor stands still.
+ */
+void simulateEncoder(EncoderMotor *aMotor, uint32_t *aNextEncoderMillis) {
+    uint8_t tSpeedPWM = aMotor->CurrentSpeedPWM;
+    if (tSpeedPWM < DEFAULT_START_SPEED_PWM / 2) {
+        *aNextEncoderMillis = 0; // motor stands still
+        return;
+    }
+    uint16_t tEncoderPeriodMillis = ((uint32_t) 1000 * DEFAULT_DRIVE_SPEED_PWM * DEFAULT_CIRCUMFERENCE_MILLIMETER)
+            / ((uint32_t) tSpeedPWM * DEFAULT_MILLIMETER_PER_SECOND * ENCODER_COUNTS_PER_FULL_ROTATION);
+    if (*aNextEncoderMillis == 0) {
+        *aNextEncoderMillis = millis() + tEncoderPeriodMillis; // first edge one period after start
+    } else if (millis() >= *aNextEncoderMillis) {
+        *aNextEncoderMillis += tEncoderPeriodMillis;
+        uint8_t tState = getBenchmarkState();
+        noInterrupts();
+        MEASURE(BENCHMARK_ENCODER_INTERRUPT, tState, aMotor->handleEncoderInterrupt());
+        interrupts();
+    }
+}
+#endif
+
+/*
+ * One loop, which measures one of the hot paths, selected by aLoopCount.
+ * The other functions are called unmeasured, to keep the behavior of the car identical to a plain updateMotors() loop.
+ */
+void runLoop(uint16_t aLoopCount) {
+    uint8_t tState = getBenchmarkState();
+    switch (aLoopCount % 4) {
+#if defined(USE_ENCODER_MOTOR_CONTROL) && !defined(USE_MPU6050_IMU)
+    case 1:
+        MEASURE(BENCHMARK_ENCODER_UPDATE_MOTOR, tState, RobotCarPWMMotorControl.rightCarMotor.updateMotor());
+        RobotCarPWMMotorControl.leftCarMotor.updateMotor();
+        break;
+#endif
+#if defined(USE_ENCODER_MOTOR_CONTROL) && defined(SUPPORT_AVERAGE_SPEED)
+    case 2:
+        MEASURE(BENCHMARK_GET_AVERAGE_SPEED, tState, RobotCarPWMMotorControl.rightCarMotor.getAverageSpeed());
+        RobotCarPWMMotorControl.updateMotors();
+        break;
+#endif
+#if defined(USE_MPU6050_IMU)
+    case 3:
+        MEASURE(BENCHMARK_READ_IMU_FIFO, tState, RobotCarPWMMotorControl.IMUData.readCarDataFromMPU6050Fifo());
+        RobotCarPWMMotorControl.updateMotors();
+        break;
+#endif
+    default:
+        MEASURE(BENCHMARK_UPDATE_MOTORS, tState, RobotCarPWMMotorControl.updateMotors());
+        break;
+    }
+}
+
+/*
+ * Stop the car, if it does not stop by itself, e.g. if it stalls at RAMP_VALUE_MIN_SPEED_PWM before the IMU distance is reached
+ */
+void runUntilStopped() {
+    static uint16_t sLoopCount;
+#if defined(USE_ENCODER_MOTOR_CONTROL)
+    uint32_t tNextRightEncoderMillis = 0;
+    uint32_t tNextLeftEncoderMillis = 0;
+#endif
+    sManeuvers++;
+    uint32_t tStartMillis = millis();
+    uint32_t tNextLoopMillis = tStartMillis;
+    do {
+        runLoop(sLoopCount++);
+#if defined(USE_ENCODER_MOTOR_CONTROL)
+        simulateEncoder(&RobotCarPWMMotorControl.rightCarMotor, &tNextRightEncoderMillis);
+        simulateEncoder(&RobotCarPWMMotorControl.leftCarMotor, &tNextLeftEncoderMillis);
+#endif
+        tNextLoopMillis += BENCHMARK_LOOP_PERIOD_MILLIS;
+        while (millis() < tNextLoopMillis) {
+            ;
+        }
+        if (tStartMillis != 0 && millis() - tStartMillis > BENCHMARK_MANEUVER_TIMEOUT_MILLIS) {
+            sManeuverTimeouts++;
+            RobotCarPWMMotorControl.stop(MOTOR_BRAKE);
+#if defined(USE_MPU6050_IMU)
+            RobotCarPWMMotorControl.CarRequestedRotationDegrees = 0;
+#endif
+            tStartMillis = 0;
+        }
+    } while (!RobotCarPWMMotorControl.isStopped());
+}
+
+void printFunctionName(uint8_t aFunctionIndex) {
+    switch (aFunctionIndex) {
+    case BENCHMARK_UPDATE_MOTORS:
+        Serial.print(F("CarPWMMotorControl::updateMotors"));
+        break;
+    case BENCHMARK_ENCODER_UPDATE_MOTOR:
+        Serial.print(F("EncoderMotor::updateMotor"));
+        break;
+    case BENCHMARK_GET_AVERAGE_SPEED:
+        Serial.print(F("EncoderMotor::getAverageSpeed"));
+        break;
+    case BENCHMARK_READ_IMU_FIFO:
+        Serial.print(F("IMUCarData::readCarDataFromMPU6050Fifo"));
+        break;
+    default:
+        Serial.print(F("EncoderMotor::handleEncoderInterrupt"));
+        break;
+    }
+}
+
+void printStateName(uint8_t aState) {
+    switch (aState) {
+    case MOTOR_STATE_START:
+        Serial.print(F("start"));
+        break;
+    case MOTOR_STATE_RAMP_UP:
+        Serial.print(F("ramp_up"));
+        break;
+    case MOTOR_STATE_DRIVE:
+        Serial.print(F("drive"));
+        break;
+    case MOTOR_STATE_RAMP_DOWN:
+        Serial.print(F("ramp_down"));
+        break;
+    case BENCHMARK_STATE_IMU_ROTATION:
+        Serial.print(F("imu_rotation"));
+        break;
+    default:
+        Serial.print(F("stopped"));
+        break;
+    }
+}
+
+void printConfiguration() {
+#if defined(USE_MPU6050_IMU)
+    Serial.print(F("imu"));
+#elif defined(USE_ENCODER_MOTOR_CONTROL)
+    Serial.print(F("encoder"));
+#else
+    Serial.print(F("pwm"));
+#endif
+}
+
+/*
+ * Print and clear all buckets
+ */
+void printBuckets() {
+    Serial.print(F("config="));
+    printConfiguration();
+    Serial.print(F(" maneuvers="));
+    Serial.print(sManeuvers);
+    Serial.print(F(" timeouts="));
+    Serial.print(sManeuverTimeouts);
+    Serial.print(F(" overhead_" BENCHMARK_TICKS_NAME "="));
+    Serial.println(sMeasurementOverheadTicks);
+
+    for (uint_fast8_t tFunctionIndex = 0; tFunctionIndex < NUMBER_OF_BENCHMARK_FUNCTIONS; ++tFunctionIndex) {
+        for (uint_fast8_t tState = 0; tState < NUMBER_OF_BENCHMARK_STATES; ++tState) {
+            BenchmarkBucket *tBucket = &sBuckets[tFunctionIndex][tState];
+            if (tBucket->Calls == 0) {
+                continue;
+            }
+            uint16_t tTicksMean = tBucket->TicksSum / tBucket->Calls;
+            Serial.print(F("bench="));
+            printFunctionName(tFunctionIndex);
+            Serial.print(F(" config="));
+            printConfiguration();
+            Serial.print(F(" state="));
+            printStateName(tState);
+            Serial.print(F(" calls="));
+            Serial.print(tBucket->Calls);
+            Serial.print(F(" " BENCHMARK_TICKS_NAME "_mean="));
+            Serial.print(tTicksMean);
+            Serial.print(F(" " BENCHMARK_TICKS_NAME "_min="));
+            Serial.print(tBucket->TicksMin);
+            Serial.print(F(" " BENCHMARK_TICKS_NAME "_max="));
+            Serial.print(tBucket->TicksMax);
+            Serial.print(F(" budget_percent="));
+            Serial.println((tTicksMean * 100.0) / BENCHMARK_TICKS_PER_MILLISECOND);
+            tBucket->Calls = 0;
+            tBucket->TicksSum = 0;
+            tBucket->TicksMax = 0;
+        }
+    }
+    sManeuvers = 0;
+    sManeuverTimeouts = 0;
+}
+
+void setup() {
+    Serial.begin(115200);
+
+#if defined(__AVR_ATmega32U4__) || defined(SERIAL_PORT_USBVIRTUAL) || defined(SERIAL_USB) || defined(SERIALUSB_PID) || defined(ARDUINO_attiny3217)
+    delay(4000); // To be able to connect Serial monitor after reset or power up and before first print out. Do not wait for an attached Serial Monitor!
+#endif
+    // Just to know which program is running on my Arduino
+    Serial.println(F("START " __FILE__ " from " __DATE__ "\r\nUsing library version " VERSION_PWMMOTORCONTROL));
+
+#ifdef USE_ADAFRUIT_MOTOR_SHIELD
+    // For Adafruit Motor Shield v2
+    RobotCarPWMMotorControl.init();
+#else
+    RobotCarPWMMotorControl.init(RIGHT_MOTOR_FORWARD_PIN, RIGHT_MOTOR_BACKWARD_PIN, RIGHT_MOTOR_PWM_PIN, LEFT_MOTOR_FORWARD_PIN,
+    LEFT_MOTOR_BACKWARD_PIN, LEFT_MOTOR_PWM_PIN);
+#endif
+    initBenchmarkTicks();
+    delay(2000);
+}
+
+void loop() {
+    RobotCarPWMMotorControl.startGoDistanceMillimeter(BENCHMARK_DRIVE_SPEED_PWM, 500, DIRECTION_FORWARD);
+    runUntilStopped();
+    RobotCarPWMMotorControl.startRotate(90, TURN_IN_PLACE);
+    runUntilStopped();
+    RobotCarPWMMotorControl.startGoDistanceMillimeter(BENCHMARK_DRIVE_SPEED_PWM, 500, DIRECTION_BACKWARD);
+    runUntilStopped();
+
+    printBuckets();
+    delay(5000);
+}
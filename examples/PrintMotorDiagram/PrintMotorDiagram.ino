@@ -1,6 +1,7 @@
 /*
  *  PrintMotorDiagram.cpp
  *  Prints PWM, distance and speed diagram of an encoder motor.
+ *  The sweeps are used to fill the speed PWM table of the motor, which is printed.
  *
  *
  *  Copyright (C) 2020-2021  Armin Joachimsmeyer
@@ -41,6 +42,12 @@
 
 #include "RobotCarPinDefinitionsAndMore.h"
 
+/*
+ * The table is written to the fixed EEPROM layout of version 1, which is not read by a car with USE_CALIBRATION_STORE,
+ * if a calibration record exists. For a car, use RobotCarPWMMotorControl.calibrateSpeedPWMTables() and writeMotorValuesToEeprom().
+ */
+//#define WRITE_SPEED_PWM_TABLE_TO_EEPROM // Store table after first forward and backward sweep as table of the right car motor (storage number 1)
+
 EncoderMotor MotorUnderTest;
 
 void setup() {
@@ -101,9 +108,15 @@ void loop() {
     /*
      * Increase PWM and print values every DELAY_MILLIS_BETWEEN_CHANGE ms
      */
+#ifdef USE_SPEED_PWM_TABLE
+    MotorUnderTest.startSpeedPWMTableCalibration(sMotorDirection, true);
+#endif
     for (uint_fast8_t tPWM = 0; tPWM < 249; ++tPWM) {
         MotorUnderTest.setSpeedPWM(tPWM, sMotorDirection);
         delay(DELAY_MILLIS_BETWEEN_CHANGE);
+#ifdef USE_SPEED_PWM_TABLE
+        MotorUnderTest.addSpeedPWMTableCalibrationValue(tPWM);
+#endif
         Serial.print(tPWM);
 
         Serial.print(' ');
@@ -128,9 +141,15 @@ void loop() {
     tMaxSpeed = MotorUnderTest.getAverageSpeed();
     MotorUnderTest.LastRideEncoderCount = 0;
     // and decrease
+#ifdef USE_SPEED_PWM_TABLE
+    MotorUnderTest.startSpeedPWMTableCalibration(sMotorDirection, false);
+#endif
     for (int tPWM = 248; tPWM >= 0; tPWM--) {
         MotorUnderTest.setSpeedPWM(tPWM, sMotorDirection);
         delay(DELAY_MILLIS_BETWEEN_CHANGE);
+#ifdef USE_SPEED_PWM_TABLE
+        MotorUnderTest.addSpeedPWMTableCalibrationValue(tPWM);
+#endif
         Serial.print(tPWM);
 
         Serial.print(' ');
@@ -166,6 +185,18 @@ void loop() {
     Serial.print(tStopSpeed);
     Serial.println();
 
+#ifdef USE_SPEED_PWM_TABLE
+    MotorUnderTest.endSpeedPWMTableCalibration(sMotorDirection);
+    MotorUnderTest.printSpeedPWMTable(&Serial);
+#  ifdef WRITE_SPEED_PWM_TABLE_TO_EEPROM
+    static bool sSpeedPWMTableWritten = false;
+    if (sMotorDirection == DIRECTION_BACKWARD && !sSpeedPWMTableWritten) {
+        MotorUnderTest.writeSpeedPWMTableToEeprom(1);
+        sSpeedPWMTableWritten = true;
+    }
+#  endif
+#endif
+
     /*
      * switch direction
      */
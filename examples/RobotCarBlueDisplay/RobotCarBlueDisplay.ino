@@ -337,6 +337,7 @@ void readVINVoltage() {
 #  else
     sVINVoltage = tVIN * ((11.0 * 1.1) / 1023);
 #  endif
+    PWMDcMotor::setVINMillivolt(sVINVoltage * 1000); // keep motor voltage constant while battery is discharging
 }
 #endif // MONITOR_VIN_VOLTAGE
 
@@ -76,7 +76,7 @@ unsigned int getDistanceAndPlayTone() {
 
 #if defined(MONITOR_VIN_VOLTAGE)
 /*
- * Check VIN every 2 seconds (PRINT_VOLTAGE_PERIOD_MILLIS) and print if changed
+ * Check VIN every 2 seconds (PRINT_VOLTAGE_PERIOD_MILLIS), give it to the motor control and print if changed
  */
 void checkVinPeriodicallyAndPrintIfChanged() {
 #  if defined(ESP32)
@@ -99,18 +99,19 @@ void checkVinPeriodicallyAndPrintIfChanged() {
 //        delay(10);                                      // wait to settle signal
 //        tVINRaw = analogRead(PIN_VIN_11TH_IN);
 #    endif
-        if(abs(sLastVINRaw - tVINRaw) > 2) {
-            sLastVINRaw = tVINRaw;
-            /*
-             * Assume resistor network of 1MOhm / 100kOhm (divider by 11)
-             * tVIN = tVINRaw * 0,01182795 => resolution is 0.01 volt
-             */
+        /*
+         * Assume resistor network of 1MOhm / 100kOhm (divider by 11)
+         * tVIN = tVINRaw * 0,01182795 => resolution is 0.01 volt
+         */
 #    if defined(VIN_VOLTAGE_CORRECTION)
-            // we have a diode  which requires around 0.8 volt between LIPO and VIN
-            float tVIN = (tVINRaw * ((11.0 * 1.1) / 1023)) + VIN_VOLTAGE_CORRECTION;
+        // we have a diode  which requires around 0.8 volt between LIPO and VIN
+        float tVIN = (tVINRaw * ((11.0 * 1.1) / 1023)) + VIN_VOLTAGE_CORRECTION;
 #    else
-            float tVIN = tVINRaw * ((11.0 * 1.1) / 1023);
+        float tVIN = tVINRaw * ((11.0 * 1.1) / 1023);
 #    endif
+        PWMDcMotor::setVINMillivolt(tVIN * 1000); // keep motor voltage constant while battery is discharging
+        if(abs(sLastVINRaw - tVINRaw) > 2) {
+            sLastVINRaw = tVINRaw;
             Serial.print(F("VIN="));
             Serial.print(tVIN);
             Serial.println(F("V"));
@@ -0,0 +1,368 @@
+/*
+ *  InstructionCounter.c
+ *
+ *  Runs an ATmega328P ELF file under simavr and counts the executed instructions and cycles
+ *  for each call of the given functions, including all nested calls and interrupts.
+ *  Additionally the longest time with interrupts disabled is reported, which is the worst case
+ *  interrupt latency caused by the program.
+ *  Encoder and IR signals can be generated at port pins to trigger the ISRs.
+ *  The serial output of the program is copied to stderr.
+ *
+ *  Build with:
+ *  gcc -O2 -Wall InstructionCounter.c -o InstructionCounter -lsimavr -lelf
+ *
+ *  Usage: InstructionCounter [options] <file.elf>
+ *  -f <name>=<hex byte address>  Count calls of this function. Up to 16 functions.
+ *  -s <port><bit>:<microseconds>  Square wave with this half period at this pin e.g. D2:5000 for an encoder.
+ *  -n <port><bit>:<milliseconds>  NEC IR frame (address 0, command 0x11) every <milliseconds> at this pin e.g. B3:200.
+ *  -t <seconds>                   Simulated time to run. Default is 10.
+ *  -l <label>                     Printed as example=<label> in front of every output line.
+ *  Output is one line of key=value pairs per function, to be easily processed by scripts.
+ *
+ *  Copyright (C) 2022  Armin Joachimsmeyer
+ *  armin.joachimsmeyer@gmail.com
+ *
+ *  This file is part of PWMMotorControl https://github.com/ArminJo/PWMMotorControl.
+ *
+ *  PWMMotorControl is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/gpl.html>.
+ *
+ */
+
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <simavr/sim_avr.h>
+#include <simavr/sim_elf.h>
+#include <simavr/sim_io.h>
+#include <simavr/sim_cycle_timers.h>
+#include <simavr/avr_ioport.h>
+#include <simavr/avr_uart.h>
+
+#define MCU_NAME            "atmega328p"
+#define MCU_FREQUENCY       16000000
+#define MAX_FUNCTIONS       16
+#define MAX_CALL_DEPTH      32
+#define MAX_PIN_SIGNALS     4
+
+struct CountedFunction {
+    const char *Name;
+    uint32_t Address; // byte address as printed by avr-nm
+    uint32_t Calls;
+    uint64_t InstructionsSum;
+    uint32_t InstructionsMin;
+    uint32_t InstructionsMax;
+    uint64_t CyclesSum;
+    uint32_t CyclesMin;
+    uint32_t CyclesMax;
+};
+
+/*
+ * A running call of a counted function
+ */
+struct CallFrame {
+    struct CountedFunction *Function;
+    uint32_t ReturnAddress;
+    uint16_t EntryStackPointer;
+    uint64_t EntryInstructions;
+    avr_cycle_count_t EntryCycle;
+};
+
+/*
+ * Square wave or NEC frame at one pin
+ */
+struct PinSignal {
+    avr_irq_t *PinIrq;
+    uint32_t PeriodMicros;
+    uint8_t Level;
+    uint8_t NECEdgeIndex;
+};
+
+struct CountedFunction sFunctions[MAX_FUNCTIONS];
+uint8_t sNumberOfFunctions;
+struct CallFrame sCallStack[MAX_CALL_DEPTH];
+uint8_t sCallDepth;
+struct PinSignal sPinSignals[MAX_PIN_SIGNALS];
+uint8_t sNumberOfPinSignals;
+
+uint64_t sInstructions;
+bool sInterruptsWereEnabled; // interrupts are disabled from reset until init()
+avr_cycle_count_t sInterruptsDisabledStartCycle;
+uint32_t sInterruptsDisabledMaxCycles;
+const char *sLabel = "";
+
+/*
+ * NEC timing in microseconds: 9 ms mark, 4.5 ms space, 32 bits with 560 us mark and 560 / 1690 us space, 560 us stop mark.
+ * Address 0x00 command 0x11, LSB first, each followed by its inverse.
+ */
+#define NEC_NUMBER_OF_EDGES (2 + (32 * 2) + 1)
+uint16_t sNECEdgeMicros[NEC_NUMBER_OF_EDGES];
+
+void initNECEdges() {
+    uint32_t tRawData = 0x00 | (0xFFUL << 8) | (0x11UL << 16) | ((uint32_t) (0x11 ^ 0xFF) << 24);
+    uint8_t tIndex = 0;
+    sNECEdgeMicros[tIndex++] = 9000;
+    sNECEdgeMicros[tIndex++] = 4500;
+    for (uint8_t i = 0; i < 32; ++i) {
+        sNECEdgeMicros[tIndex++] = 560;
+        sNECEdgeMicros[tIndex++] = (tRawData & 1) ? 1690 : 560;
+        tRawData >>= 1;
+    }
+    sNECEdgeMicros[tIndex] = 560;
+}
+
+avr_cycle_count_t handleSquareWave(avr_t *aAvr, avr_cycle_count_t aWhen, void *aParam) {
+    struct PinSignal *tSignal = (struct PinSignal*) aParam;
+    tSignal->Level = !tSignal->Level;
+    avr_raise_irq(tSignal->PinIrq, tSignal->Level);
+    return aWhen + avr_usec_to_cycles(aAvr, tSignal->PeriodMicros);
+}
+
+/*
+ * IR receiver output is active low
+ */
+avr_cycle_count_t handleNECFrame(avr_t *aAvr, avr_cycle_count_t aWhen, void *aParam) {
+    struct PinSignal *tSignal = (struct PinSignal*) aParam;
+    if (tSignal->NECEdgeIndex >= NEC_NUMBER_OF_EDGES) {
+        // end of stop mark -> idle until next frame
+        tSignal->NECEdgeIndex = 0;
+        avr_raise_irq(tSignal->PinIrq, 1);
+        return aWhen + avr_usec_to_cycles(aAvr, tSignal->PeriodMicros);
+    }
+    avr_raise_irq(tSignal->PinIrq, (tSignal->NECEdgeIndex & 1)); // even index is mark
+    return aWhen + avr_usec_to_cycles(aAvr, sNECEdgeMicros[tSignal->NECEdgeIndex++]);
+}
+
+void handleUartOutput(struct avr_irq_t *aIrq, uint32_t aValue, void *aParam) {
+    (void) aIrq;
+    (void) aParam;
+    fputc(aValue, stderr);
+}
+
+uint16_t getStackPointer(avr_t *aAvr) {
+    return aAvr->data[R_SPL] | (aAvr->data[R_SPH] << 8);
+}
+
+/*
+ * Called before each instruction
+ */
+void checkFunctionEntry(avr_t *aAvr) {
+    for (uint8_t i = 0; i < sNumberOfFunctions; ++i) {
+        if (aAvr->pc == sFunctions[i].Address && sCallDepth < MAX_CALL_DEPTH) {
+            /*
+             * Return address is on stack, high byte first, as word address
+             */
+            uint16_t tStackPointer = getStackPointer(aAvr);
+            struct CallFrame *tFrame = &sCallStack[sCallDepth++];
+            tFrame->Function = &sFunctions[i];
+            tFrame->ReturnAddress = ((aAvr->data[tStackPointer + 1] << 8) | aAvr->data[tStackPointer + 2]) * 2;
+            tFrame->EntryStackPointer = tStackPointer;
+            tFrame->EntryInstructions = sInstructions;
+            tFrame->EntryCycle = aAvr->cycle;
+            return;
+        }
+    }
+}
+
+/*
+ * Called after each instruction. Also works for functions entered by a tail jump.
+ */
+void checkFunctionReturn(avr_t *aAvr) {
+    while (sCallDepth > 0) {
+        struct CallFrame *tFrame = &sCallStack[sCallDepth - 1];
+        if (aAvr->pc != tFrame->ReturnAddress || getStackPointer(aAvr) != tFrame->EntryStackPointer + 2) {
+            return;
+        }
+        sCallDepth--;
+        struct CountedFunction *tFunction = tFrame->Function;
+        uint32_t tInstructions = sInstructions - tFrame->EntryInstructions;
+        uint32_t tCycles = aAvr->cycle - tFrame->EntryCycle;
+        if (tFunction->Calls == 0 || tInstructions < tFunction->InstructionsMin) {
+            tFunction->InstructionsMin = tInstructions;
+        }
+        if (tInstructions > tFunction->InstructionsMax) {
+            tFunction->InstructionsMax = tInstructions;
+        }
+        if (tFunction->Calls == 0 || tCycles < tFunction->CyclesMin) {
+            tFunction->CyclesMin = tCycles;
+        }
+        if (tCycles > tFunction->CyclesMax) {
+            tFunction->CyclesMax = tCycles;
+        }
+        tFunction->InstructionsSum += tInstructions;
+        tFunction->CyclesSum += tCycles;
+        tFunction->Calls++;
+    }
+}
+
+void checkInterruptsDisabled(avr_t *aAvr) {
+    if (!aAvr->sreg[S_I]) {
+        if (sInterruptsWereEnabled && sInterruptsDisabledStartCycle == 0) {
+            sInterruptsDisabledStartCycle = aAvr->cycle;
+        }
+    } else if (!sInterruptsWereEnabled) {
+        sInterruptsWereEnabled = true;
+    } else if (sInterruptsDisabledStartCycle != 0) {
+        uint32_t tCycles = aAvr->cycle - sInterruptsDisabledStartCycle;
+        if (tCycles > sInterruptsDisabledMaxCycles) {
+            sInterruptsDisabledMaxCycles = tCycles;
+        }
+        sInterruptsDisabledStartCycle = 0;
+    }
+}
+
+/*
+ * Parses "D2:5000"
+ */
+bool addPinSignal(avr_t *aAvr, const char *aArgument, bool aIsNEC) {
+    char tPort;
+    unsigned int tBit;
+    unsigned long tPeriod;
+    if (sNumberOfPinSignals >= MAX_PIN_SIGNALS || sscanf(aArgument, "%c%u:%lu", &tPort, &tBit, &tPeriod) != 3 || tBit > 7) {
+        return false;
+    }
+    struct PinSignal *tSignal = &sPinSignals[sNumberOfPinSignals++];
+    tSignal->PinIrq = avr_io_getirq(aAvr, AVR_IOCTL_IOPORT_GETIRQ(tPort), tBit);
+    if (tSignal->PinIrq == NULL) {
+        return false;
+    }
+    tSignal->Level = 1;
+    avr_raise_irq(tSignal->PinIrq, 1);
+    if (aIsNEC) {
+        tSignal->PeriodMicros = tPeriod * 1000;
+        avr_cycle_timer_register_usec(aAvr, tSignal->PeriodMicros, handleNECFrame, tSignal);
+    } else {
+        tSignal->PeriodMicros = tPeriod;
+        avr_cycle_timer_register_usec(aAvr, tSignal->PeriodMicros, handleSquareWave, tSignal);
+    }
+    return true;
+}
+
+void printUsageAndExit(const char *aProgramName) {
+    fprintf(stderr, "Usage: %s [-f <name>=<hex address>]... [-s <port><bit>:<us>]... [-n <port><bit>:<ms>] [-t <seconds>]"
+            " [-l <label>] <file.elf>\n", aProgramName);
+    exit(2);
+}
+
+int main(int argc, char *argv[]) {
+    const char *tSignalArguments[MAX_PIN_SIGNALS];
+    bool tSignalIsNEC[MAX_PIN_SIGNALS];
+    uint8_t tNumberOfSignalArguments = 0;
+    unsigned long tSeconds = 10;
+    int tOption;
+
+    while ((tOption = getopt(argc, argv, "f:s:n:t:l:")) != -1) {
+        switch (tOption) {
+        case 'f': {
+            char *tSeparator = strrchr(optarg, '=');
+            if (tSeparator == NULL || sNumberOfFunctions >= MAX_FUNCTIONS) {
+                printUsageAndExit(argv[0]);
+            }
+            *tSeparator = '\0';
+            sFunctions[sNumberOfFunctions].Name = optarg;
+            sFunctions[sNumberOfFunctions].Address = strtoul(tSeparator + 1, NULL, 16);
+            sNumberOfFunctions++;
+            break;
+        }
+        case 's':
+        case 'n':
+            if (tNumberOfSignalArguments >= MAX_PIN_SIGNALS) {
+                printUsageAndExit(argv[0]);
+            }
+            tSignalIsNEC[tNumberOfSignalArguments] = (tOption == 'n');
+            tSignalArguments[tNumberOfSignalArguments++] = optarg;
+            break;
+        case 't':
+            tSeconds = strtoul(optarg, NULL, 10);
+            break;
+        case 'l':
+            sLabel = optarg;
+            break;
+        default:
+            printUsageAndExit(argv[0]);
+        }
+    }
+    if (optind >= argc) {
+        printUsageAndExit(argv[0]);
+    }
+
+    elf_firmware_t tFirmware;
+    memset(&tFirmware, 0, sizeof(tFirmware));
+    if (elf_read_firmware(argv[optind], &tFirmware) != 0) {
+        fprintf(stderr, "Cannot read %s\n", argv[optind]);
+        return 2;
+    }
+    // Arduino ELF files contain no .mmcu section
+    strcpy(tFirmware.mmcu, MCU_NAME);
+    tFirmware.frequency = MCU_FREQUENCY;
+
+    avr_t *tAvr = avr_make_mcu_by_name(MCU_NAME);
+    if (tAvr == NULL) {
+        fprintf(stderr, "simavr has no " MCU_NAME "\n");
+        return 2;
+    }
+    avr_init(tAvr);
+    avr_load_firmware(tAvr, &tFirmware);
+
+    /*
+     * Copy serial output to stderr instead of the simavr stdout logging
+     */
+    uint32_t tUartFlags = 0;
+    avr_ioctl(tAvr, AVR_IOCTL_UART_GET_FLAGS('0'), &tUartFlags);
+    tUartFlags &= ~AVR_UART_FLAG_STDIO;
+    avr_ioctl(tAvr, AVR_IOCTL_UART_SET_FLAGS('0'), &tUartFlags);
+    avr_irq_register_notify(avr_io_getirq(tAvr, AVR_IOCTL_UART_GETIRQ('0'), UART_IRQ_OUTPUT), handleUartOutput, NULL);
+
+    initNECEdges();
+    for (uint8_t i = 0; i < tNumberOfSignalArguments; ++i) {
+        if (!addPinSignal(tAvr, tSignalArguments[i], tSignalIsNEC[i])) {
+            fprintf(stderr, "Invalid pin signal %s\n", tSignalArguments[i]);
+            return 2;
+        }
+    }
+
+    avr_cycle_count_t tEndCycle = (avr_cycle_count_t) tSeconds * MCU_FREQUENCY;
+    int tState = cpu_Running;
+    while (tAvr->cycle < tEndCycle && tState != cpu_Done && tState != cpu_Crashed) {
+        bool tIsRunning = (tAvr->state == cpu_Running);
+        if (tIsRunning) {
+            checkFunctionEntry(tAvr);
+        }
+        tState = avr_run(tAvr);
+        if (tIsRunning) {
+            sInstructions++; // one instruction per avr_run() call if not sleeping
+        }
+        checkFunctionReturn(tAvr);
+        checkInterruptsDisabled(tAvr);
+    }
+
+    printf("example=%s seconds=%lu instructions=%llu interrupts_disabled_max_cycles=%u interrupts_disabled_max_us=%.2f%s\n", sLabel,
+            tSeconds, (unsigned long long) sInstructions, sInterruptsDisabledMaxCycles,
+            (float) sInterruptsDisabledMaxCycles * 1000000 / MCU_FREQUENCY, (tState == cpu_Crashed ? " crashed=1" : ""));
+    for (uint8_t i = 0; i < sNumberOfFunctions; ++i) {
+        struct CountedFunction *tFunction = &sFunctions[i];
+        if (tFunction->Calls == 0) {
+            printf("example=%s function=%s calls=0\n", sLabel, tFunction->Name);
+            continue;
+        }
+        printf("example=%s function=%s calls=%u instructions_mean=%llu instructions_min=%u instructions_max=%u"
+                " cycles_mean=%llu cycles_min=%u cycles_max=%u us_max=%.2f\n", sLabel, tFunction->Name, tFunction->Calls,
+                (unsigned long long) (tFunction->InstructionsSum / tFunction->Calls), tFunction->InstructionsMin,
+                tFunction->InstructionsMax, (unsigned long long) (tFunction->CyclesSum / tFunction->Calls), tFunction->CyclesMin,
+                tFunction->CyclesMax, (float) tFunction->CyclesMax * 1000000 / MCU_FREQUENCY);
+    }
+    return (tState == cpu_Crashed);
+}
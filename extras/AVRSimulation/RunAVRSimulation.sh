@@ -0,0 +1,84 @@
+#!/bin/bash
+#
+# RunAVRSimulation.sh
+#
+# Builds the examples for an Arduino Uno (ATmega328P) with the same flags as in .github/workflows/LibraryBuild.yml
+# and runs each of them with InstructionCounter under simavr.
+# For updateMotors(), handleEncoderInterrupt(), the encoder ISRs and IRPinChangeInterruptHandler() the
+# instructions and cycles per call are printed, as well as the longest time with interrupts disabled.
+# Functions which are inlined or not used by an example are printed with calls=absent.
+# Both encoder inputs get a square wave of 100 Hz (RISING edge every 10 ms), the IR input pin 11 gets a NEC frame every 200 ms.
+# The serial output of the examples is written to <example>.log in the build directory.
+#
+# Requires arduino-cli with the arduino:avr core and the libraries of LibraryBuild.yml installed,
+# avr-nm in the PATH and simavr with its development files (e.g. the simavr and libsimavr-dev packages).
+#
+# Usage: ./RunAVRSimulation.sh [<seconds to simulate, default 10> [<build directory>]]
+#
+#  Copyright (C) 2022  Armin Joachimsmeyer
+#  armin.joachimsmeyer@gmail.com
+#
+#  This file is part of PWMMotorControl https://github.com/ArminJo/PWMMotorControl.
+#
+#  PWMMotorControl is free software: you can redistribute it and/or modify
+#  it under the terms of the GNU General Public License as published by
+#  the Free Software Foundation, either version 3 of the License, or
+#  (at your option) any later version.
+#
+#  This program is distributed in the hope that it will be useful,
+#  but WITHOUT ANY WARRANTY; without even the implied warranty of
+#  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+#  GNU General Public License for more details.
+#
+#  You should have received a copy of the GNU General Public License
+#  along with this program.  If not, see <http://www.gnu.org/licenses/gpl.html>.
+#
+cd "$(dirname "$0")" || exit 2
+SECONDS_TO_SIMULATE=${1:-10}
+BUILD_DIR=${2:-$(mktemp -d)}
+mkdir -p "$BUILD_DIR"
+AVR_NM=${AVR_NM:-avr-nm}
+
+gcc -O2 -Wall InstructionCounter.c -o "$BUILD_DIR/InstructionCounter" -lsimavr -lelf || exit 2
+
+# Keep in sync with the build-properties of arduino:avr:uno in LibraryBuild.yml
+EXAMPLES=(Start Square PrintMotorDiagram RobotCarBlueDisplay SmartCarFollower Benchmark)
+declare -A FLAGS=(
+    [PrintMotorDiagram]="-DUSE_ENCODER_MOTOR_CONTROL"
+    [RobotCarBlueDisplay]="-DBLUETOOTH_BAUD_RATE=BAUD_115200 -DDO_NOT_NEED_BASIC_TOUCH_EVENTS -DBREADBOARD_FULL_CONFIGURATION -DUS_SENSOR_SUPPORTS_1_PIN_MODE -DENABLE_MOTOR_LIST_FUNCTIONS"
+    [Benchmark]="-DUSE_ENCODER_MOTOR_CONTROL"
+)
+# Demangled names as printed by avr-nm -C. __vector_1 / 2 are INT0 / INT1 used by attachInterrupt(), __vector_3 is PCINT0 used for the IR pin 11.
+FUNCTIONS=("CarPWMMotorControl::updateMotors(" "EncoderMotor::handleEncoderInterrupt()" "EncoderMotor::ISR0()" "EncoderMotor::ISR1()"
+    "IRPinChangeInterruptHandler()" "__vector_1" "__vector_2" "__vector_3")
+
+for EXAMPLE in "${EXAMPLES[@]}"; do
+    OUTPUT_DIR="$BUILD_DIR/$EXAMPLE"
+    arduino-cli compile --fqbn arduino:avr:uno --library ../.. --output-dir "$OUTPUT_DIR" \
+        --build-property "compiler.cpp.extra_flags=${FLAGS[$EXAMPLE]}" "../../examples/$EXAMPLE" > "$BUILD_DIR/$EXAMPLE.build.log" 2>&1
+    if [ $? -ne 0 ]; then
+        echo "example=$EXAMPLE build=failed log=$BUILD_DIR/$EXAMPLE.build.log"
+        continue
+    fi
+    ELF_FILE="$OUTPUT_DIR/$EXAMPLE.ino.elf"
+
+    FUNCTION_ARGUMENTS=()
+    for FUNCTION in "${FUNCTIONS[@]}"; do
+        # One line per overload, e.g. "00000a2e T CarPWMMotorControl::updateMotors(void (*)())". A trailing "(" matches all overloads.
+        SYMBOLS=$("$AVR_NM" -C "$ELF_FILE" | awk -v aName="$FUNCTION" 'tolower($2) == "t" {
+            tAddress = $1; $1 = ""; $2 = ""; tName = substr($0, 3)
+            if (tName == aName || (substr(aName, length(aName)) == "(" && index(tName, aName) == 1)) print tAddress, tName
+        }')
+        if [ -z "$SYMBOLS" ]; then
+            echo "example=$EXAMPLE function=${FUNCTION// /} calls=absent"
+            continue
+        fi
+        while read -r ADDRESS NAME; do
+            FUNCTION_ARGUMENTS+=(-f "${NAME// /}=$ADDRESS")
+        done <<< "$SYMBOLS"
+    done
+
+    "$BUILD_DIR/InstructionCounter" -l "$EXAMPLE" -t "$SECONDS_TO_SIMULATE" -s D2:5000 -s D3:5000 -n B3:200 \
+        "${FUNCTION_ARGUMENTS[@]}" "$ELF_FILE" 2> "$BUILD_DIR/$EXAMPLE.log"
+done
+echo "build_dir=$BUILD_DIR"
@@ -0,0 +1,120 @@
+/*
+ *  ArcTrials.cpp
+ *
+ *  Drives arc() with different radii and rotations against CarPlant and checks for each arc
+ *  1. The heading of the car after the stop against the requested rotation.
+ *  2. The end position of the car center against the end point of the arc with the requested radius.
+ *  Radius 0 is a turn in place, where the car center must not move.
+ *
+ *  Build and run from this directory with:
+ *  g++ -std=gnu++11 -O2 -Wall -DUSE_ENCODER_MOTOR_CONTROL -I. -I../../src ArcTrials.cpp -o ArcTrials && ./ArcTrials
+ *  Output is one line of key=value pairs per arc and a summary line. Exit code is 1 if a check failed.
+ *
+ *  Copyright (C) 2022  Armin Joachimsmeyer
+ *  armin.joachimsmeyer@gmail.com
+ *
+ *  This file is part of PWMMotorControl https://github.com/ArminJo/PWMMotorControl.
+ *
+ *  PWMMotorControl is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/gpl.html>.
+ *
+ */
+
+#include <Arduino.h>
+
+#if !defined(USE_ENCODER_MOTOR_CONTROL)
+#error ArcTrials requires -DUSE_ENCODER_MOTOR_CONTROL
+#endif
+
+#include "HostArduino.hpp"
+
+#define VIN_2_LIPO
+#include "CarPWMMotorControl.hpp"
+#include "CarPlant.hpp"
+
+/*
+ * A difference of 1 encoder count between both wheels gives a heading error of 4.8 degree for a track of 130 mm.
+ * The plant runs about 1 count ahead of the encoder at the stop, which moves the end position by about 15 mm.
+ * The inner wheel of a small radius starts up to 300 ms after the outer wheel, since its low profile velocity
+ * needs the integral of the speed control to exceed the start PWM. This bends the first part of the arc.
+ */
+#if !defined(ARC_MAX_HEADING_ERROR_DEGREE)
+#define ARC_MAX_HEADING_ERROR_DEGREE        10
+#endif
+#if !defined(ARC_MAX_POSITION_ERROR_MILLIMETER)
+#define ARC_MAX_POSITION_ERROR_MILLIMETER   50
+#endif
+#define ARC_TIMEOUT_MILLIS              10000
+
+CarPlant sCarPlant;
+
+unsigned long sNumberOfFailedChecks;
+unsigned long sNumberOfChecks;
+
+void check(const char *aName, bool aCondition, int aRadiusMillimeter, int aRotationDegrees) {
+    sNumberOfChecks++;
+    if (!aCondition) {
+        sNumberOfFailedChecks++;
+        printf("check=%s failed radius_mm=%d rotation_deg=%d\n", aName, aRadiusMillimeter, aRotationDegrees);
+    }
+}
+
+/*
+ * The car starts at 0,0 with heading 0 along the x axis. A positive rotation turns left, i.e. the center of the arc is at 0,radius.
+ */
+void driveArc(int aRadiusMillimeter, int aRotationDegrees) {
+    sCarPlant.reset();
+    uint32_t tStartMillis = millis();
+    RobotCarPWMMotorControl.startArc(aRadiusMillimeter, aRotationDegrees);
+    while (RobotCarPWMMotorControl.updateMotors() && millis() - tStartMillis < ARC_TIMEOUT_MILLIS) {
+        delay(1);
+    }
+    uint32_t tDriveMillis = millis() - tStartMillis;
+    while (!sCarPlant.isStopped()) {
+        delay(1);
+    }
+
+    float tRotationRadian = aRotationDegrees * (M_PI / 180.0);
+    float tExpectedX = aRadiusMillimeter * sin(fabs(tRotationRadian));
+    float tExpectedY = aRadiusMillimeter * (1.0 - cos(tRotationRadian));
+    if (aRotationDegrees < 0) {
+        tExpectedY = -tExpectedY;
+    }
+    float tHeadingError = sCarPlant.getHeadingDegree() - aRotationDegrees;
+    float tPositionError = hypot(sCarPlant.XMillimeter - tExpectedX, sCarPlant.YMillimeter - tExpectedY);
+    printf("test=arc radius_mm=%d rotation_deg=%d heading_deg=%.1f heading_error_deg=%.1f x_mm=%.0f y_mm=%.0f"
+            " position_error_mm=%.1f drive_ms=%lu\n", aRadiusMillimeter, aRotationDegrees, sCarPlant.getHeadingDegree(), tHeadingError,
+            sCarPlant.XMillimeter, sCarPlant.YMillimeter, tPositionError, (unsigned long) tDriveMillis);
+    check("heading", fabs(tHeadingError) <= ARC_MAX_HEADING_ERROR_DEGREE, aRadiusMillimeter, aRotationDegrees);
+    check("position", tPositionError <= ARC_MAX_POSITION_ERROR_MILLIMETER, aRadiusMillimeter, aRotationDegrees);
+    delay(500);
+}
+
+int main() {
+    Serial.OutputEnabled = false;
+    VirtualClock::reset();
+    sCarPlant.init();
+
+    RobotCarPWMMotorControl.init(RIGHT_MOTOR_FORWARD_PIN, RIGHT_MOTOR_BACKWARD_PIN, RIGHT_MOTOR_PWM_PIN, LEFT_MOTOR_FORWARD_PIN,
+    LEFT_MOTOR_BACKWARD_PIN, LEFT_MOTOR_PWM_PIN);
+
+    const int tRadii[] = { 0, 50, 100, 200, 300, 500 };
+    const int tRotations[] = { 30, 90, -90, 180 };
+    for (uint_fast8_t i = 0; i < sizeof(tRadii) / sizeof(tRadii[0]); ++i) {
+        for (uint_fast8_t j = 0; j < sizeof(tRotations) / sizeof(tRotations[0]); ++j) {
+            driveArc(tRadii[i], tRotations[j]);
+        }
+    }
+    printf("checks=%lu failed_checks=%lu\n", sNumberOfChecks, sNumberOfFailedChecks);
+    return (sNumberOfFailedChecks == 0 ? 0 : 1);
+}
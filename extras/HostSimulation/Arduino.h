@@ -0,0 +1,273 @@
+/*
+ * Arduino.h
+ *
+ * Host (Linux / gcc) stand-in for the Arduino core, used to compile the unmodified library sources of the src directory
+ * on a PC for simulation, regression runs and benchmarking.
+ *
+ * Time is NOT taken from the PC clock. It is a deterministic virtual clock (see class VirtualClock), which is only advanced by
+ * delay(), delayMicroseconds() and by a small fixed cost for every call to millis() or micros().
+ * The latter guarantees progress for the busy wait loops of the library like "while (millis() <= x) { updateMotor(); }".
+ * Simulated hardware (e.g. the motor plant or the MPU6050) registers as VirtualClockComponent and gets called exactly
+ * at the virtual time of its next event, so hours of driving can be simulated in seconds.
+ *
+ * Differences to AVR you should be aware of:
+ * - int is 32 bit and long is 64 bit, so some 16 bit overflows of the AVR code do not happen here.
+ * - Pins, PWM values and interrupt handlers are just stored in arrays and can be inspected by the simulation.
+ *
+ *  Copyright (C) 2022  Armin Joachimsmeyer
+ *  armin.joachimsmeyer@gmail.com
+ *
+ *  This file is part of PWMMotorControl https://github.com/ArminJo/PWMMotorControl.
+ *
+ *  PWMMotorControl is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/gpl.html>.
+ */
+
+#ifndef HOST_ARDUINO_H
+#define HOST_ARDUINO_H
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <stdio.h>
+#include <type_traits>
+
+#define ARDUINO 10819
+#define ARDUINO_ARCH_HOST
+#define F_CPU 16000000L
+
+typedef bool boolean;
+typedef uint8_t byte;
+
+#define HIGH            0x1
+#define LOW             0x0
+#define INPUT           0x0
+#define OUTPUT          0x1
+#define INPUT_PULLUP    0x2
+
+#define CHANGE          1
+#define FALLING         2
+#define RISING          3
+
+#define DEC             10
+#define HEX             16
+#define OCT             8
+#define BIN             2
+
+#define PROGMEM
+#define PSTR(s) (s)
+#define pgm_read_byte(addr) (*(const uint8_t *)(addr))
+#define pgm_read_word(addr) (*(const uint16_t *)(addr))
+#define _BV(bit) (1 << (bit))
+
+/*
+ * ATmega328 like pin layout
+ */
+#define NUM_DIGITAL_PINS        20
+#if !defined(NUMBER_OF_INTERRUPTS)
+#  if defined(CAR_NUMBER_OF_MOTORS_PER_SIDE) && CAR_NUMBER_OF_MOTORS_PER_SIDE == 2
+#define NUMBER_OF_INTERRUPTS    4 // 2 more for the encoders of the rear motors
+#  else
+#define NUMBER_OF_INTERRUPTS    2 // may be increased for the encoders of the follower motors of CAR_NUMBER_OF_MOTORS_PER_SIDE
+#  endif
+#endif
+#define NOT_AN_INTERRUPT        -1
+#define INT0                    0
+#define INT1                    1
+#define digitalPinToInterrupt(p) ((p) == 2 ? 0 : ((p) == 3 ? 1 : NOT_AN_INTERRUPT))
+#define LED_BUILTIN             13
+#define A0                      14
+#define A1                      15
+#define A2                      16
+#define A3                      17
+#define A4                      18
+#define A5                      19
+#define A6                      20
+#define A7                      21
+
+// The ATmega328 EEPROM size. E2END enables the EEPROM functions of PWMDcMotor
+#define E2END                   0x3FF
+
+#define PI                      3.1415926535897932384626433832795
+#define DEG_TO_RAD              0.017453292519943295769236907684886
+#define RAD_TO_DEG              57.295779513082320876798154814105
+
+#define constrain(amt,low,high) ((amt)<(low)?(low):((amt)>(high)?(high):(amt)))
+
+template<typename T1, typename T2> inline typename std::common_type<T1, T2>::type min(T1 a, T2 b) {
+    return (a < b) ? a : b;
+}
+template<typename T1, typename T2> inline typename std::common_type<T1, T2>::type max(T1 a, T2 b) {
+    return (a > b) ? a : b;
+}
+inline long map(long x, long in_min, long in_max, long out_min, long out_max) {
+    return (x - in_min) * (out_max - out_min) / (in_max - in_min) + out_min;
+}
+
+/*
+ * Flash strings are plain strings on the host
+ */
+class __FlashStringHelper;
+#define F(string_literal) (reinterpret_cast<const __FlashStringHelper *>(string_literal))
+
+class Print {
+public:
+    virtual ~Print() {
+    }
+    virtual size_t write(uint8_t aByte) = 0;
+    size_t write(const char *aString);
+    size_t write(const uint8_t *aBuffer, size_t aSize);
+
+    size_t print(const __FlashStringHelper *aString);
+    size_t print(const char aString[]);
+    size_t print(char aChar);
+    size_t print(unsigned char aValue, int aBase = DEC);
+    size_t print(int aValue, int aBase = DEC);
+    size_t print(unsigned int aValue, int aBase = DEC);
+    size_t print(long aValue, int aBase = DEC);
+    size_t print(unsigned long aValue, int aBase = DEC);
+    size_t print(long long aValue, int aBase = DEC);
+    size_t print(unsigned long long aValue, int aBase = DEC);
+    size_t print(double aValue, int aDigits = 2);
+
+    size_t println();
+    template<typename T> size_t println(T aValue) {
+        size_t tCount = print(aValue);
+        return tCount + println();
+    }
+    template<typename T> size_t println(T aValue, int aFormat) {
+        size_t tCount = print(aValue, aFormat);
+        return tCount + println();
+    }
+
+private:
+    size_t printNumber(unsigned long long aValue, uint8_t aBase);
+};
+
+/*
+ * Writes to stdout. Output can be suppressed for fast simulation runs by setting OutputEnabled to false.
+ */
+class HardwareSerial: public Print {
+public:
+    void begin(unsigned long aBaudRate);
+    void end();
+    void flush();
+    int available();
+    int read();
+    size_t write(uint8_t aByte) override;
+    using Print::write;
+    operator bool() {
+        return true;
+    }
+
+    bool OutputEnabled = true;
+    unsigned long WrittenBytesCount; // to estimate the time required by Serial output on the real target
+};
+extern HardwareSerial Serial;
+
+/*
+ * Interface for simulated hardware, which must be called at well defined virtual times.
+ */
+class VirtualClockComponent {
+public:
+    virtual ~VirtualClockComponent() {
+    }
+    virtual uint64_t getNextEventMicros() = 0; // absolute virtual time of next event
+    virtual void handleEvent(uint64_t aNowMicros) = 0; // called with VirtualClock::Micros == getNextEventMicros()
+};
+
+#define VIRTUAL_CLOCK_MAX_COMPONENTS    4
+#define VIRTUAL_CLOCK_MICROS_PER_CALL   4 // Simulated CPU time for one millis() or micros() call and the code around it
+
+class VirtualClock {
+public:
+    static void reset();
+    static void advanceMicros(uint32_t aMicros);
+    static void advanceToMicros(uint64_t aAbsoluteMicros);
+    static void addComponent(VirtualClockComponent *aComponent);
+    static void removeAllComponents();
+
+    static uint64_t Micros;             // the current virtual time
+    static uint16_t MicrosPerCall;      // the cost of each millis() and micros() call, 0 freezes time for busy wait loops!
+    static bool IsHandlingEvent;        // no time advance while a component or an ISR is running
+    static uint8_t NumberOfComponents;
+    static VirtualClockComponent *Components[VIRTUAL_CLOCK_MAX_COMPONENTS];
+};
+
+unsigned long millis();
+unsigned long micros();
+void delay(unsigned long aMillis);
+void delayMicroseconds(unsigned int aMicros);
+void yield();
+
+/*
+ * Pin and interrupt functions only store the values for inspection by the simulation
+ */
+struct HostPinState {
+    uint8_t Mode;
+    uint8_t DigitalLevel;
+    uint8_t AnalogWriteValue;
+    uint16_t AnalogReadValue;   // to be set by the simulation
+};
+extern HostPinState sHostPins[NUM_DIGITAL_PINS + 2];
+
+void pinMode(uint8_t aPin, uint8_t aMode);
+void digitalWrite(uint8_t aPin, uint8_t aValue);
+int digitalRead(uint8_t aPin);
+void analogWrite(uint8_t aPin, int aValue);
+int analogRead(uint8_t aPin);
+
+/*
+ * No sound and no echo. pulseIn() waits for the timeout and returns 0.
+ */
+void tone(uint8_t aPin, unsigned int aFrequency, unsigned long aDuration = 0);
+void noTone(uint8_t aPin);
+unsigned long pulseIn(uint8_t aPin, uint8_t aState, unsigned long aTimeoutMicros = 1000000L);
+unsigned long pulseInLong(uint8_t aPin, uint8_t aState, unsigned long aTimeoutMicros = 1000000L);
+
+void attachInterrupt(uint8_t aInterruptNumber, void (*aISR)(void), int aMode);
+void detachInterrupt(uint8_t aInterruptNumber);
+void noInterrupts();
+void interrupts();
+#define cli() noInterrupts()
+#define sei() interrupts()
+void triggerHostInterrupt(uint8_t aInterruptNumber); // called by simulation, executes now or when interrupts are enabled again
+
+/*
+ * Stand-in for a hardware timer compare interrupt. It is handled like the external interrupts with number HOST_TIMER_INTERRUPT.
+ */
+#define HOST_TIMER_INTERRUPT        NUMBER_OF_INTERRUPTS
+#define NUMBER_OF_HOST_INTERRUPTS   (NUMBER_OF_INTERRUPTS + 1)
+void startHostTimerInterrupt(uint32_t aPeriodMicros, void (*aISR)(void));
+void stopHostTimerInterrupt();
+
+extern void (*sHostInterruptHandlers[NUMBER_OF_HOST_INTERRUPTS])(void);
+extern bool sHostInterruptsEnabled;
+
+long random(long aMax);
+long random(long aMin, long aMax);
+void randomSeed(unsigned long aSeed);
+
+/*
+ * AVR EEPROM functions, working on a RAM array
+ */
+extern uint8_t sHostEEPROM[E2END + 1];
+uint8_t eeprom_read_byte(const uint8_t *aAddress);
+void eeprom_write_byte(uint8_t *aAddress, uint8_t aValue);
+void eeprom_update_byte(uint8_t *aAddress, uint8_t aValue);
+void eeprom_read_block(void *aDestination, const void *aSource, size_t aSize);
+void eeprom_write_block(const void *aSource, void *aDestination, size_t aSize);
+void eeprom_update_block(const void *aSource, void *aDestination, size_t aSize);
+
+#endif // HOST_ARDUINO_H
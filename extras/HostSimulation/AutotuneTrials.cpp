@@ -0,0 +1,202 @@
+/*
+ *  AutotuneTrials.cpp
+ *
+ *  Runs CarPWMMotorControl::autotuneSpeedControl() against the simulated car of CarPlant.h with random plant parameters
+ *  for each motor (battery voltage, friction and time constant) and compares the speed control with the default gains
+ *  SPEED_CONTROL_KP_TIMES_256 and SPEED_CONTROL_KI_TIMES_256 and with the autotuned gains on the same plant.
+ *  Each comparison drives with DEFAULT_DRIVE_SPEED_PWM and drops the battery voltage by 20 percent after 1.5 seconds,
+ *  which is not seen by the battery voltage compensation. It prints the time until the speed of both wheels stays within 5 percent
+ *  of the nominal speed after start and after the voltage drop, and the integral of the speed error of both wheels after the drop.
+ *  The speed corrections of the differential drive control by one encoder count leave the 5 percent band,
+ *  add -DDO_NOT_USE_DIFFERENTIAL_DRIVE_CONTROL to compare the settling times of the wheel speed controls alone.
+ *
+ *  Build and run from this directory with:
+ *  g++ -std=gnu++11 -O2 -Wall -DUSE_ENCODER_MOTOR_CONTROL -I. -I../../src AutotuneTrials.cpp -o AutotuneTrials && ./AutotuneTrials [number of trials]
+ *  Output is one line of key=value pairs per trial and per gain set, to be easily processed by scripts.
+ *
+ *  Copyright (C) 2022  Armin Joachimsmeyer
+ *  armin.joachimsmeyer@gmail.com
+ *
+ *  This file is part of PWMMotorControl https://github.com/ArminJo/PWMMotorControl.
+ *
+ *  PWMMotorControl is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/gpl.html>.
+ *
+ */
+
+#include <Arduino.h>
+
+#if !defined(USE_ENCODER_MOTOR_CONTROL)
+#error AutotuneTrials requires -DUSE_ENCODER_MOTOR_CONTROL
+#endif
+
+#include "HostArduino.hpp"
+
+#define VIN_2_LIPO
+#if !defined(USE_SPEED_CONTROL_AUTOTUNE)
+#define USE_SPEED_CONTROL_AUTOTUNE
+#endif
+#include "CarPWMMotorControl.hpp"
+#include "CarPlant.hpp"
+
+CarPlant sCarPlant;
+
+#define VOLTAGE_DROP_MILLIS     1500
+#define VOLTAGE_DROP_END_MILLIS 3500
+#define VOLTAGE_DROP_PERCENT    20
+
+struct SettlingStatistics {
+    const char *Name;
+    unsigned long NumberOfTrials;
+    double StartSettlingMillisSum;
+    double MaxStartSettlingMillis;
+    double DropSettlingMillisSum;
+    double MaxDropSettlingMillis;
+    double DropErrorMillimeterSum;
+
+    void add(double aStartSettlingMillis, double aDropSettlingMillis, double aDropErrorMillimeter) {
+        NumberOfTrials++;
+        StartSettlingMillisSum += aStartSettlingMillis;
+        if (aStartSettlingMillis > MaxStartSettlingMillis) {
+            MaxStartSettlingMillis = aStartSettlingMillis;
+        }
+        DropSettlingMillisSum += aDropSettlingMillis;
+        if (aDropSettlingMillis > MaxDropSettlingMillis) {
+            MaxDropSettlingMillis = aDropSettlingMillis;
+        }
+        DropErrorMillimeterSum += aDropErrorMillimeter;
+    }
+
+    void print() {
+        printf("gains=%s trials=%lu start_settling_mean_ms=%.1f start_settling_max_ms=%.1f drop_settling_mean_ms=%.1f"
+                " drop_settling_max_ms=%.1f drop_error_mean_mm=%.1f\n", Name, NumberOfTrials, StartSettlingMillisSum / NumberOfTrials,
+                MaxStartSettlingMillis, DropSettlingMillisSum / NumberOfTrials, MaxDropSettlingMillis, DropErrorMillimeterSum / NumberOfTrials);
+    }
+};
+
+SettlingStatistics sDefaultStatistics = { "default" };
+SettlingStatistics sAutotunedStatistics = { "autotuned" };
+unsigned long sNumberOfNotTunedTrials;
+
+float vary(float aValue, uint8_t aPercent) {
+    return aValue * (1.0 + ((long) random(-(long) aPercent * 100, (long) aPercent * 100 + 1)) / 10000.0);
+}
+
+void setSpeedControlGains(uint16_t aKpTimes256[2], uint16_t aKiTimes256[2]) {
+    RobotCarPWMMotorControl.rightCarMotor.setSpeedControlGains(aKpTimes256[0], aKiTimes256[0]);
+    RobotCarPWMMotorControl.leftCarMotor.setSpeedControlGains(aKpTimes256[1], aKiTimes256[1]);
+}
+
+/*
+ * Drive with DEFAULT_DRIVE_SPEED_PWM, drop the battery voltage after VOLTAGE_DROP_MILLIS
+ * and add the last time, the speed of one wheel was outside 5 percent of the nominal speed, before and after the drop
+ */
+void runVoltageDropTrial(SettlingStatistics *aStatistics) {
+    DcMotorPlant *tMotors[2] = { &sCarPlant.RightMotor, &sCarPlant.LeftMotor };
+    uint16_t tSupplyMillivolt[2] = { tMotors[0]->Parameters.SupplyMillivolt, tMotors[1]->Parameters.SupplyMillivolt };
+    float tNominalSpeed = (DEFAULT_MILLIMETER_PER_SECOND * (float) DEFAULT_DRIVE_SPEED_PWM) / DEFAULT_DRIVE_SPEED_PWM;
+
+    sCarPlant.reset();
+    RobotCarPWMMotorControl.setSpeedPWMWithRamp(DEFAULT_DRIVE_SPEED_PWM, DIRECTION_FORWARD);
+    uint32_t tStartMillis = millis();
+    uint32_t tLastOutOfBandMillis[2] = { 0, VOLTAGE_DROP_MILLIS };
+    double tDropErrorMillimeter = 0;
+    while (millis() - tStartMillis < VOLTAGE_DROP_END_MILLIS) {
+        RobotCarPWMMotorControl.updateMotors();
+        delay(1);
+        uint32_t tMillis = millis() - tStartMillis;
+        if (tMillis == VOLTAGE_DROP_MILLIS) {
+            for (uint_fast8_t i = 0; i < 2; ++i) {
+                tMotors[i]->Parameters.SupplyMillivolt = (tSupplyMillivolt[i] * (100L - VOLTAGE_DROP_PERCENT)) / 100;
+            }
+        }
+        for (uint_fast8_t i = 0; i < 2; ++i) {
+            float tSpeedError = fabs(tMotors[i]->SpeedMillimeterPerSecond - tNominalSpeed);
+            if (tSpeedError > tNominalSpeed / 20) {
+                tLastOutOfBandMillis[tMillis >= VOLTAGE_DROP_MILLIS] = tMillis;
+            }
+            if (tMillis >= VOLTAGE_DROP_MILLIS) {
+                tDropErrorMillimeter += tSpeedError / (2 * MILLIS_IN_ONE_SECOND); // average of both wheels
+            }
+        }
+    }
+    RobotCarPWMMotorControl.stop(MOTOR_BRAKE);
+    while (!sCarPlant.isStopped()) {
+        delay(1);
+    }
+    for (uint_fast8_t i = 0; i < 2; ++i) {
+        tMotors[i]->Parameters.SupplyMillivolt = tSupplyMillivolt[i];
+    }
+    aStatistics->add(tLastOutOfBandMillis[0], tLastOutOfBandMillis[1] - VOLTAGE_DROP_MILLIS, tDropErrorMillimeter);
+}
+
+void runAutotuneTrial() {
+    DcMotorPlant *tPlants[2] = { &sCarPlant.RightMotor, &sCarPlant.LeftMotor };
+    EncoderMotor *tMotors[2] = { &RobotCarPWMMotorControl.rightCarMotor, &RobotCarPWMMotorControl.leftCarMotor };
+    uint16_t tSupplyMillivolt = vary(FULL_BRIDGE_INPUT_MILLIVOLT, 10);
+    for (uint_fast8_t i = 0; i < 2; ++i) {
+        DcMotorPlantParameters *tParameters = &tPlants[i]->Parameters;
+        tPlants[i]->setDefaultParameters();
+        tParameters->SupplyMillivolt = tSupplyMillivolt;
+        tParameters->FrictionMillivolt = vary(tParameters->FrictionMillivolt, 20);
+        tParameters->MechanicalTimeConstantMillis = random(50, 151);
+    }
+    PWMDcMotor::VINMillivolt = 0;
+    PWMDcMotor::setVINMillivolt(tSupplyMillivolt);
+
+    uint16_t tDefaultKpTimes256[2] = { SPEED_CONTROL_KP_TIMES_256, SPEED_CONTROL_KP_TIMES_256 };
+    uint16_t tDefaultKiTimes256[2] = { SPEED_CONTROL_KI_TIMES_256, SPEED_CONTROL_KI_TIMES_256 };
+    setSpeedControlGains(tDefaultKpTimes256, tDefaultKiTimes256);
+    sCarPlant.reset();
+    if (!RobotCarPWMMotorControl.autotuneSpeedControl()) {
+        sNumberOfNotTunedTrials++;
+        printf("supply_mv=%u not_tuned\n", tSupplyMillivolt);
+        return;
+    }
+    uint16_t tAutotunedKpTimes256[2];
+    uint16_t tAutotunedKiTimes256[2];
+    for (uint_fast8_t i = 0; i < 2; ++i) {
+        tAutotunedKpTimes256[i] = tMotors[i]->SpeedControlKpTimes256;
+        tAutotunedKiTimes256[i] = tMotors[i]->SpeedControlKiTimes256;
+        printf("motor=%s supply_mv=%u friction_mv=%u time_constant_ms=%u kp_times_256=%u ki_times_256=%u\n", (i == 0 ? "right" : "left"),
+                tSupplyMillivolt, tPlants[i]->Parameters.FrictionMillivolt, tPlants[i]->Parameters.MechanicalTimeConstantMillis,
+                tAutotunedKpTimes256[i], tAutotunedKiTimes256[i]);
+    }
+
+    setSpeedControlGains(tDefaultKpTimes256, tDefaultKiTimes256);
+    runVoltageDropTrial(&sDefaultStatistics);
+    setSpeedControlGains(tAutotunedKpTimes256, tAutotunedKiTimes256);
+    runVoltageDropTrial(&sAutotunedStatistics);
+}
+
+int main(int argc, char *argv[]) {
+    unsigned long tNumberOfTrials = 20;
+    if (argc > 1) {
+        tNumberOfTrials = atol(argv[1]);
+    }
+    Serial.OutputEnabled = false;
+    VirtualClock::reset();
+    sCarPlant.init();
+
+    RobotCarPWMMotorControl.init(RIGHT_MOTOR_FORWARD_PIN, RIGHT_MOTOR_BACKWARD_PIN, RIGHT_MOTOR_PWM_PIN, LEFT_MOTOR_FORWARD_PIN,
+    LEFT_MOTOR_BACKWARD_PIN, LEFT_MOTOR_PWM_PIN);
+
+    for (unsigned long i = 0; i < tNumberOfTrials; ++i) {
+        runAutotuneTrial();
+    }
+
+    printf("trials=%lu virtual_s=%.1f not_tuned=%lu\n", tNumberOfTrials, VirtualClock::Micros / 1e6, sNumberOfNotTunedTrials);
+    sDefaultStatistics.print();
+    sAutotunedStatistics.print();
+    return 0;
+}
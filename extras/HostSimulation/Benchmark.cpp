@@ -0,0 +1,338 @@
+/*
+ *  Benchmark.cpp
+ *
+ *  Times the hot paths of the library, which are called in every loop, under representative states of a drive.
+ *  The car drives a distance, rotates and drives back against the simulated car of CarPlant.h, with a loop period of 1 ms.
+ *  Every call is assigned to the state of the right motor (stopped, start, ramp_up, drive, ramp_down)
+ *  or to imu_rotation, if an IMU rotation is running.
+ *
+ *  Measured are:
+ *  - CarPWMMotorControl::updateMotors()
+ *  - EncoderMotor::updateMotor() and EncoderMotor::getAverageSpeed() for USE_ENCODER_MOTOR_CONTROL
+ *  - IMUCarData::readCarDataFromMPU6050Fifo() for USE_MPU6050_IMU
+ *  - doWallDetection() and postProcessDistances() of the SmartCarFollower example for different scan patterns
+ *
+ *  For every function and state, the host CPU time and the virtual time spent on the (simulated) I2C bus and ADC are printed.
+ *  The latter is independent of the host and the main part of the time readCarDataFromMPU6050Fifo() needs on the real car.
+ *  budget_percent is the percentage of the bus time of the 1 ms loop / IMU budget.
+ *  The host CPU time is no replacement for the AVR cycles, use the Benchmark example in extras/Benchmark for them.
+ *
+ *  Build and run from this directory with:
+ *  g++ -std=gnu++11 -O2 -Wall -I. -I../../src -I../../examples/SmartCarFollower Benchmark.cpp ../../examples/SmartCarFollower/HCSR04.cpp -o Benchmark && ./Benchmark [number of drives]
+ *  Add -DUSE_ENCODER_MOTOR_CONTROL or -DUSE_MPU6050_IMU for the other configurations or use RunBenchmarks.sh, which runs all of them.
+ *  Output is one line of key=value pairs per function and state, to be easily processed by scripts.
+ *
+ *  Copyright (C) 2022  Armin Joachimsmeyer
+ *  armin.joachimsmeyer@gmail.com
+ *
+ *  This file is part of PWMMotorControl https://github.com/ArminJo/PWMMotorControl.
+ *
+ *  PWMMotorControl is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/gpl.html>.
+ *
+ */
+
+#include <Arduino.h>
+#include <time.h>
+#include <vector>
+#include <algorithm>
+
+#include "HostArduino.hpp"
+#include "RobotCarPinDefinitionsAndMore.h"
+
+#define VIN_2_LIPO
+#include "CarPWMMotorControl.hpp"
+#include "CarPlant.hpp"
+#if defined(USE_MPU6050_IMU)
+#include "MPU6050Device.hpp"
+#endif
+
+#define USE_STANDARD_SERVO_LIBRARY
+#include "Distance.hpp" // from examples/SmartCarFollower
+
+#define BENCHMARK_LOOP_PERIOD_MICROS    1000
+#define BENCHMARK_DRIVE_SPEED_PWM       ((MAX_SPEED_PWM * 3) / 4) // greater than RAMP_VALUE_OFFSET_SPEED_PWM, to get ramps
+#define BENCHMARK_MANEUVER_TIMEOUT_MILLIS 5000
+#define BENCHMARK_MAX_BUCKETS           32
+#define BENCHMARK_DISTANCE_CALLS        100000
+#define BENCHMARK_DISTANCE_BATCH_SIZE   100
+#define BENCHMARK_DISTANCE_THRESHOLD_CM 40 // FOLLOWER_DISTANCE_MAXIMUM_CENTIMETER of SmartCarFollower
+
+CarPlant sCarPlant;
+#if defined(USE_MPU6050_IMU)
+MPU6050Device sMPU6050;
+#endif
+
+struct BenchmarkBucket {
+    const char *Function;
+    const char *State;
+    unsigned long Calls;
+    uint64_t HostNanosSum;
+    uint64_t HostNanosMin;
+    uint64_t BusMicrosSum;
+    std::vector<uint32_t> HostNanosSamples; // for the median, which is much less sensitive to host jitter than the mean
+};
+
+BenchmarkBucket sBuckets[BENCHMARK_MAX_BUCKETS];
+uint8_t sNumberOfBuckets;
+uint64_t sClockOverheadNanos; // time for one clock_gettime() call, subtracted from each measurement
+unsigned long sManeuvers;
+unsigned long sManeuverTimeouts;
+
+uint64_t getHostNanos() {
+    struct timespec tTime;
+    clock_gettime(CLOCK_MONOTONIC, &tTime);
+    return (uint64_t) tTime.tv_sec * 1000000000ULL + tTime.tv_nsec;
+}
+
+void calibrateClockOverhead() {
+    sClockOverheadNanos = UINT64_MAX;
+    for (uint_fast16_t i = 0; i < 1000; ++i) {
+        uint64_t tStart = getHostNanos();
+        uint64_t tDelta = getHostNanos() - tStart;
+        if (tDelta < sClockOverheadNanos) {
+            sClockOverheadNanos = tDelta;
+        }
+    }
+}
+
+/*
+ * Median time of a fixed integer workload. Used by RunBenchmarks.sh to normalize the host times of different runs,
+ * which otherwise differ by up to a factor of 2 by CPU frequency scaling and other load on the host.
+ */
+uint32_t getHostReferenceNanos() {
+    std::vector<uint32_t> tSamples;
+    volatile uint32_t tSink;
+    for (uint_fast16_t i = 0; i < 101; ++i) {
+        uint32_t tState = 2463534242UL + i;
+        uint64_t tStart = getHostNanos();
+        for (uint_fast16_t j = 0; j < 1000; ++j) {
+            tState ^= tState << 13;
+            tState ^= tState >> 17;
+            tState ^= tState << 5;
+        }
+        tSink = tState;
+        tSamples.push_back(getHostNanos() - tStart);
+    }
+    (void) tSink;
+    std::nth_element(tSamples.begin(), tSamples.begin() + tSamples.size() / 2, tSamples.end());
+    return tSamples[tSamples.size() / 2];
+}
+
+/*
+ * Buckets are identified by the string pointers, so always use literals
+ */
+BenchmarkBucket* getBucket(const char *aFunction, const char *aState) {
+    for (uint_fast8_t i = 0; i < sNumberOfBuckets; ++i) {
+        if (sBuckets[i].Function == aFunction && sBuckets[i].State == aState) {
+            return &sBuckets[i];
+        }
+    }
+    if (sNumberOfBuckets >= BENCHMARK_MAX_BUCKETS) {
+        fprintf(stderr, "Too many benchmark buckets\n");
+        exit(1);
+    }
+    BenchmarkBucket *tBucket = &sBuckets[sNumberOfBuckets++];
+    tBucket->Function = aFunction;
+    tBucket->State = aState;
+    tBucket->HostNanosMin = UINT64_MAX;
+    return tBucket;
+}
+
+/*
+ * The virtual time is frozen during the call, so only the time added by the simulated bus and ADC is measured.
+ * Very short functions can be called aNumberOfCalls times in a row, to get a resolution below the clock overhead.
+ */
+#define MEASURE(aFunction, aState, aNumberOfCalls, aCall) do { \
+    BenchmarkBucket *tBucket = getBucket(aFunction, aState); \
+    uint16_t tMicrosPerCall = VirtualClock::MicrosPerCall; \
+    VirtualClock::MicrosPerCall = 0; \
+    uint64_t tStartMicros = VirtualClock::Micros; \
+    uint64_t tStartNanos = getHostNanos(); \
+    for (uint_fast16_t tCall = 0; tCall < (aNumberOfCalls); ++tCall) { \
+        aCall; \
+    } \
+    uint64_t tNanos = getHostNanos() - tStartNanos; \
+    tBucket->BusMicrosSum += VirtualClock::Micros - tStartMicros; \
+    VirtualClock::MicrosPerCall = tMicrosPerCall; \
+    tNanos = ((tNanos > sClockOverheadNanos) ? tNanos - sClockOverheadNanos : 0) / (aNumberOfCalls); \
+    tBucket->Calls += (aNumberOfCalls); \
+    tBucket->HostNanosSum += tNanos * (aNumberOfCalls); \
+    tBucket->HostNanosSamples.push_back(tNanos); \
+    if (tNanos < tBucket->HostNanosMin) { \
+        tBucket->HostNanosMin = tNanos; \
+    } \
+} while (0)
+
+const char* getStateName() {
+#if defined(USE_MPU6050_IMU)
+    if (RobotCarPWMMotorControl.CarRequestedRotationDegrees != 0) {
+        return "imu_rotation";
+    }
+#endif
+    switch (RobotCarPWMMotorControl.rightCarMotor.MotorRampState) {
+    case MOTOR_STATE_START:
+        return "start";
+    case MOTOR_STATE_RAMP_UP:
+        return "ramp_up";
+    case MOTOR_STATE_DRIVE:
+        return "drive";
+    case MOTOR_STATE_RAMP_DOWN:
+        return "ramp_down";
+    default:
+        return "stopped";
+    }
+}
+
+/*
+ * One loop, which measures one of the hot paths, selected by aLoopCount.
+ * The other functions are called unmeasured, to keep the behavior of the car identical to a plain updateMotors() loop.
+ */
+void runLoop(unsigned long aLoopCount) {
+    const char *tState = getStateName();
+    switch (aLoopCount % 4) {
+#if defined(USE_ENCODER_MOTOR_CONTROL) && !defined(USE_MPU6050_IMU)
+    case 1:
+        MEASURE("EncoderMotor::updateMotor", tState, 1, RobotCarPWMMotorControl.rightCarMotor.updateMotor());
+        RobotCarPWMMotorControl.leftCarMotor.updateMotor();
+        break;
+#endif
+#if defined(USE_ENCODER_MOTOR_CONTROL) && defined(SUPPORT_AVERAGE_SPEED)
+    case 2:
+        MEASURE("EncoderMotor::getAverageSpeed", tState, 1, RobotCarPWMMotorControl.rightCarMotor.getAverageSpeed());
+        RobotCarPWMMotorControl.updateMotors();
+        break;
+#endif
+#if defined(USE_MPU6050_IMU)
+    case 3:
+        MEASURE("IMUCarData::readCarDataFromMPU6050Fifo", tState, 1, RobotCarPWMMotorControl.IMUData.readCarDataFromMPU6050Fifo());
+        RobotCarPWMMotorControl.updateMotors();
+        break;
+#endif
+    default:
+        MEASURE("CarPWMMotorControl::updateMotors", tState, 1, RobotCarPWMMotorControl.updateMotors());
+        break;
+    }
+}
+
+/*
+ * Stop the car, if it does not stop by itself, e.g. if it stalls at RAMP_VALUE_MIN_SPEED_PWM before the IMU distance is reached
+ */
+void runUntilStopped(unsigned long *aLoopCount) {
+    sManeuvers++;
+    uint64_t tNextLoopMicros = VirtualClock::Micros;
+    uint64_t tTimeoutMicros = VirtualClock::Micros + BENCHMARK_MANEUVER_TIMEOUT_MILLIS * 1000ULL;
+    do {
+        runLoop((*aLoopCount)++);
+        tNextLoopMicros += BENCHMARK_LOOP_PERIOD_MICROS;
+        if (VirtualClock::Micros < tNextLoopMicros) {
+            delayMicroseconds(tNextLoopMicros - VirtualClock::Micros);
+        }
+        if (VirtualClock::Micros > tTimeoutMicros) {
+            sManeuverTimeouts++;
+            RobotCarPWMMotorControl.stop(MOTOR_BRAKE);
+#if defined(USE_MPU6050_IMU)
+            RobotCarPWMMotorControl.CarRequestedRotationDegrees = 0;
+#endif
+            tTimeoutMicros = UINT64_MAX;
+        }
+    } while (!RobotCarPWMMotorControl.isStopped() || !sCarPlant.isStopped());
+}
+
+/*
+ * Typical scans of the SmartCarFollower. Index 0 is right, index 9 is left, values are centimeter.
+ */
+struct ScanPattern {
+    const char *Name;
+    uint8_t Distances[NUMBER_OF_DISTANCES];
+};
+const ScanPattern sScanPatterns[] = { { "open", { 120, 135, 150, 160, 170, 170, 160, 150, 135, 120 } }, //
+        { "corridor", { 22, 24, 30, 45, 90, 95, 45, 30, 24, 22 } }, //
+        { "wall_ahead", { 60, 45, 35, 30, 28, 28, 30, 35, 45, 60 } }, //
+        { "wall_right", { 18, 20, 25, 36, 70, 140, 150, 150, 140, 130 } } };
+
+void measureDistanceFunctions() {
+    for (uint_fast8_t i = 0; i < sizeof(sScanPatterns) / sizeof(sScanPatterns[0]); ++i) {
+        memcpy(sForwardDistancesInfo.RawDistancesArray, sScanPatterns[i].Distances, NUMBER_OF_DISTANCES);
+        for (uint_fast16_t j = 0; j < BENCHMARK_DISTANCE_CALLS / BENCHMARK_DISTANCE_BATCH_SIZE; ++j) {
+            // both functions only depend on RawDistancesArray, so repeated calls do the same work
+            MEASURE("doWallDetection", sScanPatterns[i].Name, BENCHMARK_DISTANCE_BATCH_SIZE, doWallDetection());
+            MEASURE("postProcessDistances", sScanPatterns[i].Name, BENCHMARK_DISTANCE_BATCH_SIZE,
+                    postProcessDistances(BENCHMARK_DISTANCE_THRESHOLD_CM));
+        }
+    }
+}
+
+int main(int argc, char *argv[]) {
+    unsigned long tNumberOfDrives = 20;
+    if (argc > 1) {
+        tNumberOfDrives = atol(argv[1]);
+    }
+    Serial.OutputEnabled = false;
+    VirtualClock::reset();
+    sCarPlant.init();
+#if defined(USE_MPU6050_IMU)
+    sMPU6050.init(&sCarPlant);
+#endif
+
+    RobotCarPWMMotorControl.init(RIGHT_MOTOR_FORWARD_PIN, RIGHT_MOTOR_BACKWARD_PIN, RIGHT_MOTOR_PWM_PIN, LEFT_MOTOR_FORWARD_PIN,
+    LEFT_MOTOR_BACKWARD_PIN, LEFT_MOTOR_PWM_PIN);
+#if defined(USE_MPU6050_IMU)
+    RobotCarPWMMotorControl.IMUData.resetOffsetDataAndWait();
+#endif
+    calibrateClockOverhead();
+    uint32_t tReferenceNanos = getHostReferenceNanos();
+
+    unsigned long tLoopCount = 0;
+    for (unsigned long i = 0; i < tNumberOfDrives; ++i) {
+        sCarPlant.reset();
+        RobotCarPWMMotorControl.startGoDistanceMillimeter(BENCHMARK_DRIVE_SPEED_PWM, 500, DIRECTION_FORWARD);
+        runUntilStopped(&tLoopCount);
+        RobotCarPWMMotorControl.startRotate(90, TURN_IN_PLACE);
+        runUntilStopped(&tLoopCount);
+        RobotCarPWMMotorControl.startGoDistanceMillimeter(BENCHMARK_DRIVE_SPEED_PWM, 500, DIRECTION_BACKWARD);
+        runUntilStopped(&tLoopCount);
+    }
+    measureDistanceFunctions();
+
+#if defined(USE_MPU6050_IMU)
+    const char *tConfiguration = "imu";
+#elif defined(USE_ENCODER_MOTOR_CONTROL)
+    const char *tConfiguration = "encoder";
+#else
+    const char *tConfiguration = "pwm";
+#endif
+    tReferenceNanos = (tReferenceNanos + getHostReferenceNanos()) / 2;
+    printf("config=%s maneuvers=%lu timeouts=%lu loops=%lu clock_overhead_ns=%llu reference_ns=%u\n", tConfiguration, sManeuvers,
+            sManeuverTimeouts, tLoopCount, (unsigned long long) sClockOverheadNanos, tReferenceNanos);
+    /*
+     * Print the buckets grouped by function
+     */
+    for (uint_fast8_t i = 0; i < sNumberOfBuckets; ++i) {
+        for (uint_fast8_t j = 0; j < sNumberOfBuckets; ++j) {
+            BenchmarkBucket *tBucket = &sBuckets[j];
+            if (tBucket->Function != sBuckets[i].Function || tBucket->Calls == 0) {
+                continue;
+            }
+            std::vector<uint32_t> &tSamples = tBucket->HostNanosSamples;
+            std::nth_element(tSamples.begin(), tSamples.begin() + tSamples.size() / 2, tSamples.end());
+            float tBusMicrosMean = (float) tBucket->BusMicrosSum / tBucket->Calls;
+            printf("bench=%s config=%s state=%s calls=%lu host_ns_median=%u host_ns_mean=%.1f host_ns_min=%llu bus_us_mean=%.1f"
+                    " budget_percent=%.2f\n", tBucket->Function, tConfiguration, tBucket->State, tBucket->Calls,
+                    tSamples[tSamples.size() / 2], (float) tBucket->HostNanosSum / tBucket->Calls,
+                    (unsigned long long) tBucket->HostNanosMin, tBusMicrosMean, tBusMicrosMean / (BENCHMARK_LOOP_PERIOD_MICROS / 100.0));
+            tBucket->Calls = 0; // mark as printed
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,177 @@
+/*
+ *  BrakingTrials.cpp
+ *
+ *  Checks the learned braking distance of EncoderMotor against CarPlant on 3 floors and prints for each floor
+ *  1. The deceleration learned from stops by setSpeedPWM(0) with the DefaultStopMode set to MOTOR_RELEASE,
+ *     and from stops by stop(MOTOR_BRAKE), compared with the deceleration measured by the plant.
+ *  2. The error of distance drives with the learned model and the time the motor drives with the minimum profile velocity
+ *     before the stop (creep time).
+ *  Floors are "wood" with the default plant parameters, "carpet" with high friction and "tile" with low grip,
+ *  where the wheels cannot brake with the default deceleration of the motion profile.
+ *
+ *  Build and run from this directory with:
+ *  g++ -std=gnu++11 -O2 -Wall -DUSE_ENCODER_MOTOR_CONTROL -I. -I../../src BrakingTrials.cpp -o BrakingTrials && ./BrakingTrials
+ *  Output is one line of key=value pairs per floor and test, to be easily processed by scripts.
+ *
+ *  Copyright (C) 2022  Armin Joachimsmeyer
+ *  armin.joachimsmeyer@gmail.com
+ *
+ *  This file is part of PWMMotorControl https://github.com/ArminJo/PWMMotorControl.
+ *
+ *  PWMMotorControl is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/gpl.html>.
+ *
+ */
+
+#include <Arduino.h>
+
+#if !defined(USE_ENCODER_MOTOR_CONTROL)
+#error BrakingTrials requires -DUSE_ENCODER_MOTOR_CONTROL
+#endif
+
+#include "HostArduino.hpp"
+
+#define VIN_2_LIPO
+#include "CarPWMMotorControl.hpp"
+#include "CarPlant.hpp"
+
+#if !defined(USE_LEARNED_BRAKING_DISTANCE) || !defined(USE_MOTION_PROFILE)
+#error BrakingTrials requires the learned braking distance and the motion profile, do not define DO_NOT_USE_LEARNED_BRAKING_DISTANCE or DO_NOT_USE_MOTION_PROFILE
+#endif
+
+#define NUMBER_OF_STOPS             8
+#define NUMBER_OF_DISTANCE_DRIVES   10
+#define DRIVE_BEFORE_STOP_MILLIS    1000
+#define DISTANCE_DRIVE_TIMEOUT_MILLIS 5000
+
+CarPlant sCarPlant;
+
+void setFloor(const char *aFloorName) {
+    for (uint_fast8_t i = 0; i < PLANT_NUMBER_OF_MOTORS; ++i) {
+        DcMotorPlantParameters *tParameters = &sCarPlant.Motors[i]->Parameters;
+        sCarPlant.Motors[i]->setDefaultParameters();
+        if (strcmp(aFloorName, "carpet") == 0) {
+            tParameters->FrictionMillivolt = (tParameters->StartMillivolt * 9) / 10;
+        } else if (strcmp(aFloorName, "tile") == 0) {
+            tParameters->MaxAccelerationMillimeterPerSecond2 = 1500;
+        }
+    }
+}
+
+void waitMillis(uint32_t aMillis) {
+    uint32_t tStartMillis = millis();
+    while (millis() - tStartMillis < aMillis) {
+        RobotCarPWMMotorControl.updateMotors();
+        delay(1);
+    }
+}
+
+/*
+ * Drive with DEFAULT_DRIVE_SPEED_PWM, stop by setSpeedPWM(0) or stop(MOTOR_BRAKE)
+ * and compare the learned deceleration with the one of the plant
+ */
+void measureStops(const char *aFloorName, bool aStopBySpeedPWM) {
+    EncoderMotor *tMotor = &RobotCarPWMMotorControl.rightCarMotor;
+    uint8_t tStopMode = aStopBySpeedPWM ? MOTOR_RELEASE : MOTOR_BRAKE;
+    uint8_t tDefaultStopMode = tMotor->DefaultStopMode;
+    RobotCarPWMMotorControl.setStopMode(tStopMode);
+    RobotCarPWMMotorControl.rightCarMotor.BrakingModel.reset();
+    RobotCarPWMMotorControl.leftCarMotor.BrakingModel.reset();
+
+    float tPlantDecelerationTimes2Sum = 0;
+    unsigned int tSpeedMillimeterPerSecond = 0;
+    for (uint_fast8_t i = 0; i < NUMBER_OF_STOPS; ++i) {
+        sCarPlant.reset();
+        RobotCarPWMMotorControl.setSpeedPWM(DEFAULT_DRIVE_SPEED_PWM, DIRECTION_FORWARD);
+        waitMillis(DRIVE_BEFORE_STOP_MILLIS);
+        tSpeedMillimeterPerSecond = tMotor->getSpeedMillimeterPerSecond();
+        float tPlantSpeed = sCarPlant.RightMotor.SpeedMillimeterPerSecond;
+        if (aStopBySpeedPWM) {
+            RobotCarPWMMotorControl.rightCarMotor.setSpeedPWM(0);
+            RobotCarPWMMotorControl.leftCarMotor.setSpeedPWM(0);
+        } else {
+            RobotCarPWMMotorControl.stop(MOTOR_BRAKE);
+        }
+        while (!sCarPlant.isStopped()) {
+            RobotCarPWMMotorControl.updateMotors();
+            delay(1);
+        }
+        waitMillis(2 * BRAKING_DISTANCE_STANDSTILL_MILLIS); // let the motor end its measurement
+        float tOverrun = sCarPlant.RightMotor.DistanceMillimeter - sCarPlant.RightMotor.DistanceAtDriveEndMillimeter;
+        tPlantDecelerationTimes2Sum += (tPlantSpeed * tPlantSpeed) / tOverrun;
+    }
+    RobotCarPWMMotorControl.setStopMode(tDefaultStopMode);
+    printf("test=stop floor=%s stop=%s stops=%d speed_mm_s=%u plant_deceleration_times_2=%.0f learned_deceleration_times_2=%u\n",
+            aFloorName, aStopBySpeedPWM ? "set_speed_pwm_0" : "brake", NUMBER_OF_STOPS, tSpeedMillimeterPerSecond,
+            tPlantDecelerationTimes2Sum / NUMBER_OF_STOPS,
+            tMotor->BrakingModel.DecelerationTimes2[tStopMode - MOTOR_BRAKE][tSpeedMillimeterPerSecond / BRAKING_DISTANCE_SPEED_BAND_WIDTH]);
+}
+
+/*
+ * Distance drives, which start with the learned values of the preceding drives
+ */
+void measureDistanceDrives(const char *aFloorName) {
+    EncoderMotor *tMotor = &RobotCarPWMMotorControl.rightCarMotor;
+    RobotCarPWMMotorControl.rightCarMotor.BrakingModel.reset();
+    RobotCarPWMMotorControl.leftCarMotor.BrakingModel.reset();
+    randomSeed(1);
+
+    float tErrorSum = 0;
+    float tMaxAbsError = 0;
+    unsigned long tCreepMillisSum = 0;
+    unsigned long tDriveMillisSum = 0;
+    for (uint_fast8_t i = 0; i < NUMBER_OF_DISTANCE_DRIVES; ++i) {
+        int tRequestedMillimeter = random(200, 801);
+        sCarPlant.reset();
+        uint32_t tStartMillis = millis();
+        RobotCarPWMMotorControl.startGoDistanceMillimeter(tRequestedMillimeter);
+        while (RobotCarPWMMotorControl.updateMotors() && millis() - tStartMillis < DISTANCE_DRIVE_TIMEOUT_MILLIS) {
+            delay(1);
+            if (tMotor->MotorRampState == MOTOR_STATE_RAMP_DOWN && tMotor->Profile.getVelocity() <= tMotor->Profile.MinVelocity) {
+                tCreepMillisSum++;
+            }
+        }
+        tDriveMillisSum += millis() - tStartMillis;
+        while (!sCarPlant.isStopped()) {
+            delay(1);
+        }
+        waitMillis(2 * BRAKING_DISTANCE_STANDSTILL_MILLIS);
+        float tError = sCarPlant.getDistanceMillimeter() - tRequestedMillimeter;
+        tErrorSum += tError;
+        if (tMaxAbsError < fabs(tError)) {
+            tMaxAbsError = fabs(tError);
+        }
+    }
+    printf("test=distance floor=%s drives=%d error_mean_mm=%.1f error_max_abs_mm=%.1f creep_mean_ms=%.1f drive_mean_ms=%.0f"
+            " learned_brake_deceleration_times_2=%u\n", aFloorName, NUMBER_OF_DISTANCE_DRIVES, tErrorSum / NUMBER_OF_DISTANCE_DRIVES,
+            tMaxAbsError, (float) tCreepMillisSum / NUMBER_OF_DISTANCE_DRIVES, (float) tDriveMillisSum / NUMBER_OF_DISTANCE_DRIVES,
+            tMotor->BrakingModel.DecelerationTimes2[0][1]);
+}
+
+int main() {
+    Serial.OutputEnabled = false;
+    VirtualClock::reset();
+    sCarPlant.init();
+
+    RobotCarPWMMotorControl.init(RIGHT_MOTOR_FORWARD_PIN, RIGHT_MOTOR_BACKWARD_PIN, RIGHT_MOTOR_PWM_PIN, LEFT_MOTOR_FORWARD_PIN,
+    LEFT_MOTOR_BACKWARD_PIN, LEFT_MOTOR_PWM_PIN);
+
+    const char *tFloorNames[] = { "wood", "carpet", "tile" };
+    for (uint_fast8_t i = 0; i < sizeof(tFloorNames) / sizeof(tFloorNames[0]); ++i) {
+        setFloor(tFloorNames[i]);
+        measureStops(tFloorNames[i], true);
+        measureStops(tFloorNames[i], false);
+        measureDistanceDrives(tFloorNames[i]);
+    }
+    return 0;
+}
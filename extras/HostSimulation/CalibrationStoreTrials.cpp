@@ -0,0 +1,239 @@
+/*
+ *  CalibrationStoreTrials.cpp
+ *
+ *  Checks the calibration record of CalibrationStore.h with the host EEPROM.
+ *  1. Values of the fixed layout of the previous versions are read, as long as no record was written.
+ *  2. All values are restored by readMotorValuesFromEeprom() after they were changed.
+ *  3. Random sequences of stores, like from the GUI, where only some of the stores change a value.
+ *     The number of writes of each EEPROM cell is counted and compared with the number of stores and of changes.
+ *  4. A write of a slot is interrupted after a random number of bytes, the previous record must be read then.
+ *  5. A random bit of the current slot is flipped, the previous record must be read then.
+ *
+ *  Build and run from this directory with:
+ *  g++ -std=gnu++11 -O2 -Wall -DUSE_ENCODER_MOTOR_CONTROL -I. -I../../src CalibrationStoreTrials.cpp -o CalibrationStoreTrials && ./CalibrationStoreTrials [number of trials]
+ *  Output is one line of key=value pairs per check, to be easily processed by scripts. Exit code is 1 if a check failed.
+ *
+ *  Copyright (C) 2022  Armin Joachimsmeyer
+ *  armin.joachimsmeyer@gmail.com
+ *
+ *  This file is part of PWMMotorControl https://github.com/ArminJo/PWMMotorControl.
+ *
+ *  PWMMotorControl is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/gpl.html>.
+ *
+ */
+
+#include <Arduino.h>
+
+#if !defined(USE_ENCODER_MOTOR_CONTROL)
+#error CalibrationStoreTrials requires -DUSE_ENCODER_MOTOR_CONTROL
+#endif
+
+#include "HostArduino.hpp"
+
+#define USE_SPEED_CONTROL_AUTOTUNE
+#include "CarPWMMotorControl.hpp"
+
+#if !defined(USE_CALIBRATION_STORE) || !defined(USE_SPEED_PWM_TABLE)
+#error CalibrationStoreTrials requires the calibration store and the speed PWM table, do not define DO_NOT_USE_CALIBRATION_STORE or DO_NOT_USE_SPEED_PWM_TABLE
+#endif
+
+#define NUMBER_OF_STORES            1000
+#define PERCENT_OF_CHANGING_STORES  10
+
+unsigned long sNumberOfFailedChecks;
+uint8_t sLastEEPROM[E2END + 1];
+unsigned long sCellWrites[E2END + 1];
+
+void check(const char *aName, bool aCondition) {
+    if (!aCondition) {
+        sNumberOfFailedChecks++;
+        printf("check=%s failed\n", aName);
+    }
+}
+
+void eraseEEPROM() {
+    memset(sHostEEPROM, 0xFF, sizeof(sHostEEPROM));
+    memcpy(sLastEEPROM, sHostEEPROM, sizeof(sLastEEPROM));
+    memset(sCellWrites, 0, sizeof(sCellWrites));
+}
+
+/*
+ * The host eeprom_update_byte() does not write unchanged cells, so each changed cell is one write
+ */
+void countCellWrites() {
+    for (uint_fast16_t i = 0; i <= E2END; ++i) {
+        if (sHostEEPROM[i] != sLastEEPROM[i]) {
+            sCellWrites[i]++;
+        }
+    }
+    memcpy(sLastEEPROM, sHostEEPROM, sizeof(sLastEEPROM));
+}
+
+unsigned long getMaxCellWrites() {
+    unsigned long tMaxCellWrites = 0;
+    for (uint_fast16_t i = 0; i <= E2END; ++i) {
+        if (sCellWrites[i] > tMaxCellWrites) {
+            tMaxCellWrites = sCellWrites[i];
+        }
+    }
+    return tMaxCellWrites;
+}
+
+void setRandomValues() {
+    EncoderMotor *tMotors[2] = { &RobotCarPWMMotorControl.leftCarMotor, &RobotCarPWMMotorControl.rightCarMotor };
+    for (uint_fast8_t i = 0; i < 2; ++i) {
+        tMotors[i]->setDriveSpeedAndSpeedCompensationPWM(random(50, 220), random(0, 24));
+        for (uint_fast8_t j = 0; j < SPEED_PWM_TABLE_SIZE; ++j) {
+            tMotors[i]->SpeedPWMTable[DIRECTION_FORWARD][j] = random(30, 256);
+            tMotors[i]->SpeedPWMTable[DIRECTION_BACKWARD][j] = random(30, 256);
+        }
+        tMotors[i]->setSpeedControlGains(random(1, 200), random(1, 50));
+    }
+}
+
+/*
+ * Compares the values of the motors with a record, which was filled by getValuesForCalibrationRecord()
+ */
+bool valuesAreEqual(CalibrationRecordStruct *aRecord) {
+    CalibrationRecordStruct tRecord = *aRecord;
+    RobotCarPWMMotorControl.getValuesForCalibrationRecord(&tRecord);
+    return memcmp(&tRecord, aRecord, sizeof(tRecord)) == 0;
+}
+
+void checkFixedLayout() {
+    eraseEEPROM();
+    RobotCarPWMMotorControl.leftCarMotor.setDriveSpeedAndSpeedCompensationPWM(123, 7);
+    RobotCarPWMMotorControl.rightCarMotor.setDriveSpeedAndSpeedCompensationPWM(124, 0);
+    RobotCarPWMMotorControl.leftCarMotor.writeMotorValuesToEeprom(0);
+    RobotCarPWMMotorControl.rightCarMotor.writeMotorValuesToEeprom(1);
+    RobotCarPWMMotorControl.leftCarMotor.setDriveSpeedAndSpeedCompensationPWM(DEFAULT_DRIVE_SPEED_PWM, 0);
+    RobotCarPWMMotorControl.rightCarMotor.setDriveSpeedAndSpeedCompensationPWM(DEFAULT_DRIVE_SPEED_PWM, 0);
+    RobotCarPWMMotorControl.readMotorValuesFromEeprom();
+    bool tOK = RobotCarPWMMotorControl.leftCarMotor.DriveSpeedPWM == 123
+            && RobotCarPWMMotorControl.leftCarMotor.SpeedPWMCompensation == 7
+            && RobotCarPWMMotorControl.rightCarMotor.DriveSpeedPWM == 124;
+    check("fixed_layout", tOK);
+    printf("check=fixed_layout ok=%d\n", tOK);
+}
+
+void checkRestore(unsigned long aNumberOfTrials) {
+    unsigned long tNumberOfRestored = 0;
+    for (unsigned long i = 0; i < aNumberOfTrials; ++i) {
+        CalibrationRecordStruct tRecord;
+        memset(&tRecord, 0, sizeof(tRecord));
+        setRandomValues();
+        RobotCarPWMMotorControl.writeMotorValuesToEeprom();
+        RobotCarPWMMotorControl.getValuesForCalibrationRecord(&tRecord);
+        setRandomValues();
+        RobotCarPWMMotorControl.readMotorValuesFromEeprom();
+        if (valuesAreEqual(&tRecord)) {
+            tNumberOfRestored++;
+        }
+    }
+    check("restore", tNumberOfRestored == aNumberOfTrials);
+    printf("check=restore trials=%lu restored=%lu\n", aNumberOfTrials, tNumberOfRestored);
+}
+
+void checkWear() {
+    eraseEEPROM();
+    setRandomValues();
+    unsigned long tNumberOfChanges = 0;
+    unsigned long tNumberOfWrittenSlots = 0;
+    for (unsigned long i = 0; i < NUMBER_OF_STORES; ++i) {
+        if (random(100) < PERCENT_OF_CHANGING_STORES) {
+            // like the compensation buttons of the GUI
+            RobotCarPWMMotorControl.changeSpeedPWMCompensation(random(2) ? 1 : -1);
+            tNumberOfChanges++;
+        }
+        CalibrationStore tCalibrationStore;
+        CalibrationRecordStruct tRecord;
+        tCalibrationStore.readRecord(&tRecord);
+        uint8_t tSequenceNumber = tRecord.SequenceNumber;
+        RobotCarPWMMotorControl.writeMotorValuesToEeprom();
+        tCalibrationStore.readRecord(&tRecord);
+        if (tRecord.SequenceNumber != tSequenceNumber) {
+            tNumberOfWrittenSlots++;
+        }
+        countCellWrites();
+    }
+    unsigned long tMaxCellWrites = getMaxCellWrites();
+    // The first store writes the changes of setRandomValues()
+    check("wear_slots", tNumberOfWrittenSlots <= tNumberOfChanges + 1);
+    check("wear_cells", tMaxCellWrites <= (tNumberOfChanges + 1) / CALIBRATION_STORE_NUMBER_OF_SLOTS + 1);
+    printf("check=wear stores=%u changes=%lu written_slots=%lu max_cell_writes=%lu\n", NUMBER_OF_STORES,
+            tNumberOfChanges, tNumberOfWrittenSlots, tMaxCellWrites);
+}
+
+/*
+ * Interrupt the write of the next slot after a random number of bytes or flip a random bit of the written slot
+ */
+void checkCorruption(unsigned long aNumberOfTrials, bool aFlipBit) {
+    unsigned long tNumberOfRecovered = 0;
+    for (unsigned long i = 0; i < aNumberOfTrials; ++i) {
+        CalibrationRecordStruct tPreviousRecord;
+        memset(&tPreviousRecord, 0, sizeof(tPreviousRecord));
+        setRandomValues();
+        RobotCarPWMMotorControl.writeMotorValuesToEeprom();
+        RobotCarPWMMotorControl.getValuesForCalibrationRecord(&tPreviousRecord);
+
+        memcpy(sLastEEPROM, sHostEEPROM, sizeof(sLastEEPROM));
+        setRandomValues();
+        RobotCarPWMMotorControl.writeMotorValuesToEeprom();
+        CalibrationStore tCalibrationStore;
+        CalibrationRecordStruct tRecord;
+        tCalibrationStore.readRecord(&tRecord);
+        uint16_t tSlotStart = CALIBRATION_STORE_EEPROM_START + tCalibrationStore.CurrentSlot * sizeof(CalibrationRecordStruct);
+        if (aFlipBit) {
+            sHostEEPROM[tSlotStart + random(sizeof(CalibrationRecordStruct))] ^= 1 << random(8);
+        } else {
+            // Restore the bytes behind the interruption
+            uint8_t tWrittenBytes = random(sizeof(CalibrationRecordStruct) - 1);
+            memcpy(&sHostEEPROM[tSlotStart + tWrittenBytes], &sLastEEPROM[tSlotStart + tWrittenBytes],
+                    sizeof(CalibrationRecordStruct) - tWrittenBytes);
+        }
+
+        setRandomValues();
+        RobotCarPWMMotorControl.readMotorValuesFromEeprom();
+        if (valuesAreEqual(&tPreviousRecord)) {
+            tNumberOfRecovered++;
+        }
+        // Write a valid record again for the next trial
+        RobotCarPWMMotorControl.writeMotorValuesToEeprom();
+    }
+    const char *tName = (aFlipBit ? "bit_flip" : "interrupted_write");
+    check(tName, tNumberOfRecovered == aNumberOfTrials);
+    printf("check=%s trials=%lu recovered=%lu\n", tName, aNumberOfTrials, tNumberOfRecovered);
+}
+
+int main(int argc, char *argv[]) {
+    unsigned long tNumberOfTrials = 1000;
+    if (argc > 1) {
+        tNumberOfTrials = atol(argv[1]);
+    }
+    Serial.OutputEnabled = false;
+    VirtualClock::reset();
+
+    RobotCarPWMMotorControl.init(RIGHT_MOTOR_FORWARD_PIN, RIGHT_MOTOR_BACKWARD_PIN, RIGHT_MOTOR_PWM_PIN, LEFT_MOTOR_FORWARD_PIN,
+    LEFT_MOTOR_BACKWARD_PIN, LEFT_MOTOR_PWM_PIN);
+
+    checkFixedLayout();
+    checkRestore(tNumberOfTrials);
+    checkWear();
+    checkCorruption(tNumberOfTrials, false);
+    checkCorruption(tNumberOfTrials, true);
+
+    printf("record_bytes=%u slots=%u failed_checks=%lu\n", (unsigned int) sizeof(CalibrationRecordStruct), CALIBRATION_STORE_NUMBER_OF_SLOTS,
+            sNumberOfFailedChecks);
+    return (sNumberOfFailedChecks == 0 ? 0 : 1);
+}
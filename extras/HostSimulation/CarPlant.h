@@ -0,0 +1,167 @@
+/*
+ * CarPlant.h
+ *
+ * Physical model of the 2 DC motors of a differential drive car for the host simulation.
+ * The inputs are the pin states written by PWMDcMotor::setMotorDriverMode() and PWMDcMotor::setSpeedPWM(),
+ * the outputs are the encoder interrupts, which are triggered at the exact virtual time of each slot edge, and the car pose.
+ * With USE_QUADRATURE_ENCODER, the levels of both encoder channels are written to their pins before each interrupt.
+ *
+ * The motor model is referred to the wheel circumference, i.e. speeds are in mm/s at the tire.
+ * Drive:   dv/dt = ((U - UFriction) / Ke - v) / Tau     U is the bridge output voltage, Ke the back EMF constant
+ * Brake:   dv/dt = (-UFriction / Ke - v) / Tau         motor is short circuited by the bridge
+ * Release: dv/dt = -UFriction / (Ke * Tau)             only friction
+ * A stopped motor only starts if U is above the start voltage (deadband).
+ * The floor below the wheel follows the tire with at most GripAccelerationMillimeterPerSecond2, the difference is slip.
+ * Pose and IMU use the floor movement, the encoder the tire movement.
+ * Ke is chosen such that DEFAULT_DRIVE_MILLIVOLT results in DEFAULT_MILLIMETER_PER_SECOND.
+ * For a 4WD car with CAR_NUMBER_OF_MOTORS_PER_SIDE == 2, the rear motors are simulated too, but only the front motors move the car.
+ * The rear motors use the pins and interrupts of RobotCarPinDefinitionsAndMore.h, which are connected by initRearCarMotors().
+ *
+ *  Copyright (C) 2022  Armin Joachimsmeyer
+ *  armin.joachimsmeyer@gmail.com
+ *
+ *  This file is part of PWMMotorControl https://github.com/ArminJo/PWMMotorControl.
+ *
+ *  PWMMotorControl is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/gpl.html>.
+ */
+
+#ifndef CAR_PLANT_H
+#define CAR_PLANT_H
+
+#include "Arduino.h"
+#include "PWMDcMotor.h" // for FULL_BRIDGE_* and DEFAULT_* constants
+
+#if defined(MOSFET_BRIDGE_USED)
+#define PLANT_START_MILLIVOLT           DEFAULT_START_MILLIVOLT_MOSFET
+#else
+#define PLANT_START_MILLIVOLT           DEFAULT_START_MILLIVOLT_L298
+#endif
+#define PLANT_STEP_MICROS               250 // Integration step. Input pins are sampled at each step.
+#define PLANT_TRACK_WIDTH_MILLIMETER    130 // Corresponds to FACTOR_DEGREE_TO_MILLIMETER_2WD_CAR_DEFAULT
+#define PLANT_MAX_PENDING_EDGES         4
+#if defined(CAR_NUMBER_OF_MOTORS_PER_SIDE) && CAR_NUMBER_OF_MOTORS_PER_SIDE == 2
+#define PLANT_HAS_REAR_MOTORS
+#define PLANT_NUMBER_OF_MOTORS          4
+#  if defined(USE_QUADRATURE_ENCODER)
+#error "The rear motors of the plant have no quadrature encoder pins"
+#  endif
+#else
+#define PLANT_NUMBER_OF_MOTORS          2
+#endif
+#if defined(USE_QUADRATURE_ENCODER)
+#define PLANT_ENCODER_EDGES_PER_SLOT    4 // Both edges of channel A and B
+#else
+#define PLANT_ENCODER_EDGES_PER_SLOT    1 // Rising edge of the single channel
+#endif
+
+struct DcMotorPlantParameters {
+    uint16_t SupplyMillivolt;           // Battery voltage
+    uint16_t BridgeLossMillivolt;       // 2200 for L298, 0 for MOSFET bridges
+    uint16_t StartMillivolt;            // Deadband. Bridge output voltage, at which a stopped motor starts to turn
+    uint16_t FrictionMillivolt;         // Voltage equivalent of the friction of a turning motor, must be below StartMillivolt
+    uint16_t MechanicalTimeConstantMillis; // Inertia of motor and car
+    uint16_t MaxAccelerationMillimeterPerSecond2; // Tire grip limit, for acceleration and braking
+    float CircumferenceMillimeter;      // Real circumference of the wheel, may differ from DEFAULT_CIRCUMFERENCE_MILLIMETER
+    uint8_t EncoderSlots;               // Number of slots of the encoder disc
+    uint8_t EncoderRingingPercent;      // Probability of a second edge within ENCODER_SENSOR_RING_MILLIS
+    uint16_t GripAccelerationMillimeterPerSecond2; // Maximum acceleration of the car by this wheel. 0 for a car blocked by an obstacle.
+};
+
+/*
+ * One motor with wheel and encoder
+ */
+class DcMotorPlant {
+public:
+    void init(uint8_t aForwardPin, uint8_t aBackwardPin, uint8_t aPWMPin, uint8_t aInterruptNumber);
+    void setDefaultParameters();
+    void reset();
+    void resetStopMeasurement();
+    int16_t getBridgeOutputMillivolt();
+    void step(uint64_t aNowMicros, uint32_t aStepMicros);
+    void stepFloor(float aOldSpeed, double aDeltaMillimeter, float aStepSeconds);
+    void scheduleEdge(uint64_t aEdgeMicros, int8_t aStep);
+    uint64_t getNextEdgeMicros();
+    bool isStopped();
+#if defined(USE_QUADRATURE_ENCODER)
+    void setQuadratureEncoderPins(uint8_t aEncoderPinA, uint8_t aEncoderPinB);
+    void writeQuadratureEncoderPins();
+#endif
+
+    DcMotorPlantParameters Parameters;
+
+    uint8_t ForwardPin;
+    uint8_t BackwardPin;
+    uint8_t PWMPin;
+    uint8_t InterruptNumber;
+
+    float SpeedMillimeterPerSecond;     // positive is forward, speed of the tire, which is seen by the encoder
+    double DistanceMillimeter;          // signed distance driven since reset()
+    float FloorSpeedMillimeterPerSecond; // speed of the floor below the wheel, differs from SpeedMillimeterPerSecond by slip
+    double FloorDistanceMillimeter;
+    double EncoderPosition;             // in slots * PLANT_ENCODER_EDGES_PER_SLOT, signed
+    unsigned long EncoderEdgeCount;     // number of interrupts triggered, including ringing
+#if defined(USE_QUADRATURE_ENCODER)
+    uint8_t EncoderPinA;
+    uint8_t EncoderPinB;
+    long EncoderPinsPosition;           // position of the last edge written to the pins
+#endif
+
+    uint64_t PendingEdgeMicros[PLANT_MAX_PENDING_EDGES]; // sorted
+    int8_t PendingEdgeStep[PLANT_MAX_PENDING_EDGES]; // +1 for forward, -1 for backward edges
+    uint8_t NumberOfPendingEdges;
+
+    /*
+     * Stop measurement. Drive end is the transition from bridge driving to brake, release or PWM 0.
+     */
+    bool IsDriving;
+    uint64_t DriveEndMicros;            // 0 if not yet ended since last resetStopMeasurement()
+    double DistanceAtDriveEndMillimeter;
+    uint64_t StandstillMicros;          // first standstill after DriveEndMicros
+};
+
+class CarPlant: public VirtualClockComponent {
+public:
+    void init();
+    void reset();
+    void resetStopMeasurement();
+    bool isStopped();
+    uint64_t getNextEventMicros() override;
+    void handleEvent(uint64_t aNowMicros) override;
+
+    float getHeadingDegree();
+    float getDistanceMillimeter();
+    float getSpeedMillimeterPerSecond();
+    float getYawRateRadianPerSecond();
+
+    DcMotorPlant RightMotor;
+    DcMotorPlant LeftMotor;
+#if defined(PLANT_HAS_REAR_MOTORS)
+    DcMotorPlant RightRearMotor;
+    DcMotorPlant LeftRearMotor;
+#endif
+    DcMotorPlant *Motors[PLANT_NUMBER_OF_MOTORS]; // All motors, the first 2 are RightMotor and LeftMotor
+    uint16_t TrackWidthMillimeter;
+
+    double XMillimeter;
+    double YMillimeter;
+    double HeadingRadian;               // positive is counterclockwise, i.e. left turn
+
+    uint64_t NextStepMicros;
+};
+
+#if defined(PLANT_HAS_REAR_MOTORS)
+void initRearCarMotors();
+#endif
+
+#endif // CAR_PLANT_H
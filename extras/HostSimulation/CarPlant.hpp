@@ -0,0 +1,422 @@
+/*
+ * CarPlant.hpp
+ *
+ * Implementation of the physical model of the car for the host simulation.
+ * Include it exactly once in the main program after HostArduino.hpp.
+ *
+ *  Copyright (C) 2022  Armin Joachimsmeyer
+ *  armin.joachimsmeyer@gmail.com
+ *
+ *  This file is part of PWMMotorControl https://github.com/ArminJo/PWMMotorControl.
+ *
+ *  PWMMotorControl is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/gpl.html>.
+ */
+#ifndef CAR_PLANT_HPP
+#define CAR_PLANT_HPP
+
+#include "CarPlant.h"
+
+/*
+ * Own random generator, in order not to change the random() sequence of the program under test
+ */
+static uint32_t sPlantRandomState = 0x9E3779B9UL;
+static uint32_t getPlantRandom() {
+    sPlantRandomState ^= sPlantRandomState << 13;
+    sPlantRandomState ^= sPlantRandomState >> 17;
+    sPlantRandomState ^= sPlantRandomState << 5;
+    return sPlantRandomState;
+}
+
+/*******************************************************************************************
+ * DcMotorPlant
+ *******************************************************************************************/
+void DcMotorPlant::init(uint8_t aForwardPin, uint8_t aBackwardPin, uint8_t aPWMPin, uint8_t aInterruptNumber) {
+    ForwardPin = aForwardPin;
+    BackwardPin = aBackwardPin;
+    PWMPin = aPWMPin;
+    InterruptNumber = aInterruptNumber;
+    setDefaultParameters();
+    reset();
+}
+
+void DcMotorPlant::setDefaultParameters() {
+    Parameters.SupplyMillivolt = FULL_BRIDGE_INPUT_MILLIVOLT;
+    Parameters.BridgeLossMillivolt = FULL_BRIDGE_LOSS_MILLIVOLT;
+    Parameters.StartMillivolt = PLANT_START_MILLIVOLT;
+    Parameters.FrictionMillivolt = (PLANT_START_MILLIVOLT * 6) / 10;
+    Parameters.MechanicalTimeConstantMillis = 80;
+    Parameters.MaxAccelerationMillimeterPerSecond2 = 5000;
+    Parameters.CircumferenceMillimeter = DEFAULT_CIRCUMFERENCE_MILLIMETER;
+    Parameters.EncoderSlots = 20;
+    Parameters.EncoderRingingPercent = 0;
+    Parameters.GripAccelerationMillimeterPerSecond2 = 10000; // Above MaxAccelerationMillimeterPerSecond2, i.e. no slip
+}
+
+void DcMotorPlant::reset() {
+    SpeedMillimeterPerSecond = 0;
+    DistanceMillimeter = 0;
+    FloorSpeedMillimeterPerSecond = 0;
+    FloorDistanceMillimeter = 0;
+    EncoderPosition = 0;
+    EncoderEdgeCount = 0;
+    NumberOfPendingEdges = 0;
+#if defined(USE_QUADRATURE_ENCODER)
+    EncoderPinsPosition = 0;
+    writeQuadratureEncoderPins();
+#endif
+    IsDriving = false;
+    resetStopMeasurement();
+}
+
+void DcMotorPlant::resetStopMeasurement() {
+    DriveEndMicros = 0;
+    DistanceAtDriveEndMillimeter = DistanceMillimeter;
+    StandstillMicros = 0;
+}
+
+bool DcMotorPlant::isStopped() {
+    return SpeedMillimeterPerSecond == 0;
+}
+
+/*
+ * L298: Enable (PWM) LOW -> outputs are floating, regardless of the direction pins.
+ * MOSFET bridges like TB6612: PWM LOW -> short brake, only both direction pins LOW -> outputs are floating.
+ * @return bridge output voltage, INT16_MIN for floating outputs (release) and 0 for short brake
+ */
+int16_t DcMotorPlant::getBridgeOutputMillivolt() {
+    uint8_t tForward = sHostPins[ForwardPin].DigitalLevel;
+    uint8_t tBackward = sHostPins[BackwardPin].DigitalLevel;
+    uint8_t tPWM = sHostPins[PWMPin].AnalogWriteValue;
+    if (tForward == tBackward) {
+#if defined(MOSFET_BRIDGE_USED)
+        return (tForward) ? 0 : INT16_MIN;
+#else
+        return (tForward && tPWM > 0) ? 0 : INT16_MIN;
+#endif
+    }
+    if (tPWM == 0) {
+#if defined(MOSFET_BRIDGE_USED)
+        return 0;
+#else
+        return INT16_MIN;
+#endif
+    }
+    int32_t tMillivolt = ((int32_t) Parameters.SupplyMillivolt - Parameters.BridgeLossMillivolt) * tPWM / MAX_SPEED_PWM;
+    if (tMillivolt < 0) {
+        tMillivolt = 0;
+    }
+    return (tForward) ? tMillivolt : -tMillivolt;
+}
+
+/*
+ * Compute speed and position at aNowMicros + aStepMicros with the inputs of aNowMicros
+ * and schedule the encoder edges for this interval
+ */
+void DcMotorPlant::step(uint64_t aNowMicros, uint32_t aStepMicros) {
+    float tStepSeconds = aStepMicros / 1000000.0;
+    float tTau = Parameters.MechanicalTimeConstantMillis / 1000.0;
+    // Millivolt per mm/s, chosen to get DEFAULT_MILLIMETER_PER_SECOND at DEFAULT_DRIVE_MILLIVOLT
+    float tKe = (float) (DEFAULT_DRIVE_MILLIVOLT - Parameters.FrictionMillivolt) / DEFAULT_MILLIMETER_PER_SECOND;
+    float tFrictionSpeed = Parameters.FrictionMillivolt / tKe;
+
+    int16_t tMillivolt = getBridgeOutputMillivolt();
+    bool tIsDriving = (tMillivolt != INT16_MIN && tMillivolt != 0);
+    if (IsDriving && !tIsDriving && DriveEndMicros == 0) {
+        DriveEndMicros = aNowMicros;
+        DistanceAtDriveEndMillimeter = DistanceMillimeter;
+        StandstillMicros = 0;
+    }
+    IsDriving = tIsDriving;
+
+    float tSpeed = SpeedMillimeterPerSecond;
+    float tAcceleration;
+    if (tSpeed == 0) {
+        // Deadband
+        if (!tIsDriving || abs(tMillivolt) < Parameters.StartMillivolt) {
+            stepFloor(0, 0, tStepSeconds);
+            return;
+        }
+        tFrictionSpeed = (tMillivolt > 0) ? tFrictionSpeed : -tFrictionSpeed;
+    } else if (tSpeed < 0) {
+        tFrictionSpeed = -tFrictionSpeed;
+    }
+
+    if (tMillivolt == INT16_MIN) {
+        tAcceleration = -tFrictionSpeed / tTau;
+    } else {
+        tAcceleration = ((tMillivolt / tKe) - tFrictionSpeed - tSpeed) / tTau;
+    }
+    if (tAcceleration > Parameters.MaxAccelerationMillimeterPerSecond2) {
+        tAcceleration = Parameters.MaxAccelerationMillimeterPerSecond2;
+    } else if (tAcceleration < -(float) Parameters.MaxAccelerationMillimeterPerSecond2) {
+        tAcceleration = -(float) Parameters.MaxAccelerationMillimeterPerSecond2;
+    }
+
+    float tNewSpeed = tSpeed + tAcceleration * tStepSeconds;
+    if (tSpeed != 0 && ((tSpeed > 0) != (tNewSpeed > 0)) && (tMillivolt == INT16_MIN || abs(tMillivolt) < Parameters.StartMillivolt)) {
+        // Friction stops the motor and does not reverse it
+        tStepSeconds = -tSpeed / tAcceleration;
+        tNewSpeed = 0;
+        if (DriveEndMicros != 0 && StandstillMicros == 0) {
+            StandstillMicros = aNowMicros + (uint64_t) (tStepSeconds * 1000000.0);
+        }
+    }
+    float tFloorStepSeconds = aStepMicros / 1000000.0; // tStepSeconds may be shortened by the friction stop
+    SpeedMillimeterPerSecond = tNewSpeed;
+
+    /*
+     * Position and encoder edges, speed is linear within the step
+     */
+    double tDeltaMillimeter = (tSpeed + tNewSpeed) / 2.0 * tStepSeconds;
+    DistanceMillimeter += tDeltaMillimeter;
+    stepFloor(tSpeed, tDeltaMillimeter, tFloorStepSeconds);
+    double tOldPosition = EncoderPosition;
+    EncoderPosition += tDeltaMillimeter * Parameters.EncoderSlots * PLANT_ENCODER_EDGES_PER_SLOT / Parameters.CircumferenceMillimeter;
+
+    double tOldSlot = floor(tOldPosition);
+    double tNewSlot = floor(EncoderPosition);
+    if (tNewSlot == tOldSlot) {
+        return;
+    }
+    double tEdgePosition = (tNewSlot > tOldSlot) ? tOldSlot + 1 : tOldSlot;
+    double tEdgeIncrement = (tNewSlot > tOldSlot) ? 1 : -1;
+    int tNumberOfEdges = abs((int) (tNewSlot - tOldSlot));
+    for (int i = 0; i < tNumberOfEdges; ++i) {
+        uint64_t tEdgeMicros = aNowMicros
+                + (uint64_t) ((tEdgePosition - tOldPosition) / (EncoderPosition - tOldPosition) * tStepSeconds * 1000000.0 + 0.5);
+        if (tEdgeMicros <= aNowMicros) {
+            tEdgeMicros = aNowMicros + 1;
+        }
+        scheduleEdge(tEdgeMicros, (int8_t) tEdgeIncrement);
+        if (Parameters.EncoderRingingPercent > 0 && (getPlantRandom() % 100) < Parameters.EncoderRingingPercent) {
+#if defined(USE_QUADRATURE_ENCODER)
+            // The channel returns for a short time to its old level
+            uint64_t tRingingMicros = tEdgeMicros + 300 + (getPlantRandom() % 1200);
+            scheduleEdge(tRingingMicros, (int8_t) -tEdgeIncrement);
+            scheduleEdge(tRingingMicros + 50, (int8_t) tEdgeIncrement);
+#else
+            scheduleEdge(tEdgeMicros + 300 + (getPlantRandom() % 1200), (int8_t) tEdgeIncrement);
+#endif
+        }
+        tEdgePosition += tEdgeIncrement;
+    }
+}
+
+/*
+ * With grip, the floor moves like the tire, otherwise it is accelerated by the grip towards the tire speed
+ */
+void DcMotorPlant::stepFloor(float aOldSpeed, double aDeltaMillimeter, float aStepSeconds) {
+    float tOldFloorSpeed = FloorSpeedMillimeterPerSecond;
+    float tMaxSpeedChange = Parameters.GripAccelerationMillimeterPerSecond2 * aStepSeconds;
+    float tSpeedChange = SpeedMillimeterPerSecond - tOldFloorSpeed;
+    if (tOldFloorSpeed == aOldSpeed && fabs(tSpeedChange) <= tMaxSpeedChange) {
+        FloorSpeedMillimeterPerSecond = SpeedMillimeterPerSecond;
+        FloorDistanceMillimeter += aDeltaMillimeter;
+        return;
+    }
+    if (tSpeedChange > tMaxSpeedChange) {
+        tSpeedChange = tMaxSpeedChange;
+    } else if (tSpeedChange < -tMaxSpeedChange) {
+        tSpeedChange = -tMaxSpeedChange;
+    }
+    FloorSpeedMillimeterPerSecond = tOldFloorSpeed + tSpeedChange;
+    FloorDistanceMillimeter += (tOldFloorSpeed + FloorSpeedMillimeterPerSecond) / 2.0 * aStepSeconds;
+}
+
+/*
+ * Insert edge sorted into pending list
+ */
+void DcMotorPlant::scheduleEdge(uint64_t aEdgeMicros, int8_t aStep) {
+    if (NumberOfPendingEdges >= PLANT_MAX_PENDING_EDGES) {
+        return; // more than 4 edges in 250 us are not plausible for a 20 slot disc
+    }
+    uint8_t i = NumberOfPendingEdges++;
+    while (i > 0 && PendingEdgeMicros[i - 1] > aEdgeMicros) {
+        PendingEdgeMicros[i] = PendingEdgeMicros[i - 1];
+        PendingEdgeStep[i] = PendingEdgeStep[i - 1];
+        i--;
+    }
+    PendingEdgeMicros[i] = aEdgeMicros;
+    PendingEdgeStep[i] = aStep;
+}
+
+#if defined(USE_QUADRATURE_ENCODER)
+void DcMotorPlant::setQuadratureEncoderPins(uint8_t aEncoderPinA, uint8_t aEncoderPinB) {
+    EncoderPinA = aEncoderPinA;
+    EncoderPinB = aEncoderPinB;
+    writeQuadratureEncoderPins();
+}
+
+/*
+ * Forward sequence of (A, B) is 00 -> 10 -> 11 -> 01, A leads B
+ */
+void DcMotorPlant::writeQuadratureEncoderPins() {
+    uint8_t tPhase = EncoderPinsPosition & 0x03;
+    sHostPins[EncoderPinA].DigitalLevel = (tPhase == 1 || tPhase == 2);
+    sHostPins[EncoderPinB].DigitalLevel = (tPhase == 2 || tPhase == 3);
+}
+#endif
+
+uint64_t DcMotorPlant::getNextEdgeMicros() {
+    if (NumberOfPendingEdges == 0) {
+        return UINT64_MAX;
+    }
+    return PendingEdgeMicros[0];
+}
+
+/*******************************************************************************************
+ * CarPlant
+ *******************************************************************************************/
+/*
+ * Uses the pins of RobotCarPinDefinitionsAndMore.h and registers at the virtual clock
+ */
+void CarPlant::init() {
+    RightMotor.init(RIGHT_MOTOR_FORWARD_PIN, RIGHT_MOTOR_BACKWARD_PIN, RIGHT_MOTOR_PWM_PIN, RIGHT_MOTOR_INTERRUPT);
+    LeftMotor.init(LEFT_MOTOR_FORWARD_PIN, LEFT_MOTOR_BACKWARD_PIN, LEFT_MOTOR_PWM_PIN, LEFT_MOTOR_INTERRUPT);
+#if defined(USE_QUADRATURE_ENCODER)
+    RightMotor.setQuadratureEncoderPins(RIGHT_MOTOR_ENCODER_A_PIN, RIGHT_MOTOR_ENCODER_B_PIN);
+    LeftMotor.setQuadratureEncoderPins(LEFT_MOTOR_ENCODER_A_PIN, LEFT_MOTOR_ENCODER_B_PIN);
+#endif
+    Motors[0] = &RightMotor;
+    Motors[1] = &LeftMotor;
+#if defined(PLANT_HAS_REAR_MOTORS)
+    RightRearMotor.init(RIGHT_REAR_MOTOR_FORWARD_PIN, RIGHT_REAR_MOTOR_BACKWARD_PIN, RIGHT_REAR_MOTOR_PWM_PIN, RIGHT_REAR_MOTOR_INTERRUPT);
+    LeftRearMotor.init(LEFT_REAR_MOTOR_FORWARD_PIN, LEFT_REAR_MOTOR_BACKWARD_PIN, LEFT_REAR_MOTOR_PWM_PIN, LEFT_REAR_MOTOR_INTERRUPT);
+    Motors[2] = &RightRearMotor;
+    Motors[3] = &LeftRearMotor;
+#endif
+    TrackWidthMillimeter = PLANT_TRACK_WIDTH_MILLIMETER;
+    reset();
+    VirtualClock::addComponent(this);
+}
+
+void CarPlant::reset() {
+    for (uint_fast8_t i = 0; i < PLANT_NUMBER_OF_MOTORS; ++i) {
+        Motors[i]->reset();
+    }
+    XMillimeter = 0;
+    YMillimeter = 0;
+    HeadingRadian = 0;
+    NextStepMicros = VirtualClock::Micros;
+}
+
+void CarPlant::resetStopMeasurement() {
+    for (uint_fast8_t i = 0; i < PLANT_NUMBER_OF_MOTORS; ++i) {
+        Motors[i]->resetStopMeasurement();
+    }
+}
+
+bool CarPlant::isStopped() {
+    for (uint_fast8_t i = 0; i < PLANT_NUMBER_OF_MOTORS; ++i) {
+        if (!Motors[i]->isStopped()) {
+            return false;
+        }
+    }
+    return true;
+}
+
+float CarPlant::getHeadingDegree() {
+    return HeadingRadian * (180.0 / M_PI);
+}
+
+/*
+ * @return distance of the car center since reset()
+ */
+float CarPlant::getDistanceMillimeter() {
+    return (RightMotor.FloorDistanceMillimeter + LeftMotor.FloorDistanceMillimeter) / 2.0;
+}
+
+float CarPlant::getSpeedMillimeterPerSecond() {
+    return (RightMotor.FloorSpeedMillimeterPerSecond + LeftMotor.FloorSpeedMillimeterPerSecond) / 2.0;
+}
+
+/*
+ * Positive is counterclockwise
+ */
+float CarPlant::getYawRateRadianPerSecond() {
+    return (RightMotor.FloorSpeedMillimeterPerSecond - LeftMotor.FloorSpeedMillimeterPerSecond) / TrackWidthMillimeter;
+}
+
+uint64_t CarPlant::getNextEventMicros() {
+    uint64_t tNextMicros = NextStepMicros;
+    for (uint_fast8_t i = 0; i < PLANT_NUMBER_OF_MOTORS; ++i) {
+        if (Motors[i]->getNextEdgeMicros() < tNextMicros) {
+            tNextMicros = Motors[i]->getNextEdgeMicros();
+        }
+    }
+    return tNextMicros;
+}
+
+/*
+ * Edges of the last interval are handled before the next step, since they belong to the old interval
+ */
+void CarPlant::handleEvent(uint64_t aNowMicros) {
+    for (uint_fast8_t i = 0; i < PLANT_NUMBER_OF_MOTORS; ++i) {
+        DcMotorPlant *tMotor = Motors[i];
+        while (tMotor->NumberOfPendingEdges > 0 && tMotor->PendingEdgeMicros[0] <= aNowMicros) {
+#if defined(USE_QUADRATURE_ENCODER)
+            tMotor->EncoderPinsPosition += tMotor->PendingEdgeStep[0];
+            tMotor->writeQuadratureEncoderPins();
+#endif
+            tMotor->NumberOfPendingEdges--;
+            memmove(&tMotor->PendingEdgeMicros[0], &tMotor->PendingEdgeMicros[1], tMotor->NumberOfPendingEdges * sizeof(uint64_t));
+            memmove(&tMotor->PendingEdgeStep[0], &tMotor->PendingEdgeStep[1], tMotor->NumberOfPendingEdges);
+            tMotor->EncoderEdgeCount++;
+            triggerHostInterrupt(tMotor->InterruptNumber);
+        }
+    }
+
+    if (aNowMicros >= NextStepMicros) {
+        double tOldRightMillimeter = RightMotor.FloorDistanceMillimeter;
+        double tOldLeftMillimeter = LeftMotor.FloorDistanceMillimeter;
+        for (uint_fast8_t i = 0; i < PLANT_NUMBER_OF_MOTORS; ++i) {
+            Motors[i]->step(aNowMicros, PLANT_STEP_MICROS);
+        }
+
+        // Differential drive kinematics
+        double tDeltaRight = RightMotor.FloorDistanceMillimeter - tOldRightMillimeter;
+        double tDeltaLeft = LeftMotor.FloorDistanceMillimeter - tOldLeftMillimeter;
+        double tDeltaHeading = (tDeltaRight - tDeltaLeft) / TrackWidthMillimeter;
+        double tDeltaDistance = (tDeltaRight + tDeltaLeft) / 2.0;
+        XMillimeter += tDeltaDistance * cos(HeadingRadian + tDeltaHeading / 2.0);
+        YMillimeter += tDeltaDistance * sin(HeadingRadian + tDeltaHeading / 2.0);
+        HeadingRadian += tDeltaHeading;
+
+        NextStepMicros = aNowMicros + PLANT_STEP_MICROS;
+    }
+}
+
+#if defined(PLANT_HAS_REAR_MOTORS)
+void handleRightRearEncoderInterrupt() {
+    RobotCarPWMMotorControl.rightFollowerCarMotors[0].handleEncoderInterrupt();
+}
+
+void handleLeftRearEncoderInterrupt() {
+    RobotCarPWMMotorControl.leftFollowerCarMotors[0].handleEncoderInterrupt();
+}
+
+/*
+ * Does what the sketch of a 4WD car must do for its rear motors. Call it after RobotCarPWMMotorControl.init().
+ */
+void initRearCarMotors() {
+    RobotCarPWMMotorControl.rightFollowerCarMotors[0].init(RIGHT_REAR_MOTOR_FORWARD_PIN, RIGHT_REAR_MOTOR_BACKWARD_PIN,
+    RIGHT_REAR_MOTOR_PWM_PIN);
+    RobotCarPWMMotorControl.leftFollowerCarMotors[0].init(LEFT_REAR_MOTOR_FORWARD_PIN, LEFT_REAR_MOTOR_BACKWARD_PIN,
+    LEFT_REAR_MOTOR_PWM_PIN);
+    attachInterrupt(RIGHT_REAR_MOTOR_INTERRUPT, handleRightRearEncoderInterrupt, RISING);
+    attachInterrupt(LEFT_REAR_MOTOR_INTERRUPT, handleLeftRearEncoderInterrupt, RISING);
+}
+#endif
+
+#endif // CAR_PLANT_HPP
@@ -0,0 +1,56 @@
+/*
+ * EEPROM.h
+ *
+ * Host stand-in for the Arduino EEPROM library. Uses the same RAM array as the AVR eeprom_*() functions of Arduino.h.
+ *
+ *  Copyright (C) 2022  Armin Joachimsmeyer
+ *  armin.joachimsmeyer@gmail.com
+ *
+ *  This file is part of PWMMotorControl https://github.com/ArminJo/PWMMotorControl.
+ *
+ *  PWMMotorControl is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/gpl.html>.
+ */
+
+#ifndef HOST_EEPROM_H
+#define HOST_EEPROM_H
+
+#include "Arduino.h"
+
+class EEPROMClass {
+public:
+    uint8_t read(int aIndex) {
+        return eeprom_read_byte((const uint8_t*) (intptr_t) aIndex);
+    }
+    void write(int aIndex, uint8_t aValue) {
+        eeprom_write_byte((uint8_t*) (intptr_t) aIndex, aValue);
+    }
+    void update(int aIndex, uint8_t aValue) {
+        eeprom_update_byte((uint8_t*) (intptr_t) aIndex, aValue);
+    }
+    uint16_t length() {
+        return E2END + 1;
+    }
+    template<typename T> T& get(int aIndex, T &aValue) {
+        eeprom_read_block(&aValue, (const void*) (intptr_t) aIndex, sizeof(T));
+        return aValue;
+    }
+    template<typename T> const T& put(int aIndex, const T &aValue) {
+        eeprom_update_block(&aValue, (void*) (intptr_t) aIndex, sizeof(T));
+        return aValue;
+    }
+};
+
+static EEPROMClass EEPROM;
+
+#endif // HOST_EEPROM_H
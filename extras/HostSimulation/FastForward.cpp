@@ -0,0 +1,84 @@
+/*
+ *  FastForward.cpp
+ *
+ *  Runs the Square example pattern on the host with the virtual clock, as fast as the PC can,
+ *  and prints how many updateMotors() calls were executed per simulated and per real second.
+ *
+ *  Build and run from this directory with:
+ *  g++ -std=gnu++11 -O2 -Wall -I. -I../../src FastForward.cpp -o FastForward && ./FastForward [simulated hours]
+ *
+ *  Copyright (C) 2022  Armin Joachimsmeyer
+ *  armin.joachimsmeyer@gmail.com
+ *
+ *  This file is part of PWMMotorControl https://github.com/ArminJo/PWMMotorControl.
+ *
+ *  PWMMotorControl is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/gpl.html>.
+ *
+ */
+
+#include <Arduino.h>
+#include <time.h>
+
+#include "HostArduino.hpp"
+
+#define VIN_2_LIPO
+#include "CarPWMMotorControl.hpp"
+
+#define SIZE_OF_SQUARE_MILLIMETER  400
+
+unsigned long sUpdateMotorsCount;
+
+void countLoopCallback() {
+    sUpdateMotorsCount++;
+}
+
+int main(int argc, char *argv[]) {
+    double tSimulatedHours = 1.0;
+    if (argc > 1) {
+        tSimulatedHours = atof(argv[1]);
+    }
+    Serial.OutputEnabled = false;
+    VirtualClock::reset();
+
+    RobotCarPWMMotorControl.init(RIGHT_MOTOR_FORWARD_PIN, RIGHT_MOTOR_BACKWARD_PIN, RIGHT_MOTOR_PWM_PIN, LEFT_MOTOR_FORWARD_PIN,
+    LEFT_MOTOR_BACKWARD_PIN, LEFT_MOTOR_PWM_PIN);
+
+    struct timespec tStart, tEnd;
+    clock_gettime(CLOCK_MONOTONIC, &tStart);
+
+    uint64_t tEndMicros = tSimulatedHours * 3600.0 * 1000000.0;
+    uint8_t tMotorDirection = DIRECTION_FORWARD;
+    unsigned long tSquareCount = 0;
+    while (VirtualClock::Micros < tEndMicros) {
+        for (int i = 0; i < 4; ++i) {
+            RobotCarPWMMotorControl.goDistanceMillimeter(SIZE_OF_SQUARE_MILLIMETER, tMotorDirection, &countLoopCallback);
+            delay(400);
+            RobotCarPWMMotorControl.rotate(90, TURN_FORWARD, true, &countLoopCallback);
+            delay(400);
+        }
+        RobotCarPWMMotorControl.rotate(180, TURN_IN_PLACE, false, &countLoopCallback);
+        tMotorDirection = oppositeDIRECTION(tMotorDirection);
+        tSquareCount++;
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &tEnd);
+    double tRealSeconds = (tEnd.tv_sec - tStart.tv_sec) + (tEnd.tv_nsec - tStart.tv_nsec) / 1e9;
+    double tVirtualSeconds = VirtualClock::Micros / 1e6;
+
+    printf("squares=%lu virtual_s=%.1f real_s=%.3f speedup=%.0f\n", tSquareCount, tVirtualSeconds, tRealSeconds,
+            tVirtualSeconds / tRealSeconds);
+    printf("updateMotors_calls=%lu calls_per_virtual_s=%.0f ns_per_call=%.1f\n", sUpdateMotorsCount,
+            sUpdateMotorsCount / tVirtualSeconds, (tRealSeconds * 1e9) / sUpdateMotorsCount);
+    return 0;
+}
@@ -0,0 +1,173 @@
+/*
+ *  FastPWMDcMotorTrials.cpp
+ *
+ *  Checks, that FastPWMDcMotor writes the same output as PWMDcMotor
+ *  1. FullBridgeMotorDriver on the left motor pins against PWMDcMotor on the right motor pins, for forward, backward,
+ *     brake and release at different battery voltages.
+ *  2. With SpeedPWMCompensation, where the output of FastPWMDcMotor must be the output of the compensated PWM without compensation.
+ *  3. PCA9685MotorDriver, where the bytes of the I2C transaction are captured and the PWM and direction channels are checked.
+ *
+ *  Build and run from this directory with:
+ *  g++ -std=gnu++11 -O2 -Wall -I. -I../../src FastPWMDcMotorTrials.cpp -o FastPWMDcMotorTrials && ./FastPWMDcMotorTrials
+ *  Output is one line of key=value pairs for each failed check and a summary line. Exit code is 1 if a check failed.
+ *
+ *  Copyright (C) 2022  Armin Joachimsmeyer
+ *  armin.joachimsmeyer@gmail.com
+ *
+ *  This file is part of PWMMotorControl https://github.com/ArminJo/PWMMotorControl.
+ *
+ *  PWMMotorControl is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/gpl.html>.
+ *
+ */
+
+#include <Arduino.h>
+
+#if defined(USE_ADAFRUIT_MOTOR_SHIELD)
+#error FastPWMDcMotorTrials compares with the full bridge output of PWMDcMotor, do not define USE_ADAFRUIT_MOTOR_SHIELD
+#endif
+
+#include "HostArduino.hpp"
+
+#define VIN_2_LIPO
+#include "PWMDcMotor.hpp"
+#include "FastPWMDcMotor.h"
+#include "PCA9685MotorDriver.h"
+
+#define PCA9685_TRIAL_MOTOR_NUMBER  2 // IN1 11, IN2 12, PWM 13
+#define PCA9685_TRANSACTION_LENGTH  13 // register + 3 channels with 4 bytes
+
+unsigned long sNumberOfFailedChecks;
+unsigned long sNumberOfChecks;
+
+PWMDcMotor sReferenceMotor;
+FastPWMDcMotor<FullBridgeMotorDriver<LEFT_MOTOR_FORWARD_PIN, LEFT_MOTOR_BACKWARD_PIN, LEFT_MOTOR_PWM_PIN> > sFullBridgeMotor;
+FastPWMDcMotor<PCA9685MotorDriver<PCA9685_TRIAL_MOTOR_NUMBER> > sPCA9685Motor;
+
+/*
+ * Stores the last transaction written to the PCA9685
+ */
+class PCA9685Device: public HostI2CDevice {
+public:
+    void receive(const uint8_t *aData, uint8_t aLength) override {
+        memcpy(LastTransaction, aData, min(aLength, (uint8_t) sizeof(LastTransaction)));
+        LastTransactionLength = aLength;
+    }
+    uint8_t transmit(uint8_t *aBuffer, uint8_t aQuantity) override {
+        (void) aBuffer;
+        (void) aQuantity;
+        return 0;
+    }
+    uint16_t getChannelOff(uint8_t aChannelIndex) {
+        uint8_t *tOffBytes = &LastTransaction[1 + (4 * aChannelIndex) + 2];
+        return tOffBytes[0] | (tOffBytes[1] << 8);
+    }
+    uint16_t getChannelOn(uint8_t aChannelIndex) {
+        uint8_t *tOnBytes = &LastTransaction[1 + (4 * aChannelIndex)];
+        return tOnBytes[0] | (tOnBytes[1] << 8);
+    }
+
+    uint8_t LastTransaction[PCA9685_TRANSACTION_LENGTH];
+    uint8_t LastTransactionLength;
+} sPCA9685Device;
+
+void check(const char *aName, bool aCondition, uint16_t aVINMillivolt, uint8_t aSpeedPWM) {
+    sNumberOfChecks++;
+    if (!aCondition) {
+        sNumberOfFailedChecks++;
+        printf("check=%s failed vin_mv=%u pwm=%u\n", aName, aVINMillivolt, aSpeedPWM);
+    }
+}
+
+/*
+ * @return true if both motors have the same driver outputs
+ */
+bool hasSameFullBridgeOutput() {
+    return sHostPins[RIGHT_MOTOR_FORWARD_PIN].DigitalLevel == sHostPins[LEFT_MOTOR_FORWARD_PIN].DigitalLevel
+            && sHostPins[RIGHT_MOTOR_BACKWARD_PIN].DigitalLevel == sHostPins[LEFT_MOTOR_BACKWARD_PIN].DigitalLevel
+            && sHostPins[RIGHT_MOTOR_PWM_PIN].AnalogWriteValue == sHostPins[LEFT_MOTOR_PWM_PIN].AnalogWriteValue;
+}
+
+void checkFullBridgeDriver(uint16_t aVINMillivolt, uint8_t aSpeedPWM, uint8_t aDirection) {
+    sReferenceMotor.setSpeedPWM(aSpeedPWM, aDirection);
+    sFullBridgeMotor.setSpeedPWM(aSpeedPWM, aDirection);
+    check("full_bridge_output", hasSameFullBridgeOutput(), aVINMillivolt, aSpeedPWM);
+    check("full_bridge_current_pwm", sReferenceMotor.CurrentSpeedPWM == sFullBridgeMotor.CurrentSpeedPWM, aVINMillivolt, aSpeedPWM);
+}
+
+/*
+ * The compensated output of sFullBridgeMotor must be the output of sReferenceMotor for the compensated PWM
+ */
+void checkCompensation(uint16_t aVINMillivolt, uint8_t aSpeedPWM, uint8_t aCompensation) {
+    sFullBridgeMotor.setSpeedPWMCompensation(aCompensation);
+    uint8_t tCompensatedSpeedPWM = (aSpeedPWM > aCompensation) ? aSpeedPWM - aCompensation : 0;
+    sReferenceMotor.setSpeedPWM(tCompensatedSpeedPWM, DIRECTION_FORWARD);
+    sFullBridgeMotor.setSpeedPWM(aSpeedPWM, DIRECTION_FORWARD);
+    check("compensation_output", hasSameFullBridgeOutput(), aVINMillivolt, aSpeedPWM);
+    check("compensation_current_pwm", sFullBridgeMotor.CurrentSpeedPWM == tCompensatedSpeedPWM, aVINMillivolt, aSpeedPWM);
+    sFullBridgeMotor.setSpeedPWMCompensation(0);
+}
+
+void checkPCA9685Driver(uint16_t aVINMillivolt, uint8_t aSpeedPWM, uint8_t aDirection, uint8_t aCompensation) {
+    sPCA9685Motor.setSpeedPWMCompensation(aCompensation);
+    sPCA9685Device.LastTransactionLength = 0;
+    sPCA9685Motor.setSpeedPWM(aSpeedPWM, aDirection);
+    check("pca9685_transaction_length", sPCA9685Device.LastTransactionLength == PCA9685_TRANSACTION_LENGTH, aVINMillivolt, aSpeedPWM);
+    check("pca9685_register",
+            sPCA9685Device.LastTransaction[0]
+                    == PCA9685_FIRST_PWM_REGISTER + 4 * PCA9685MotorDriver<PCA9685_TRIAL_MOTOR_NUMBER>::FirstChannel, aVINMillivolt,
+            aSpeedPWM);
+    // Motor 2 has the channel order IN1, IN2, PWM
+    uint16_t tExpectedPWMOff = 16 * PWMDcMotor::getOutputSpeedPWM(aSpeedPWM - aCompensation);
+    check("pca9685_pwm", sPCA9685Device.getChannelOff(2) == tExpectedPWMOff, aVINMillivolt, aSpeedPWM);
+    check("pca9685_in1", sPCA9685Device.getChannelOn(0) == ((aDirection == DIRECTION_FORWARD) ? 4096 : 0), aVINMillivolt, aSpeedPWM);
+    check("pca9685_in2", sPCA9685Device.getChannelOn(1) == ((aDirection == DIRECTION_BACKWARD) ? 4096 : 0), aVINMillivolt,
+            aSpeedPWM);
+    sPCA9685Motor.stop(MOTOR_RELEASE);
+}
+
+int main() {
+    Serial.OutputEnabled = false;
+    VirtualClock::reset();
+    Wire.addDevice(&sPCA9685Device, PCA9685_DEFAULT_ADDRESS);
+
+    sReferenceMotor.init(RIGHT_MOTOR_FORWARD_PIN, RIGHT_MOTOR_BACKWARD_PIN, RIGHT_MOTOR_PWM_PIN);
+    sFullBridgeMotor.init();
+    sPCA9685Motor.init();
+
+    const uint16_t tVINMillivolts[] = { FULL_BRIDGE_INPUT_MILLIVOLT, 6000, 7400, 8400 };
+    for (uint_fast8_t i = 0; i < sizeof(tVINMillivolts) / sizeof(tVINMillivolts[0]); ++i) {
+        uint16_t tVINMillivolt = tVINMillivolts[i];
+        PWMDcMotor::setVINMillivolt(tVINMillivolt);
+        for (uint16_t tSpeedPWM = 0; tSpeedPWM <= MAX_SPEED_PWM; tSpeedPWM += 17) {
+            checkFullBridgeDriver(tVINMillivolt, tSpeedPWM, DIRECTION_FORWARD);
+            checkFullBridgeDriver(tVINMillivolt, tSpeedPWM, DIRECTION_BACKWARD); // includes the brake at direction change
+            sReferenceMotor.stop(MOTOR_BRAKE);
+            sFullBridgeMotor.stop(MOTOR_BRAKE);
+            check("full_bridge_brake", hasSameFullBridgeOutput(), tVINMillivolt, tSpeedPWM);
+            sReferenceMotor.stop(MOTOR_RELEASE);
+            sFullBridgeMotor.stop(MOTOR_RELEASE);
+            check("full_bridge_release", hasSameFullBridgeOutput(), tVINMillivolt, tSpeedPWM);
+
+            checkCompensation(tVINMillivolt, tSpeedPWM, 10);
+            sReferenceMotor.stop(MOTOR_RELEASE);
+            sFullBridgeMotor.stop(MOTOR_RELEASE);
+            if (tSpeedPWM > 10) {
+                checkPCA9685Driver(tVINMillivolt, tSpeedPWM, DIRECTION_FORWARD, 0);
+                checkPCA9685Driver(tVINMillivolt, tSpeedPWM, DIRECTION_BACKWARD, 10);
+            }
+        }
+    }
+    printf("checks=%lu failed_checks=%lu\n", sNumberOfChecks, sNumberOfFailedChecks);
+    return (sNumberOfFailedChecks == 0 ? 0 : 1);
+}
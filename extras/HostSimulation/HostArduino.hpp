@@ -0,0 +1,553 @@
+/*
+ * HostArduino.hpp
+ *
+ * Implementation of the host stand-ins for the Arduino core, Wire and EEPROM.
+ * Include it exactly once in the main program, like the library *.hpp files.
+ *
+ *  Copyright (C) 2022  Armin Joachimsmeyer
+ *  armin.joachimsmeyer@gmail.com
+ *
+ *  This file is part of PWMMotorControl https://github.com/ArminJo/PWMMotorControl.
+ *
+ *  PWMMotorControl is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/gpl.html>.
+ */
+#ifndef HOST_ARDUINO_HPP
+#define HOST_ARDUINO_HPP
+
+#include "Arduino.h"
+#include "Wire.h"
+
+HardwareSerial Serial;
+TwoWire Wire;
+
+HostPinState sHostPins[NUM_DIGITAL_PINS + 2];
+void (*sHostInterruptHandlers[NUMBER_OF_HOST_INTERRUPTS])(void);
+bool sHostInterruptsEnabled = true;
+bool sHostInterruptIsPending[NUMBER_OF_HOST_INTERRUPTS];
+uint8_t sHostEEPROM[E2END + 1];
+
+/*
+ * Erased EEPROM cells contain 0xFF
+ */
+struct HostEEPROMInitializer {
+    HostEEPROMInitializer() {
+        memset(sHostEEPROM, 0xFF, sizeof(sHostEEPROM));
+    }
+} sHostEEPROMInitializer;
+
+/*******************************************************************************************
+ * Virtual clock
+ *******************************************************************************************/
+uint64_t VirtualClock::Micros;
+uint16_t VirtualClock::MicrosPerCall = VIRTUAL_CLOCK_MICROS_PER_CALL;
+bool VirtualClock::IsHandlingEvent;
+uint8_t VirtualClock::NumberOfComponents;
+VirtualClockComponent *VirtualClock::Components[VIRTUAL_CLOCK_MAX_COMPONENTS];
+
+/*
+ * Reset time to 0 and remove all components
+ */
+void VirtualClock::reset() {
+    Micros = 0;
+    IsHandlingEvent = false;
+    removeAllComponents();
+}
+
+void VirtualClock::addComponent(VirtualClockComponent *aComponent) {
+    if (NumberOfComponents < VIRTUAL_CLOCK_MAX_COMPONENTS) {
+        Components[NumberOfComponents++] = aComponent;
+    }
+}
+
+void VirtualClock::removeAllComponents() {
+    NumberOfComponents = 0;
+}
+
+void VirtualClock::advanceMicros(uint32_t aMicros) {
+    advanceToMicros(Micros + aMicros);
+}
+
+/*
+ * Process all component events up to aAbsoluteMicros in chronological order, then set time to aAbsoluteMicros.
+ * Calls from inside an event handler or ISR do not advance time.
+ */
+void VirtualClock::advanceToMicros(uint64_t aAbsoluteMicros) {
+    if (IsHandlingEvent || aAbsoluteMicros <= Micros) {
+        return;
+    }
+    IsHandlingEvent = true;
+    while (true) {
+        VirtualClockComponent *tNextComponent = NULL;
+        uint64_t tNextEventMicros = aAbsoluteMicros;
+        for (uint_fast8_t i = 0; i < NumberOfComponents; ++i) {
+            uint64_t tEventMicros = Components[i]->getNextEventMicros();
+            if (tEventMicros <= tNextEventMicros) {
+                tNextEventMicros = tEventMicros;
+                tNextComponent = Components[i];
+            }
+        }
+        if (tNextComponent == NULL) {
+            break;
+        }
+        if (tNextEventMicros > Micros) {
+            Micros = tNextEventMicros;
+        }
+        tNextComponent->handleEvent(Micros);
+    }
+    Micros = aAbsoluteMicros;
+    IsHandlingEvent = false;
+}
+
+unsigned long millis() {
+    VirtualClock::advanceMicros(VirtualClock::MicrosPerCall);
+    return VirtualClock::Micros / 1000;
+}
+
+unsigned long micros() {
+    VirtualClock::advanceMicros(VirtualClock::MicrosPerCall);
+    return VirtualClock::Micros;
+}
+
+void delay(unsigned long aMillis) {
+    VirtualClock::advanceMicros(aMillis * 1000);
+}
+
+void delayMicroseconds(unsigned int aMicros) {
+    VirtualClock::advanceMicros(aMicros);
+}
+
+/*
+ * Busy wait loops, which only call yield(), must advance the time too
+ */
+void yield() {
+    VirtualClock::advanceMicros(VirtualClock::MicrosPerCall);
+}
+
+/*******************************************************************************************
+ * Pins and interrupts
+ *******************************************************************************************/
+void pinMode(uint8_t aPin, uint8_t aMode) {
+    sHostPins[aPin].Mode = aMode;
+}
+
+void digitalWrite(uint8_t aPin, uint8_t aValue) {
+    sHostPins[aPin].DigitalLevel = (aValue != LOW);
+}
+
+int digitalRead(uint8_t aPin) {
+    return sHostPins[aPin].DigitalLevel;
+}
+
+/*
+ * Like the AVR core, 0 and 255 switch the pin to digital LOW or HIGH
+ */
+void analogWrite(uint8_t aPin, int aValue) {
+    sHostPins[aPin].AnalogWriteValue = aValue;
+    sHostPins[aPin].DigitalLevel = (aValue > 127);
+}
+
+int analogRead(uint8_t aPin) {
+    if (aPin < A0) {
+        aPin += A0; // channel number given
+    }
+    VirtualClock::advanceMicros(112); // conversion time of the AVR ADC with prescaler 128
+    return sHostPins[aPin].AnalogReadValue;
+}
+
+void tone(uint8_t aPin, unsigned int aFrequency, unsigned long aDuration) {
+    (void) aPin;
+    (void) aFrequency;
+    (void) aDuration;
+}
+
+void noTone(uint8_t aPin) {
+    (void) aPin;
+}
+
+unsigned long pulseIn(uint8_t aPin, uint8_t aState, unsigned long aTimeoutMicros) {
+    (void) aPin;
+    (void) aState;
+    VirtualClock::advanceMicros(aTimeoutMicros);
+    return 0;
+}
+
+unsigned long pulseInLong(uint8_t aPin, uint8_t aState, unsigned long aTimeoutMicros) {
+    return pulseIn(aPin, aState, aTimeoutMicros);
+}
+
+void attachInterrupt(uint8_t aInterruptNumber, void (*aISR)(void), int aMode) {
+    (void) aMode;
+    if (aInterruptNumber < NUMBER_OF_INTERRUPTS) {
+        sHostInterruptHandlers[aInterruptNumber] = aISR;
+    }
+}
+
+void detachInterrupt(uint8_t aInterruptNumber) {
+    if (aInterruptNumber < NUMBER_OF_INTERRUPTS) {
+        sHostInterruptHandlers[aInterruptNumber] = NULL;
+    }
+}
+
+void noInterrupts() {
+    sHostInterruptsEnabled = false;
+}
+
+/*
+ * Enable interrupts and run the ones which were triggered while disabled
+ */
+void interrupts() {
+    sHostInterruptsEnabled = true;
+    for (uint_fast8_t i = 0; i < NUMBER_OF_HOST_INTERRUPTS; ++i) {
+        if (sHostInterruptIsPending[i]) {
+            triggerHostInterrupt(i);
+        }
+    }
+}
+
+/*
+ * Like on AVR, interrupts are disabled while the ISR runs
+ */
+void triggerHostInterrupt(uint8_t aInterruptNumber) {
+    if (aInterruptNumber >= NUMBER_OF_HOST_INTERRUPTS || sHostInterruptHandlers[aInterruptNumber] == NULL) {
+        return;
+    }
+    if (!sHostInterruptsEnabled) {
+        sHostInterruptIsPending[aInterruptNumber] = true;
+        return;
+    }
+    sHostInterruptIsPending[aInterruptNumber] = false;
+    bool tIsHandlingEvent = VirtualClock::IsHandlingEvent;
+    VirtualClock::IsHandlingEvent = true; // no time advance inside ISR
+    sHostInterruptsEnabled = false;
+    sHostInterruptHandlers[aInterruptNumber]();
+    sHostInterruptsEnabled = true;
+    VirtualClock::IsHandlingEvent = tIsHandlingEvent;
+}
+
+/*
+ * Triggers HOST_TIMER_INTERRUPT every PeriodMicros. Is added to the virtual clock by startHostTimerInterrupt().
+ */
+class HostTimer: public VirtualClockComponent {
+public:
+    uint64_t getNextEventMicros() {
+        if (PeriodMicros == 0) {
+            return UINT64_MAX;
+        }
+        return NextEventMicros;
+    }
+    void handleEvent(uint64_t aNowMicros) {
+        NextEventMicros = aNowMicros + PeriodMicros;
+        triggerHostInterrupt(HOST_TIMER_INTERRUPT);
+    }
+
+    uint32_t PeriodMicros; // 0 -> stopped
+    uint64_t NextEventMicros;
+} sHostTimer;
+
+void startHostTimerInterrupt(uint32_t aPeriodMicros, void (*aISR)(void)) {
+    sHostInterruptHandlers[HOST_TIMER_INTERRUPT] = aISR;
+    sHostTimer.PeriodMicros = aPeriodMicros;
+    sHostTimer.NextEventMicros = VirtualClock::Micros + aPeriodMicros;
+    for (uint_fast8_t i = 0; i < VirtualClock::NumberOfComponents; ++i) {
+        if (VirtualClock::Components[i] == &sHostTimer) {
+            return;
+        }
+    }
+    VirtualClock::addComponent(&sHostTimer);
+}
+
+void stopHostTimerInterrupt() {
+    sHostTimer.PeriodMicros = 0;
+    sHostInterruptHandlers[HOST_TIMER_INTERRUPT] = NULL;
+}
+
+/*******************************************************************************************
+ * Random, deterministic xorshift32
+ *******************************************************************************************/
+static uint32_t sHostRandomState = 2463534242UL;
+
+void randomSeed(unsigned long aSeed) {
+    if (aSeed != 0) {
+        sHostRandomState = aSeed;
+    }
+}
+
+long random(long aMax) {
+    if (aMax == 0) {
+        return 0;
+    }
+    sHostRandomState ^= sHostRandomState << 13;
+    sHostRandomState ^= sHostRandomState >> 17;
+    sHostRandomState ^= sHostRandomState << 5;
+    return sHostRandomState % aMax;
+}
+
+long random(long aMin, long aMax) {
+    if (aMin >= aMax) {
+        return aMin;
+    }
+    return random(aMax - aMin) + aMin;
+}
+
+/*******************************************************************************************
+ * EEPROM
+ *******************************************************************************************/
+uint8_t eeprom_read_byte(const uint8_t *aAddress) {
+    return sHostEEPROM[((uintptr_t) aAddress) & E2END];
+}
+
+void eeprom_write_byte(uint8_t *aAddress, uint8_t aValue) {
+    sHostEEPROM[((uintptr_t) aAddress) & E2END] = aValue;
+}
+
+void eeprom_update_byte(uint8_t *aAddress, uint8_t aValue) {
+    if (eeprom_read_byte(aAddress) != aValue) {
+        eeprom_write_byte(aAddress, aValue);
+    }
+}
+
+void eeprom_read_block(void *aDestination, const void *aSource, size_t aSize) {
+    for (size_t i = 0; i < aSize; ++i) {
+        ((uint8_t*) aDestination)[i] = eeprom_read_byte((const uint8_t*) aSource + i);
+    }
+}
+
+void eeprom_write_block(const void *aSource, void *aDestination, size_t aSize) {
+    for (size_t i = 0; i < aSize; ++i) {
+        eeprom_write_byte((uint8_t*) aDestination + i, ((const uint8_t*) aSource)[i]);
+    }
+}
+
+void eeprom_update_block(const void *aSource, void *aDestination, size_t aSize) {
+    for (size_t i = 0; i < aSize; ++i) {
+        eeprom_update_byte((uint8_t*) aDestination + i, ((const uint8_t*) aSource)[i]);
+    }
+}
+
+/*******************************************************************************************
+ * Print and Serial
+ *******************************************************************************************/
+size_t Print::write(const char *aString) {
+    return write((const uint8_t*) aString, strlen(aString));
+}
+
+size_t Print::write(const uint8_t *aBuffer, size_t aSize) {
+    size_t tCount = 0;
+    while (aSize--) {
+        tCount += write(*aBuffer++);
+    }
+    return tCount;
+}
+
+size_t Print::print(const __FlashStringHelper *aString) {
+    return write(reinterpret_cast<const char*>(aString));
+}
+
+size_t Print::print(const char aString[]) {
+    return write(aString);
+}
+
+size_t Print::print(char aChar) {
+    return write((uint8_t) aChar);
+}
+
+size_t Print::print(unsigned char aValue, int aBase) {
+    return printNumber(aValue, aBase);
+}
+
+size_t Print::print(int aValue, int aBase) {
+    return print((long long) aValue, aBase);
+}
+
+size_t Print::print(unsigned int aValue, int aBase) {
+    return printNumber(aValue, aBase);
+}
+
+size_t Print::print(long aValue, int aBase) {
+    return print((long long) aValue, aBase);
+}
+
+size_t Print::print(unsigned long aValue, int aBase) {
+    return printNumber(aValue, aBase);
+}
+
+size_t Print::print(long long aValue, int aBase) {
+    if (aBase == DEC && aValue < 0) {
+        return write('-') + printNumber(-aValue, DEC);
+    }
+    return printNumber(aValue, aBase);
+}
+
+size_t Print::print(unsigned long long aValue, int aBase) {
+    return printNumber(aValue, aBase);
+}
+
+size_t Print::print(double aValue, int aDigits) {
+    char tBuffer[32];
+    snprintf(tBuffer, sizeof(tBuffer), "%.*f", aDigits, aValue);
+    return write(tBuffer);
+}
+
+size_t Print::println() {
+    return write("\r\n");
+}
+
+size_t Print::printNumber(unsigned long long aValue, uint8_t aBase) {
+    char tBuffer[8 * sizeof(long long) + 1];
+    char *tStringPointer = &tBuffer[sizeof(tBuffer) - 1];
+    *tStringPointer = '\0';
+    if (aBase < 2) {
+        aBase = 10;
+    }
+    do {
+        char tDigit = aValue % aBase;
+        aValue /= aBase;
+        *--tStringPointer = tDigit < 10 ? tDigit + '0' : tDigit + 'A' - 10;
+    } while (aValue);
+    return write(tStringPointer);
+}
+
+void HardwareSerial::begin(unsigned long aBaudRate) {
+    (void) aBaudRate;
+}
+
+void HardwareSerial::end() {
+}
+
+void HardwareSerial::flush() {
+    if (OutputEnabled) {
+        fflush(stdout);
+    }
+}
+
+int HardwareSerial::available() {
+    return 0;
+}
+
+int HardwareSerial::read() {
+    return -1;
+}
+
+size_t HardwareSerial::write(uint8_t aByte) {
+    WrittenBytesCount++;
+    if (OutputEnabled && aByte != '\r') {
+        putchar(aByte);
+    }
+    return 1;
+}
+
+/*******************************************************************************************
+ * Wire
+ *******************************************************************************************/
+void TwoWire::begin() {
+}
+
+void TwoWire::end() {
+}
+
+void TwoWire::setClock(uint32_t aClockHertz) {
+    ClockHertz = aClockHertz;
+}
+
+void TwoWire::setWireTimeout(uint32_t aTimeoutMicros, bool aResetWithTimeout) {
+    (void) aTimeoutMicros;
+    (void) aResetWithTimeout;
+}
+
+void TwoWire::addDevice(HostI2CDevice *aDevice, uint8_t aAddress) {
+    if (NumberOfDevices < WIRE_MAX_DEVICES) {
+        aDevice->Address = aAddress;
+        Devices[NumberOfDevices++] = aDevice;
+    }
+}
+
+void TwoWire::removeAllDevices() {
+    NumberOfDevices = 0;
+}
+
+HostI2CDevice* TwoWire::findDevice(uint8_t aAddress) {
+    for (uint_fast8_t i = 0; i < NumberOfDevices; ++i) {
+        if (Devices[i]->Address == aAddress) {
+            return Devices[i];
+        }
+    }
+    return NULL;
+}
+
+/*
+ * 9 clocks per byte plus start and stop condition
+ */
+void TwoWire::addBusTime(uint8_t aNumberOfBytes) {
+    TransferredBytesCount += aNumberOfBytes;
+    VirtualClock::advanceMicros(((aNumberOfBytes * 9UL + 2) * 1000000UL) / ClockHertz);
+}
+
+void TwoWire::beginTransmission(uint8_t aAddress) {
+    TransmitAddress = aAddress;
+    TransmitLength = 0;
+}
+
+size_t TwoWire::write(uint8_t aByte) {
+    if (TransmitLength >= BUFFER_LENGTH) {
+        return 0;
+    }
+    TransmitBuffer[TransmitLength++] = aByte;
+    return 1;
+}
+
+/*
+ * @return 0 success, 2 address NACK
+ */
+uint8_t TwoWire::endTransmission(bool aSendStop) {
+    (void) aSendStop;
+    addBusTime(TransmitLength + 1);
+    HostI2CDevice *tDevice = findDevice(TransmitAddress);
+    if (tDevice == NULL) {
+        NackCount++;
+        return 2;
+    }
+    tDevice->receive(TransmitBuffer, TransmitLength);
+    return 0;
+}
+
+uint8_t TwoWire::requestFrom(uint8_t aAddress, uint8_t aQuantity, uint8_t aSendStop) {
+    (void) aSendStop;
+    ReceiveIndex = 0;
+    ReceiveLength = 0;
+    if (aQuantity > BUFFER_LENGTH) {
+        aQuantity = BUFFER_LENGTH;
+    }
+    HostI2CDevice *tDevice = findDevice(aAddress);
+    if (tDevice == NULL) {
+        NackCount++;
+        addBusTime(1);
+        return 0;
+    }
+    ReceiveLength = tDevice->transmit(ReceiveBuffer, aQuantity);
+    addBusTime(ReceiveLength + 1);
+    return ReceiveLength;
+}
+
+int TwoWire::available() {
+    return ReceiveLength - ReceiveIndex;
+}
+
+int TwoWire::read() {
+    if (ReceiveIndex >= ReceiveLength) {
+        return -1;
+    }
+    return ReceiveBuffer[ReceiveIndex++];
+}
+
+#endif // HOST_ARDUINO_HPP
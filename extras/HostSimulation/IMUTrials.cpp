@@ -0,0 +1,219 @@
+/*
+ *  IMUTrials.cpp
+ *
+ *  Runs IMUCarData against the simulated MPU6050 of MPU6050Device.h and prints
+ *  1. FIFO draining throughput and overflows for different call intervals of readCarDataFromMPU6050Fifo()
+ *  2. The behavior of the auto offset of a standing car with a drifting gyroscope bias
+ *  3. The growth of the errors of integrated speed, distance and turn angle while driving
+ *  4. With -DUSE_ENCODER_MOTOR_CONTROL, distance drives on a floor with full grip, with a slippery right wheel and against an obstacle.
+ *     Add -DDO_NOT_USE_TRACTION_CONTROL to compare with the drives without traction control.
+ *
+ *  Build and run from this directory with:
+ *  g++ -std=gnu++11 -O2 -Wall -DUSE_MPU6050_IMU -I. -I../../src IMUTrials.cpp -o IMUTrials && ./IMUTrials [gyroscope drift per second]
+ *  Output is one line of key=value pairs per measurement, to be easily processed by scripts.
+ *
+ *  Copyright (C) 2022  Armin Joachimsmeyer
+ *  armin.joachimsmeyer@gmail.com
+ *
+ *  This file is part of PWMMotorControl https://github.com/ArminJo/PWMMotorControl.
+ *
+ *  PWMMotorControl is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/gpl.html>.
+ *
+ */
+
+#include <Arduino.h>
+
+#if !defined(USE_MPU6050_IMU)
+#error IMUTrials requires -DUSE_MPU6050_IMU
+#endif
+
+#include "HostArduino.hpp"
+
+#define VIN_2_LIPO
+#include "CarPWMMotorControl.hpp"
+#include "CarPlant.hpp"
+#include "MPU6050Device.hpp"
+
+CarPlant sCarPlant;
+MPU6050Device sMPU6050;
+IMUCarData &sIMUData = RobotCarPWMMotorControl.IMUData;
+
+uint32_t sReadMicros; // virtual time spent in readCarDataFromMPU6050Fifo()
+unsigned long sReadCalls;
+unsigned long sOffsetChanges;
+
+void timedReadFifo() {
+    uint64_t tStartMicros = VirtualClock::Micros;
+    sIMUData.readCarDataFromMPU6050Fifo();
+    sReadMicros += VirtualClock::Micros - tStartMicros;
+    sReadCalls++;
+    if (sIMUData.OffsetsHaveChanged) {
+        sIMUData.OffsetsHaveChanged = false;
+        sOffsetChanges++;
+    }
+}
+
+/*
+ * Read FIFO every aIntervalMillis for 10 seconds after the initial offset calibration
+ */
+void measureFifoThroughput(uint16_t aIntervalMillis) {
+    sIMUData.resetOffsetDataAndWait();
+    unsigned long tStartResets = sMPU6050.FifoResetCount;
+    unsigned long tStartOverwritten = sMPU6050.OverwrittenBytesCount;
+    unsigned long tStartReadBytes = sMPU6050.FifoReadBytesCount;
+    sReadMicros = 0;
+    sReadCalls = 0;
+
+    uint64_t tEndMicros = VirtualClock::Micros + 10000000;
+    while (VirtualClock::Micros < tEndMicros) {
+        timedReadFifo();
+        delay(aIntervalMillis);
+    }
+    unsigned long tReadChunks = (sMPU6050.FifoReadBytesCount - tStartReadBytes) / 8;
+    printf("test=fifo interval_ms=%u calls=%lu chunks_read=%lu us_per_call=%.1f us_per_chunk=%.2f bus_load_percent=%.1f"
+            " fifo_resets=%lu lost_chunks=%lu\n", aIntervalMillis, sReadCalls, tReadChunks, (float) sReadMicros / sReadCalls,
+            tReadChunks ? (float) sReadMicros / tReadChunks : 0, sReadMicros / 100000.0, sMPU6050.FifoResetCount - tStartResets,
+            (sMPU6050.OverwrittenBytesCount - tStartOverwritten) / 8);
+}
+
+/*
+ * Car is standing still, gyroscope bias drifts
+ */
+void measureAutoOffset(float aGyroscopeDriftPerSecond, uint16_t aMinutes) {
+    sMPU6050.Parameters.GyroscopeDriftPerSecond = aGyroscopeDriftPerSecond;
+    sMPU6050.GyroscopeDrift = 0;
+    sIMUData.resetOffsetDataAndWait();
+    printf("test=offset_initial accel_offset=%d accel_bias=%d gyro_offset=%d gyro_bias=%.1f\n", sIMUData.AcceleratorForwardOffset,
+            sMPU6050.Parameters.AccelerometerBias[0], sIMUData.GyroscopePanOffset,
+            sMPU6050.Parameters.GyroscopeBias[2] + sMPU6050.GyroscopeDrift);
+    sOffsetChanges = 0;
+    for (uint16_t i = 1; i <= aMinutes; ++i) {
+        uint64_t tEndMicros = VirtualClock::Micros + 60000000;
+        while (VirtualClock::Micros < tEndMicros) {
+            timedReadFifo();
+            delay(5);
+        }
+        printf("test=offset_tracking minute=%u gyro_offset=%d gyro_bias=%.1f turn_angle_deg=%d speed_cm_s=%d offset_changes=%lu\n",
+                i, sIMUData.GyroscopePanOffset, sMPU6050.Parameters.GyroscopeBias[2] + sMPU6050.GyroscopeDrift,
+                sIMUData.getTurnAngleDegree(), sIMUData.getSpeedCmPerSecond(), sOffsetChanges);
+    }
+    sMPU6050.Parameters.GyroscopeDriftPerSecond = 0;
+}
+
+/*
+ * Drive forward 2 seconds with a slight left curve, stop 1 second, drive backward 2 seconds, stop 1 second.
+ * Compare integrated IMU values with the plant at increasing times.
+ */
+void measureErrorGrowth() {
+    sIMUData.resetOffsetDataAndWait();
+    sCarPlant.reset();
+    sOffsetChanges = 0;
+
+    const uint16_t tReportSeconds[] = { 1, 2, 5, 10, 30, 60, 120 };
+    uint8_t tReportIndex = 0;
+    uint64_t tStartMicros = VirtualClock::Micros;
+    float tMaxSpeedError = 0;
+    while (tReportIndex < sizeof(tReportSeconds) / sizeof(tReportSeconds[0])) {
+        uint32_t tPhaseMillis = ((VirtualClock::Micros - tStartMicros) / 1000) % 6000;
+        if (tPhaseMillis < 2000) {
+            RobotCarPWMMotorControl.rightCarMotor.setSpeedPWM(DEFAULT_DRIVE_SPEED_PWM + 8, DIRECTION_FORWARD);
+            RobotCarPWMMotorControl.leftCarMotor.setSpeedPWM(DEFAULT_DRIVE_SPEED_PWM, DIRECTION_FORWARD);
+        } else if (tPhaseMillis >= 3000 && tPhaseMillis < 5000) {
+            RobotCarPWMMotorControl.rightCarMotor.setSpeedPWM(DEFAULT_DRIVE_SPEED_PWM, DIRECTION_BACKWARD);
+            RobotCarPWMMotorControl.leftCarMotor.setSpeedPWM(DEFAULT_DRIVE_SPEED_PWM, DIRECTION_BACKWARD);
+        } else {
+            RobotCarPWMMotorControl.rightCarMotor.stop(MOTOR_BRAKE);
+            RobotCarPWMMotorControl.leftCarMotor.stop(MOTOR_BRAKE);
+        }
+        timedReadFifo();
+        delay(2);
+
+        float tSpeedError = fabs(sIMUData.getSpeedCmPerSecond() * 10.0 - sCarPlant.getSpeedMillimeterPerSecond());
+        if (tSpeedError > tMaxSpeedError) {
+            tMaxSpeedError = tSpeedError;
+        }
+        if (VirtualClock::Micros - tStartMicros >= tReportSeconds[tReportIndex] * 1000000ULL) {
+            printf("test=error_growth seconds=%u speed_error_max_mm_s=%.0f distance_mm=%.0f distance_error_mm=%.0f"
+                    " heading_deg=%.1f heading_error_deg=%.1f offset_changes=%lu\n", tReportSeconds[tReportIndex], tMaxSpeedError,
+                    sCarPlant.getDistanceMillimeter(), sIMUData.getDistanceMillimeter() - sCarPlant.getDistanceMillimeter(),
+                    sCarPlant.getHeadingDegree(), sIMUData.getTurnAngleDegree() - sCarPlant.getHeadingDegree(), sOffsetChanges);
+            tReportIndex++;
+        }
+    }
+    RobotCarPWMMotorControl.stop(MOTOR_BRAKE);
+}
+
+#if defined(USE_ENCODER_MOTOR_CONTROL)
+/*
+ * Drive 500 mm with the grip of both wheels and print the floor distance, the distance error of the right encoder, the heading,
+ * the time until stop and the traction events. The floor distance of a blocked car is 0, so its time shows the stall detection.
+ */
+void measureTraction(const char *aFloorName, uint16_t aRightGrip, uint16_t aLeftGrip) {
+    sIMUData.resetOffsetDataAndWait();
+    sCarPlant.reset();
+    sCarPlant.RightMotor.Parameters.GripAccelerationMillimeterPerSecond2 = aRightGrip;
+    sCarPlant.LeftMotor.Parameters.GripAccelerationMillimeterPerSecond2 = aLeftGrip;
+#  if defined(USE_TRACTION_CONTROL)
+    RobotCarPWMMotorControl.getAndClearTractionEvents();
+#  endif
+    uint32_t tStartMillis = millis();
+    RobotCarPWMMotorControl.startGoDistanceMillimeter(500);
+    while (RobotCarPWMMotorControl.updateMotors() && millis() - tStartMillis < 5000) {
+        delay(1);
+    }
+    uint32_t tStopMillis = millis() - tStartMillis;
+    RobotCarPWMMotorControl.stop(MOTOR_BRAKE);
+    while (!sCarPlant.isStopped()) {
+        delay(1);
+    }
+    uint8_t tTractionEvents = 0;
+#  if defined(USE_TRACTION_CONTROL)
+    tTractionEvents = RobotCarPWMMotorControl.getAndClearTractionEvents();
+#  endif
+    printf("test=traction floor=%s distance_mm=%.0f right_encoder_error_mm=%.0f heading_deg=%.1f stop_ms=%lu events=0x%02X\n", aFloorName,
+            sCarPlant.getDistanceMillimeter(), RobotCarPWMMotorControl.rightCarMotor.getDistanceMillimeter() - sCarPlant.RightMotor.FloorDistanceMillimeter,
+            sCarPlant.getHeadingDegree(), (unsigned long) tStopMillis, tTractionEvents);
+    sCarPlant.RightMotor.setDefaultParameters();
+    sCarPlant.LeftMotor.setDefaultParameters();
+    delay(500);
+}
+#endif
+
+int main(int argc, char *argv[]) {
+    float tGyroscopeDriftPerSecond = 0.2;
+    if (argc > 1) {
+        tGyroscopeDriftPerSecond = atof(argv[1]);
+    }
+    Serial.OutputEnabled = false;
+    VirtualClock::reset();
+    sCarPlant.init();
+    sMPU6050.init(&sCarPlant);
+
+    RobotCarPWMMotorControl.init(RIGHT_MOTOR_FORWARD_PIN, RIGHT_MOTOR_BACKWARD_PIN, RIGHT_MOTOR_PWM_PIN, LEFT_MOTOR_FORWARD_PIN,
+    LEFT_MOTOR_BACKWARD_PIN, LEFT_MOTOR_PWM_PIN);
+
+    const uint16_t tIntervals[] = { 1, 2, 5, 10, 20, 50, 100, 150, 200 };
+    for (uint8_t i = 0; i < sizeof(tIntervals) / sizeof(tIntervals[0]); ++i) {
+        measureFifoThroughput(tIntervals[i]);
+    }
+    measureAutoOffset(tGyroscopeDriftPerSecond, 10);
+    measureErrorGrowth();
+#if defined(USE_ENCODER_MOTOR_CONTROL)
+    measureTraction("grip", 10000, 10000);
+    measureTraction("slippery_right", 500, 10000);
+    measureTraction("slippery", 500, 500);
+    measureTraction("blocked", 0, 0);
+#endif
+    return 0;
+}
@@ -0,0 +1,100 @@
+/*
+ * MPU6050Device.h
+ *
+ * Simulated MPU6050 (GY-521 breakout) behind the host Wire stand-in.
+ * Supports the registers used by IMUCarData: sample rate and DLPF config, FIFO enable, FIFO reset, FIFO count, FIFO read
+ * and the direct data registers from ACCEL_XOUT_H to GYRO_ZOUT_H.
+ * Like the real chip, the 1024 byte FIFO overwrites the oldest data on overflow and the FIFO count stays at 1024.
+ *
+ * Samples are generated at the configured sample rate by the virtual clock.
+ * Forward acceleration and yaw rate are taken from the CarPlant, if one is connected, and bias, noise,
+ * vibration noise of the running motors and bias drift are added.
+ *
+ *  Copyright (C) 2022  Armin Joachimsmeyer
+ *  armin.joachimsmeyer@gmail.com
+ *
+ *  This file is part of PWMMotorControl https://github.com/ArminJo/PWMMotorControl.
+ *
+ *  PWMMotorControl is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/gpl.html>.
+ */
+
+#ifndef MPU6050_DEVICE_H
+#define MPU6050_DEVICE_H
+
+#include "Arduino.h"
+#include "Wire.h"
+#include "MPU6050Defines.h"
+#include "CarPlant.h"
+
+#define MPU6050_FIFO_SIZE               1024
+#define MPU6050_NUMBER_OF_REGISTERS     0x80
+#define MPU6050_ACCEL_RAW_PER_G         16384.0 // +/-2 g range
+#define MPU6050_GYRO_RAW_PER_DPS        131.072 // +/-250 degree per second range
+#define MILLIMETER_PER_SECOND2_PER_G    9806.65
+
+struct MPU6050DeviceParameters {
+    int16_t AccelerometerBias[3];       // raw LSB of x, y and z axis
+    int16_t GyroscopeBias[3];           // raw LSB of x, y and z axis
+    float AccelerometerNoise;           // standard deviation in raw LSB
+    float GyroscopeNoise;               // standard deviation in raw LSB
+    float VibrationNoisePerMillimeterPerSecond; // additional accelerometer noise of the running motors
+    float AccelerometerDriftPerSecond;  // bias change of x axis in raw LSB per second, e.g. by temperature
+    float GyroscopeDriftPerSecond;      // bias change of z axis in raw LSB per second
+};
+
+class MPU6050Device: public HostI2CDevice, public VirtualClockComponent {
+public:
+    void init(CarPlant *aCarPlant = NULL);
+    void setDefaultParameters();
+    void powerOnReset();
+    void resetFifo();
+    uint32_t getSamplePeriodMicros();
+
+    void receive(const uint8_t *aData, uint8_t aLength) override;
+    uint8_t transmit(uint8_t *aBuffer, uint8_t aQuantity) override;
+    uint64_t getNextEventMicros() override;
+    void handleEvent(uint64_t aNowMicros) override;
+
+    void generateSample(uint64_t aNowMicros);
+    void writeRegisterWord(uint8_t aRegisterNumber, int16_t aValue);
+    void pushToFifo(uint8_t aValue);
+    uint8_t popFromFifo();
+    float getGaussianNoise(float aStandardDeviation);
+
+    MPU6050DeviceParameters Parameters;
+    CarPlant *ConnectedCarPlant;
+
+    uint8_t Registers[MPU6050_NUMBER_OF_REGISTERS];
+    uint8_t RegisterPointer;
+
+    uint8_t Fifo[MPU6050_FIFO_SIZE];
+    uint16_t FifoReadIndex;
+    uint16_t FifoCount;
+
+    uint64_t NextSampleMicros;
+    uint64_t LastBiasUpdateMicros;
+    float LastSpeedMillimeterPerSecond;
+    float AccelerometerDrift;           // current drift value in raw LSB
+    float GyroscopeDrift;
+
+    /*
+     * Statistics
+     */
+    unsigned long GeneratedSamplesCount;
+    unsigned long OverwrittenBytesCount; // bytes lost by FIFO overflow
+    unsigned long FifoReadBytesCount;
+    unsigned long FifoResetCount;
+};
+
+#endif // MPU6050_DEVICE_H
@@ -0,0 +1,280 @@
+/*
+ * MPU6050Device.hpp
+ *
+ * Implementation of the simulated MPU6050.
+ * Include it exactly once in the main program after HostArduino.hpp and CarPlant.hpp.
+ *
+ *  Copyright (C) 2022  Armin Joachimsmeyer
+ *  armin.joachimsmeyer@gmail.com
+ *
+ *  This file is part of PWMMotorControl https://github.com/ArminJo/PWMMotorControl.
+ *
+ *  PWMMotorControl is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/gpl.html>.
+ */
+#ifndef MPU6050_DEVICE_HPP
+#define MPU6050_DEVICE_HPP
+
+#include "MPU6050Device.h"
+
+static uint32_t sMPU6050RandomState = 0x6A09E667UL;
+
+/*
+ * Registers with the device at the default address of Wire and at the virtual clock
+ */
+void MPU6050Device::init(CarPlant *aCarPlant) {
+    ConnectedCarPlant = aCarPlant;
+    setDefaultParameters();
+    powerOnReset();
+    Wire.addDevice(this, MPU6050_DEFAULT_ADDRESS);
+    VirtualClock::addComponent(this);
+}
+
+/*
+ * Values of a typical GY-521 board
+ */
+void MPU6050Device::setDefaultParameters() {
+    Parameters.AccelerometerBias[0] = 320; // ~20 mg
+    Parameters.AccelerometerBias[1] = -150;
+    Parameters.AccelerometerBias[2] = 600;
+    Parameters.GyroscopeBias[0] = -40;
+    Parameters.GyroscopeBias[1] = 25;
+    Parameters.GyroscopeBias[2] = 110; // ~0.8 degree per second
+    Parameters.AccelerometerNoise = 65; // 400 ug/sqrt(Hz) at 184 Hz bandwidth
+    Parameters.GyroscopeNoise = 9; // 0.005 dps/sqrt(Hz) at 188 Hz bandwidth
+    Parameters.VibrationNoisePerMillimeterPerSecond = 0.5;
+    Parameters.AccelerometerDriftPerSecond = 0;
+    Parameters.GyroscopeDriftPerSecond = 0;
+}
+
+void MPU6050Device::powerOnReset() {
+    memset(Registers, 0, sizeof(Registers));
+    Registers[MPU6050_RA_PWR_MGMT_1] = _BV(MPU6050_PWR1_SLEEP_BIT);
+    Registers[MPU6050_RA_WHO_AM_I] = MPU6050_DEFAULT_ADDRESS;
+    RegisterPointer = 0;
+    resetFifo();
+    FifoResetCount = 0;
+    NextSampleMicros = VirtualClock::Micros + getSamplePeriodMicros();
+    LastBiasUpdateMicros = VirtualClock::Micros;
+    LastSpeedMillimeterPerSecond = 0;
+    AccelerometerDrift = 0;
+    GyroscopeDrift = 0;
+    GeneratedSamplesCount = 0;
+    OverwrittenBytesCount = 0;
+    FifoReadBytesCount = 0;
+}
+
+void MPU6050Device::resetFifo() {
+    FifoReadIndex = 0;
+    FifoCount = 0;
+    FifoResetCount++;
+}
+
+/*
+ * Gyroscope output rate is 8 kHz if DLPF is disabled, else 1 kHz
+ */
+uint32_t MPU6050Device::getSamplePeriodMicros() {
+    uint8_t tDLPFConfig = Registers[MPU6050_RA_CONFIG] & 0x07;
+    uint32_t tOutputRatePeriodMicros = (tDLPFConfig == 0 || tDLPFConfig == 7) ? 125 : 1000;
+    return tOutputRatePeriodMicros * (Registers[MPU6050_RA_SMPLRT_DIV] + 1);
+}
+
+/*
+ * First byte is the register number, the following bytes are written to consecutive registers
+ */
+void MPU6050Device::receive(const uint8_t *aData, uint8_t aLength) {
+    if (aLength == 0) {
+        return;
+    }
+    RegisterPointer = aData[0] & (MPU6050_NUMBER_OF_REGISTERS - 1);
+    for (uint_fast8_t i = 1; i < aLength; ++i) {
+        uint8_t tValue = aData[i];
+        if (RegisterPointer == MPU6050_RA_USER_CTRL) {
+            if (tValue & _BV(MPU6050_USERCTRL_FIFO_RESET_BIT)) {
+                resetFifo();
+                tValue &= ~_BV(MPU6050_USERCTRL_FIFO_RESET_BIT); // bit is self clearing
+            }
+        } else if (RegisterPointer == MPU6050_RA_PWR_MGMT_1 && (tValue & _BV(MPU6050_PWR1_DEVICE_RESET_BIT))) {
+            powerOnReset();
+            continue;
+        } else if (RegisterPointer == MPU6050_RA_FIFO_R_W) {
+            pushToFifo(tValue);
+            continue;
+        }
+        Registers[RegisterPointer] = tValue;
+        if (RegisterPointer == MPU6050_RA_SMPLRT_DIV || RegisterPointer == MPU6050_RA_CONFIG) {
+            NextSampleMicros = VirtualClock::Micros + getSamplePeriodMicros();
+        }
+        RegisterPointer = (RegisterPointer + 1) & (MPU6050_NUMBER_OF_REGISTERS - 1);
+    }
+}
+
+/*
+ * FIFO_R_W does not increment the register pointer
+ */
+uint8_t MPU6050Device::transmit(uint8_t *aBuffer, uint8_t aQuantity) {
+    for (uint_fast8_t i = 0; i < aQuantity; ++i) {
+        if (RegisterPointer == MPU6050_RA_FIFO_R_W) {
+            aBuffer[i] = popFromFifo();
+            continue;
+        }
+        if (RegisterPointer == MPU6050_RA_FIFO_COUNTH) {
+            aBuffer[i] = FifoCount >> 8;
+        } else if (RegisterPointer == MPU6050_RA_FIFO_COUNTH + 1) {
+            aBuffer[i] = FifoCount & 0xFF;
+        } else {
+            aBuffer[i] = Registers[RegisterPointer];
+        }
+        RegisterPointer = (RegisterPointer + 1) & (MPU6050_NUMBER_OF_REGISTERS - 1);
+    }
+    return aQuantity;
+}
+
+uint64_t MPU6050Device::getNextEventMicros() {
+    return NextSampleMicros;
+}
+
+void MPU6050Device::handleEvent(uint64_t aNowMicros) {
+    if (!(Registers[MPU6050_RA_PWR_MGMT_1] & _BV(MPU6050_PWR1_SLEEP_BIT))) {
+        generateSample(aNowMicros);
+    }
+    NextSampleMicros = aNowMicros + getSamplePeriodMicros();
+}
+
+/*
+ * Writes the data registers and appends the values enabled by the FIFO_EN register to the FIFO
+ */
+void MPU6050Device::generateSample(uint64_t aNowMicros) {
+    float tDeltaSeconds = (aNowMicros - LastBiasUpdateMicros) / 1000000.0;
+    LastBiasUpdateMicros = aNowMicros;
+    AccelerometerDrift += Parameters.AccelerometerDriftPerSecond * tDeltaSeconds;
+    GyroscopeDrift += Parameters.GyroscopeDriftPerSecond * tDeltaSeconds;
+
+    float tSpeed = 0;
+    float tYawRateDegreePerSecond = 0;
+    if (ConnectedCarPlant != NULL) {
+        tSpeed = ConnectedCarPlant->getSpeedMillimeterPerSecond();
+        tYawRateDegreePerSecond = ConnectedCarPlant->getYawRateRadianPerSecond() * (180.0 / M_PI);
+    }
+    float tForwardAcceleration = 0;
+    if (tDeltaSeconds > 0) {
+        tForwardAcceleration = (tSpeed - LastSpeedMillimeterPerSecond) / tDeltaSeconds;
+    }
+    LastSpeedMillimeterPerSecond = tSpeed;
+
+    float tAccelerometer[3];
+    float tVibrationNoise = Parameters.VibrationNoisePerMillimeterPerSecond * fabs(tSpeed);
+    for (uint_fast8_t i = 0; i < 3; ++i) {
+        tAccelerometer[i] = Parameters.AccelerometerBias[i] + getGaussianNoise(Parameters.AccelerometerNoise)
+                + getGaussianNoise(tVibrationNoise);
+    }
+    float tForwardRaw = tForwardAcceleration * (MPU6050_ACCEL_RAW_PER_G / MILLIMETER_PER_SECOND2_PER_G) + AccelerometerDrift;
+#ifdef USE_NEGATIVE_ACCELERATION_FOR_SPEED
+    tForwardRaw = -tForwardRaw;
+#endif
+#ifdef USE_ACCELERATOR_Y_FOR_SPEED
+    tAccelerometer[1] += tForwardRaw;
+#else
+    tAccelerometer[0] += tForwardRaw;
+#endif
+    tAccelerometer[2] += MPU6050_ACCEL_RAW_PER_G; // gravity
+
+    float tGyroscope[3];
+    for (uint_fast8_t i = 0; i < 3; ++i) {
+        tGyroscope[i] = Parameters.GyroscopeBias[i] + getGaussianNoise(Parameters.GyroscopeNoise);
+    }
+    tGyroscope[2] += tYawRateDegreePerSecond * MPU6050_GYRO_RAW_PER_DPS + GyroscopeDrift;
+
+    for (uint_fast8_t i = 0; i < 3; ++i) {
+        writeRegisterWord(MPU6050_RA_ACCEL_XOUT_H + (2 * i), constrain(tAccelerometer[i], -32768, 32767));
+        writeRegisterWord(MPU6050_RA_GYRO_XOUT_H + (2 * i), constrain(tGyroscope[i], -32768, 32767));
+    }
+    writeRegisterWord(MPU6050_RA_TEMP_OUT_H, (25.0 - 36.53) * 340); // 25 degree celsius
+    GeneratedSamplesCount++;
+
+    /*
+     * FIFO order is the register order
+     */
+    if (Registers[MPU6050_RA_USER_CTRL] & _BV(MPU6050_USERCTRL_FIFO_EN_BIT)) {
+        uint8_t tFifoEnable = Registers[MPU6050_RA_FIFO_EN];
+        if (tFifoEnable & _BV(MPU6050_ACCEL_FIFO_EN_BIT)) {
+            for (uint_fast8_t i = 0; i < 6; ++i) {
+                pushToFifo(Registers[MPU6050_RA_ACCEL_XOUT_H + i]);
+            }
+        }
+        if (tFifoEnable & _BV(MPU6050_TEMP_FIFO_EN_BIT)) {
+            pushToFifo(Registers[MPU6050_RA_TEMP_OUT_H]);
+            pushToFifo(Registers[MPU6050_RA_TEMP_OUT_H + 1]);
+        }
+        for (uint_fast8_t i = 0; i < 3; ++i) {
+            if (tFifoEnable & _BV(MPU6050_XG_FIFO_EN_BIT - i)) {
+                pushToFifo(Registers[MPU6050_RA_GYRO_XOUT_H + (2 * i)]);
+                pushToFifo(Registers[MPU6050_RA_GYRO_XOUT_H + (2 * i) + 1]);
+            }
+        }
+    }
+}
+
+/*
+ * Big endian, like the MPU6050 registers
+ */
+void MPU6050Device::writeRegisterWord(uint8_t aRegisterNumber, int16_t aValue) {
+    Registers[aRegisterNumber] = ((uint16_t) aValue) >> 8;
+    Registers[aRegisterNumber + 1] = aValue & 0xFF;
+}
+
+/*
+ * If FIFO is full, the oldest byte is overwritten
+ */
+void MPU6050Device::pushToFifo(uint8_t aValue) {
+    if (FifoCount >= MPU6050_FIFO_SIZE) {
+        FifoReadIndex = (FifoReadIndex + 1) % MPU6050_FIFO_SIZE;
+        FifoCount--;
+        OverwrittenBytesCount++;
+    }
+    Fifo[(FifoReadIndex + FifoCount) % MPU6050_FIFO_SIZE] = aValue;
+    FifoCount++;
+}
+
+/*
+ * Reading an empty FIFO returns the last value read
+ */
+uint8_t MPU6050Device::popFromFifo() {
+    if (FifoCount == 0) {
+        return Fifo[(FifoReadIndex + MPU6050_FIFO_SIZE - 1) % MPU6050_FIFO_SIZE];
+    }
+    uint8_t tValue = Fifo[FifoReadIndex];
+    FifoReadIndex = (FifoReadIndex + 1) % MPU6050_FIFO_SIZE;
+    FifoCount--;
+    FifoReadBytesCount++;
+    return tValue;
+}
+
+/*
+ * Box-Muller with an own xorshift generator
+ */
+float MPU6050Device::getGaussianNoise(float aStandardDeviation) {
+    if (aStandardDeviation <= 0) {
+        return 0;
+    }
+    float tUniform[2];
+    for (uint_fast8_t i = 0; i < 2; ++i) {
+        sMPU6050RandomState ^= sMPU6050RandomState << 13;
+        sMPU6050RandomState ^= sMPU6050RandomState >> 17;
+        sMPU6050RandomState ^= sMPU6050RandomState << 5;
+        tUniform[i] = (sMPU6050RandomState + 1.0) / 4294967297.0; // (0, 1)
+    }
+    return aStandardDeviation * sqrt(-2.0 * log(tUniform[0])) * cos(2.0 * M_PI * tUniform[1]);
+}
+
+#endif // MPU6050_DEVICE_HPP
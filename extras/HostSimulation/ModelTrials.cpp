@@ -0,0 +1,168 @@
+/*
+ *  ModelTrials.cpp
+ *
+ *  Runs CarPWMMotorControl::identifyMotorModels() against the simulated car of CarPlant.h with random plant parameters
+ *  for each motor (battery voltage, start and friction voltage, time constant and wheel circumference)
+ *  and compares the identified models of both motors and directions with the values of the plant.
+ *  The plant values are converted to the units of the model, i.e. to the PWM requested by the library and the speed seen by the encoder.
+ *
+ *  Build and run from this directory with:
+ *  g++ -std=gnu++11 -O2 -Wall -DUSE_ENCODER_MOTOR_CONTROL -I. -I../../src ModelTrials.cpp -o ModelTrials && ./ModelTrials [number of trials]
+ *  Output is one line of key=value pairs per model parameter, to be easily processed by scripts.
+ *
+ *  Copyright (C) 2022  Armin Joachimsmeyer
+ *  armin.joachimsmeyer@gmail.com
+ *
+ *  This file is part of PWMMotorControl https://github.com/ArminJo/PWMMotorControl.
+ *
+ *  PWMMotorControl is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/gpl.html>.
+ *
+ */
+
+#include <Arduino.h>
+
+#if !defined(USE_ENCODER_MOTOR_CONTROL)
+#error ModelTrials requires -DUSE_ENCODER_MOTOR_CONTROL
+#endif
+
+#include "HostArduino.hpp"
+
+#define VIN_2_LIPO
+#define USE_MOTOR_MODEL_IDENTIFICATION
+#include "CarPWMMotorControl.hpp"
+#include "CarPlant.hpp"
+
+CarPlant sCarPlant;
+
+struct ModelErrorStatistics {
+    const char *Name;
+    unsigned long NumberOfModels;
+    double ErrorSum;
+    double MaxAbsError;
+
+    void add(double aError) {
+        NumberOfModels++;
+        ErrorSum += aError;
+        if (fabs(aError) > MaxAbsError) {
+            MaxAbsError = fabs(aError);
+        }
+    }
+
+    void print() {
+        printf("parameter=%s models=%lu error_mean=%.2f error_max_abs=%.2f\n", Name, NumberOfModels, ErrorSum / NumberOfModels,
+                MaxAbsError);
+    }
+};
+
+ModelErrorStatistics sStartSpeedPWMStatistics = { "start_pwm" };
+ModelErrorStatistics sStopSpeedPWMStatistics = { "stop_pwm" };
+ModelErrorStatistics sGainStatistics = { "gain_percent" };
+ModelErrorStatistics sTimeConstantStatistics = { "time_constant_percent" };
+unsigned long sNumberOfNotIdentifiedModels;
+
+float vary(float aValue, uint8_t aPercent) {
+    return aValue * (1.0 + ((long) random(-(long) aPercent * 100, (long) aPercent * 100 + 1)) / 10000.0);
+}
+
+/*
+ * The PWM value written by PWMDcMotor::setSpeedPWM() for a requested PWM
+ */
+uint8_t getOutputSpeedPWM(uint8_t aSpeedPWM) {
+    uint16_t tOutputSpeedPWM = ((uint16_t) aSpeedPWM * PWMDcMotor::VINCompensationFactorTimes128) >> 7;
+    return (tOutputSpeedPWM > MAX_SPEED_PWM) ? MAX_SPEED_PWM : tOutputSpeedPWM;
+}
+
+void compareModel(const char *aMotorName, uint8_t aDirection, DcMotorPlant *aPlant, MotorModelStruct *aModel) {
+    DcMotorPlantParameters *tParameters = &aPlant->Parameters;
+    float tOutputMillivoltPerPWM = (float) (tParameters->SupplyMillivolt - tParameters->BridgeLossMillivolt) / MAX_SPEED_PWM;
+    float tKe = (float) (DEFAULT_DRIVE_MILLIVOLT - tParameters->FrictionMillivolt) / DEFAULT_MILLIMETER_PER_SECOND;
+    float tOutputPerRequestedPWM = PWMDcMotor::VINCompensationFactorTimes128 / 128.0;
+
+    uint8_t tStartSpeedPWM = 1;
+    while (tStartSpeedPWM < MAX_SPEED_PWM && getOutputSpeedPWM(tStartSpeedPWM) * tOutputMillivoltPerPWM < tParameters->StartMillivolt) {
+        tStartSpeedPWM++;
+    }
+    float tStopSpeedPWM = tParameters->FrictionMillivolt / (tOutputMillivoltPerPWM * tOutputPerRequestedPWM);
+    // Speed seen by the encoder differs from the speed of the tire by the circumference
+    float tGain = tOutputMillivoltPerPWM * tOutputPerRequestedPWM / tKe
+            * (FACTOR_COUNT_TO_MILLIMETER_INTEGER_DEFAULT * tParameters->EncoderSlots / tParameters->CircumferenceMillimeter);
+
+    if (aModel->StartSpeedPWM == 0) {
+        sNumberOfNotIdentifiedModels++;
+        printf("motor=%s direction=%c not_identified\n", aMotorName, sMotorModeCharArray[aDirection]);
+        return;
+    }
+    float tIdentifiedGain = aModel->GainTimes256 / 256.0;
+    sStartSpeedPWMStatistics.add((int) aModel->StartSpeedPWM - tStartSpeedPWM);
+    sStopSpeedPWMStatistics.add(aModel->StopSpeedPWM - tStopSpeedPWM);
+    sGainStatistics.add((tIdentifiedGain - tGain) * 100 / tGain);
+    sTimeConstantStatistics.add(
+            ((float) aModel->TimeConstantMillis - tParameters->MechanicalTimeConstantMillis) * 100
+                    / tParameters->MechanicalTimeConstantMillis);
+    printf("motor=%s direction=%c start_pwm=%u/%u stop_pwm=%u/%.1f gain=%.2f/%.2f time_constant_ms=%u/%u\n", aMotorName,
+            sMotorModeCharArray[aDirection], aModel->StartSpeedPWM, tStartSpeedPWM, aModel->StopSpeedPWM, tStopSpeedPWM,
+            tIdentifiedGain, tGain, aModel->TimeConstantMillis, tParameters->MechanicalTimeConstantMillis);
+}
+
+void runIdentificationTrial() {
+    DcMotorPlant *tPlants[2] = { &sCarPlant.RightMotor, &sCarPlant.LeftMotor };
+    EncoderMotor *tMotors[2] = { &RobotCarPWMMotorControl.rightCarMotor, &RobotCarPWMMotorControl.leftCarMotor };
+    const char *tMotorNames[2] = { "right", "left" };
+    uint16_t tSupplyMillivolt = vary(FULL_BRIDGE_INPUT_MILLIVOLT, 10);
+    for (uint_fast8_t i = 0; i < 2; ++i) {
+        DcMotorPlantParameters *tParameters = &tPlants[i]->Parameters;
+        tPlants[i]->setDefaultParameters();
+        tParameters->SupplyMillivolt = tSupplyMillivolt;
+        tParameters->StartMillivolt = vary(tParameters->StartMillivolt, 20);
+        tParameters->FrictionMillivolt = vary(tParameters->StartMillivolt * 0.6, 20);
+        tParameters->MechanicalTimeConstantMillis = random(50, 121);
+        tParameters->CircumferenceMillimeter = vary(DEFAULT_CIRCUMFERENCE_MILLIMETER, 3);
+    }
+    PWMDcMotor::VINMillivolt = 0;
+    PWMDcMotor::setVINMillivolt(tSupplyMillivolt);
+    sCarPlant.reset();
+
+    RobotCarPWMMotorControl.identifyMotorModels();
+
+    for (uint_fast8_t i = 0; i < 2; ++i) {
+        for (uint_fast8_t tDirection = DIRECTION_FORWARD; tDirection <= DIRECTION_BACKWARD; ++tDirection) {
+            compareModel(tMotorNames[i], tDirection, tPlants[i], &tMotors[i]->MotorModel[tDirection]);
+        }
+    }
+}
+
+int main(int argc, char *argv[]) {
+    unsigned long tNumberOfTrials = 20;
+    if (argc > 1) {
+        tNumberOfTrials = atol(argv[1]);
+    }
+    Serial.OutputEnabled = false;
+    VirtualClock::reset();
+    sCarPlant.init();
+
+    RobotCarPWMMotorControl.init(RIGHT_MOTOR_FORWARD_PIN, RIGHT_MOTOR_BACKWARD_PIN, RIGHT_MOTOR_PWM_PIN, LEFT_MOTOR_FORWARD_PIN,
+    LEFT_MOTOR_BACKWARD_PIN, LEFT_MOTOR_PWM_PIN);
+
+    for (unsigned long i = 0; i < tNumberOfTrials; ++i) {
+        runIdentificationTrial();
+    }
+
+    printf("trials=%lu virtual_s=%.1f not_identified=%lu\n", tNumberOfTrials, VirtualClock::Micros / 1e6,
+            sNumberOfNotIdentifiedModels);
+    sStartSpeedPWMStatistics.print();
+    sStopSpeedPWMStatistics.print();
+    sGainStatistics.print();
+    sTimeConstantStatistics.print();
+    return 0;
+}
@@ -0,0 +1,626 @@
+/*
+ *  PlantTrials.cpp
+ *
+ *  Runs a number of random startGoDistanceMillimeter() and rotate() trials against the simulated car of CarPlant.h
+ *  and prints the statistics of distance error, stop overrun and settling time.
+ *  Each trial uses slightly varied plant parameters (battery voltage, friction and wheel circumference).
+ *  The speed trials drive 3 seconds with DEFAULT_DRIVE_SPEED_PWM at a battery voltage between empty and full and different
+ *  friction of both motors, and print the error to the nominal speed, the time until the speed stays within 5 percent
+ *  and the heading drift per meter. With USE_SPEED_PWM_TABLE, each speed trial starts with calibrateSpeedPWMTables().
+ *  The heading after the distance trials and the movement of the car center by the turns in place are printed as heading and center trial.
+ *  Without encoders, the discharge trial prints the speed change, if the battery voltage drops by 1 volt while driving with constant PWM.
+ *  With the motion profile, the velocity_yaw trial prints the yaw rate error of setVelocityAndYawRate() commands from standstill and
+ *  while driving, and the convergence trial the wheel distance until velocity and yaw rate are within tolerance.
+ *  With encoders, the count trials print the getDistanceCountError() of each wheel and the heading after goDistanceCount().
+ *  With encoders, the distance_ringing trial repeats the distance trial with a sensor, which gives an additional ringing edge
+ *  for PLANT_ENCODER_RINGING_PERCENT of the slots. Compare it with a build with -DDO_NOT_USE_MICROS_FOR_ENCODER_PERIOD.
+ *  The count_reverse trial requests the count move while the car is still moving backward, to the same or the opposite direction.
+ *
+ *  Build and run from this directory with:
+ *  g++ -std=gnu++11 -O2 -Wall -I. -I../../src PlantTrials.cpp -o PlantTrials && ./PlantTrials [number of trials]
+ *  Add -DUSE_ENCODER_MOTOR_CONTROL to run the trials with the encoder motor control.
+ *  Add e.g. -DTRIAL_LOOP_DELAY_MILLIS=100 to simulate a sketch, which blocks its loop while the car is moving,
+ *  and -DUSE_MOTOR_CONTROL_TIMER_INTERRUPT to run the control step by the (simulated) timer interrupt.
+ *  Add -DUSE_MOTION_COMMAND_QUEUE to compare a sequence of 3 distance drives by blocking calls with the same sequence by the queue.
+ *  Output is one line of key=value pairs per trial type, to be easily processed by scripts.
+ *
+ *  Copyright (C) 2022  Armin Joachimsmeyer
+ *  armin.joachimsmeyer@gmail.com
+ *
+ *  This file is part of PWMMotorControl https://github.com/ArminJo/PWMMotorControl.
+ *
+ *  PWMMotorControl is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/gpl.html>.
+ *
+ */
+
+#include <Arduino.h>
+#include <time.h>
+
+#include "HostArduino.hpp"
+
+#define VIN_2_LIPO
+#include "CarPWMMotorControl.hpp"
+#include "CarPlant.hpp"
+
+#if !defined(PLANT_ENCODER_RINGING_PERCENT)
+#define PLANT_ENCODER_RINGING_PERCENT   40 // For the distance_ringing trial
+#endif
+
+CarPlant sCarPlant;
+
+struct TrialStatistics {
+    const char *Name;
+    unsigned long NumberOfTrials;
+    double ErrorSum;
+    double ErrorSquareSum;
+    double MaxAbsError;
+    double OverrunSum;
+    double MaxOverrun;
+    double SettlingMillisSum;
+    double MaxSettlingMillis;
+
+    void add(double aError, double aOverrun, double aSettlingMillis) {
+        NumberOfTrials++;
+        ErrorSum += aError;
+        ErrorSquareSum += aError * aError;
+        if (fabs(aError) > MaxAbsError) {
+            MaxAbsError = fabs(aError);
+        }
+        OverrunSum += aOverrun;
+        if (aOverrun > MaxOverrun) {
+            MaxOverrun = aOverrun;
+        }
+        SettlingMillisSum += aSettlingMillis;
+        if (aSettlingMillis > MaxSettlingMillis) {
+            MaxSettlingMillis = aSettlingMillis;
+        }
+    }
+
+    void print(const char *aErrorUnit) {
+        if (NumberOfTrials == 0) {
+            return;
+        }
+        double tMean = ErrorSum / NumberOfTrials;
+        double tVariance = (ErrorSquareSum / NumberOfTrials) - (tMean * tMean);
+        printf("trial=%s count=%lu error_mean_%s=%.2f error_stddev_%s=%.2f error_max_abs_%s=%.2f"
+                " overrun_mean_mm=%.2f overrun_max_mm=%.2f settling_mean_ms=%.1f settling_max_ms=%.1f\n", Name, NumberOfTrials,
+                aErrorUnit, tMean, aErrorUnit, sqrt(tVariance > 0 ? tVariance : 0), aErrorUnit, MaxAbsError,
+                OverrunSum / NumberOfTrials, MaxOverrun, SettlingMillisSum / NumberOfTrials, MaxSettlingMillis);
+    }
+};
+
+TrialStatistics sDistanceStatistics = { "distance" };
+TrialStatistics sRotateStatistics = { "rotate" };
+TrialStatistics sSpeedStatistics = { "speed" };
+TrialStatistics sStraightStatistics = { "straight" };
+TrialStatistics sHeadingStatistics = { "heading" };
+TrialStatistics sCenterStatistics = { "center" };
+#if !defined(USE_ENCODER_MOTOR_CONTROL)
+TrialStatistics sDischargeStatistics = { "discharge" };
+#endif
+#if defined(USE_ENCODER_MOTOR_CONTROL)
+TrialStatistics sDistanceRingingStatistics = { "distance_ringing" };
+TrialStatistics sHeadingRingingStatistics = { "heading_ringing" };
+TrialStatistics sCountRightStatistics = { "count_right" };
+TrialStatistics sCountLeftStatistics = { "count_left" };
+TrialStatistics sCountDifferenceStatistics = { "count_difference" };
+TrialStatistics sCountHeadingStatistics = { "count_heading" };
+TrialStatistics sCountReverseStatistics = { "count_reverse" };
+#endif
+#if defined(USE_MOTION_PROFILE)
+TrialStatistics sVelocityYawStatistics = { "velocity_yaw" };
+TrialStatistics sConvergenceStatistics = { "convergence" };
+#endif
+#if defined(USE_MOTION_COMMAND_QUEUE)
+TrialStatistics sSequenceBlockingStatistics = { "sequence_blocking" };
+TrialStatistics sSequenceQueueStatistics = { "sequence_queue" };
+#endif
+
+#if defined(TRIAL_LOOP_DELAY_MILLIS)
+/*
+ * Like DistanceServoWriteAndDelay() or BlueDisplay callbacks in the loop of the examples
+ */
+void blockingLoopCallback() {
+    delay(TRIAL_LOOP_DELAY_MILLIS);
+}
+#define TRIAL_LOOP_CALLBACK blockingLoopCallback
+#else
+#define TRIAL_LOOP_CALLBACK NULL
+#endif
+
+/*
+ * Vary a value by +/- aPercent
+ */
+float vary(float aValue, uint8_t aPercent) {
+    return aValue * (1.0 + ((long) random(-(long) aPercent * 100, (long) aPercent * 100 + 1)) / 10000.0);
+}
+
+/*
+ * The battery of the next trial is measured as in checkVinPeriodicallyAndPrintIfChanged() of the examples, but without the filter delay
+ */
+void setVINMillivoltUnfiltered(uint16_t aVINMillivolt) {
+    PWMDcMotor::VINMillivolt = 0;
+    PWMDcMotor::setVINMillivolt(aVINMillivolt);
+}
+
+void setRandomPlantParameters() {
+    uint16_t tSupplyMillivolt = vary(FULL_BRIDGE_INPUT_MILLIVOLT, 5);
+    for (uint_fast8_t i = 0; i < PLANT_NUMBER_OF_MOTORS; ++i) {
+        sCarPlant.Motors[i]->setDefaultParameters();
+        sCarPlant.Motors[i]->Parameters.SupplyMillivolt = tSupplyMillivolt;
+        sCarPlant.Motors[i]->Parameters.FrictionMillivolt = vary(sCarPlant.Motors[i]->Parameters.FrictionMillivolt, 10);
+        sCarPlant.Motors[i]->Parameters.CircumferenceMillimeter = vary(DEFAULT_CIRCUMFERENCE_MILLIMETER, 1);
+    }
+    setVINMillivoltUnfiltered(tSupplyMillivolt);
+}
+
+/*
+ * Let the car come to a complete standstill and compute overrun and settling time from the plant measurement
+ */
+void waitForPlantStandstill(double *aOverrunMillimeter, double *aSettlingMillis) {
+    RobotCarPWMMotorControl.waitUntilStopped(TRIAL_LOOP_CALLBACK);
+    while (!sCarPlant.isStopped()) {
+        delay(1);
+    }
+    delay(1); // let the plant register the drive end of motors, which stopped in the same step
+
+    DcMotorPlant *tMotors[2] = { &sCarPlant.RightMotor, &sCarPlant.LeftMotor };
+    double tMaxOverrun = 0;
+    double tMaxSettlingMillis = 0;
+    for (uint_fast8_t i = 0; i < 2; ++i) {
+        DcMotorPlant *tMotor = tMotors[i];
+        if (tMotor->DriveEndMicros == 0) {
+            continue; // motor was not driven
+        }
+        double tOverrun = fabs(tMotor->DistanceMillimeter - tMotor->DistanceAtDriveEndMillimeter);
+        if (tOverrun > tMaxOverrun) {
+            tMaxOverrun = tOverrun;
+        }
+        if (tMotor->StandstillMicros > tMotor->DriveEndMicros) {
+            double tSettlingMillis = (tMotor->StandstillMicros - tMotor->DriveEndMicros) / 1000.0;
+            if (tSettlingMillis > tMaxSettlingMillis) {
+                tMaxSettlingMillis = tSettlingMillis;
+            }
+        }
+    }
+    *aOverrunMillimeter = tMaxOverrun;
+    *aSettlingMillis = tMaxSettlingMillis;
+}
+
+void runDistanceTrial(TrialStatistics *aDistanceStatistics, TrialStatistics *aHeadingStatistics) {
+    int tRequestedMillimeter = random(100, 1001);
+    if (random(2)) {
+        tRequestedMillimeter = -tRequestedMillimeter;
+    }
+    sCarPlant.reset();
+    RobotCarPWMMotorControl.startGoDistanceMillimeter(tRequestedMillimeter);
+
+    double tOverrun, tSettlingMillis;
+    waitForPlantStandstill(&tOverrun, &tSettlingMillis);
+    double tError = fabs(sCarPlant.getDistanceMillimeter()) - abs(tRequestedMillimeter);
+    aDistanceStatistics->add(tError, tOverrun, tSettlingMillis);
+    aHeadingStatistics->add(sCarPlant.getHeadingDegree(), 0, 0);
+}
+
+#if defined(USE_ENCODER_MOTOR_CONTROL)
+/*
+ * Distance trial with ringing encoder sensors, the ringing edges must be suppressed by the encoder interrupt handler
+ */
+void runDistanceRingingTrial() {
+    for (uint_fast8_t i = 0; i < PLANT_NUMBER_OF_MOTORS; ++i) {
+        sCarPlant.Motors[i]->Parameters.EncoderRingingPercent = PLANT_ENCODER_RINGING_PERCENT;
+    }
+    runDistanceTrial(&sDistanceRingingStatistics, &sHeadingRingingStatistics);
+    for (uint_fast8_t i = 0; i < PLANT_NUMBER_OF_MOTORS; ++i) {
+        sCarPlant.Motors[i]->Parameters.EncoderRingingPercent = 0;
+    }
+}
+#endif
+
+void runRotateTrial() {
+    int tRequestedDegree = random(30, 181);
+    if (random(2)) {
+        tRequestedDegree = -tRequestedDegree;
+    }
+    turn_direction_t tTurnDirection = (turn_direction_t) random(3);
+    sCarPlant.reset();
+    RobotCarPWMMotorControl.startRotate(tRequestedDegree, tTurnDirection);
+
+    double tOverrun, tSettlingMillis;
+    waitForPlantStandstill(&tOverrun, &tSettlingMillis);
+    double tError = (sCarPlant.getHeadingDegree() - tRequestedDegree);
+    if (tRequestedDegree < 0) {
+        tError = -tError; // positive error is always overturn
+    }
+    sRotateStatistics.add(tError, tOverrun, tSettlingMillis);
+    if (tTurnDirection == TURN_IN_PLACE) {
+        sCenterStatistics.add(hypot(sCarPlant.XMillimeter, sCarPlant.YMillimeter), 0, 0);
+    }
+}
+
+/*
+ * Drive 3 seconds and compare the speed of the last 1.5 seconds with the nominal speed of the PWM value
+ */
+#define SPEED_TRIAL_MILLIS          3000
+#define SPEED_TRIAL_MEASURE_MILLIS  1500
+void runSpeedTrial() {
+    uint16_t tSupplyMillivolt = random(FULL_BRIDGE_INPUT_MILLIVOLT - 800, FULL_BRIDGE_INPUT_MILLIVOLT + 1000); // 2 LiPo from empty to full
+    for (uint_fast8_t i = 0; i < PLANT_NUMBER_OF_MOTORS; ++i) {
+        sCarPlant.Motors[i]->setDefaultParameters();
+        sCarPlant.Motors[i]->Parameters.SupplyMillivolt = tSupplyMillivolt;
+        sCarPlant.Motors[i]->Parameters.FrictionMillivolt = vary(sCarPlant.Motors[i]->Parameters.FrictionMillivolt, 20);
+    }
+    setVINMillivoltUnfiltered(tSupplyMillivolt);
+    sCarPlant.reset();
+#if defined(USE_SPEED_PWM_TABLE)
+    // Calibrate for the battery voltage and friction of this trial
+    RobotCarPWMMotorControl.calibrateSpeedPWMTables();
+    sCarPlant.reset();
+#endif
+    float tNominalSpeed = (DEFAULT_MILLIMETER_PER_SECOND * (float) DEFAULT_DRIVE_SPEED_PWM) / DEFAULT_DRIVE_SPEED_PWM;
+    RobotCarPWMMotorControl.setSpeedPWMWithRamp(DEFAULT_DRIVE_SPEED_PWM, DIRECTION_FORWARD);
+
+    uint32_t tStartMillis = millis();
+    uint32_t tLastOutOfBandMillis = 0;
+    double tSpeedSum = 0;
+    unsigned long tSpeedSamples = 0;
+    float tHeadingAtMeasureStart = 0;
+    double tDistanceAtMeasureStart = 0;
+    while (millis() - tStartMillis < SPEED_TRIAL_MILLIS) {
+        RobotCarPWMMotorControl.updateMotors(TRIAL_LOOP_CALLBACK);
+        delay(1);
+        uint32_t tMillis = millis() - tStartMillis;
+        float tSpeed = sCarPlant.getSpeedMillimeterPerSecond();
+        if (fabs(tSpeed - tNominalSpeed) > tNominalSpeed / 20) {
+            tLastOutOfBandMillis = tMillis;
+        }
+        if (tMillis == SPEED_TRIAL_MILLIS - SPEED_TRIAL_MEASURE_MILLIS) {
+            tHeadingAtMeasureStart = sCarPlant.getHeadingDegree();
+            tDistanceAtMeasureStart = sCarPlant.getDistanceMillimeter();
+        } else if (tMillis > SPEED_TRIAL_MILLIS - SPEED_TRIAL_MEASURE_MILLIS) {
+            tSpeedSum += tSpeed;
+            tSpeedSamples++;
+        }
+    }
+    double tMeasureDistanceMeter = (sCarPlant.getDistanceMillimeter() - tDistanceAtMeasureStart) / 1000.0;
+    double tHeadingDriftPerMeter = 0;
+    if (tMeasureDistanceMeter > 0.01) {
+        tHeadingDriftPerMeter = fabs(sCarPlant.getHeadingDegree() - tHeadingAtMeasureStart) / tMeasureDistanceMeter;
+    }
+    RobotCarPWMMotorControl.stop(MOTOR_BRAKE);
+    while (!sCarPlant.isStopped()) {
+        delay(1);
+    }
+    sSpeedStatistics.add((tSpeedSum / tSpeedSamples) - tNominalSpeed, 0, tLastOutOfBandMillis);
+    sStraightStatistics.add(tHeadingDriftPerMeter, 0, 0);
+}
+
+#if defined(USE_ENCODER_MOTOR_CONTROL)
+/*
+ * Small moves of 3 to 39 counts, like docking or aligning to a station.
+ * Errors are the counts each wheel drove too far, the count difference right - left and the heading after standstill.
+ */
+void runDistanceCountTrial() {
+    int tRequestedCount = random(3, 40);
+    if (random(2)) {
+        tRequestedCount = -tRequestedCount;
+    }
+    sCarPlant.reset();
+    RobotCarPWMMotorControl.goDistanceCount(tRequestedCount, TRIAL_LOOP_CALLBACK);
+
+    double tOverrun, tSettlingMillis;
+    waitForPlantStandstill(&tOverrun, &tSettlingMillis);
+    int tRightError = RobotCarPWMMotorControl.getDistanceCountError(&RobotCarPWMMotorControl.rightCarMotor);
+    int tLeftError = RobotCarPWMMotorControl.getDistanceCountError(&RobotCarPWMMotorControl.leftCarMotor);
+    sCountRightStatistics.add(tRightError, tOverrun, tSettlingMillis);
+    sCountLeftStatistics.add(tLeftError, tOverrun, tSettlingMillis);
+    sCountDifferenceStatistics.add(tRightError - tLeftError, 0, 0);
+    sCountHeadingStatistics.add(sCarPlant.getHeadingDegree(), 0, 0);
+}
+
+/*
+ * A count move requested while the car is still moving backward. Forward moves stop the car first and start with count 0,
+ * backward moves continue and add the current counts to the target.
+ * Errors are the getDistanceCountError() of both wheels.
+ */
+void runDistanceCountReverseTrial() {
+    int tRequestedCount = random(3, 40);
+    if (random(2)) {
+        tRequestedCount = -tRequestedCount;
+    }
+    sCarPlant.reset();
+    RobotCarPWMMotorControl.startGoDistanceCount(-40);
+    unsigned long tStartMillis = millis();
+    while (millis() - tStartMillis < 300) {
+        RobotCarPWMMotorControl.updateMotors();
+        delay(1);
+    }
+    RobotCarPWMMotorControl.goDistanceCount(tRequestedCount, TRIAL_LOOP_CALLBACK);
+
+    double tOverrun, tSettlingMillis;
+    waitForPlantStandstill(&tOverrun, &tSettlingMillis); // overrun is not evaluated, since the plant measures it from the first move
+    sCountReverseStatistics.add(RobotCarPWMMotorControl.getDistanceCountError(&RobotCarPWMMotorControl.rightCarMotor), 0, 0);
+    sCountReverseStatistics.add(RobotCarPWMMotorControl.getDistanceCountError(&RobotCarPWMMotorControl.leftCarMotor), 0, 0);
+}
+#endif
+
+#if !defined(USE_ENCODER_MOTOR_CONTROL)
+/*
+ * Drive with constant PWM, let the battery voltage drop by 1 volt and give the new voltage to setVINMillivolt()
+ * every DISCHARGE_TRIAL_VIN_PERIOD_MILLIS, as checkVinPeriodicallyAndPrintIfChanged() of the examples does.
+ * Error is the speed after the drop minus the speed before. The PWM is not changed by the sketch,
+ * so the new voltage must be applied by setVINMillivolt() itself.
+ */
+#define DISCHARGE_TRIAL_MILLIS              2000
+#define DISCHARGE_TRIAL_VIN_PERIOD_MILLIS   200
+void runDischargeTrial() {
+    uint16_t tSupplyMillivolt = FULL_BRIDGE_INPUT_MILLIVOLT + 1000;
+    for (uint_fast8_t i = 0; i < PLANT_NUMBER_OF_MOTORS; ++i) {
+        sCarPlant.Motors[i]->Parameters.SupplyMillivolt = tSupplyMillivolt;
+    }
+    setVINMillivoltUnfiltered(tSupplyMillivolt);
+    sCarPlant.reset();
+    RobotCarPWMMotorControl.setSpeedPWMWithRamp(DEFAULT_DRIVE_SPEED_PWM, DIRECTION_FORWARD);
+    float tSpeedBeforeDrop = 0;
+    for (uint_fast8_t tPhase = 0; tPhase < 2; ++tPhase) {
+        if (tPhase == 1) {
+            tSupplyMillivolt -= 1000;
+            for (uint_fast8_t i = 0; i < PLANT_NUMBER_OF_MOTORS; ++i) {
+                sCarPlant.Motors[i]->Parameters.SupplyMillivolt = tSupplyMillivolt;
+            }
+        }
+        uint32_t tStartMillis = millis();
+        while (millis() - tStartMillis < DISCHARGE_TRIAL_MILLIS) {
+            RobotCarPWMMotorControl.updateMotors(TRIAL_LOOP_CALLBACK);
+            delay(1);
+            if ((millis() - tStartMillis) % DISCHARGE_TRIAL_VIN_PERIOD_MILLIS == 0) {
+                PWMDcMotor::setVINMillivolt(tSupplyMillivolt);
+            }
+        }
+        float tSpeed = sCarPlant.getSpeedMillimeterPerSecond();
+        if (tPhase == 0) {
+            tSpeedBeforeDrop = tSpeed;
+        } else {
+            sDischargeStatistics.add(tSpeed - tSpeedBeforeDrop, 0, 0);
+        }
+    }
+    RobotCarPWMMotorControl.stop(MOTOR_BRAKE);
+    while (!sCarPlant.isStopped()) {
+        delay(1);
+    }
+}
+#endif
+
+#if defined(USE_MOTION_PROFILE)
+/*
+ * Random command for straight runs, turns in place or both.
+ * The wheel speeds of turns in place are between 100 and 200 mm/s, the inner wheel of the others runs at least 80 mm/s.
+ */
+void getRandomVelocityAndYawRate(int *aVelocityMillimeterPerSecond, int *aYawRateDegreePerSecond) {
+    long tKind = random(3);
+    *aVelocityMillimeterPerSecond = 0;
+    *aYawRateDegreePerSecond = 0;
+    if (tKind == 0) {
+        *aVelocityMillimeterPerSecond = random(150, 301);
+    } else if (tKind == 1) {
+        *aYawRateDegreePerSecond = random(90, 181);
+    } else {
+        *aVelocityMillimeterPerSecond = random(150, 301);
+        *aYawRateDegreePerSecond = random(20, 61);
+    }
+    if (random(2)) {
+        *aYawRateDegreePerSecond = -*aYawRateDegreePerSecond;
+    }
+}
+
+/*
+ * Start with a random command from standstill and change to another random command while driving.
+ * For each command, the velocity of the car center and the yaw rate must stay within VELOCITY_YAW_TRIAL_TOLERANCE_PERCENT plus
+ * 10 mm/s or 5 deg/s, which is a wheel speed difference of 11 mm/s. Both are averaged over VELOCITY_YAW_TRIAL_WINDOW_MILLIS,
+ * which are 2 encoder slots at 110 mm/s, to suppress the ripple caused by the PWM changes at each encoder slot.
+ * Convergence error is the mean distance driven by both wheels until then, which should be less than one
+ * wheel revolution of DEFAULT_CIRCUMFERENCE_MILLIMETER. Velocity_yaw error is the mean yaw rate error of the last second.
+ */
+#define VELOCITY_YAW_TRIAL_MILLIS               2500
+#define VELOCITY_YAW_TRIAL_WINDOW_MILLIS        200
+#define VELOCITY_YAW_TRIAL_MEASURE_MILLIS       1000
+#define VELOCITY_YAW_TRIAL_TOLERANCE_PERCENT    5
+void runVelocityAndYawRateTrial() {
+    sCarPlant.reset();
+    for (uint_fast8_t tPhase = 0; tPhase < 2; ++tPhase) {
+        int tVelocity, tYawRate;
+        getRandomVelocityAndYawRate(&tVelocity, &tYawRate);
+        RobotCarPWMMotorControl.setVelocityAndYawRate(tVelocity, tYawRate);
+
+        double tLastRightDistance = sCarPlant.RightMotor.FloorDistanceMillimeter;
+        double tLastLeftDistance = sCarPlant.LeftMotor.FloorDistanceMillimeter;
+        double tWheelDistance = 0; // Mean of the distances driven by both wheels in any direction
+        double tWheelDistanceAtLastOutOfBand = 0;
+        uint32_t tStartMillis = millis();
+        uint32_t tLastOutOfBandMillis = 0;
+        double tYawRateErrorSum = 0;
+        unsigned long tYawRateSamples = 0;
+        /*
+         * The history contains the values of about VELOCITY_YAW_TRIAL_WINDOW_MILLIS before
+         */
+        uint32_t tMillisHistory[VELOCITY_YAW_TRIAL_WINDOW_MILLIS];
+        float tDistanceHistory[VELOCITY_YAW_TRIAL_WINDOW_MILLIS];
+        double tHeadingHistory[VELOCITY_YAW_TRIAL_WINDOW_MILLIS];
+        for (uint_fast8_t i = 0; i < VELOCITY_YAW_TRIAL_WINDOW_MILLIS; ++i) {
+            tMillisHistory[i] = 0;
+            tDistanceHistory[i] = sCarPlant.getDistanceMillimeter();
+            tHeadingHistory[i] = sCarPlant.HeadingRadian;
+        }
+        while (millis() - tStartMillis < VELOCITY_YAW_TRIAL_MILLIS) {
+            RobotCarPWMMotorControl.updateMotors(TRIAL_LOOP_CALLBACK);
+            delay(1);
+            uint32_t tMillis = millis() - tStartMillis;
+            uint_fast8_t tIndex = tMillis % VELOCITY_YAW_TRIAL_WINDOW_MILLIS;
+            float tWindowSeconds = (tMillis - tMillisHistory[tIndex]) / 1000.0;
+            float tSpeedError = ((sCarPlant.getDistanceMillimeter() - tDistanceHistory[tIndex]) / tWindowSeconds) - tVelocity;
+            float tYawRateError = (((sCarPlant.HeadingRadian - tHeadingHistory[tIndex]) * RAD_TO_DEG) / tWindowSeconds) - tYawRate;
+            tWheelDistance += (fabs(sCarPlant.RightMotor.FloorDistanceMillimeter - tLastRightDistance)
+                    + fabs(sCarPlant.LeftMotor.FloorDistanceMillimeter - tLastLeftDistance)) / 2;
+            tLastRightDistance = sCarPlant.RightMotor.FloorDistanceMillimeter;
+            tLastLeftDistance = sCarPlant.LeftMotor.FloorDistanceMillimeter;
+            tMillisHistory[tIndex] = tMillis;
+            tDistanceHistory[tIndex] = sCarPlant.getDistanceMillimeter();
+            tHeadingHistory[tIndex] = sCarPlant.HeadingRadian;
+            if (fabs(tSpeedError) > 10 + (tVelocity * VELOCITY_YAW_TRIAL_TOLERANCE_PERCENT) / 100.0
+                    || fabs(tYawRateError) > 5 + (abs(tYawRate) * VELOCITY_YAW_TRIAL_TOLERANCE_PERCENT) / 100.0) {
+                tLastOutOfBandMillis = tMillis;
+                tWheelDistanceAtLastOutOfBand = tWheelDistance;
+            }
+            if (tMillis > VELOCITY_YAW_TRIAL_MILLIS - VELOCITY_YAW_TRIAL_MEASURE_MILLIS) {
+                tYawRateErrorSum += tYawRateError;
+                tYawRateSamples++;
+            }
+        }
+        sVelocityYawStatistics.add(tYawRateErrorSum / tYawRateSamples, 0, tLastOutOfBandMillis);
+        sConvergenceStatistics.add(tWheelDistanceAtLastOutOfBand, 0, tLastOutOfBandMillis);
+    }
+    RobotCarPWMMotorControl.stop(MOTOR_BRAKE);
+    while (!sCarPlant.isStopped()) {
+        delay(1);
+    }
+}
+#endif
+
+#if defined(USE_MOTION_COMMAND_QUEUE)
+/*
+ * Drive the same 3 forward distances once by blocking calls and once by the motion command queue.
+ * Error is the distance error of the sum, settling time is the time for the whole sequence. Overrun is not measured.
+ */
+#define SEQUENCE_TRIAL_NUMBER_OF_SEGMENTS   3
+void runSequenceTrial() {
+    int tRequestedMillimeter[SEQUENCE_TRIAL_NUMBER_OF_SEGMENTS];
+    int tSumMillimeter = 0;
+    for (uint_fast8_t i = 0; i < SEQUENCE_TRIAL_NUMBER_OF_SEGMENTS; ++i) {
+        tRequestedMillimeter[i] = random(100, 501);
+        tSumMillimeter += tRequestedMillimeter[i];
+    }
+    double tOverrun, tSettlingMillis;
+
+    sCarPlant.reset();
+    uint32_t tStartMillis = millis();
+    for (uint_fast8_t i = 0; i < SEQUENCE_TRIAL_NUMBER_OF_SEGMENTS; ++i) {
+        RobotCarPWMMotorControl.goDistanceMillimeter(tRequestedMillimeter[i], TRIAL_LOOP_CALLBACK);
+    }
+    waitForPlantStandstill(&tOverrun, &tSettlingMillis);
+    sSequenceBlockingStatistics.add(sCarPlant.getDistanceMillimeter() - tSumMillimeter, 0, millis() - tStartMillis);
+    delay(200);
+
+    sCarPlant.reset();
+    tStartMillis = millis();
+    for (uint_fast8_t i = 0; i < SEQUENCE_TRIAL_NUMBER_OF_SEGMENTS; ++i) {
+        RobotCarPWMMotorControl.queueGoDistanceMillimeter(tRequestedMillimeter[i]);
+    }
+    waitForPlantStandstill(&tOverrun, &tSettlingMillis);
+    sSequenceQueueStatistics.add(sCarPlant.getDistanceMillimeter() - tSumMillimeter, 0, millis() - tStartMillis);
+}
+#endif
+
+int main(int argc, char *argv[]) {
+    unsigned long tNumberOfTrials = 1000;
+    if (argc > 1) {
+        tNumberOfTrials = atol(argv[1]);
+    }
+    Serial.OutputEnabled = false;
+    VirtualClock::reset();
+    sCarPlant.init();
+
+    RobotCarPWMMotorControl.init(RIGHT_MOTOR_FORWARD_PIN, RIGHT_MOTOR_BACKWARD_PIN, RIGHT_MOTOR_PWM_PIN, LEFT_MOTOR_FORWARD_PIN,
+    LEFT_MOTOR_BACKWARD_PIN, LEFT_MOTOR_PWM_PIN);
+#if defined(PLANT_HAS_REAR_MOTORS)
+    initRearCarMotors();
+#endif
+#if defined(USE_MOTOR_CONTROL_TIMER_INTERRUPT)
+    RobotCarPWMMotorControl.startMotorControlTimerInterrupt();
+#endif
+
+    struct timespec tStart, tEnd;
+    clock_gettime(CLOCK_MONOTONIC, &tStart);
+
+    for (unsigned long i = 0; i < tNumberOfTrials; ++i) {
+        setRandomPlantParameters();
+        runDistanceTrial(&sDistanceStatistics, &sHeadingStatistics);
+        delay(200);
+        runRotateTrial();
+        delay(200);
+        runSpeedTrial();
+        delay(200);
+#if defined(USE_ENCODER_MOTOR_CONTROL)
+        runDistanceCountTrial();
+        delay(200);
+        runDistanceCountReverseTrial();
+        delay(200);
+        runDistanceRingingTrial();
+        delay(200);
+#else
+        runDischargeTrial();
+        delay(200);
+#endif
+#if defined(USE_MOTION_PROFILE)
+        runVelocityAndYawRateTrial();
+        delay(200);
+#endif
+#if defined(USE_MOTION_COMMAND_QUEUE)
+        runSequenceTrial();
+        delay(200);
+#endif
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &tEnd);
+    double tRealSeconds = (tEnd.tv_sec - tStart.tv_sec) + (tEnd.tv_nsec - tStart.tv_nsec) / 1e9;
+
+#if defined(USE_ENCODER_MOTOR_CONTROL)
+    printf("control=encoder");
+#else
+    printf("control=pwm");
+#endif
+#if defined(USE_MOTOR_CONTROL_TIMER_INTERRUPT)
+    printf(" timer_interrupt=%d", MOTOR_CONTROL_TIMER_INTERRUPT_MILLIS);
+#endif
+#if defined(TRIAL_LOOP_DELAY_MILLIS)
+    printf(" loop_delay_ms=%d", TRIAL_LOOP_DELAY_MILLIS);
+#endif
+    printf(" trials=%lu virtual_s=%.1f real_s=%.3f trials_per_real_minute=%.0f\n", 3 * tNumberOfTrials,
+            VirtualClock::Micros / 1e6, tRealSeconds, (3 * tNumberOfTrials * 60.0) / tRealSeconds);
+    sDistanceStatistics.print("mm");
+    sRotateStatistics.print("deg");
+    sSpeedStatistics.print("mm_s");
+    sStraightStatistics.print("deg_m");
+    sHeadingStatistics.print("deg");
+    sCenterStatistics.print("mm");
+#if defined(USE_ENCODER_MOTOR_CONTROL)
+    sDistanceRingingStatistics.print("mm");
+    sHeadingRingingStatistics.print("deg");
+    sCountRightStatistics.print("count");
+    sCountLeftStatistics.print("count");
+    sCountDifferenceStatistics.print("count");
+    sCountHeadingStatistics.print("deg");
+    sCountReverseStatistics.print("count");
+#else
+    sDischargeStatistics.print("mm_s");
+#endif
+#if defined(USE_MOTION_PROFILE)
+    sVelocityYawStatistics.print("deg_s");
+    sConvergenceStatistics.print("mm");
+#endif
+#if defined(USE_MOTION_COMMAND_QUEUE)
+    sSequenceBlockingStatistics.print("mm");
+    sSequenceQueueStatistics.print("mm");
+#endif
+    return 0;
+}
@@ -0,0 +1,211 @@
+/*
+ *  QuadratureEncoderTrials.cpp
+ *
+ *  Moves the wheels of CarPlant with a quadrature encoder and checks for each move
+ *  1. The change of getEncoderPosition() against the signed number of edges, the plant has written to the encoder pins.
+ *  2. The change of LastRideEncoderCount, which counts up for moves in the direction of the last ride
+ *     and counts down for moves against it, i.e. when the wheel is pushed back, but not below 0.
+ *  3. The encoder position at which wheelGoDistanceTicks() stops the motor, with encoder ringing enabled.
+ *  Wheels are pushed and rolled back by setting the plant speed of the released motor.
+ *
+ *  Build and run from this directory with:
+ *  g++ -std=gnu++11 -O2 -Wall -DUSE_ENCODER_MOTOR_CONTROL -DUSE_QUADRATURE_ENCODER -I. -I../../src QuadratureEncoderTrials.cpp -o QuadratureEncoderTrials && ./QuadratureEncoderTrials
+ *  Output is one line of key=value pairs per move and a summary line. Exit code is 1 if a check failed.
+ *
+ *  Copyright (C) 2022  Armin Joachimsmeyer
+ *  armin.joachimsmeyer@gmail.com
+ *
+ *  This file is part of PWMMotorControl https://github.com/ArminJo/PWMMotorControl.
+ *
+ *  PWMMotorControl is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/gpl.html>.
+ *
+ */
+
+#include <Arduino.h>
+
+#if !defined(USE_ENCODER_MOTOR_CONTROL) || !defined(USE_QUADRATURE_ENCODER)
+#error QuadratureEncoderTrials requires -DUSE_ENCODER_MOTOR_CONTROL -DUSE_QUADRATURE_ENCODER
+#endif
+
+#include "HostArduino.hpp"
+
+#define VIN_2_LIPO
+#include "CarPWMMotorControl.hpp"
+#include "CarPlant.hpp"
+
+#if !defined(QUADRATURE_NUMBER_OF_TRIALS)
+#define QUADRATURE_NUMBER_OF_TRIALS     10
+#endif
+/*
+ * The plant detects the drive end at its next step, which can be one edge after the stop of wheelGoDistanceTicks().
+ */
+#define TICKS_MAX_STOP_ERROR_COUNTS     1
+#define TICKS_RINGING_PERCENT           40
+#define TICKS_TIMEOUT_MILLIS            5000
+#define ROLL_BACK_MAX_NUMBER_OF_PUSHES  20
+
+CarPlant sCarPlant;
+
+unsigned long sNumberOfFailedChecks;
+unsigned long sNumberOfChecks;
+
+void check(const char *aName, bool aCondition, const char *aMove, int aValue) {
+    sNumberOfChecks++;
+    if (!aCondition) {
+        sNumberOfFailedChecks++;
+        printf("check=%s failed move=%s value=%d\n", aName, aMove, aValue);
+    }
+}
+
+/*
+ * Wait for the plant wheels to stop and for the last (ringing) edges to reach the encoder pins
+ */
+void waitForStandstill() {
+    while (!sCarPlant.isStopped() || sCarPlant.RightMotor.NumberOfPendingEdges > 0 || sCarPlant.LeftMotor.NumberOfPendingEdges > 0) {
+        delay(1);
+    }
+    delay(10);
+}
+
+unsigned int getLastRideEncoderCount(EncoderMotor *aMotor) {
+    EncoderSnapshotStruct tSnapshot;
+    aMotor->getEncoderSnapshot(&tSnapshot);
+    return tSnapshot.LastRideEncoderCount;
+}
+
+/*
+ * Compares the encoder values of both motors after a move with the edges written by the plant
+ * @param aExpectedLastRideDirection - direction of the last ride, which determines if LastRideEncoderCount counts up or down
+ */
+void checkMove(const char *aMove, long *aStartEncoderPositions, long *aStartPinsPositions, unsigned int *aStartLastRideEncoderCounts,
+        uint8_t aExpectedLastRideDirection) {
+    EncoderMotor *tMotors[2] = { &RobotCarPWMMotorControl.rightCarMotor, &RobotCarPWMMotorControl.leftCarMotor };
+    DcMotorPlant *tPlantMotors[2] = { &sCarPlant.RightMotor, &sCarPlant.LeftMotor };
+    for (uint_fast8_t i = 0; i < 2; ++i) {
+        long tEdges = tPlantMotors[i]->EncoderPinsPosition - aStartPinsPositions[i];
+        long tPositionDelta = tMotors[i]->getEncoderPosition() - aStartEncoderPositions[i];
+        long tExpectedLastRideEncoderCount = (long) aStartLastRideEncoderCounts[i]
+                + ((aExpectedLastRideDirection == DIRECTION_FORWARD) ? tEdges : -tEdges);
+        if (tExpectedLastRideEncoderCount < 0) {
+            tExpectedLastRideEncoderCount = 0;
+        }
+        unsigned int tLastRideEncoderCount = getLastRideEncoderCount(tMotors[i]);
+        printf("move=%s motor=%s edges=%ld position_delta=%ld last_ride_count=%u expected_last_ride_count=%ld\n", aMove,
+                (i == 0 ? "right" : "left"), tEdges, tPositionDelta, tLastRideEncoderCount, tExpectedLastRideEncoderCount);
+        check("moved", tEdges != 0, aMove, i);
+        check("position", tPositionDelta == tEdges, aMove, i);
+        check("last_ride_count", (long) tLastRideEncoderCount == tExpectedLastRideEncoderCount, aMove, i);
+    }
+}
+
+void storeStartValues(long *aStartEncoderPositions, long *aStartPinsPositions, unsigned int *aStartLastRideEncoderCounts) {
+    aStartEncoderPositions[0] = RobotCarPWMMotorControl.rightCarMotor.getEncoderPosition();
+    aStartEncoderPositions[1] = RobotCarPWMMotorControl.leftCarMotor.getEncoderPosition();
+    aStartPinsPositions[0] = sCarPlant.RightMotor.EncoderPinsPosition;
+    aStartPinsPositions[1] = sCarPlant.LeftMotor.EncoderPinsPosition;
+    aStartLastRideEncoderCounts[0] = getLastRideEncoderCount(&RobotCarPWMMotorControl.rightCarMotor);
+    aStartLastRideEncoderCounts[1] = getLastRideEncoderCount(&RobotCarPWMMotorControl.leftCarMotor);
+}
+
+/*
+ * Drives a distance and then pushes and rolls back both released wheels
+ */
+void runRideTrial(unsigned int aDistanceMillimeter, uint8_t aDirection, float aPushSpeedMillimeterPerSecond) {
+    long tStartEncoderPositions[2];
+    long tStartPinsPositions[2];
+    unsigned int tStartLastRideEncoderCounts[2];
+
+    const char *tRide = (aDirection == DIRECTION_FORWARD) ? "ride_forward" : "ride_backward";
+    storeStartValues(tStartEncoderPositions, tStartPinsPositions, tStartLastRideEncoderCounts);
+    tStartLastRideEncoderCounts[0] = 0; // A ride starts with a new LastRideEncoderCount
+    tStartLastRideEncoderCounts[1] = 0;
+    RobotCarPWMMotorControl.goDistanceMillimeter(aDistanceMillimeter, aDirection);
+    RobotCarPWMMotorControl.stop(MOTOR_RELEASE);
+    waitForStandstill();
+    checkMove(tRide, tStartEncoderPositions, tStartPinsPositions, tStartLastRideEncoderCounts, aDirection);
+
+    // Roll back against the direction of the ride, then push in the direction of the ride
+    float tRideSign = (aDirection == DIRECTION_FORWARD) ? 1.0 : -1.0;
+    storeStartValues(tStartEncoderPositions, tStartPinsPositions, tStartLastRideEncoderCounts);
+    sCarPlant.RightMotor.SpeedMillimeterPerSecond = -tRideSign * aPushSpeedMillimeterPerSecond;
+    sCarPlant.LeftMotor.SpeedMillimeterPerSecond = -tRideSign * aPushSpeedMillimeterPerSecond;
+    waitForStandstill();
+    checkMove("roll_back", tStartEncoderPositions, tStartPinsPositions, tStartLastRideEncoderCounts, aDirection);
+
+    storeStartValues(tStartEncoderPositions, tStartPinsPositions, tStartLastRideEncoderCounts);
+    sCarPlant.RightMotor.SpeedMillimeterPerSecond = tRideSign * aPushSpeedMillimeterPerSecond;
+    sCarPlant.LeftMotor.SpeedMillimeterPerSecond = tRideSign * aPushSpeedMillimeterPerSecond;
+    waitForStandstill();
+    checkMove("push", tStartEncoderPositions, tStartPinsPositions, tStartLastRideEncoderCounts, aDirection);
+
+    // Roll back more than the ride to check the clamping at 0
+    for (uint_fast8_t i = 0; i < ROLL_BACK_MAX_NUMBER_OF_PUSHES; ++i) {
+        storeStartValues(tStartEncoderPositions, tStartPinsPositions, tStartLastRideEncoderCounts);
+        if (tStartLastRideEncoderCounts[0] == 0 && tStartLastRideEncoderCounts[1] == 0) {
+            break;
+        }
+        sCarPlant.RightMotor.SpeedMillimeterPerSecond = -tRideSign * 4 * aPushSpeedMillimeterPerSecond;
+        sCarPlant.LeftMotor.SpeedMillimeterPerSecond = -tRideSign * 4 * aPushSpeedMillimeterPerSecond;
+        waitForStandstill();
+        checkMove("roll_back_far", tStartEncoderPositions, tStartPinsPositions, tStartLastRideEncoderCounts, aDirection);
+    }
+    check("clamped", tStartLastRideEncoderCounts[0] == 0 && tStartLastRideEncoderCounts[1] == 0, "roll_back_far", 0);
+}
+
+/*
+ * Moves the right wheel by wheelGoDistanceTicks() with encoder ringing.
+ * Each ringing gives 2 additional interrupts, which must not be counted as ticks.
+ */
+void runTicksTrial(int aTicks, uint8_t aDirection) {
+    EncoderMotor *tMotor = &RobotCarPWMMotorControl.rightCarMotor;
+    DcMotorPlant *tPlantMotor = &sCarPlant.RightMotor;
+    tPlantMotor->Parameters.EncoderRingingPercent = TICKS_RINGING_PERCENT;
+    long tStartPinsPosition = tPlantMotor->EncoderPinsPosition;
+    long tStartEncoderPosition = tMotor->getEncoderPosition();
+    unsigned long tStartEdgeCount = tPlantMotor->EncoderEdgeCount;
+
+    uint32_t tStartMillis = millis();
+    tMotor->wheelGoDistanceTicks(aTicks, DEFAULT_DRIVE_SPEED_PWM, aDirection);
+    while (tMotor->CurrentSpeedPWM != 0 && millis() - tStartMillis < TICKS_TIMEOUT_MILLIS) {
+        delayMicroseconds(100);
+    }
+    long tStopEdges = labs(tPlantMotor->EncoderPinsPosition - tStartPinsPosition);
+    tMotor->stop(MOTOR_RELEASE);
+    waitForStandstill();
+    long tPositionDelta = tMotor->getEncoderPosition() - tStartEncoderPosition;
+    long tEdges = tPlantMotor->EncoderPinsPosition - tStartPinsPosition;
+    printf("move=ticks direction=%s ticks=%d stop_edges=%ld interrupts=%lu edges=%ld position_delta=%ld\n",
+            (aDirection == DIRECTION_FORWARD ? "forward" : "backward"), aTicks, tStopEdges,
+            tPlantMotor->EncoderEdgeCount - tStartEdgeCount, tEdges, tPositionDelta);
+    check("ticks", labs(tStopEdges - aTicks) <= TICKS_MAX_STOP_ERROR_COUNTS, "ticks", aTicks);
+    check("position", tPositionDelta == tEdges, "ticks", aTicks);
+    tPlantMotor->Parameters.EncoderRingingPercent = 0;
+}
+
+int main() {
+    Serial.OutputEnabled = false;
+    VirtualClock::reset();
+    sCarPlant.init();
+
+    RobotCarPWMMotorControl.init(RIGHT_MOTOR_FORWARD_PIN, RIGHT_MOTOR_BACKWARD_PIN, RIGHT_MOTOR_PWM_PIN, LEFT_MOTOR_FORWARD_PIN,
+    LEFT_MOTOR_BACKWARD_PIN, LEFT_MOTOR_PWM_PIN);
+
+    randomSeed(1);
+    for (uint_fast8_t i = 0; i < QUADRATURE_NUMBER_OF_TRIALS; ++i) {
+        runRideTrial(100 + random(400), (i & 1) ? DIRECTION_BACKWARD : DIRECTION_FORWARD, 200 + random(300)); // Slower pushes may move less than one edge
+        runTicksTrial(8 + random(80), (i & 1) ? DIRECTION_FORWARD : DIRECTION_BACKWARD);
+    }
+    printf("checks=%lu failed_checks=%lu\n", sNumberOfChecks, sNumberOfFailedChecks);
+    return (sNumberOfFailedChecks == 0 ? 0 : 1);
+}
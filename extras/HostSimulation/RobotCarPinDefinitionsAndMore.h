@@ -0,0 +1,74 @@
+/*
+ *  RobotCarPinDefinitionsAndMore.h
+ *
+ *  Pin definitions for the host simulation. Same pin mapping as for the AVR (UNO) examples.
+ *
+ *  Copyright (C) 2022  Armin Joachimsmeyer
+ *  armin.joachimsmeyer@gmail.com
+ *
+ *  This file is part of PWMMotorControl https://github.com/ArminJo/PWMMotorControl.
+ *
+ *  PWMMotorControl is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/gpl.html>.
+ *
+ */
+
+#ifndef ROBOT_CAR_PIN_DEFINITIONS_AND_MORE_H
+#define ROBOT_CAR_PIN_DEFINITIONS_AND_MORE_H
+
+#define RIGHT_MOTOR_INTERRUPT       INT0 // Pin 2
+#define LEFT_MOTOR_INTERRUPT        INT1 // Pin 3
+
+// Channels of quadrature encoders for USE_QUADRATURE_ENCODER. Channel B is simulated as pin change interrupt.
+#define RIGHT_MOTOR_ENCODER_A_PIN   2
+#define RIGHT_MOTOR_ENCODER_B_PIN  11
+#define LEFT_MOTOR_ENCODER_A_PIN    3
+#define LEFT_MOTOR_ENCODER_B_PIN   13
+#define USE_OWN_PIN_CHANGE_INTERRUPT_FOR_ENCODER_B_PIN // The plant calls the interrupt handler of A for the edges of B too
+
+#define RIGHT_MOTOR_FORWARD_PIN     4 // IN4 <- Label on the L298N board
+#define RIGHT_MOTOR_BACKWARD_PIN    7 // IN3
+#define RIGHT_MOTOR_PWM_PIN         5 // ENB - Must be PWM capable
+
+#define LEFT_MOTOR_FORWARD_PIN      9 // IN1
+#define LEFT_MOTOR_BACKWARD_PIN     8 // IN2
+#define LEFT_MOTOR_PWM_PIN          6 // ENA - Must be PWM capable
+
+#if defined(CAR_NUMBER_OF_MOTORS_PER_SIDE) && CAR_NUMBER_OF_MOTORS_PER_SIDE == 2
+/*
+ * Rear motors of a 4WD car. An ATmega328 has no PWM pins and external interrupts left for them,
+ * so the pins and interrupts are only available in the simulation.
+ */
+#define RIGHT_REAR_MOTOR_INTERRUPT       2
+#define LEFT_REAR_MOTOR_INTERRUPT        3
+
+#define RIGHT_REAR_MOTOR_FORWARD_PIN     0
+#define RIGHT_REAR_MOTOR_BACKWARD_PIN    1
+#define RIGHT_REAR_MOTOR_PWM_PIN        A3
+
+#define LEFT_REAR_MOTOR_FORWARD_PIN     A4
+#define LEFT_REAR_MOTOR_BACKWARD_PIN    A5
+#define LEFT_REAR_MOTOR_PWM_PIN         A6
+#endif
+
+// VIN/11 at A2, e.g. 1MOhm to VIN, 100kOhm to ground
+#define VIN_11TH_IN_CHANNEL         2 // = A2
+#define PIN_VIN_11TH_IN            A2
+
+// Distance sensor, servo and buzzer as used by the examples
+#define PIN_DISTANCE_SERVO         10
+#define PIN_BUZZER                 12
+#define PIN_TRIGGER_OUT            A0
+#define PIN_ECHO_IN                A1
+
+#endif /* ROBOT_CAR_PIN_DEFINITIONS_AND_MORE_H */
@@ -0,0 +1,97 @@
+#!/bin/bash
+#
+# RunBenchmarks.sh
+#
+# Builds and runs Benchmark.cpp for the PWM, encoder and IMU configuration and prints the results of all runs.
+# If a file with the output of a previous run is given, the results are compared with it
+# and every function / state whose host_ns_median increased by more than the threshold percent or whose bus_us_mean increased
+# at all is reported. Host times are scaled by the ratio of the reference_ns values of both runs, to compensate
+# for a different speed of the host. To suppress the jitter of the host, host_ns_median must also increase by more than 20 ns
+# and is not compared for function / state combinations with less than 1000 calls.
+# The exit code is 1 in this case, so it can be used as regression check.
+#
+# Usage: ./RunBenchmarks.sh [<baseline file> [<threshold percent, default 20>]]
+# e.g.   ./RunBenchmarks.sh > baseline.txt; <change code>; ./RunBenchmarks.sh baseline.txt
+#
+#  Copyright (C) 2022  Armin Joachimsmeyer
+#  armin.joachimsmeyer@gmail.com
+#
+#  This file is part of PWMMotorControl https://github.com/ArminJo/PWMMotorControl.
+#
+#  PWMMotorControl is free software: you can redistribute it and/or modify
+#  it under the terms of the GNU General Public License as published by
+#  the Free Software Foundation, either version 3 of the License, or
+#  (at your option) any later version.
+#
+#  This program is distributed in the hope that it will be useful,
+#  but WITHOUT ANY WARRANTY; without even the implied warranty of
+#  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+#  GNU General Public License for more details.
+#
+#  You should have received a copy of the GNU General Public License
+#  along with this program.  If not, see <http://www.gnu.org/licenses/gpl.html>.
+#
+cd "$(dirname "$0")" || exit 2
+BASELINE=$1
+THRESHOLD_PERCENT=${2:-20}
+BUILD_DIR=$(mktemp -d)
+RESULT=$BUILD_DIR/result.txt
+trap 'rm -rf "$BUILD_DIR"' EXIT
+
+for CONFIGURATION in "" "-DUSE_ENCODER_MOTOR_CONTROL" "-DUSE_MPU6050_IMU"; do
+    g++ -std=gnu++11 -O2 -Wall $CONFIGURATION -I. -I../../src -I../../examples/SmartCarFollower Benchmark.cpp \
+        ../../examples/SmartCarFollower/HCSR04.cpp -o "$BUILD_DIR/Benchmark" || exit 2
+    "$BUILD_DIR/Benchmark" >> "$RESULT" || exit 2
+done
+cat "$RESULT"
+
+if [ -z "$BASELINE" ]; then
+    exit 0
+fi
+# Key is bench, config and state. Bus time is deterministic, so every increase is reported.
+awk -v threshold="$THRESHOLD_PERCENT" '
+function value(aLine, aKey,    tFields, i, tPair) {
+    split(aLine, tFields, " ")
+    for (i in tFields) {
+        split(tFields[i], tPair, "=")
+        if (tPair[1] == aKey) {
+            return tPair[2]
+        }
+    }
+    return ""
+}
+/^config=/ {
+    if (FNR == NR) {
+        sBaseReferenceNanos[value($0, "config")] = value($0, "reference_ns")
+    } else if (sBaseReferenceNanos[value($0, "config")] > 0) {
+        sScale[value($0, "config")] = value($0, "reference_ns") / sBaseReferenceNanos[value($0, "config")]
+    }
+    next
+}
+/^bench=/ {
+    tKey = value($0, "bench") " " value($0, "config") " " value($0, "state")
+    if (FNR == NR) {
+        sBaseHostNanos[tKey] = value($0, "host_ns_median")
+        sBaseBusMicros[tKey] = value($0, "bus_us_mean")
+        next
+    }
+    if (!(tKey in sBaseHostNanos)) {
+        next
+    }
+    tScale = sScale[value($0, "config")]
+    tHostNanos = value($0, "host_ns_median") / (tScale > 0 ? tScale : 1)
+    tBusMicros = value($0, "bus_us_mean")
+    if (value($0, "calls") >= 1000 && tHostNanos > sBaseHostNanos[tKey] * (1 + threshold / 100) &&
+            tHostNanos > sBaseHostNanos[tKey] + 20) {
+        printf("regression=host_ns_median %s old=%s new_scaled=%.0f\n", tKey, sBaseHostNanos[tKey], tHostNanos)
+        sRegressions++
+    }
+    if (tBusMicros > sBaseBusMicros[tKey] + 0.05) {
+        printf("regression=bus_us_mean %s old=%s new=%s\n", tKey, sBaseBusMicros[tKey], tBusMicros)
+        sRegressions++
+    }
+}
+END {
+    printf("regressions=%d threshold_percent=%s\n", sRegressions, threshold)
+    exit (sRegressions > 0)
+}' "$BASELINE" "$RESULT"
@@ -0,0 +1,52 @@
+/*
+ * Servo.h
+ *
+ * Host stand-in for the Arduino Servo library. The written angle is only stored for inspection by the simulation.
+ *
+ *  Copyright (C) 2022  Armin Joachimsmeyer
+ *  armin.joachimsmeyer@gmail.com
+ *
+ *  This file is part of PWMMotorControl https://github.com/ArminJo/PWMMotorControl.
+ *
+ *  PWMMotorControl is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/gpl.html>.
+ */
+
+#ifndef HOST_SERVO_H
+#define HOST_SERVO_H
+
+#include "Arduino.h"
+
+class Servo {
+public:
+    uint8_t attach(int aPin) {
+        Pin = aPin;
+        return 0;
+    }
+    void detach() {
+    }
+    void write(int aDegree) {
+        Degree = aDegree;
+    }
+    int read() {
+        return Degree;
+    }
+    bool attached() {
+        return true;
+    }
+
+    int Pin;
+    int Degree;
+};
+
+#endif // HOST_SERVO_H
@@ -0,0 +1,151 @@
+/*
+ *  WheelSlipTrials.cpp
+ *
+ *  Runs the wheel slip control of a 4WD car against CarPlant with simulated rear motors and prints for distance drives
+ *  1. On a floor with full grip, where no slip may be detected.
+ *  2. With a slipping right rear wheel, which lost its load, e.g. by an uneven floor. Since it has to move only itself,
+ *     it has less friction and inertia and runs ahead of the right front wheel, which now carries its load.
+ *     The slip must be detected and the right rear wheel must be slowed down until it is no longer ahead.
+ *  3. The same, with the load lost in the middle of the drive at full speed. Here the speed control of the right rear wheel
+ *     keeps it from running ahead, so no or only a short slip is expected to be detected.
+ *  Add -DWHEEL_SLIP_KP_TIMES_16=0 to compare with the drives without wheel slip correction.
+ *
+ *  Build and run from this directory with:
+ *  g++ -std=gnu++11 -O2 -Wall -DUSE_ENCODER_MOTOR_CONTROL -DCAR_NUMBER_OF_MOTORS_PER_SIDE=2 -I. -I../../src WheelSlipTrials.cpp -o WheelSlipTrials && ./WheelSlipTrials
+ *  Output is one line of key=value pairs per scenario, to be easily processed by scripts.
+ *
+ *  Copyright (C) 2022  Armin Joachimsmeyer
+ *  armin.joachimsmeyer@gmail.com
+ *
+ *  This file is part of PWMMotorControl https://github.com/ArminJo/PWMMotorControl.
+ *
+ *  PWMMotorControl is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/gpl.html>.
+ *
+ */
+
+#include <Arduino.h>
+
+#if !defined(USE_ENCODER_MOTOR_CONTROL) || !defined(CAR_NUMBER_OF_MOTORS_PER_SIDE) || CAR_NUMBER_OF_MOTORS_PER_SIDE != 2
+#error WheelSlipTrials requires -DUSE_ENCODER_MOTOR_CONTROL -DCAR_NUMBER_OF_MOTORS_PER_SIDE=2
+#endif
+
+#include "HostArduino.hpp"
+
+#define VIN_2_LIPO
+#include "CarPWMMotorControl.hpp"
+#include "CarPlant.hpp"
+
+CarPlant sCarPlant;
+
+#define SLIP_TRIAL_DISTANCE_MILLIMETER  1000
+#define SLIP_TRIAL_TIMEOUT_MILLIS       5000
+
+/*
+ * The unloaded wheel has 40% of the friction and a quarter of the inertia, the front wheel of this side takes over the difference
+ */
+void setSlippingRightRearWheel() {
+    DcMotorPlantParameters *tSlippingParameters = &sCarPlant.RightRearMotor.Parameters;
+    DcMotorPlantParameters *tLoadedParameters = &sCarPlant.RightMotor.Parameters;
+    uint16_t tFrictionShiftMillivolt = tSlippingParameters->FrictionMillivolt - (tSlippingParameters->FrictionMillivolt * 4) / 10;
+    tSlippingParameters->FrictionMillivolt -= tFrictionShiftMillivolt;
+    tSlippingParameters->StartMillivolt = (tSlippingParameters->StartMillivolt * 6) / 10;
+    tSlippingParameters->MechanicalTimeConstantMillis /= 4;
+    tSlippingParameters->MaxAccelerationMillimeterPerSecond2 *= 2;
+    tSlippingParameters->GripAccelerationMillimeterPerSecond2 = 500;
+    tLoadedParameters->FrictionMillivolt += tFrictionShiftMillivolt;
+    if (tLoadedParameters->FrictionMillivolt >= tLoadedParameters->StartMillivolt) {
+        tLoadedParameters->FrictionMillivolt = tLoadedParameters->StartMillivolt - 100;
+    }
+    tLoadedParameters->MechanicalTimeConstantMillis += sCarPlant.RightRearMotor.Parameters.MechanicalTimeConstantMillis * 3;
+}
+
+void setDefaultPlantParameters() {
+    for (uint_fast8_t i = 0; i < PLANT_NUMBER_OF_MOTORS; ++i) {
+        sCarPlant.Motors[i]->setDefaultParameters();
+    }
+}
+
+/*
+ * Drive SLIP_TRIAL_DISTANCE_MILLIMETER and record the distance, which the right rear wheel is ahead of the right front wheel.
+ * aSlipStartMillimeter is the car distance, at which the right rear wheel loses its load.
+ * Detection time is the time from losing the load to the first slip correction of the right rear wheel.
+ * Recovery time is the time from the first slip correction until the wheel is no longer ahead by more than WHEEL_SLIP_THRESHOLD_MILLIMETER.
+ */
+void measureWheelSlip(const char *aFloorName, bool aSlip, uint16_t aSlipStartMillimeter) {
+    setDefaultPlantParameters();
+    sCarPlant.reset();
+    EncoderMotor *tRearMotor = &RobotCarPWMMotorControl.rightFollowerCarMotors[0];
+    EncoderMotor *tFrontMotor = &RobotCarPWMMotorControl.rightCarMotor;
+
+    bool tSlipStarted = false;
+    uint32_t tSlipStartMillis = 0;
+    uint32_t tDetectionMillis = 0;
+    uint32_t tRecoveryMillis = 0;
+    int tMaxAheadMillimeter = 0;
+    int tMinSlipCorrection = 0;
+    uint32_t tStartMillis = millis();
+    RobotCarPWMMotorControl.startGoDistanceMillimeter(SLIP_TRIAL_DISTANCE_MILLIMETER);
+    while (RobotCarPWMMotorControl.updateMotors() && millis() - tStartMillis < SLIP_TRIAL_TIMEOUT_MILLIS) {
+        delay(1);
+        uint32_t tMillis = millis() - tStartMillis;
+        if (aSlip && !tSlipStarted && sCarPlant.getDistanceMillimeter() >= aSlipStartMillimeter) {
+            setSlippingRightRearWheel();
+            tSlipStarted = true;
+            tSlipStartMillis = tMillis;
+        }
+        int tAheadMillimeter = (int) tRearMotor->getDistanceMillimeter() - (int) tFrontMotor->getDistanceMillimeter();
+        if (tMaxAheadMillimeter < tAheadMillimeter) {
+            tMaxAheadMillimeter = tAheadMillimeter;
+        }
+        int tSlipCorrection = tRearMotor->SlipCorrectionMillimeterPerSecond;
+        if (tMinSlipCorrection > tSlipCorrection) {
+            tMinSlipCorrection = tSlipCorrection;
+        }
+        if (tSlipCorrection < 0 && tDetectionMillis == 0) {
+            tDetectionMillis = tMillis;
+        }
+        if (tDetectionMillis != 0 && tRecoveryMillis == 0 && tAheadMillimeter <= WHEEL_SLIP_THRESHOLD_MILLIMETER) {
+            tRecoveryMillis = tMillis;
+        }
+    }
+    uint32_t tStopMillis = millis() - tStartMillis;
+    RobotCarPWMMotorControl.stop(MOTOR_BRAKE);
+    while (!sCarPlant.isStopped()) {
+        delay(1);
+    }
+    int tEndAheadMillimeter = (int) tRearMotor->getDistanceMillimeter() - (int) tFrontMotor->getDistanceMillimeter();
+
+    printf("test=wheel_slip floor=%s detected=%d detection_ms=%ld recovery_ms=%ld max_ahead_mm=%d end_ahead_mm=%d"
+            " min_correction_mm_s=%d rear_spin_mm=%.0f distance_error_mm=%.0f heading_deg=%.1f stop_ms=%lu\n", aFloorName,
+            tDetectionMillis != 0, (tDetectionMillis == 0) ? -1L : (long) (tDetectionMillis - tSlipStartMillis),
+            (tRecoveryMillis == 0) ? -1L : (long) (tRecoveryMillis - tDetectionMillis), tMaxAheadMillimeter, tEndAheadMillimeter,
+            tMinSlipCorrection, sCarPlant.RightRearMotor.DistanceMillimeter - sCarPlant.RightRearMotor.FloorDistanceMillimeter,
+            sCarPlant.getDistanceMillimeter() - SLIP_TRIAL_DISTANCE_MILLIMETER, sCarPlant.getHeadingDegree(), (unsigned long) tStopMillis);
+    delay(500);
+}
+
+int main() {
+    Serial.OutputEnabled = false;
+    VirtualClock::reset();
+    sCarPlant.init();
+
+    RobotCarPWMMotorControl.init(RIGHT_MOTOR_FORWARD_PIN, RIGHT_MOTOR_BACKWARD_PIN, RIGHT_MOTOR_PWM_PIN, LEFT_MOTOR_FORWARD_PIN,
+    LEFT_MOTOR_BACKWARD_PIN, LEFT_MOTOR_PWM_PIN);
+    initRearCarMotors();
+
+    measureWheelSlip("grip", false, 0);
+    measureWheelSlip("slipping_right_rear", true, 0);
+    measureWheelSlip("slipping_right_rear_at_500_mm", true, 500);
+    return 0;
+}
@@ -0,0 +1,89 @@
+/*
+ * Wire.h
+ *
+ * Host stand-in for the Arduino Wire library.
+ * Transmissions are routed to simulated I2C devices (class HostI2CDevice) registered with Wire.addDevice().
+ * Every transferred byte advances the virtual clock by the time it requires on the real bus (9 bit per byte incl. ACK),
+ * so I2C heavy code like IMUCarData::readCarDataFromMPU6050Fifo() has realistic timing.
+ *
+ *  Copyright (C) 2022  Armin Joachimsmeyer
+ *  armin.joachimsmeyer@gmail.com
+ *
+ *  This file is part of PWMMotorControl https://github.com/ArminJo/PWMMotorControl.
+ *
+ *  PWMMotorControl is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/gpl.html>.
+ */
+
+#ifndef HOST_WIRE_H
+#define HOST_WIRE_H
+
+#include "Arduino.h"
+
+#define BUFFER_LENGTH 32 // Same as AVR Wire library
+#define WIRE_MAX_DEVICES 4
+
+/*
+ * Interface for simulated I2C slaves
+ */
+class HostI2CDevice {
+public:
+    virtual ~HostI2CDevice() {
+    }
+    // Called at endTransmission() with all bytes written by the master
+    virtual void receive(const uint8_t *aData, uint8_t aLength) = 0;
+    // Called at requestFrom(). Must fill aBuffer and return the number of bytes transmitted
+    virtual uint8_t transmit(uint8_t *aBuffer, uint8_t aQuantity) = 0;
+
+    uint8_t Address;
+};
+
+class TwoWire: public Print {
+public:
+    void begin();
+    void end();
+    void setClock(uint32_t aClockHertz);
+    void setWireTimeout(uint32_t aTimeoutMicros = 25000, bool aResetWithTimeout = false);
+
+    void beginTransmission(uint8_t aAddress);
+    uint8_t endTransmission(bool aSendStop = true);
+    uint8_t requestFrom(uint8_t aAddress, uint8_t aQuantity, uint8_t aSendStop = true);
+    size_t write(uint8_t aByte) override;
+    using Print::write;
+    int available();
+    int read();
+
+    void addDevice(HostI2CDevice *aDevice, uint8_t aAddress);
+    void removeAllDevices();
+    HostI2CDevice* findDevice(uint8_t aAddress);
+    void addBusTime(uint8_t aNumberOfBytes);
+
+    uint32_t ClockHertz = 100000;
+    uint8_t TransmitAddress;
+    uint8_t TransmitBuffer[BUFFER_LENGTH];
+    uint8_t TransmitLength;
+    uint8_t ReceiveBuffer[BUFFER_LENGTH];
+    uint8_t ReceiveLength;
+    uint8_t ReceiveIndex;
+
+    uint8_t NumberOfDevices;
+    HostI2CDevice *Devices[WIRE_MAX_DEVICES];
+
+    // Statistics
+    unsigned long TransferredBytesCount;
+    unsigned long NackCount;
+};
+
+extern TwoWire Wire;
+
+#endif // HOST_WIRE_H
@@ -0,0 +1,67 @@
+/*
+ * BrakingDistanceModel.h
+ *
+ *  Braking distance v^2 / (2 * deceleration) with a deceleration, which is learned from the overrun measured after each stop.
+ *  A deceleration is kept for each stop mode MOTOR_BRAKE and MOTOR_RELEASE and for each speed band, since the brake force
+ *  of a short circuited motor is proportional to the speed, but the friction of a released motor is not.
+ *  All values start with RAMP_DECELERATION_TIMES_2 and adapt to the current floor after a few stops.
+ *
+ *  Velocity is in mm/s and deceleration in mm/s^2.
+ *
+ *  Copyright (C) 2022  Armin Joachimsmeyer
+ *  armin.joachimsmeyer@gmail.com
+ *
+ *  This file is part of PWMMotorControl https://github.com/ArminJo/PWMMotorControl.
+ *
+ *  PWMMotorControl is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/gpl.html>.
+ */
+
+#ifndef BRAKING_DISTANCE_MODEL_H_
+#define BRAKING_DISTANCE_MODEL_H_
+
+#include <stdint.h>
+
+#define BRAKING_DISTANCE_NUMBER_OF_SPEED_BANDS      4
+#define BRAKING_DISTANCE_SPEED_BAND_WIDTH           200 // mm/s, the last band contains all higher speeds
+#define BRAKING_DISTANCE_FILTER_SHIFT               2   // New measurement has a weight of 1/4
+#define BRAKING_DISTANCE_MIN_DECELERATION_TIMES_2   500   // mm/s^2, limits for a single measurement
+#define BRAKING_DISTANCE_MAX_DECELERATION_TIMES_2   20000 // mm/s^2
+#define BRAKING_DISTANCE_MIN_MEASUREMENT_SPEED      50  // mm/s, the overrun of lower speeds is below the resolution of the encoder
+#define BRAKING_DISTANCE_STANDSTILL_MILLIS          250 // No distance change for this time after stop is taken as standstill
+
+class BrakingDistanceModel {
+public:
+    BrakingDistanceModel();
+    void reset();
+    unsigned int getBrakingDistanceMillimeter(unsigned int aSpeedMillimeterPerSecond, uint8_t aStopMode);
+    uint16_t getDeceleration(unsigned int aSpeedMillimeterPerSecond, uint8_t aStopMode);
+    void startMeasurement(unsigned int aSpeedMillimeterPerSecond, uint8_t aStopMode, unsigned int aDistanceMillimeter);
+    void endMeasurement(unsigned int aDistanceMillimeter);
+
+    // [MOTOR_BRAKE - MOTOR_BRAKE or MOTOR_RELEASE - MOTOR_BRAKE][speed band]
+    uint16_t DecelerationTimes2[2][BRAKING_DISTANCE_NUMBER_OF_SPEED_BANDS];
+
+    /*
+     * Values of the running measurement
+     */
+    bool MeasurementIsRunning;
+    uint8_t MeasurementStopMode;
+    unsigned int MeasurementSpeedMillimeterPerSecond;
+    unsigned int MeasurementStartDistanceMillimeter;
+    unsigned long MeasurementStartMillis;
+};
+
+#endif /* BRAKING_DISTANCE_MODEL_H_ */
+
+#pragma once
@@ -0,0 +1,116 @@
+/*
+ * BrakingDistanceModel.hpp
+ *
+ *  Braking distance with learned deceleration.
+ *
+ *  At stop, the owner calls startMeasurement() with the current speed and distance.
+ *  At standstill, the owner calls endMeasurement() with the distance, and the deceleration of the stop mode
+ *  and speed band is moved towards v^2 / (2 * overrun) by a low pass filter.
+ *  A measurement, which is not ended because the motor was started again before standstill, is just discarded
+ *  by resetting MeasurementIsRunning.
+ *
+ *  Copyright (C) 2022  Armin Joachimsmeyer
+ *  armin.joachimsmeyer@gmail.com
+ *
+ *  This file is part of PWMMotorControl https://github.com/ArminJo/PWMMotorControl.
+ *
+ *  PWMMotorControl is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/gpl.html>.
+ */
+#ifndef BRAKING_DISTANCE_MODEL_HPP
+#define BRAKING_DISTANCE_MODEL_HPP
+
+#include <Arduino.h>
+#include "BrakingDistanceModel.h"
+
+BrakingDistanceModel::BrakingDistanceModel() { // @suppress("Class members should be properly initialized")
+    reset();
+}
+
+/*
+ * Forget all learned values
+ */
+void BrakingDistanceModel::reset() {
+    for (uint_fast8_t i = 0; i < BRAKING_DISTANCE_NUMBER_OF_SPEED_BANDS; ++i) {
+        DecelerationTimes2[0][i] = RAMP_DECELERATION_TIMES_2;
+        DecelerationTimes2[1][i] = RAMP_DECELERATION_TIMES_2;
+    }
+    MeasurementIsRunning = false;
+}
+
+static uint8_t getBrakingDistanceSpeedBand(unsigned int aSpeedMillimeterPerSecond) {
+    uint8_t tSpeedBand = aSpeedMillimeterPerSecond / BRAKING_DISTANCE_SPEED_BAND_WIDTH;
+    if (tSpeedBand >= BRAKING_DISTANCE_NUMBER_OF_SPEED_BANDS) {
+        tSpeedBand = BRAKING_DISTANCE_NUMBER_OF_SPEED_BANDS - 1;
+    }
+    return tSpeedBand;
+}
+
+/*
+ * @param aStopMode MOTOR_BRAKE or MOTOR_RELEASE
+ */
+unsigned int BrakingDistanceModel::getBrakingDistanceMillimeter(unsigned int aSpeedMillimeterPerSecond, uint8_t aStopMode) {
+    return ((unsigned long) aSpeedMillimeterPerSecond * aSpeedMillimeterPerSecond)
+            / DecelerationTimes2[ForceStopMODE(aStopMode) - MOTOR_BRAKE][getBrakingDistanceSpeedBand(aSpeedMillimeterPerSecond)];
+}
+
+/*
+ * @param aStopMode MOTOR_BRAKE or MOTOR_RELEASE
+ * @return the learned deceleration in mm/s^2
+ */
+uint16_t BrakingDistanceModel::getDeceleration(unsigned int aSpeedMillimeterPerSecond, uint8_t aStopMode) {
+    return DecelerationTimes2[ForceStopMODE(aStopMode) - MOTOR_BRAKE][getBrakingDistanceSpeedBand(aSpeedMillimeterPerSecond)] / 2;
+}
+
+/*
+ * @param aStopMode MOTOR_BRAKE or MOTOR_RELEASE
+ * @param aDistanceMillimeter the distance at stop, may be interpolated between 2 encoder counts
+ */
+void BrakingDistanceModel::startMeasurement(unsigned int aSpeedMillimeterPerSecond, uint8_t aStopMode,
+        unsigned int aDistanceMillimeter) {
+    MeasurementIsRunning = (aSpeedMillimeterPerSecond >= BRAKING_DISTANCE_MIN_MEASUREMENT_SPEED);
+    MeasurementStopMode = ForceStopMODE(aStopMode);
+    MeasurementSpeedMillimeterPerSecond = aSpeedMillimeterPerSecond;
+    MeasurementStartDistanceMillimeter = aDistanceMillimeter;
+    MeasurementStartMillis = millis();
+}
+
+/*
+ * @param aDistanceMillimeter the distance at standstill
+ */
+void BrakingDistanceModel::endMeasurement(unsigned int aDistanceMillimeter) {
+    if (!MeasurementIsRunning) {
+        return;
+    }
+    MeasurementIsRunning = false;
+    if (aDistanceMillimeter < MeasurementStartDistanceMillimeter) {
+        return; // distance was reset in between
+    }
+    unsigned int tOverrunMillimeter = aDistanceMillimeter - MeasurementStartDistanceMillimeter;
+    unsigned long tDecelerationTimes2 = BRAKING_DISTANCE_MAX_DECELERATION_TIMES_2;
+    if (tOverrunMillimeter > 0) {
+        tDecelerationTimes2 = ((unsigned long) MeasurementSpeedMillimeterPerSecond * MeasurementSpeedMillimeterPerSecond)
+                / tOverrunMillimeter;
+        if (tDecelerationTimes2 > BRAKING_DISTANCE_MAX_DECELERATION_TIMES_2) {
+            tDecelerationTimes2 = BRAKING_DISTANCE_MAX_DECELERATION_TIMES_2;
+        } else if (tDecelerationTimes2 < BRAKING_DISTANCE_MIN_DECELERATION_TIMES_2) {
+            tDecelerationTimes2 = BRAKING_DISTANCE_MIN_DECELERATION_TIMES_2;
+        }
+    }
+    uint16_t *tDecelerationPointer = &DecelerationTimes2[MeasurementStopMode - MOTOR_BRAKE][getBrakingDistanceSpeedBand(
+            MeasurementSpeedMillimeterPerSecond)];
+    *tDecelerationPointer += ((long) tDecelerationTimes2 - (long) *tDecelerationPointer) >> BRAKING_DISTANCE_FILTER_SHIFT;
+}
+
+#endif // #ifndef BRAKING_DISTANCE_MODEL_HPP
+#pragma once
@@ -0,0 +1,87 @@
+/*
+ * CalibrationStore.h
+ *
+ *  Versioned and CRC protected EEPROM record for all calibration values of the car,
+ *  written by CarPWMMotorControl::writeMotorValuesToEeprom() and read by CarPWMMotorControl::readMotorValuesFromEeprom().
+ *  The record contains DriveSpeedPWM and SpeedPWMCompensation, the speed PWM tables (feed forward),
+ *  the speed control gains and the IMU offsets for both motors. Its layout does not depend on the USE_* options.
+ *  Values, which are not available with the current options, are taken from the stored record, so they are not lost.
+ *
+ *  The record is stored in CALIBRATION_STORE_NUMBER_OF_SLOTS slots, which are written one after the other.
+ *  The valid slot with the highest sequence number is the current one. If writing of a slot is interrupted,
+ *  its CRC does not match and the previous slot is still valid.
+ *  A record, which is equal to the current one, is not written, so repeated stores from the GUI do not wear out the EEPROM.
+ *  With 4 slots, each EEPROM cell is written at most every 4th change.
+ *
+ *  The slots start at CALIBRATION_STORE_EEPROM_START behind the fixed layout of the previous versions
+ *  (EepromMotorInfoStruct's, speed PWM tables and speed control gains), so that values of this layout can be read
+ *  as long as no record was written.
+ *
+ *  Copyright (C) 2022  Armin Joachimsmeyer
+ *  armin.joachimsmeyer@gmail.com
+ *
+ *  This file is part of PWMMotorControl https://github.com/ArminJo/PWMMotorControl.
+ *
+ *  PWMMotorControl is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/gpl.html>.
+ */
+
+#ifndef CALIBRATION_STORE_H_
+#define CALIBRATION_STORE_H_
+
+#include <stdint.h>
+
+#define CALIBRATION_RECORD_VERSION          1   // Must be changed if CalibrationRecordStruct changes
+#define CALIBRATION_RECORD_NUMBER_OF_MOTORS 2   // Index 0 is the left motor, 1 the right motor, like the storage numbers of the fixed layout
+#define CALIBRATION_RECORD_SPEED_PWM_TABLE_SIZE 8 // Must be equal to SPEED_PWM_TABLE_SIZE
+#if !defined(CALIBRATION_STORE_NUMBER_OF_SLOTS)
+#define CALIBRATION_STORE_NUMBER_OF_SLOTS   4   // 52 bytes per slot
+#endif
+#if !defined(CALIBRATION_STORE_EEPROM_START)
+#define CALIBRATION_STORE_EEPROM_START      128 // Behind the 96 bytes of the fixed layout used before
+#endif
+#define CALIBRATION_STORE_NO_SLOT           0xFF
+
+/*
+ * All 16 bit values are 2 byte aligned, so the layout has no padding bytes.
+ * 0 means "not calibrated" for each value.
+ */
+struct CalibrationRecordStruct {
+    uint8_t Version;
+    uint8_t SequenceNumber;     // Incremented by each write, the slot with the highest number is the current one
+    uint8_t DriveSpeedPWM[CALIBRATION_RECORD_NUMBER_OF_MOTORS];
+    uint8_t SpeedPWMCompensation[CALIBRATION_RECORD_NUMBER_OF_MOTORS];
+    uint8_t SpeedPWMTable[CALIBRATION_RECORD_NUMBER_OF_MOTORS][2][CALIBRATION_RECORD_SPEED_PWM_TABLE_SIZE];
+    uint16_t SpeedControlKpTimes256[CALIBRATION_RECORD_NUMBER_OF_MOTORS];
+    uint16_t SpeedControlKiTimes256[CALIBRATION_RECORD_NUMBER_OF_MOTORS];
+    int16_t AcceleratorForwardOffset;
+    int16_t GyroscopePanOffset;
+    uint16_t CRC;               // CRC-16-CCITT of all bytes before
+};
+
+class CalibrationStore {
+public:
+    bool readRecord(CalibrationRecordStruct *aRecord);
+    bool writeRecord(CalibrationRecordStruct *aRecord);
+
+    void readSlot(uint8_t aSlot, CalibrationRecordStruct *aRecord);
+    void writeSlot(uint8_t aSlot, CalibrationRecordStruct *aRecord);
+    static uint16_t computeCRC(CalibrationRecordStruct *aRecord);
+    static bool isValid(CalibrationRecordStruct *aRecord);
+
+    uint8_t CurrentSlot;        // Slot of the current record, CALIBRATION_STORE_NO_SLOT if no slot is valid
+};
+
+#endif /* CALIBRATION_STORE_H_ */
+
+#pragma once
@@ -0,0 +1,134 @@
+/*
+ * CalibrationStore.hpp
+ *
+ *  Search of the current slot, CRC check and rotating write of the calibration record.
+ *  The owner fills the record with the values to store and converts the read record to its values.
+ *
+ *  Copyright (C) 2022  Armin Joachimsmeyer
+ *  armin.joachimsmeyer@gmail.com
+ *
+ *  This file is part of PWMMotorControl https://github.com/ArminJo/PWMMotorControl.
+ *
+ *  PWMMotorControl is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/gpl.html>.
+ */
+#ifndef CALIBRATION_STORE_HPP
+#define CALIBRATION_STORE_HPP
+
+#include <Arduino.h>
+#include <stddef.h> // for offsetof
+#include "CalibrationStore.h"
+
+#if defined(_STM32_DEF_)
+#include <EEPROM.h> // Support for STM32 EEPROM emulation.
+#endif
+
+#if defined(E2END)
+void CalibrationStore::readSlot(uint8_t aSlot, CalibrationRecordStruct *aRecord) {
+#if defined(_STM32_DEF_)
+    EEPROM.get(CALIBRATION_STORE_EEPROM_START + (aSlot * sizeof(CalibrationRecordStruct)), *aRecord);
+#else
+    eeprom_read_block((void*) aRecord, (void*) (CALIBRATION_STORE_EEPROM_START + (aSlot * sizeof(CalibrationRecordStruct))),
+            sizeof(CalibrationRecordStruct));
+#endif
+}
+
+/*
+ * Only changed bytes are written
+ */
+void CalibrationStore::writeSlot(uint8_t aSlot, CalibrationRecordStruct *aRecord) {
+#if defined(_STM32_DEF_)
+    EEPROM.put(CALIBRATION_STORE_EEPROM_START + (aSlot * sizeof(CalibrationRecordStruct)), *aRecord);
+#else
+    eeprom_update_block((void*) aRecord, (void*) (CALIBRATION_STORE_EEPROM_START + (aSlot * sizeof(CalibrationRecordStruct))),
+            sizeof(CalibrationRecordStruct));
+#endif
+}
+
+/*
+ * Reads the current record, i.e. the valid record with the highest sequence number.
+ * Sequence numbers are compared modulo 256, so the overflow of the sequence number does not matter.
+ * @return false and a record filled with 0 if no slot is valid, e.g. for an erased EEPROM
+ */
+bool CalibrationStore::readRecord(CalibrationRecordStruct *aRecord) {
+    CalibrationRecordStruct tRecord;
+    CurrentSlot = CALIBRATION_STORE_NO_SLOT;
+    memset(aRecord, 0, sizeof(CalibrationRecordStruct));
+    for (uint_fast8_t i = 0; i < CALIBRATION_STORE_NUMBER_OF_SLOTS; ++i) {
+        readSlot(i, &tRecord);
+        if (isValid(&tRecord)
+                && (CurrentSlot == CALIBRATION_STORE_NO_SLOT || (int8_t) (tRecord.SequenceNumber - aRecord->SequenceNumber) > 0)) {
+            CurrentSlot = i;
+            *aRecord = tRecord;
+        }
+    }
+    return CurrentSlot != CALIBRATION_STORE_NO_SLOT;
+}
+
+/*
+ * Writes the values of aRecord to the slot behind the current one, if they differ from the values of the current record.
+ * Version, SequenceNumber and CRC of aRecord are set by this function.
+ * @return true if a slot was written
+ */
+bool CalibrationStore::writeRecord(CalibrationRecordStruct *aRecord) {
+    CalibrationRecordStruct tCurrentRecord;
+    uint8_t tSlot = 0;
+    if (readRecord(&tCurrentRecord)) {
+        if (memcmp(&tCurrentRecord.DriveSpeedPWM, &aRecord->DriveSpeedPWM,
+                offsetof(CalibrationRecordStruct, CRC) - offsetof(CalibrationRecordStruct, DriveSpeedPWM)) == 0) {
+            *aRecord = tCurrentRecord;
+            return false;
+        }
+        tSlot = CurrentSlot + 1;
+        if (tSlot >= CALIBRATION_STORE_NUMBER_OF_SLOTS) {
+            tSlot = 0;
+        }
+    }
+    aRecord->Version = CALIBRATION_RECORD_VERSION;
+    aRecord->SequenceNumber = tCurrentRecord.SequenceNumber + 1;
+    aRecord->CRC = computeCRC(aRecord);
+    writeSlot(tSlot, aRecord);
+    CurrentSlot = tSlot;
+    return true;
+}
+
+#endif // defined(E2END)
+
+/*
+ * CRC-16-CCITT, polynomial 0x1021, start value 0xFFFF, of all bytes before the CRC
+ */
+uint16_t CalibrationStore::computeCRC(CalibrationRecordStruct *aRecord) {
+    uint8_t *tBytePointer = (uint8_t*) aRecord;
+    uint16_t tCRC = 0xFFFF;
+    for (uint_fast8_t i = 0; i < offsetof(CalibrationRecordStruct, CRC); ++i) {
+        tCRC ^= (uint16_t) (*tBytePointer++) << 8;
+        for (uint_fast8_t j = 0; j < 8; ++j) {
+            if (tCRC & 0x8000) {
+                tCRC = (tCRC << 1) ^ 0x1021;
+            } else {
+                tCRC <<= 1;
+            }
+        }
+    }
+    return tCRC;
+}
+
+/*
+ * An erased slot contains 0xFF, which is no valid version
+ */
+bool CalibrationStore::isValid(CalibrationRecordStruct *aRecord) {
+    return aRecord->Version == CALIBRATION_RECORD_VERSION && aRecord->CRC == computeCRC(aRecord);
+}
+
+#endif // #ifndef CALIBRATION_STORE_HPP
+#pragma once
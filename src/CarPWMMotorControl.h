@@ -37,6 +37,63 @@
 #endif
 #include <stdint.h>
 
+/*
+ * Run the control step updateMotors() by a timer interrupt every MOTOR_CONTROL_TIMER_INTERRUPT_MILLIS after startMotorControlTimerInterrupt().
+ * Then ramps, distance checks and IMU rotation stops do not depend on blocking calls in the loop of the sketch.
+ * The control step runs with interrupts enabled, so encoder, millis() and I2C interrupts are served during it.
+ * Uses Timer2 on AVR, so tone() can not be used in this mode.
+ */
+//#define USE_MOTOR_CONTROL_TIMER_INTERRUPT
+#if defined(USE_MOTOR_CONTROL_TIMER_INTERRUPT) && !defined(MOTOR_CONTROL_TIMER_INTERRUPT_MILLIS)
+#define MOTOR_CONTROL_TIMER_INTERRUPT_MILLIS    1 // 1 or 2
+#endif
+
+/*
+ * Queue for motion commands, which are started one after the other by updateMotors() without a blocking call of the sketch.
+ * With USE_ENCODER_MOTOR_CONTROL, a distance drive followed by a distance drive in the same direction is not stopped in between,
+ * but the target distance is extended and the speed is blended to the speed of the next drive.
+ * Requires MOTION_COMMAND_QUEUE_SIZE * 6 + 13 bytes RAM.
+ */
+//#define USE_MOTION_COMMAND_QUEUE
+#if defined(USE_MOTION_COMMAND_QUEUE)
+#  if !defined(MOTION_COMMAND_QUEUE_SIZE)
+#define MOTION_COMMAND_QUEUE_SIZE   8 // must be a power of 2
+#  endif
+#define MOTION_COMMAND_GO_DISTANCE  0 // Parameter is speed PWM, Value is signed distance in mm
+#define MOTION_COMMAND_ROTATE       1 // Parameter is turn direction, Value is signed degrees
+#define MOTION_COMMAND_SET_SPEED    2 // Parameter is speed PWM, Value is direction. Speed PWM 0 ramps down to stop.
+#define MOTION_COMMAND_WAIT         3 // Value is milliseconds
+#define MOTION_COMMAND_ARC          4 // Parameter is direction, Value is signed degrees, Radius is radius in mm
+
+struct MotionCommandStruct {
+    uint8_t Type;
+    uint8_t Parameter;
+    int Value;
+    int Radius; // only for MOTION_COMMAND_ARC
+};
+#endif
+
+#if defined(USE_TRACTION_CONTROL)
+#define TRACTION_EVENT_SLIP_RIGHT   0x01
+#define TRACTION_EVENT_SLIP_LEFT    0x02
+#define TRACTION_EVENT_STALL        0x04 // car was stopped
+#endif
+
+/*
+ * Store all calibration values of the car in one versioned and CRC protected EEPROM record, see CalibrationStore.h.
+ * The record is written to rotating slots and only if values have changed.
+ */
+//#define DO_NOT_USE_CALIBRATION_STORE // Activate this to use the fixed EEPROM layout of version 1 and to save program space.
+#if !defined(DO_NOT_USE_CALIBRATION_STORE)
+#define USE_CALIBRATION_STORE
+#include "CalibrationStore.h"
+#  if defined(USE_SPEED_PWM_TABLE) && SPEED_PWM_TABLE_SIZE != CALIBRATION_RECORD_SPEED_PWM_TABLE_SIZE
+#error "SPEED_PWM_TABLE_SIZE must be equal to CALIBRATION_RECORD_SPEED_PWM_TABLE_SIZE"
+#  endif
+#endif
+
+#define DISTANCE_COUNT_STANDSTILL_MILLIS    250 // goDistanceCount() returns, if no encoder interrupt occurred for this time after stop
+
 /*
  * Values for 20 slot encoder discs. Circumference of the wheel is 22.0 cm
  * Distance between two wheels is around 14 cm -> 360 degree are 82 cm
@@ -83,6 +140,20 @@ public:
 
     void writeMotorValuesToEeprom();
     void readMotorValuesFromEeprom();
+#ifdef USE_CALIBRATION_STORE
+    void setValuesFromCalibrationRecord(CalibrationRecordStruct *aCalibrationRecord);
+    void getValuesForCalibrationRecord(CalibrationRecordStruct *aCalibrationRecord);
+#endif
+#ifdef USE_SPEED_PWM_TABLE
+    void calibrateSpeedPWMTables(void (*aLoopCallback)(void) = NULL);
+#endif
+#ifdef USE_MOTOR_MODEL_IDENTIFICATION
+    void identifyMotorModels(void (*aLoopCallback)(void) = NULL);
+#endif
+#ifdef USE_SPEED_CONTROL_AUTOTUNE
+    bool autotuneSpeedControl(unsigned int aSetpointMillimeterPerSecond = DEFAULT_MILLIMETER_PER_SECOND,
+            void (*aLoopCallback)(void) = NULL);
+#endif
 
 #if defined(USE_ENCODER_MOTOR_CONTROL) || defined(USE_MPU6050_IMU)
     void getStartSpeedPWM(void (*aLoopCallback)(void)); // aLoopCallback must call readCarDataFromMPU6050Fifo()
@@ -131,6 +202,22 @@ public:
     void goDistanceMillimeter(unsigned int aRequestedDistanceMillimeter, uint8_t aRequestedDirection,
             void (*aLoopCallback)(void) = NULL); // Blocking function, uses waitUntilStopped
 
+#ifdef USE_ENCODER_MOTOR_CONTROL
+    /*
+     * Both wheels drive aRequestedDistanceCount encoder counts. The targets are not changed while driving, each wheel stops at its own target.
+     * Only with USE_DIFFERENTIAL_DRIVE_CONTROL both wheels are kept together while driving and ramping down,
+     * with DO_NOT_USE_MOTION_PROFILE or DO_NOT_USE_DIFFERENTIAL_DRIVE_CONTROL each wheel ramps down and stops on its own.
+     * getDistanceCountError() returns the counts each wheel drove too far (positive) or too short (negative),
+     * goDistanceCount() returns after standstill, so the overrun is included.
+     */
+    void startGoDistanceCount(uint8_t aRequestedSpeedPWM, unsigned int aRequestedDistanceCount, uint8_t aRequestedDirection);
+    void startGoDistanceCount(int aRequestedDistanceCount); // only setup values, no movement -> use updateMotors()
+    void goDistanceCount(int aRequestedDistanceCount, void (*aLoopCallback)(void) = NULL); // Blocking function, waits for standstill
+    int getDistanceCountError(EncoderMotor *aMotor);
+    unsigned int RightTargetDistanceCount;
+    unsigned int LeftTargetDistanceCount;
+#endif
+
     bool checkAndHandleDirectionChange(uint8_t aRequestedDirection); // used internally
 
     /*
@@ -148,6 +235,30 @@ public:
             void (*aLoopCallback)(void) = NULL);
 #endif
 
+    /*
+     * Drive the center of the car on an arc with aRadiusMillimeter without stopping at the begin of the turn.
+     * aRotationDegrees positive -> right wheel is the outer wheel, i.e. turn left for forward driving.
+     * aRadiusMillimeter 0 is a turn in place.
+     */
+    void startArc(int aRadiusMillimeter, int aRotationDegrees, uint8_t aRequestedDirection = DIRECTION_FORWARD);
+    void arc(int aRadiusMillimeter, int aRotationDegrees, uint8_t aRequestedDirection = DIRECTION_FORWARD,
+            void (*aLoopCallback)(void) = NULL);
+    bool getArcWheelValues(int aRadiusMillimeter, int aRotationDegrees, uint8_t *aRightSpeedPWM, unsigned int *aRightDistanceMillimeter,
+            uint8_t *aLeftSpeedPWM, unsigned int *aLeftDistanceMillimeter);
+#if defined(USE_MOTION_PROFILE) && !defined(USE_MPU6050_IMU)
+    void scaleArcInnerWheelProfile(int aRotationDegrees, unsigned int aRightDistanceMillimeter, unsigned int aLeftDistanceMillimeter);
+#endif
+
+#ifdef USE_MOTION_PROFILE
+    /*
+     * Drive the center of the car with a linear velocity and turn it with a yaw rate, positive is a left turn.
+     * Both wheels blend to their new velocities at the same time, so the car follows the commanded path during the transition.
+     * The yaw rate is controlled by the differential drive control, with USE_MPU6050_IMU by the gyroscope.
+     * 0 for both ramps down to stop.
+     */
+    void setVelocityAndYawRate(int aVelocityMillimeterPerSecond, int aYawRateDegreePerSecond);
+#endif
+
 #ifdef USE_MPU6050_IMU
     IMUCarData IMUData;
     int CarRequestedRotationDegrees; // 0 -> car is moving forward / backward
@@ -157,6 +268,10 @@ public:
     unsigned int CarSpeedCmPerSecondFromIMU;
     unsigned int CarRequestedDistanceMillimeter;
     unsigned int CarDistanceMillimeterFromIMU;
+#  if defined(USE_LEARNED_BRAKING_DISTANCE) && !defined(USE_ENCODER_MOTOR_CONTROL)
+    BrakingDistanceModel BrakingModel; // Learns the distance from startRampDown() to standstill. Encoder motors have their own model.
+    void updateBrakingDistanceMeasurement(); // called by updateMotors()
+#  endif
 #else
     float FactorDegreeToMillimeter;
 #endif
@@ -165,6 +280,83 @@ public:
     bool updateMotors(void (*aLoopCallback)(void));
     void delayAndUpdateMotors(unsigned int aDelayMillis);
 
+#ifdef USE_DIFFERENTIAL_DRIVE_CONTROL
+    void updateDifferentialDriveControl(); // called by updateMotors()
+    long getWheelDistanceDifferenceMicrometer();
+    bool DifferentialDriveControlIsActive; // both wheels are driven by their motion profile
+    unsigned long NextDifferentialDriveControlMillis;
+    long WheelDistanceDifferenceOffsetMicrometer; // measured difference at activation
+    long CommandedWheelDistanceDifferenceMicrometer; // integrated difference of the profile velocities since activation
+#endif
+
+#ifdef USE_TRACTION_CONTROL
+    void updateTractionControl(); // called by updateMotors()
+    void updateWheelTraction(EncoderMotor *aMotor, int aFloorMillimeterPerSecond, uint8_t aSlipEvent);
+    uint8_t getAndClearTractionEvents();
+    volatile uint8_t TractionEvents; // TRACTION_EVENT_* bits, cleared only by getAndClearTractionEvents()
+    unsigned long NextTractionControlMillis;
+    unsigned long TractionStallStartMillis;
+    bool TractionStallIsDetected; // IMU sees no movement, TractionStallStartMillis is valid
+#endif
+
+#ifdef USE_WHEEL_SLIP_CONTROL
+    /*
+     * The follower motors are initialized by the sketch, e.g. with rightFollowerCarMotors[0].init(<pins>).
+     * Only 2 motors can use attachEncoderInterrupt(), so the sketch must call handleEncoderInterrupt() of the other motors
+     * by its own interrupts, e.g. pin change interrupts. With USE_QUADRATURE_ENCODER, it must call setQuadratureEncoderPins() of them too.
+     */
+    void startFollowerMotors(); // called by updateMotors()
+    void updateFollowerMotors(); // called by updateMotors()
+    void updateFollowerMotorsOfOneSide(EncoderMotor *aLeadingMotor, EncoderMotor *aFollowerMotors);
+    void setWheelSlipCorrection(EncoderMotor *aMotor, unsigned int aSideDistanceMillimeter);
+    EncoderMotor rightFollowerCarMotors[CAR_NUMBER_OF_FOLLOWER_MOTORS_PER_SIDE]; // e.g. right rear wheel
+    EncoderMotor leftFollowerCarMotors[CAR_NUMBER_OF_FOLLOWER_MOTORS_PER_SIDE];
+#endif
+
+#ifdef USE_MOTOR_CONTROL_TIMER_INTERRUPT
+    /*
+     * After start, updateMotors() called by the sketch only returns the state and the blocking functions just wait.
+     * All functions of this class, which change motor values, hold the lock while changing them.
+     * Use lock and unlock if the sketch changes values of the motors directly or accesses the I2C bus of the IMU or the motor shield.
+     */
+    void startMotorControlTimerInterrupt();
+    void stopMotorControlTimerInterrupt();
+    void handleMotorControlTimerInterrupt();
+    void lockMotorControlTimerInterrupt();
+    void unlockMotorControlTimerInterrupt();
+    volatile bool MotorControlTimerInterruptIsRunning;
+    volatile bool IsInMotorControlTimerInterrupt;
+    volatile uint8_t MotorControlTimerLockCount; // != 0 -> foreground is changing motor values, so the control step is skipped
+#endif
+
+#ifdef USE_MOTION_COMMAND_QUEUE
+    /*
+     * The queue functions return false if queue is full.
+     * stop() does not clear the queue, use clearMotionCommandQueue() for it.
+     */
+    bool queueGoDistanceMillimeter(int aRequestedDistanceMillimeter);
+    bool queueGoDistanceMillimeter(uint8_t aRequestedSpeedPWM, int aRequestedDistanceMillimeter);
+    bool queueRotate(int aRotationDegrees, turn_direction_t aTurnDirection = TURN_IN_PLACE);
+    bool queueSetSpeedPWMWithRamp(uint8_t aRequestedSpeedPWM, uint8_t aRequestedDirection = DIRECTION_FORWARD);
+    bool queueWait(unsigned int aWaitMillis);
+    bool queueArc(int aRadiusMillimeter, int aRotationDegrees, uint8_t aRequestedDirection = DIRECTION_FORWARD);
+    bool queueMotionCommand(uint8_t aType, uint8_t aParameter, int aValue, int aRadius = 0);
+    void clearMotionCommandQueue();
+    bool hasPendingMotionCommands(); // true if a command is running or waiting in queue
+    void updateMotionCommandQueue(); // called by updateMotors()
+    void startMotionCommand();
+    bool isMotionCommandFinished();
+#  ifdef USE_ENCODER_MOTOR_CONTROL
+    bool extendRunningMotionCommand(MotionCommandStruct *aNextCommand);
+#  endif
+    MotionCommandStruct MotionCommandQueue[MOTION_COMMAND_QUEUE_SIZE];
+    volatile uint8_t MotionCommandQueueReadIndex; // free running, index in array is (Index & (MOTION_COMMAND_QUEUE_SIZE - 1))
+    volatile uint8_t MotionCommandQueueWriteIndex;
+    volatile bool MotionCommandIsRunning;
+    MotionCommandStruct RunningMotionCommand;
+    unsigned long MotionCommandStartMillis; // for MOTION_COMMAND_WAIT
+#endif
+
     /*
      * Start/Stop functions
      */
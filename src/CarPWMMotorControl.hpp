@@ -40,6 +40,12 @@
 #include "PWMDcMotor.hpp"
 
 #include "CarPWMMotorControl.h"
+#if defined(USE_LEARNED_BRAKING_DISTANCE)
+#include "BrakingDistanceModel.hpp"
+#endif
+#if defined(USE_CALIBRATION_STORE)
+#include "CalibrationStore.hpp"
+#endif
 
 /*
  * The Car Control instance to be used by the main program
@@ -48,10 +54,117 @@ CarPWMMotorControl RobotCarPWMMotorControl;
 
 //#define DEBUG // Only for development
 
+#ifdef USE_MOTOR_CONTROL_TIMER_INTERRUPT
+#  if !defined(ARDUINO_ARCH_HOST) && !(defined(__AVR__) && defined(TIMSK2))
+#error "USE_MOTOR_CONTROL_TIMER_INTERRUPT requires an AVR with Timer2"
+#  endif
+/*
+ * Functions which change motor values must not be interrupted by the control step
+ */
+#define LOCK_MOTOR_CONTROL_TIMER_INTERRUPT()    lockMotorControlTimerInterrupt()
+#define UNLOCK_MOTOR_CONTROL_TIMER_INTERRUPT()  unlockMotorControlTimerInterrupt()
+#else
+#define LOCK_MOTOR_CONTROL_TIMER_INTERRUPT()
+#define UNLOCK_MOTOR_CONTROL_TIMER_INTERRUPT()
+#endif
+
 CarPWMMotorControl::CarPWMMotorControl()
 { // @suppress("Class members should be properly initialized")
     //Serial.println("Constructor!");
+#ifdef USE_MOTOR_CONTROL_TIMER_INTERRUPT
+    MotorControlTimerInterruptIsRunning = false;
+    IsInMotorControlTimerInterrupt = false;
+    MotorControlTimerLockCount = 0;
+#endif
+#ifdef USE_DIFFERENTIAL_DRIVE_CONTROL
+    DifferentialDriveControlIsActive = false;
+#endif
+#ifdef USE_TRACTION_CONTROL
+    TractionEvents = 0;
+    TractionStallIsDetected = false;
+#endif
+#ifdef USE_MOTION_COMMAND_QUEUE
+    MotionCommandQueueReadIndex = 0;
+    MotionCommandQueueWriteIndex = 0;
+    MotionCommandIsRunning = false;
+#endif
+}
+
+#ifdef USE_MOTOR_CONTROL_TIMER_INTERRUPT
+CarPWMMotorControl *sPointerForMotorControlTimerISR;
+
+#  if defined(ARDUINO_ARCH_HOST)
+void handleMotorControlTimerISR()
+{
+    sPointerForMotorControlTimerISR->handleMotorControlTimerInterrupt();
+}
+#  else
+ISR(TIMER2_COMPA_vect)
+{
+    sPointerForMotorControlTimerISR->handleMotorControlTimerInterrupt();
+}
+#  endif
+
+/*
+ * On AVR Timer2 is used in CTC mode with prescaler 128, which gives 125 counts per millisecond at 16 MHz
+ */
+void CarPWMMotorControl::startMotorControlTimerInterrupt()
+{
+    sPointerForMotorControlTimerISR = this;
+    MotorControlTimerInterruptIsRunning = true;
+#  if defined(ARDUINO_ARCH_HOST)
+    startHostTimerInterrupt(MOTOR_CONTROL_TIMER_INTERRUPT_MILLIS * 1000, handleMotorControlTimerISR);
+#  else
+    TIMSK2 = 0;
+    TCCR2A = _BV(WGM21); // CTC mode
+    TCCR2B = _BV(CS22) | _BV(CS20); // prescaler 128
+    OCR2A = ((F_CPU / 128 / 1000) * MOTOR_CONTROL_TIMER_INTERRUPT_MILLIS) - 1;
+    TCNT2 = 0;
+    TIFR2 = _BV(OCF2A); // clear pending interrupt
+    TIMSK2 = _BV(OCIE2A);
+#  endif
+}
+
+void CarPWMMotorControl::stopMotorControlTimerInterrupt()
+{
+#  if defined(ARDUINO_ARCH_HOST)
+    stopHostTimerInterrupt();
+#  else
+    TIMSK2 = 0;
+#  endif
+    MotorControlTimerInterruptIsRunning = false;
+}
+
+/*
+ * Runs the control step with interrupts enabled, since encoder interrupts, millis() and Wire must work during it.
+ * The step is skipped if it is still running from the last interrupt or if the foreground holds the lock.
+ */
+void CarPWMMotorControl::handleMotorControlTimerInterrupt()
+{
+    if (IsInMotorControlTimerInterrupt || MotorControlTimerLockCount != 0)
+    {
+        return;
+    }
+    IsInMotorControlTimerInterrupt = true;
+    interrupts();
+    updateMotors();
+    noInterrupts();
+    IsInMotorControlTimerInterrupt = false;
+}
+
+/*
+ * Calls can be nested
+ */
+void CarPWMMotorControl::lockMotorControlTimerInterrupt()
+{
+    MotorControlTimerLockCount++;
+}
+
+void CarPWMMotorControl::unlockMotorControlTimerInterrupt()
+{
+    MotorControlTimerLockCount--;
 }
+#endif // USE_MOTOR_CONTROL_TIMER_INTERRUPT
 
 #ifdef USE_MPU6050_IMU
 /*
@@ -263,9 +376,11 @@ bool CarPWMMotorControl::checkAndHandleDirectionChange(uint8_t aRequestedDirecti
  */
 void CarPWMMotorControl::setSpeedPWM(uint8_t aRequestedSpeedPWM, uint8_t aRequestedDirection)
 {
+    LOCK_MOTOR_CONTROL_TIMER_INTERRUPT();
     checkAndHandleDirectionChange(aRequestedDirection);
     rightCarMotor.setSpeedPWM(aRequestedSpeedPWM, aRequestedDirection);
     leftCarMotor.setSpeedPWM(aRequestedSpeedPWM, aRequestedDirection);
+    UNLOCK_MOTOR_CONTROL_TIMER_INTERRUPT();
 }
 
 /*
@@ -273,8 +388,10 @@ void CarPWMMotorControl::setSpeedPWM(uint8_t aRequestedSpeedPWM, uint8_t aReques
  */
 void CarPWMMotorControl::changeSpeedPWM(uint8_t aRequestedSpeedPWM)
 {
+    LOCK_MOTOR_CONTROL_TIMER_INTERRUPT();
     rightCarMotor.changeSpeedPWM(aRequestedSpeedPWM);
     leftCarMotor.changeSpeedPWM(aRequestedSpeedPWM);
+    UNLOCK_MOTOR_CONTROL_TIMER_INTERRUPT();
 }
 
 /*
@@ -284,6 +401,7 @@ void CarPWMMotorControl::changeSpeedPWM(uint8_t aRequestedSpeedPWM)
  */
 void CarPWMMotorControl::setSpeedPWM(uint8_t aRequestedSpeedPWM, uint8_t aRequestedDirection, int8_t aLeftRightSpeedPWM)
 {
+    LOCK_MOTOR_CONTROL_TIMER_INTERRUPT();
     checkAndHandleDirectionChange(aRequestedDirection);
 #ifdef USE_ENCODER_MOTOR_CONTROL
     EncoderMotor *tMotorWithModifiedSpeedPWM;
@@ -310,6 +428,7 @@ void CarPWMMotorControl::setSpeedPWM(uint8_t aRequestedSpeedPWM, uint8_t aReques
     {
         tMotorWithModifiedSpeedPWM->setSpeedPWM(0, aRequestedDirection);
     }
+    UNLOCK_MOTOR_CONTROL_TIMER_INTERRUPT();
 }
 
 /*
@@ -317,8 +436,10 @@ void CarPWMMotorControl::setSpeedPWM(uint8_t aRequestedSpeedPWM, uint8_t aReques
  */
 void CarPWMMotorControl::setSpeedPWM(int aRequestedSpeedPWM)
 {
+    LOCK_MOTOR_CONTROL_TIMER_INTERRUPT();
     rightCarMotor.setSpeedPWM(aRequestedSpeedPWM);
     leftCarMotor.setSpeedPWM(aRequestedSpeedPWM);
+    UNLOCK_MOTOR_CONTROL_TIMER_INTERRUPT();
 }
 
 uint8_t CarPWMMotorControl::getCarDirectionOrBrakeMode()
@@ -326,17 +447,338 @@ uint8_t CarPWMMotorControl::getCarDirectionOrBrakeMode()
     return CarDirectionOrBrakeMode;
 }
 
+/*
+ * Reads the current calibration record. If no record was written until now, the values of the fixed layout are read.
+ */
 void CarPWMMotorControl::readMotorValuesFromEeprom()
 {
+#if defined(USE_CALIBRATION_STORE) && defined(E2END)
+    CalibrationStore tCalibrationStore;
+    CalibrationRecordStruct tCalibrationRecord;
+    if (tCalibrationStore.readRecord(&tCalibrationRecord))
+    {
+        setValuesFromCalibrationRecord(&tCalibrationRecord);
+        return;
+    }
+#endif
     leftCarMotor.readMotorValuesFromEeprom(0);
     rightCarMotor.readMotorValuesFromEeprom(1);
+#if defined(USE_SPEED_PWM_TABLE) && defined(E2END)
+    leftCarMotor.readSpeedPWMTableFromEeprom(0);
+    rightCarMotor.readSpeedPWMTableFromEeprom(1);
+#endif
+#if defined(USE_SPEED_CONTROL_AUTOTUNE) && defined(E2END)
+    leftCarMotor.readSpeedControlGainsFromEeprom(0);
+    rightCarMotor.readSpeedControlGainsFromEeprom(1);
+#endif
 }
 
+/*
+ * Writes a new calibration record, if values have changed since the last write.
+ * It is safe to call this function after each change of a value, e.g. by the GUI.
+ */
 void CarPWMMotorControl::writeMotorValuesToEeprom()
 {
+#if defined(USE_CALIBRATION_STORE) && defined(E2END)
+    CalibrationStore tCalibrationStore;
+    CalibrationRecordStruct tCalibrationRecord;
+    tCalibrationStore.readRecord(&tCalibrationRecord); // Keeps the values, which are not available with the current options
+    getValuesForCalibrationRecord(&tCalibrationRecord);
+    tCalibrationStore.writeRecord(&tCalibrationRecord);
+#else
     leftCarMotor.writeMotorValuesToEeprom(0);
     rightCarMotor.writeMotorValuesToEeprom(1);
+#  if defined(USE_SPEED_PWM_TABLE) && defined(E2END)
+    leftCarMotor.writeSpeedPWMTableToEeprom(0);
+    rightCarMotor.writeSpeedPWMTableToEeprom(1);
+#  endif
+#  if defined(USE_SPEED_CONTROL_AUTOTUNE) && defined(E2END)
+    leftCarMotor.writeSpeedControlGainsToEeprom(0);
+    rightCarMotor.writeSpeedControlGainsToEeprom(1);
+#  endif
+#endif
+}
+
+#ifdef USE_CALIBRATION_STORE
+/*
+ * Values of 0 are not calibrated and do not change the current values.
+ * A speed PWM table with entry 0 equal 0 is not calibrated and resets the table of the motor.
+ */
+void CarPWMMotorControl::setValuesFromCalibrationRecord(CalibrationRecordStruct *aCalibrationRecord)
+{
+#ifdef USE_ENCODER_MOTOR_CONTROL
+    EncoderMotor *tMotors[CALIBRATION_RECORD_NUMBER_OF_MOTORS] = { &leftCarMotor, &rightCarMotor };
+#else
+    PWMDcMotor *tMotors[CALIBRATION_RECORD_NUMBER_OF_MOTORS] = { &leftCarMotor, &rightCarMotor };
+#endif
+    for (uint_fast8_t i = 0; i < CALIBRATION_RECORD_NUMBER_OF_MOTORS; ++i)
+    {
+        if (aCalibrationRecord->DriveSpeedPWM[i] != 0)
+        {
+            tMotors[i]->setDriveSpeedAndSpeedCompensationPWM(aCalibrationRecord->DriveSpeedPWM[i],
+                    aCalibrationRecord->SpeedPWMCompensation[i]);
+        }
+#ifdef USE_SPEED_PWM_TABLE
+        memcpy(tMotors[i]->SpeedPWMTable, aCalibrationRecord->SpeedPWMTable[i], sizeof(tMotors[i]->SpeedPWMTable));
+#endif
+#ifdef USE_SPEED_CONTROL_AUTOTUNE
+        if (aCalibrationRecord->SpeedControlKiTimes256[i] != 0)
+        {
+            tMotors[i]->setSpeedControlGains(aCalibrationRecord->SpeedControlKpTimes256[i], aCalibrationRecord->SpeedControlKiTimes256[i]);
+        }
+#endif
+    }
+#ifdef USE_MPU6050_IMU
+    if (aCalibrationRecord->AcceleratorForwardOffset != 0)
+    {
+        IMUData.setSpeedAndTurnOffsets(aCalibrationRecord->AcceleratorForwardOffset, aCalibrationRecord->GyroscopePanOffset);
+    }
+#endif
+}
+
+/*
+ * Overwrites the values of the record, which are available with the current options.
+ * IMU offsets are only overwritten, if they are already acquired.
+ */
+void CarPWMMotorControl::getValuesForCalibrationRecord(CalibrationRecordStruct *aCalibrationRecord)
+{
+#ifdef USE_ENCODER_MOTOR_CONTROL
+    EncoderMotor *tMotors[CALIBRATION_RECORD_NUMBER_OF_MOTORS] = { &leftCarMotor, &rightCarMotor };
+#else
+    PWMDcMotor *tMotors[CALIBRATION_RECORD_NUMBER_OF_MOTORS] = { &leftCarMotor, &rightCarMotor };
+#endif
+    for (uint_fast8_t i = 0; i < CALIBRATION_RECORD_NUMBER_OF_MOTORS; ++i)
+    {
+        aCalibrationRecord->DriveSpeedPWM[i] = tMotors[i]->DriveSpeedPWM;
+        aCalibrationRecord->SpeedPWMCompensation[i] = tMotors[i]->SpeedPWMCompensation;
+#ifdef USE_SPEED_PWM_TABLE
+        memcpy(aCalibrationRecord->SpeedPWMTable[i], tMotors[i]->SpeedPWMTable, sizeof(tMotors[i]->SpeedPWMTable));
+#endif
+#ifdef USE_SPEED_CONTROL_AUTOTUNE
+        aCalibrationRecord->SpeedControlKpTimes256[i] = tMotors[i]->SpeedControlKpTimes256;
+        aCalibrationRecord->SpeedControlKiTimes256[i] = tMotors[i]->SpeedControlKiTimes256;
+#endif
+    }
+#ifdef USE_MPU6050_IMU
+    if (IMUData.AcceleratorForwardOffset != 0)
+    {
+        aCalibrationRecord->AcceleratorForwardOffset = IMUData.AcceleratorForwardOffset;
+        aCalibrationRecord->GyroscopePanOffset = IMUData.GyroscopePanOffset;
+    }
+#endif
+}
+#endif // USE_CALIBRATION_STORE
+
+#ifdef USE_SPEED_PWM_TABLE
+/*
+ * Sweeps PWM of both motors from 0 to MAX_SPEED_PWM and back for forward and backward direction and fills the speed PWM tables.
+ * Takes around 20 seconds and the car drives around 4 meter forward and then backward.
+ * Tables are not stored in EEPROM, use writeMotorValuesToEeprom() for this.
+ */
+void CarPWMMotorControl::calibrateSpeedPWMTables(void (*aLoopCallback)(void))
+{
+    LOCK_MOTOR_CONTROL_TIMER_INTERRUPT(); // motors are controlled directly here
+    for (uint_fast8_t tDirection = DIRECTION_FORWARD; tDirection <= DIRECTION_BACKWARD; ++tDirection)
+    {
+        resetEncoderControlValues();
+        for (uint_fast8_t tSweep = 0; tSweep < 2; ++tSweep)
+        {
+            bool tIsRampUp = (tSweep == 0);
+            rightCarMotor.startSpeedPWMTableCalibration(tDirection, tIsRampUp);
+            leftCarMotor.startSpeedPWMTableCalibration(tDirection, tIsRampUp);
+            uint8_t tSpeedPWM = (tIsRampUp ? 1 : MAX_SPEED_PWM);
+            while (true)
+            {
+                rightCarMotor.setSpeedPWM(tSpeedPWM, tDirection);
+                leftCarMotor.setSpeedPWM(tSpeedPWM, tDirection);
+                /*
+                 * Active delay
+                 */
+                uint32_t tStartMillis = millis();
+                do
+                {
+                    if (aLoopCallback != NULL)
+                    {
+                        aLoopCallback();
+                    }
+                } while (millis() - tStartMillis < SPEED_PWM_TABLE_CALIBRATION_STEP_MILLIS);
+                rightCarMotor.addSpeedPWMTableCalibrationValue(tSpeedPWM);
+                leftCarMotor.addSpeedPWMTableCalibrationValue(tSpeedPWM);
+
+                if (tSpeedPWM == (tIsRampUp ? MAX_SPEED_PWM : 1))
+                {
+                    break;
+                }
+                tSpeedPWM += (tIsRampUp ? 1 : -1);
+            }
+        }
+        stop(MOTOR_BRAKE);
+        delay(200);
+        rightCarMotor.endSpeedPWMTableCalibration(tDirection);
+        leftCarMotor.endSpeedPWMTableCalibration(tDirection);
+    }
+    UNLOCK_MOTOR_CONTROL_TIMER_INTERRUPT();
+}
+#endif
+
+#ifdef USE_MOTOR_MODEL_IDENTIFICATION
+/*
+ * Identifies the model of both motors for forward and backward direction, see MotorModelIdentification.h.
+ * Call setVINMillivolt() before, since the model is identified for the PWM before the battery voltage compensation.
+ * Takes around 20 seconds and the car drives around 2 meter forward and then backward.
+ * With USE_SPEED_PWM_TABLE, the speed PWM tables are filled from the models.
+ * Print the results with rightCarMotor.printMotorModel(&Serial). Models are not stored in EEPROM.
+ */
+void CarPWMMotorControl::identifyMotorModels(void (*aLoopCallback)(void))
+{
+    EncoderMotor *tMotors[2] = { &rightCarMotor, &leftCarMotor };
+    MotorModelIdentification tIdentifications[2]; // Sample buffers are only required while identifying
+    EncoderSnapshotStruct tSnapshot;
+    // Above this PWM, the output is clipped by the compensation of a low battery voltage
+    uint16_t tMaxSpeedPWM = (MAX_SPEED_PWM * 128) / PWMDcMotor::VINCompensationFactorTimes128;
+    if (tMaxSpeedPWM > MAX_SPEED_PWM)
+    {
+        tMaxSpeedPWM = MAX_SPEED_PWM;
+    }
+
+    LOCK_MOTOR_CONTROL_TIMER_INTERRUPT(); // motors are controlled directly here
+    for (uint_fast8_t tDirection = DIRECTION_FORWARD; tDirection <= DIRECTION_BACKWARD; ++tDirection)
+    {
+        /*
+         * Bisection of the start PWM of both motors. Each probe starts from standstill.
+         */
+        tIdentifications[0].startStartSpeedPWMSearch(tMaxSpeedPWM);
+        tIdentifications[1].startStartSpeedPWMSearch(tMaxSpeedPWM);
+        while (true)
+        {
+            bool tSearchIsRunning = false;
+            unsigned int tStartEncoderCount[2];
+            for (uint_fast8_t i = 0; i < 2; ++i)
+            {
+                tMotors[i]->getEncoderSnapshot(&tSnapshot);
+                tStartEncoderCount[i] = tSnapshot.EncoderCount;
+                uint8_t tSpeedPWM = tIdentifications[i].getStartProbeSpeedPWM();
+                if (tSpeedPWM != 0)
+                {
+                    tMotors[i]->setSpeedPWM(tSpeedPWM, tDirection);
+                    tSearchIsRunning = true;
+                }
+            }
+            if (!tSearchIsRunning)
+            {
+                break;
+            }
+            uint32_t tStartMillis = millis();
+            do
+            {
+                if (aLoopCallback != NULL)
+                {
+                    aLoopCallback();
+                }
+            } while (millis() - tStartMillis < MOTOR_MODEL_START_PROBE_MILLIS);
+            for (uint_fast8_t i = 0; i < 2; ++i)
+            {
+                tMotors[i]->getEncoderSnapshot(&tSnapshot);
+                tIdentifications[i].addStartProbeResult(tSnapshot.EncoderCount != tStartEncoderCount[i]);
+            }
+            stop(MOTOR_BRAKE);
+            delay(MOTOR_MODEL_STANDSTILL_MILLIS);
+        }
+
+        /*
+         * Steps from start PWM to MAX_SPEED_PWM without stop in between
+         */
+        for (uint_fast8_t tStepIndex = 0; tStepIndex < MOTOR_MODEL_NUMBER_OF_STEPS; ++tStepIndex)
+        {
+            unsigned long tStepStartMicros = micros();
+            for (uint_fast8_t i = 0; i < 2; ++i)
+            {
+                tMotors[i]->setSpeedPWM(tIdentifications[i].getStepSpeedPWM(tStepIndex), tDirection);
+                tIdentifications[i].startStep(tStepIndex, tStepStartMicros);
+            }
+            uint32_t tStartMillis = millis();
+            do
+            {
+                if (aLoopCallback != NULL)
+                {
+                    aLoopCallback();
+                }
+                rightCarMotor.addMotorModelSample(&tIdentifications[0]);
+                leftCarMotor.addMotorModelSample(&tIdentifications[1]);
+            } while (millis() - tStartMillis < MOTOR_MODEL_STEP_MILLIS);
+            tIdentifications[0].endStep();
+            tIdentifications[1].endStep();
+        }
+        stop(MOTOR_BRAKE);
+        delay(MOTOR_MODEL_STANDSTILL_MILLIS);
+        tIdentifications[0].computeModel(&rightCarMotor.MotorModel[tDirection]);
+        tIdentifications[1].computeModel(&leftCarMotor.MotorModel[tDirection]);
+    }
+#  ifdef USE_SPEED_PWM_TABLE
+    rightCarMotor.setSpeedPWMTableFromMotorModel();
+    leftCarMotor.setSpeedPWMTableFromMotorModel();
+#  endif
+    UNLOCK_MOTOR_CONTROL_TIMER_INTERRUPT();
+}
+#endif
+
+#ifdef USE_SPEED_CONTROL_AUTOTUNE
+/*
+ * Autotunes the speed control gains of both motors at aSetpointMillimeterPerSecond by relay oscillation, see SpeedControlAutotune.h.
+ * The car drives forward for around 3 seconds, i.e. around 1 meter at DEFAULT_MILLIMETER_PER_SECOND.
+ * The gains of a motor are only changed, if its oscillation was finished.
+ * Store them with writeMotorValuesToEeprom() and print them with rightCarMotor.printSpeedControlGains(&Serial).
+ * @return true if the gains of both motors are changed
+ */
+bool CarPWMMotorControl::autotuneSpeedControl(unsigned int aSetpointMillimeterPerSecond, void (*aLoopCallback)(void))
+{
+    EncoderMotor *tMotors[2] = { &rightCarMotor, &leftCarMotor };
+    SpeedControlAutotune tAutotunes[2];
+
+    LOCK_MOTOR_CONTROL_TIMER_INTERRUPT(); // motors are controlled directly here
+    resetEncoderControlValues();
+    for (uint_fast8_t i = 0; i < 2; ++i)
+    {
+        tMotors[i]->setSpeedPWM(tMotors[i]->getFeedForwardSpeedPWM(aSetpointMillimeterPerSecond, DIRECTION_FORWARD), DIRECTION_FORWARD);
+    }
+    uint32_t tStartMillis = millis();
+    do
+    {
+        if (aLoopCallback != NULL)
+        {
+            aLoopCallback();
+        }
+    } while (millis() - tStartMillis < SPEED_CONTROL_AUTOTUNE_SETTLE_MILLIS);
+
+    tStartMillis = millis();
+    for (uint_fast8_t i = 0; i < 2; ++i)
+    {
+        tAutotunes[i].start(aSetpointMillimeterPerSecond, tMotors[i]->getFeedForwardSpeedPWM(aSetpointMillimeterPerSecond, DIRECTION_FORWARD),
+                tStartMillis);
+    }
+    uint32_t tNextUpdateMillis = tStartMillis;
+    while ((!tAutotunes[0].isFinished() || !tAutotunes[1].isFinished())
+            && millis() - tStartMillis < SPEED_CONTROL_AUTOTUNE_TIMEOUT_MILLIS)
+    {
+        if (aLoopCallback != NULL)
+        {
+            aLoopCallback();
+        }
+        if ((long)(millis() - tNextUpdateMillis) >= 0)
+        {
+            tNextUpdateMillis += SPEED_CONTROL_INTERVAL_MILLIS;
+            rightCarMotor.updateSpeedControlAutotune(&tAutotunes[0]);
+            leftCarMotor.updateSpeedControlAutotune(&tAutotunes[1]);
+        }
+    }
+    stop(MOTOR_BRAKE);
+    delay(200);
+    bool tRightIsTuned = rightCarMotor.setSpeedControlGainsFromAutotune(&tAutotunes[0]);
+    bool tLeftIsTuned = leftCarMotor.setSpeedControlGainsFromAutotune(&tAutotunes[1]);
+    UNLOCK_MOTOR_CONTROL_TIMER_INTERRUPT();
+    return tRightIsTuned && tLeftIsTuned;
 }
+#endif
 
 /*
  * Stop car
@@ -344,9 +786,18 @@ void CarPWMMotorControl::writeMotorValuesToEeprom()
  */
 void CarPWMMotorControl::stop(uint8_t aStopMode)
 {
+    LOCK_MOTOR_CONTROL_TIMER_INTERRUPT();
     rightCarMotor.stop(aStopMode);
     leftCarMotor.stop(aStopMode);
+#ifdef USE_WHEEL_SLIP_CONTROL
+    for (uint_fast8_t i = 0; i < CAR_NUMBER_OF_FOLLOWER_MOTORS_PER_SIDE; ++i)
+    {
+        rightFollowerCarMotors[i].stop(aStopMode);
+        leftFollowerCarMotors[i].stop(aStopMode);
+    }
+#endif
     CarDirectionOrBrakeMode = rightCarMotor.CurrentDirectionOrBrakeMode; // get right stopMode, STOP_MODE_KEEP is evaluated here
+    UNLOCK_MOTOR_CONTROL_TIMER_INTERRUPT();
 }
 
 /*
@@ -356,14 +807,30 @@ void CarPWMMotorControl::setStopMode(uint8_t aStopMode)
 {
     rightCarMotor.setStopMode(aStopMode);
     leftCarMotor.setStopMode(aStopMode);
+#ifdef USE_WHEEL_SLIP_CONTROL
+    for (uint_fast8_t i = 0; i < CAR_NUMBER_OF_FOLLOWER_MOTORS_PER_SIDE; ++i)
+    {
+        rightFollowerCarMotors[i].setStopMode(aStopMode);
+        leftFollowerCarMotors[i].setStopMode(aStopMode);
+    }
+#endif
 }
 
 void CarPWMMotorControl::resetEncoderControlValues()
 {
+    LOCK_MOTOR_CONTROL_TIMER_INTERRUPT();
 #ifdef USE_ENCODER_MOTOR_CONTROL
     rightCarMotor.resetEncoderControlValues();
     leftCarMotor.resetEncoderControlValues();
 #endif
+#ifdef USE_WHEEL_SLIP_CONTROL
+    for (uint_fast8_t i = 0; i < CAR_NUMBER_OF_FOLLOWER_MOTORS_PER_SIDE; ++i)
+    {
+        rightFollowerCarMotors[i].resetEncoderControlValues();
+        leftFollowerCarMotors[i].resetEncoderControlValues();
+    }
+#endif
+    UNLOCK_MOTOR_CONTROL_TIMER_INTERRUPT();
 }
 
 #ifdef USE_MPU6050_IMU
@@ -396,6 +863,131 @@ void CarPWMMotorControl::updateIMUData()
         }
     }
 }
+
+#  ifdef USE_TRACTION_CONTROL
+/*
+ * Compares the encoder speed of each wheel with the speed of the floor below it, which is computed from the IMU data.
+ * The yaw rate of the gyroscope is more reliable than the speed of the accelerator, which is only reset at start of a distance drive.
+ */
+void CarPWMMotorControl::updateTractionControl()
+{
+    unsigned long tMillis = millis();
+    if (tMillis < NextTractionControlMillis || IMUData.AcceleratorForwardOffset == 0)
+    {
+        return;
+    }
+    NextTractionControlMillis = tMillis + TRACTION_CONTROL_INTERVAL_MILLIS;
+
+    int tCarMillimeterPerSecond = IMUData.getSpeedCmPerSecond() * 10;
+    /*
+     * GyroscopePan has 131 LSB per degree per second, a turn of 1 degree gives a wheel distance difference of FACTOR_DEGREE_TO_MILLIMETER_DEFAULT.
+     * Positive is a left turn, i.e. the right wheel is faster.
+     */
+    int tHalfDifferenceMillimeterPerSecond = ((long) ((int16_t) IMUData.GyroscopePan.Word)
+            * (long) (FACTOR_DEGREE_TO_MILLIMETER_DEFAULT * GYRO_RAW_TO_DEGREE_PER_SECOND_FOR_250DPS_RANGE * 32768)) >> 16;
+    updateWheelTraction(&rightCarMotor, tCarMillimeterPerSecond + tHalfDifferenceMillimeterPerSecond, TRACTION_EVENT_SLIP_RIGHT);
+    updateWheelTraction(&leftCarMotor, tCarMillimeterPerSecond - tHalfDifferenceMillimeterPerSecond, TRACTION_EVENT_SLIP_LEFT);
+
+    /*
+     * Stall detection
+     */
+    if ((rightCarMotor.MotorRampState == MOTOR_STATE_RAMP_UP || rightCarMotor.MotorRampState == MOTOR_STATE_DRIVE
+            || leftCarMotor.MotorRampState == MOTOR_STATE_RAMP_UP || leftCarMotor.MotorRampState == MOTOR_STATE_DRIVE)
+            && abs(tCarMillimeterPerSecond) < TRACTION_CONTROL_STALL_MILLIMETER_PER_SECOND
+            && abs(tHalfDifferenceMillimeterPerSecond) < TRACTION_CONTROL_STALL_MILLIMETER_PER_SECOND)
+    {
+        if (!TractionStallIsDetected)
+        {
+            TractionStallIsDetected = true;
+            TractionStallStartMillis = tMillis;
+        }
+        else if (tMillis - TractionStallStartMillis >= TRACTION_CONTROL_STALL_MILLIS)
+        {
+            TractionStallIsDetected = false;
+            TractionEvents |= TRACTION_EVENT_STALL;
+            CarRequestedRotationDegrees = 0;
+            CarRequestedDistanceMillimeter = 0;
+#    ifdef USE_MOTION_COMMAND_QUEUE
+            clearMotionCommandQueue();
+#    endif
+            stop(MOTOR_BRAKE);
+        }
+    }
+    else
+    {
+        TractionStallIsDetected = false;
+    }
+}
+
+/*
+ * @param aFloorMillimeterPerSecond Signed speed of the floor below the wheel, positive is forward
+ */
+void CarPWMMotorControl::updateWheelTraction(EncoderMotor *aMotor, int aFloorMillimeterPerSecond, uint8_t aSlipEvent)
+{
+    if (aMotor->MotorRampState != MOTOR_STATE_RAMP_UP && aMotor->MotorRampState != MOTOR_STATE_DRIVE)
+    {
+        aMotor->TractionControlSpeedPWMLimit = 0;
+        aMotor->TractionControlSlipCount = 0;
+        return;
+    }
+    EncoderSnapshotStruct tSnapshot;
+    aMotor->getEncoderSnapshot(&tSnapshot);
+    if (tSnapshot.EncoderCount < 2 * ENCODER_COUNTS_PER_SLOT)
+    {
+        return; // no valid period after start
+    }
+    int tWheelMillimeterPerSecond = aMotor->getSpeedMillimeterPerSecond(&tSnapshot);
+    if (aMotor->LastDirection == DIRECTION_BACKWARD)
+    {
+        aFloorMillimeterPerSecond = -aFloorMillimeterPerSecond;
+    }
+    if (tWheelMillimeterPerSecond - aFloorMillimeterPerSecond
+            > TRACTION_CONTROL_SLIP_MILLIMETER_PER_SECOND + (tWheelMillimeterPerSecond / 16))
+    {
+        if (aMotor->TractionControlSlipCount < TRACTION_CONTROL_SLIP_INTERVALS)
+        {
+            aMotor->TractionControlSlipCount++;
+        }
+        if (aMotor->TractionControlSlipCount >= TRACTION_CONTROL_SLIP_INTERVALS)
+        {
+            TractionEvents |= aSlipEvent;
+            uint8_t tSpeedPWMLimit = aMotor->CurrentSpeedPWM - (aMotor->CurrentSpeedPWM / 4);
+            if (tSpeedPWMLimit < DEFAULT_START_SPEED_PWM)
+            {
+                tSpeedPWMLimit = DEFAULT_START_SPEED_PWM;
+            }
+            aMotor->TractionControlSpeedPWMLimit = tSpeedPWMLimit;
+        }
+    }
+    else
+    {
+        aMotor->TractionControlSlipCount = 0;
+        if (aMotor->TractionControlSpeedPWMLimit != 0)
+        {
+            if (aMotor->TractionControlSpeedPWMLimit > MAX_SPEED_PWM - TRACTION_CONTROL_RECOVERY_PWM)
+            {
+                aMotor->TractionControlSpeedPWMLimit = 0;
+            }
+            else
+            {
+                aMotor->TractionControlSpeedPWMLimit += TRACTION_CONTROL_RECOVERY_PWM;
+            }
+        }
+    }
+}
+
+/*
+ * @return TRACTION_EVENT_* bits, which occurred since the last call
+ */
+uint8_t CarPWMMotorControl::getAndClearTractionEvents()
+{
+    LOCK_MOTOR_CONTROL_TIMER_INTERRUPT();
+    uint8_t tTractionEvents = TractionEvents;
+    TractionEvents = 0;
+    UNLOCK_MOTOR_CONTROL_TIMER_INTERRUPT();
+    return tTractionEvents;
+}
+#  endif // USE_TRACTION_CONTROL
 #endif // USE_MPU6050_IMU
 
 /*
@@ -418,9 +1010,37 @@ void stopMotorAfter1Second()
  */
 bool CarPWMMotorControl::updateMotors()
 {
+#ifdef USE_MOTOR_CONTROL_TIMER_INTERRUPT
+    if (MotorControlTimerInterruptIsRunning && !IsInMotorControlTimerInterrupt)
+    {
+        yield(); // for the blocking functions, which call us in a loop
+        // the control step is done by the timer interrupt, which may not yet have started the motors
+#  ifdef USE_MOTION_COMMAND_QUEUE
+        return (!isStopped() || rightCarMotor.MotorRampState == MOTOR_STATE_START || leftCarMotor.MotorRampState == MOTOR_STATE_START
+                || hasPendingMotionCommands());
+#  else
+        return (!isStopped() || rightCarMotor.MotorRampState == MOTOR_STATE_START || leftCarMotor.MotorRampState == MOTOR_STATE_START);
+#  endif
+    }
+#endif
+#ifdef USE_MOTION_COMMAND_QUEUE
+    updateMotionCommandQueue();
+#endif
+#ifdef USE_WHEEL_SLIP_CONTROL
+    startFollowerMotors();
+#endif
 #ifdef USE_MPU6050_IMU
     bool tReturnValue = !isStopped();
     updateIMUData();
+#ifdef USE_TRACTION_CONTROL
+    updateTractionControl();
+#endif
+#if defined(USE_LEARNED_BRAKING_DISTANCE) && !defined(USE_ENCODER_MOTOR_CONTROL)
+    if (BrakingModel.MeasurementIsRunning)
+    {
+        updateBrakingDistanceMeasurement();
+    }
+#endif
     if (CarRequestedRotationDegrees != 0)
     {
         /*
@@ -442,11 +1062,13 @@ bool CarPWMMotorControl::updateMotors()
             CarRequestedRotationDegrees = 0;
             tReturnValue = false;
         }
-        else if ((tCarTurnAngleHalfDegreesFromIMUForCompare + getTurnDistanceHalfDegree()) >= tRequestedRotationDegreesForCompare)
+        else if (rightCarMotor.CurrentDirectionOrBrakeMode != leftCarMotor.CurrentDirectionOrBrakeMode
+                && (tCarTurnAngleHalfDegreesFromIMUForCompare + getTurnDistanceHalfDegree()) >= tRequestedRotationDegreesForCompare)
         {
             //            Serial.print(getTurnDistanceHalfDegree());
             /*
              * Reduce SpeedPWM just before target angle is reached. If motors are not stopped, we run for extra 2 to 4 degree
+             * Not for arcs with both wheels in the same direction, since the same SpeedPWM for both wheels would end the turn.
              */
             changeSpeedPWM(rightCarMotor.DriveSpeedPWM / 2);
         }
@@ -478,11 +1100,17 @@ bool CarPWMMotorControl::updateMotors()
                 if (rightCarMotor.MotorRampState != MOTOR_STATE_RAMP_DOWN && (CarDistanceMillimeterFromIMU + tBrakingDistanceMillimeter) >= CarRequestedDistanceMillimeter)
                 {
                     // Start braking
+#ifdef USE_LEARNED_BRAKING_DISTANCE
+                    BrakingModel.startMeasurement(CarSpeedCmPerSecondFromIMU * 10, MOTOR_BRAKE, CarDistanceMillimeterFromIMU);
+#endif
                     startRampDown();
                 }
             }
 #endif // USE_ENCODER_MOTOR_CONTROL
         }
+#ifdef USE_DIFFERENTIAL_DRIVE_CONTROL
+        updateDifferentialDriveControl();
+#endif
         /*
          * In case of IMU distance driving only ramp up and down are managed by these calls
          */
@@ -491,27 +1119,495 @@ bool CarPWMMotorControl::updateMotors()
     }
 
 #else  // USE_MPU6050_IMU
+#ifdef USE_DIFFERENTIAL_DRIVE_CONTROL
+    updateDifferentialDriveControl();
+#endif
     bool tReturnValue = rightCarMotor.updateMotor();
     tReturnValue |= leftCarMotor.updateMotor();
 #endif // USE_MPU6050_IMU
 
+#ifdef USE_WHEEL_SLIP_CONTROL
+    updateFollowerMotors();
+#endif
+#ifdef USE_MOTION_COMMAND_QUEUE
+    tReturnValue |= hasPendingMotionCommands();
+#endif
     return tReturnValue;
     ;
 }
 
+#ifdef USE_DIFFERENTIAL_DRIVE_CONTROL
 /*
- * @return true if not stopped (motor expects another update)
+ * Right minus left wheel distance, each counted in its own direction. Positive is a left turn for forward driving.
+ * For straight runs with IMU, it is computed from the turn angle of the gyroscope.
  */
-bool CarPWMMotorControl::updateMotors(void (*aLoopCallback)(void))
+long CarPWMMotorControl::getWheelDistanceDifferenceMicrometer()
 {
-    if (aLoopCallback != NULL)
+#ifdef USE_MPU6050_IMU
+    if (rightCarMotor.LastDirection == leftCarMotor.LastDirection)
     {
-        aLoopCallback();
+        long tMicrometer = CarTurnAngleHalfDegreesFromIMU * (long)(FACTOR_DEGREE_TO_MILLIMETER_DEFAULT * 500);
+        if (rightCarMotor.LastDirection == DIRECTION_BACKWARD)
+        {
+            return -tMicrometer;
+        }
+        return tMicrometer;
     }
-    return updateMotors();
+#endif
+    return ((long)rightCarMotor.getDistanceMillimeter() - (long)leftCarMotor.getDistanceMillimeter()) * 1000;
 }
 
-void CarPWMMotorControl::delayAndUpdateMotors(unsigned int aDelayMillis)
+/*
+ * Runs every MOTION_PROFILE_INTERVAL_MILLIS as long as both wheels are driven by their motion profile.
+ * The wheel distance difference must follow the integrated difference of both profile velocities,
+ * which is 0 for straight runs and turns in place. PD control, the integral part is done by the speed control of each wheel.
+ * The D part is disabled by default, see DIFFERENTIAL_DRIVE_KV_TIMES_16.
+ */
+void CarPWMMotorControl::updateDifferentialDriveControl()
+{
+    uint8_t tRightState = rightCarMotor.MotorRampState;
+    uint8_t tLeftState = leftCarMotor.MotorRampState;
+    if (isStopped() || tRightState == MOTOR_STATE_STOPPED || tRightState == MOTOR_STATE_START || tLeftState == MOTOR_STATE_STOPPED
+            || tLeftState == MOTOR_STATE_START)
+    {
+        if (DifferentialDriveControlIsActive)
+        {
+            DifferentialDriveControlIsActive = false;
+            rightCarMotor.SpeedCorrectionMillimeterPerSecond = 0;
+            leftCarMotor.SpeedCorrectionMillimeterPerSecond = 0;
+        }
+        return;
+    }
+
+    unsigned long tMillis = millis();
+    if (!DifferentialDriveControlIsActive)
+    {
+        DifferentialDriveControlIsActive = true;
+        WheelDistanceDifferenceOffsetMicrometer = getWheelDistanceDifferenceMicrometer();
+        CommandedWheelDistanceDifferenceMicrometer = 0;
+        NextDifferentialDriveControlMillis = tMillis;
+    }
+    if (tMillis < NextDifferentialDriveControlMillis)
+    {
+        return;
+    }
+    NextDifferentialDriveControlMillis = tMillis + MOTION_PROFILE_INTERVAL_MILLIS;
+
+    int tCommandedSpeedDifference = (int)rightCarMotor.Profile.getVelocity() - (int)leftCarMotor.Profile.getVelocity();
+    CommandedWheelDistanceDifferenceMicrometer += (long)tCommandedSpeedDifference * MOTION_PROFILE_INTERVAL_MILLIS;
+    long tPositionErrorMillimeter = (CommandedWheelDistanceDifferenceMicrometer
+            - (getWheelDistanceDifferenceMicrometer() - WheelDistanceDifferenceOffsetMicrometer)) / 1000;
+    int tSpeedError = tCommandedSpeedDifference
+            - ((int)rightCarMotor.getSpeedMillimeterPerSecond() - (int)leftCarMotor.getSpeedMillimeterPerSecond());
+
+    long tCorrection = (tPositionErrorMillimeter * DIFFERENTIAL_DRIVE_KP_TIMES_16 + (long)tSpeedError * DIFFERENTIAL_DRIVE_KV_TIMES_16) / 16;
+    if (tCorrection > DIFFERENTIAL_DRIVE_MAX_CORRECTION)
+    {
+        tCorrection = DIFFERENTIAL_DRIVE_MAX_CORRECTION;
+    }
+    else if (tCorrection < -DIFFERENTIAL_DRIVE_MAX_CORRECTION)
+    {
+        tCorrection = -DIFFERENTIAL_DRIVE_MAX_CORRECTION;
+    }
+    rightCarMotor.SpeedCorrectionMillimeterPerSecond = tCorrection / 2;
+    leftCarMotor.SpeedCorrectionMillimeterPerSecond = -(tCorrection / 2);
+}
+#endif // USE_DIFFERENTIAL_DRIVE_CONTROL
+
+#ifdef USE_WHEEL_SLIP_CONTROL
+/*
+ * Must be called before the leading motors leave MOTOR_STATE_START,
+ * so that the encoder distances of all motors of a side start at the same time.
+ */
+void CarPWMMotorControl::startFollowerMotors()
+{
+    EncoderMotor *tLeadingMotor = &rightCarMotor;
+    EncoderMotor *tFollowerMotors = rightFollowerCarMotors;
+    for (uint_fast8_t tSide = 0; tSide < 2; ++tSide)
+    {
+        if (tLeadingMotor->MotorRampState == MOTOR_STATE_START)
+        {
+            tLeadingMotor->SlipCorrectionMillimeterPerSecond = 0;
+            for (uint_fast8_t i = 0; i < CAR_NUMBER_OF_FOLLOWER_MOTORS_PER_SIDE; ++i)
+            {
+                EncoderMotor *tFollowerMotor = &tFollowerMotors[i];
+                tFollowerMotor->initEncoderControlValues();
+                tFollowerMotor->initSpeedControl();
+                tFollowerMotor->SlipCorrectionMillimeterPerSecond = 0;
+                tFollowerMotor->NextRampChangeMillis = millis(); // compute first value now
+                tFollowerMotor->MotorRampState = MOTOR_STATE_START;
+            }
+        }
+        tLeadingMotor = &leftCarMotor;
+        tFollowerMotors = leftFollowerCarMotors;
+    }
+}
+
+void CarPWMMotorControl::updateFollowerMotors()
+{
+    updateFollowerMotorsOfOneSide(&rightCarMotor, rightFollowerCarMotors);
+    updateFollowerMotorsOfOneSide(&leftCarMotor, leftFollowerCarMotors);
+}
+
+/*
+ * The wheel with the shortest distance of a side is assumed to have grip.
+ * Each wheel, which is more than WHEEL_SLIP_THRESHOLD_MILLIMETER ahead, gets a velocity reduction proportional to the excess distance.
+ */
+void CarPWMMotorControl::setWheelSlipCorrection(EncoderMotor *aMotor, unsigned int aSideDistanceMillimeter)
+{
+    int tExcessMillimeter = (int)(aMotor->getDistanceMillimeter() - aSideDistanceMillimeter) - WHEEL_SLIP_THRESHOLD_MILLIMETER;
+    int tCorrection = 0;
+    if (tExcessMillimeter > 0)
+    {
+        tCorrection = -(int)(((long)tExcessMillimeter * WHEEL_SLIP_KP_TIMES_16) / 16);
+        if (tCorrection < -WHEEL_SLIP_MAX_CORRECTION)
+        {
+            tCorrection = -WHEEL_SLIP_MAX_CORRECTION;
+        }
+    }
+    aMotor->SlipCorrectionMillimeterPerSecond = tCorrection;
+}
+
+/*
+ * If the leading motor is controlled by its motion profile, each follower motor runs its own speed control with the profile velocity
+ * of the leading motor, reduced by its slip correction. Otherwise the PWM of the leading motor is copied.
+ * All new PWM values are computed first and then written in one go, so all wheels of a side get their new values at the same time.
+ */
+void CarPWMMotorControl::updateFollowerMotorsOfOneSide(EncoderMotor *aLeadingMotor, EncoderMotor *aFollowerMotors)
+{
+    unsigned long tMillis = millis();
+    uint8_t tLeadingState = aLeadingMotor->MotorRampState;
+    bool tLeadingMotorIsControlled = (tLeadingState != MOTOR_STATE_STOPPED && tLeadingState != MOTOR_STATE_START);
+    uint8_t tNewSpeedPWM[CAR_NUMBER_OF_FOLLOWER_MOTORS_PER_SIDE];
+    bool tHasNewSpeedPWM[CAR_NUMBER_OF_FOLLOWER_MOTORS_PER_SIDE];
+
+    unsigned int tSideDistanceMillimeter = aLeadingMotor->getDistanceMillimeter();
+    for (uint_fast8_t i = 0; i < CAR_NUMBER_OF_FOLLOWER_MOTORS_PER_SIDE; ++i)
+    {
+        unsigned int tDistanceMillimeter = aFollowerMotors[i].getDistanceMillimeter();
+        if (tSideDistanceMillimeter > tDistanceMillimeter)
+        {
+            tSideDistanceMillimeter = tDistanceMillimeter;
+        }
+    }
+    if (tLeadingMotorIsControlled)
+    {
+        setWheelSlipCorrection(aLeadingMotor, tSideDistanceMillimeter);
+    }
+    else
+    {
+        aLeadingMotor->SlipCorrectionMillimeterPerSecond = 0;
+    }
+
+    for (uint_fast8_t i = 0; i < CAR_NUMBER_OF_FOLLOWER_MOTORS_PER_SIDE; ++i)
+    {
+        EncoderMotor *tFollowerMotor = &aFollowerMotors[i];
+        tHasNewSpeedPWM[i] = true;
+        if (tLeadingState == MOTOR_STATE_STOPPED)
+        {
+            // Leading motor is stopped or directly set by setSpeedPWM()
+            tNewSpeedPWM[i] = aLeadingMotor->CurrentSpeedPWM;
+            tFollowerMotor->SlipCorrectionMillimeterPerSecond = 0;
+        }
+        else if (tLeadingMotorIsControlled && tMillis >= tFollowerMotor->NextRampChangeMillis)
+        {
+            tFollowerMotor->NextRampChangeMillis = tMillis + MOTION_PROFILE_INTERVAL_MILLIS;
+            setWheelSlipCorrection(tFollowerMotor, tSideDistanceMillimeter);
+            int tVelocity = (int)aLeadingMotor->Profile.getVelocity() + tFollowerMotor->SlipCorrectionMillimeterPerSecond;
+#ifdef USE_DIFFERENTIAL_DRIVE_CONTROL
+            tVelocity += aLeadingMotor->SpeedCorrectionMillimeterPerSecond;
+#endif
+            if (tVelocity < 0)
+            {
+                tVelocity = 0;
+            }
+            tFollowerMotor->checkAndHandleDirectionChange(aLeadingMotor->LastDirection); // required for the feed forward value
+            EncoderSnapshotStruct tSnapshot;
+            tFollowerMotor->getEncoderSnapshot(&tSnapshot);
+            if (tFollowerMotor->hasSpeedFeedback(&tSnapshot, tMillis))
+            {
+                tNewSpeedPWM[i] = tFollowerMotor->computeSpeedControlPWM(tVelocity, aLeadingMotor->Profile.Acceleration);
+            }
+            else
+            {
+                tNewSpeedPWM[i] = tFollowerMotor->getFeedForwardSpeedPWM(
+                        EncoderMotor::getFeedForwardMillimeterPerSecond(tVelocity, aLeadingMotor->Profile.Acceleration),
+                        aLeadingMotor->LastDirection);
+                if (tNewSpeedPWM[i] < SPEED_CONTROL_MIN_PWM)
+                {
+                    tNewSpeedPWM[i] = SPEED_CONTROL_MIN_PWM;
+                }
+            }
+            tFollowerMotor->MotorRampState = tLeadingState;
+        }
+        else
+        {
+            tHasNewSpeedPWM[i] = false;
+        }
+    }
+
+    for (uint_fast8_t i = 0; i < CAR_NUMBER_OF_FOLLOWER_MOTORS_PER_SIDE; ++i)
+    {
+        if (tHasNewSpeedPWM[i])
+        {
+            EncoderMotor *tFollowerMotor = &aFollowerMotors[i];
+            if (tNewSpeedPWM[i] != 0)
+            {
+                tFollowerMotor->setSpeedPWM(tNewSpeedPWM[i], aLeadingMotor->LastDirection);
+            }
+            else if (!tFollowerMotor->isStopped() || tFollowerMotor->MotorRampState != MOTOR_STATE_STOPPED)
+            {
+                tFollowerMotor->stop(aLeadingMotor->CurrentDirectionOrBrakeMode);
+            }
+        }
+    }
+}
+#endif // USE_WHEEL_SLIP_CONTROL
+
+#ifdef USE_MOTION_COMMAND_QUEUE
+/*
+ * Uses DriveSpeedPWM of the right motor
+ */
+bool CarPWMMotorControl::queueGoDistanceMillimeter(int aRequestedDistanceMillimeter)
+{
+    return queueMotionCommand(MOTION_COMMAND_GO_DISTANCE, rightCarMotor.DriveSpeedPWM, aRequestedDistanceMillimeter);
+}
+
+/*
+ * @param aRequestedDistanceMillimeter negative -> go backward
+ */
+bool CarPWMMotorControl::queueGoDistanceMillimeter(uint8_t aRequestedSpeedPWM, int aRequestedDistanceMillimeter)
+{
+    return queueMotionCommand(MOTION_COMMAND_GO_DISTANCE, aRequestedSpeedPWM, aRequestedDistanceMillimeter);
+}
+
+/*
+ * @param aRotationDegrees positive -> turn left, negative -> turn right
+ */
+bool CarPWMMotorControl::queueRotate(int aRotationDegrees, turn_direction_t aTurnDirection)
+{
+    return queueMotionCommand(MOTION_COMMAND_ROTATE, aTurnDirection, aRotationDegrees);
+}
+
+/*
+ * The command is finished, when drive speed is reached. aRequestedSpeedPWM == 0 ramps down to stop.
+ */
+bool CarPWMMotorControl::queueSetSpeedPWMWithRamp(uint8_t aRequestedSpeedPWM, uint8_t aRequestedDirection)
+{
+    return queueMotionCommand(MOTION_COMMAND_SET_SPEED, aRequestedSpeedPWM, aRequestedDirection);
+}
+
+/*
+ * Wait while the motors keep their current state
+ */
+bool CarPWMMotorControl::queueWait(unsigned int aWaitMillis)
+{
+    return queueMotionCommand(MOTION_COMMAND_WAIT, 0, (int) aWaitMillis);
+}
+
+/*
+ * @param aRotationDegrees positive -> right wheel is the outer wheel, i.e. turn left for forward driving
+ */
+bool CarPWMMotorControl::queueArc(int aRadiusMillimeter, int aRotationDegrees, uint8_t aRequestedDirection)
+{
+    return queueMotionCommand(MOTION_COMMAND_ARC, aRequestedDirection, aRotationDegrees, aRadiusMillimeter);
+}
+
+/*
+ * The command is written before the write index is incremented, so it can be called while the timer interrupt is reading the queue
+ * @return false if queue is full
+ */
+bool CarPWMMotorControl::queueMotionCommand(uint8_t aType, uint8_t aParameter, int aValue, int aRadius)
+{
+    uint8_t tWriteIndex = MotionCommandQueueWriteIndex;
+    if ((uint8_t)(tWriteIndex - MotionCommandQueueReadIndex) >= MOTION_COMMAND_QUEUE_SIZE)
+    {
+        return false;
+    }
+    MotionCommandStruct *tCommand = &MotionCommandQueue[tWriteIndex & (MOTION_COMMAND_QUEUE_SIZE - 1)];
+    tCommand->Type = aType;
+    tCommand->Parameter = aParameter;
+    tCommand->Value = aValue;
+    tCommand->Radius = aRadius;
+    MotionCommandQueueWriteIndex = tWriteIndex + 1;
+    return true;
+}
+
+/*
+ * Removes all waiting commands and forgets the running one. The motors are not stopped.
+ */
+void CarPWMMotorControl::clearMotionCommandQueue()
+{
+    LOCK_MOTOR_CONTROL_TIMER_INTERRUPT();
+    MotionCommandQueueReadIndex = MotionCommandQueueWriteIndex;
+    MotionCommandIsRunning = false;
+    UNLOCK_MOTOR_CONTROL_TIMER_INTERRUPT();
+}
+
+bool CarPWMMotorControl::hasPendingMotionCommands()
+{
+    return (MotionCommandIsRunning || MotionCommandQueueReadIndex != MotionCommandQueueWriteIndex);
+}
+
+#ifdef USE_ENCODER_MOTOR_CONTROL
+/*
+ * Extends the target distance of both motors by the next distance drive or arc, if both wheels keep their direction.
+ * With IMU, only distance drives are extended, since the end of an arc is detected by the IMU.
+ * @return true if extended
+ */
+bool CarPWMMotorControl::extendRunningMotionCommand(MotionCommandStruct *aNextCommand)
+{
+    uint8_t tDirection = rightCarMotor.CurrentDirectionOrBrakeMode;
+    uint8_t tRightSpeedPWM;
+    uint8_t tLeftSpeedPWM;
+    unsigned int tRightDistanceMillimeter;
+    unsigned int tLeftDistanceMillimeter;
+    if (aNextCommand->Type == MOTION_COMMAND_GO_DISTANCE)
+    {
+        if (aNextCommand->Value == 0 || (aNextCommand->Value < 0) != (tDirection == DIRECTION_BACKWARD))
+        {
+            return false;
+        }
+        tRightSpeedPWM = aNextCommand->Parameter;
+        tLeftSpeedPWM = aNextCommand->Parameter;
+        tRightDistanceMillimeter = abs(aNextCommand->Value);
+        tLeftDistanceMillimeter = tRightDistanceMillimeter;
+#  ifdef USE_MPU6050_IMU
+        CarRequestedDistanceMillimeter += tRightDistanceMillimeter;
+#  endif
+    }
+#  ifndef USE_MPU6050_IMU
+    else if (aNextCommand->Type == MOTION_COMMAND_ARC)
+    {
+        if (aNextCommand->Parameter != tDirection
+                || getArcWheelValues(aNextCommand->Radius, aNextCommand->Value, &tRightSpeedPWM, &tRightDistanceMillimeter,
+                        &tLeftSpeedPWM, &tLeftDistanceMillimeter) || tRightSpeedPWM == 0 || tLeftSpeedPWM == 0)
+        {
+            return false;
+        }
+    }
+#  endif
+    else
+    {
+        return false;
+    }
+    rightCarMotor.extendGoDistanceMillimeter(tRightSpeedPWM, tRightDistanceMillimeter);
+    leftCarMotor.extendGoDistanceMillimeter(tLeftSpeedPWM, tLeftDistanceMillimeter);
+    return true;
+}
+#endif
+
+/*
+ * Starts the next command, if the running command is finished.
+ * A distance drive or arc is not finished by ramp down and stop, if the next command is a distance drive or arc in the same direction.
+ * Then the target distance of both motors is extended and the ramp down is cancelled.
+ */
+void CarPWMMotorControl::updateMotionCommandQueue()
+{
+    if (MotionCommandIsRunning)
+    {
+#ifdef USE_ENCODER_MOTOR_CONTROL
+        if ((RunningMotionCommand.Type == MOTION_COMMAND_GO_DISTANCE || RunningMotionCommand.Type == MOTION_COMMAND_ARC)
+                && MotionCommandQueueReadIndex != MotionCommandQueueWriteIndex
+                && (rightCarMotor.MotorRampState == MOTOR_STATE_RAMP_DOWN || leftCarMotor.MotorRampState == MOTOR_STATE_RAMP_DOWN)
+                && !rightCarMotor.isStopped() && !leftCarMotor.isStopped()
+                && rightCarMotor.CurrentDirectionOrBrakeMode == leftCarMotor.CurrentDirectionOrBrakeMode)
+        {
+            MotionCommandStruct *tNextCommand = &MotionCommandQueue[MotionCommandQueueReadIndex & (MOTION_COMMAND_QUEUE_SIZE - 1)];
+            if (extendRunningMotionCommand(tNextCommand))
+            {
+                RunningMotionCommand = *tNextCommand;
+                MotionCommandQueueReadIndex++;
+                return;
+            }
+        }
+#endif
+        if (!isMotionCommandFinished())
+        {
+            return;
+        }
+        MotionCommandIsRunning = false;
+    }
+
+    if (MotionCommandQueueReadIndex != MotionCommandQueueWriteIndex)
+    {
+        RunningMotionCommand = MotionCommandQueue[MotionCommandQueueReadIndex & (MOTION_COMMAND_QUEUE_SIZE - 1)];
+        MotionCommandQueueReadIndex++;
+        MotionCommandIsRunning = true;
+        startMotionCommand();
+    }
+}
+
+void CarPWMMotorControl::startMotionCommand()
+{
+    int tValue = RunningMotionCommand.Value;
+    switch (RunningMotionCommand.Type)
+    {
+    case MOTION_COMMAND_GO_DISTANCE:
+        if (tValue < 0)
+        {
+            startGoDistanceMillimeter(RunningMotionCommand.Parameter, -tValue, DIRECTION_BACKWARD);
+        }
+        else
+        {
+            startGoDistanceMillimeter(RunningMotionCommand.Parameter, tValue, DIRECTION_FORWARD);
+        }
+        break;
+    case MOTION_COMMAND_ROTATE:
+        startRotate(tValue, (turn_direction_t) RunningMotionCommand.Parameter);
+        break;
+    case MOTION_COMMAND_ARC:
+        startArc(RunningMotionCommand.Radius, tValue, RunningMotionCommand.Parameter);
+        break;
+    case MOTION_COMMAND_SET_SPEED:
+        if (RunningMotionCommand.Parameter == 0)
+        {
+            startRampDown();
+        }
+        else
+        {
+            setSpeedPWMWithRamp(RunningMotionCommand.Parameter, tValue);
+        }
+        break;
+    default: // MOTION_COMMAND_WAIT
+        MotionCommandStartMillis = millis();
+        break;
+    }
+}
+
+bool CarPWMMotorControl::isMotionCommandFinished()
+{
+    bool tIsStopped = isStopped() && rightCarMotor.MotorRampState != MOTOR_STATE_START
+            && leftCarMotor.MotorRampState != MOTOR_STATE_START;
+    switch (RunningMotionCommand.Type)
+    {
+    case MOTION_COMMAND_SET_SPEED:
+        if (RunningMotionCommand.Parameter != 0)
+        {
+            return (isState(MOTOR_STATE_DRIVE) || tIsStopped);
+        }
+        return tIsStopped;
+    case MOTION_COMMAND_WAIT:
+        return (millis() - MotionCommandStartMillis >= (unsigned int) RunningMotionCommand.Value);
+    default: // MOTION_COMMAND_GO_DISTANCE, MOTION_COMMAND_ROTATE and MOTION_COMMAND_ARC
+        return tIsStopped;
+    }
+}
+#endif // USE_MOTION_COMMAND_QUEUE
+
+/*
+ * @return true if not stopped (motor expects another update)
+ */
+bool CarPWMMotorControl::updateMotors(void (*aLoopCallback)(void))
+{
+    if (aLoopCallback != NULL)
+    {
+        aLoopCallback();
+    }
+    return updateMotors();
+}
+
+void CarPWMMotorControl::delayAndUpdateMotors(unsigned int aDelayMillis)
 {
     uint32_t tStartMillis = millis();
     do
@@ -522,16 +1618,20 @@ void CarPWMMotorControl::delayAndUpdateMotors(unsigned int aDelayMillis)
 
 void CarPWMMotorControl::startRampUp(uint8_t aRequestedDirection)
 {
+    LOCK_MOTOR_CONTROL_TIMER_INTERRUPT();
     checkAndHandleDirectionChange(aRequestedDirection);
     rightCarMotor.startRampUp(aRequestedDirection);
     leftCarMotor.startRampUp(aRequestedDirection);
+    UNLOCK_MOTOR_CONTROL_TIMER_INTERRUPT();
 }
 
 void CarPWMMotorControl::setSpeedPWMWithRamp(uint8_t aRequestedSpeedPWM, uint8_t aRequestedDirection)
 {
+    LOCK_MOTOR_CONTROL_TIMER_INTERRUPT();
     checkAndHandleDirectionChange(aRequestedDirection);
     rightCarMotor.setSpeedPWMWithRamp(aRequestedSpeedPWM, aRequestedDirection);
     leftCarMotor.setSpeedPWMWithRamp(aRequestedSpeedPWM, aRequestedDirection);
+    UNLOCK_MOTOR_CONTROL_TIMER_INTERRUPT();
 }
 
 /*
@@ -574,6 +1674,7 @@ void CarPWMMotorControl::startGoDistanceMillimeter(unsigned int aRequestedDistan
 void CarPWMMotorControl::startGoDistanceMillimeter(uint8_t aRequestedSpeedPWM, unsigned int aRequestedDistanceMillimeter,
                                                    uint8_t aRequestedDirection)
 {
+    LOCK_MOTOR_CONTROL_TIMER_INTERRUPT();
 
     checkAndHandleDirectionChange(aRequestedDirection);
 
@@ -589,6 +1690,7 @@ void CarPWMMotorControl::startGoDistanceMillimeter(uint8_t aRequestedSpeedPWM, u
     rightCarMotor.startGoDistanceMillimeter(aRequestedSpeedPWM, aRequestedDistanceMillimeter, aRequestedDirection);
     leftCarMotor.startGoDistanceMillimeter(aRequestedSpeedPWM, aRequestedDistanceMillimeter, aRequestedDirection);
 #endif
+    UNLOCK_MOTOR_CONTROL_TIMER_INTERRUPT();
 }
 
 void CarPWMMotorControl::goDistanceMillimeter(unsigned int aRequestedDistanceMillimeter, uint8_t aRequestedDirection,
@@ -621,6 +1723,87 @@ void CarPWMMotorControl::goDistanceMillimeter(int aRequestedDistanceMillimeter,
     waitUntilStopped(aLoopCallback);
 }
 
+#ifdef USE_ENCODER_MOTOR_CONTROL
+/*
+ * If the car is already moving in the requested direction, the counts are added to the current counts of each wheel.
+ * A direction change stops the car first and the counts start again at 0.
+ * Each wheel stops at its own target. Only with USE_DIFFERENTIAL_DRIVE_CONTROL, both wheels ramp down synchronized,
+ * otherwise each wheel ramps down on its own and the car may turn a bit while moving.
+ */
+void CarPWMMotorControl::startGoDistanceCount(uint8_t aRequestedSpeedPWM, unsigned int aRequestedDistanceCount,
+                                              uint8_t aRequestedDirection)
+{
+    LOCK_MOTOR_CONTROL_TIMER_INTERRUPT();
+    checkAndHandleDirectionChange(aRequestedDirection); // Before reading the counts, which are reset at the start after the stop
+    EncoderSnapshotStruct tSnapshot;
+    RightTargetDistanceCount = aRequestedDistanceCount;
+    LeftTargetDistanceCount = aRequestedDistanceCount;
+    if (!isStopped())
+    {
+        rightCarMotor.getEncoderSnapshot(&tSnapshot);
+        RightTargetDistanceCount += tSnapshot.LastRideEncoderCount;
+        leftCarMotor.getEncoderSnapshot(&tSnapshot);
+        LeftTargetDistanceCount += tSnapshot.LastRideEncoderCount;
+    }
+    /*
+     * getDistanceMillimeter() computes the same value for exactly aRequestedDistanceCount counts,
+     * and a smaller one for one count less, since a count has more than 1 mm
+     */
+    startGoDistanceMillimeter(aRequestedSpeedPWM,
+            ((unsigned long) aRequestedDistanceCount * FACTOR_COUNT_TO_MILLIMETER_INTEGER_DEFAULT) / ENCODER_COUNTS_PER_SLOT,
+            aRequestedDirection);
+    UNLOCK_MOTOR_CONTROL_TIMER_INTERRUPT();
+}
+
+void CarPWMMotorControl::startGoDistanceCount(int aRequestedDistanceCount)
+{
+    if (aRequestedDistanceCount < 0)
+    {
+        startGoDistanceCount(rightCarMotor.DriveSpeedPWM, -aRequestedDistanceCount, DIRECTION_BACKWARD);
+    }
+    else
+    {
+        startGoDistanceCount(rightCarMotor.DriveSpeedPWM, aRequestedDistanceCount, DIRECTION_FORWARD);
+    }
+}
+
+/*
+ * Waits until distance is reached and both wheels are at standstill
+ * @param  aLoopCallback called until car is at standstill to avoid blocking
+ */
+void CarPWMMotorControl::goDistanceCount(int aRequestedDistanceCount, void (*aLoopCallback)(void))
+{
+    startGoDistanceCount(aRequestedDistanceCount);
+    waitUntilStopped(aLoopCallback);
+
+    EncoderSnapshotStruct tRightSnapshot;
+    EncoderSnapshotStruct tLeftSnapshot;
+    do
+    {
+        updateMotors(aLoopCallback); // for the braking distance measurement
+        rightCarMotor.getEncoderSnapshot(&tRightSnapshot);
+        leftCarMotor.getEncoderSnapshot(&tLeftSnapshot);
+    } while (millis() - tRightSnapshot.LastEncoderInterruptMillis < DISTANCE_COUNT_STANDSTILL_MILLIS
+            || millis() - tLeftSnapshot.LastEncoderInterruptMillis < DISTANCE_COUNT_STANDSTILL_MILLIS);
+}
+
+/*
+ * @param aMotor &rightCarMotor or &leftCarMotor
+ * @return counts driven more than requested by startGoDistanceCount(), negative if the wheel stopped before the target
+ */
+int CarPWMMotorControl::getDistanceCountError(EncoderMotor *aMotor)
+{
+    EncoderSnapshotStruct tSnapshot;
+    aMotor->getEncoderSnapshot(&tSnapshot);
+    if (aMotor == &rightCarMotor)
+    {
+        return (int) tSnapshot.LastRideEncoderCount - (int) RightTargetDistanceCount;
+    }
+    return (int) tSnapshot.LastRideEncoderCount - (int) LeftTargetDistanceCount;
+}
+
+#endif // USE_ENCODER_MOTOR_CONTROL
+
 /*
  * Stop car with ramp and give DistanceCountAfterRampUp counts for braking.
  */
@@ -631,8 +1814,10 @@ void CarPWMMotorControl::stopAndWaitForIt(void (*aLoopCallback)(void))
         return;
     }
 
+    LOCK_MOTOR_CONTROL_TIMER_INTERRUPT();
     rightCarMotor.startRampDown();
     leftCarMotor.startRampDown();
+    UNLOCK_MOTOR_CONTROL_TIMER_INTERRUPT();
     /*
      * blocking wait for stop
      */
@@ -649,8 +1834,10 @@ void CarPWMMotorControl::startRampDown()
      * Set NextChangeMaxTargetCount to change state from MOTOR_STATE_DRIVE to MOTOR_STATE_RAMP_DOWN
      * Use DistanceCountAfterRampUp as ramp down count
      */
+    LOCK_MOTOR_CONTROL_TIMER_INTERRUPT();
     rightCarMotor.startRampDown();
     leftCarMotor.startRampDown();
+    UNLOCK_MOTOR_CONTROL_TIMER_INTERRUPT();
 }
 
 /*
@@ -702,6 +1889,7 @@ void CarPWMMotorControl::setFactorDegreeToMillimeter(float aFactorDegreeToMillim
 char sTurnDirectionCharArray[3] = {'F', 'B', 'P'};
 void CarPWMMotorControl::startRotate(int aRotationDegrees, turn_direction_t aTurnDirection, bool aUseSlowSpeed)
 {
+    LOCK_MOTOR_CONTROL_TIMER_INTERRUPT();
     /*
      * We have 6 cases
      * - aTurnDirection = TURN_FORWARD      + -> left, right motor F, left 0    - -> right, right motor 0, left F
@@ -810,6 +1998,7 @@ void CarPWMMotorControl::startRotate(int aRotationDegrees, turn_direction_t aTur
     tRightMotorIfPositiveTurn->startGoDistanceMillimeter(tTurnSpeedPWMRight, tDistanceMillimeterRight, DIRECTION_FORWARD);
     tLeftMotorIfPositiveTurn->startGoDistanceMillimeter(tTurnSpeedPWMLeft, tDistanceMillimeterLeft, DIRECTION_BACKWARD);
 #endif
+    UNLOCK_MOTOR_CONTROL_TIMER_INTERRUPT();
 }
 
 /**
@@ -830,13 +2019,261 @@ void CarPWMMotorControl::rotate(int aRotationDegrees, turn_direction_t aTurnDire
     }
 }
 
+/**
+ * Computes distance and SpeedPWM of both wheels for an arc. The outer wheel uses its DriveSpeedPWM,
+ * the inner wheel the SpeedPWM for the same ratio of speed as of distance, so both wheels finish at the same time.
+ * Without encoder motors, the inner SpeedPWM is at least DEFAULT_START_SPEED_PWM.
+ * The distance of a wheel to the car center is taken from FactorDegreeToMillimeter, which is the distance of one wheel for a pivot turn.
+ * @param  aRadiusMillimeter radius of the path of the car center
+ * @param  aRotationDegrees positive -> right wheel is the outer wheel
+ * @return true if the inner wheel must turn in opposite direction, because aRadiusMillimeter is smaller than half of the track
+ */
+bool CarPWMMotorControl::getArcWheelValues(int aRadiusMillimeter, int aRotationDegrees, uint8_t *aRightSpeedPWM,
+                                           unsigned int *aRightDistanceMillimeter, uint8_t *aLeftSpeedPWM, unsigned int *aLeftDistanceMillimeter)
+{
+#ifdef USE_MPU6050_IMU
+    float tFactorDegreeToMillimeter = FACTOR_DEGREE_TO_MILLIMETER_DEFAULT;
+#else
+    float tFactorDegreeToMillimeter = FactorDegreeToMillimeter;
+#endif
+    unsigned int tRotationDegrees = abs(aRotationDegrees);
+    float tCenterDistanceMillimeter = abs(aRadiusMillimeter) * tRotationDegrees * (PI / 180.0);
+    float tHalfTrackDistanceMillimeter = tRotationDegrees * tFactorDegreeToMillimeter / 2;
+    unsigned int tOuterDistanceMillimeter = tCenterDistanceMillimeter + tHalfTrackDistanceMillimeter + 0.5;
+    float tInnerDistanceMillimeter = tCenterDistanceMillimeter - tHalfTrackDistanceMillimeter;
+    bool tInnerWheelIsReversed = (tInnerDistanceMillimeter < 0);
+    unsigned int tAbsInnerDistanceMillimeter = fabs(tInnerDistanceMillimeter) + 0.5;
+
+    uint8_t tOuterSpeedPWM;
+    if (aRotationDegrees >= 0)
+    {
+        tOuterSpeedPWM = rightCarMotor.DriveSpeedPWM;
+        *aRightDistanceMillimeter = tOuterDistanceMillimeter;
+        *aLeftDistanceMillimeter = tAbsInnerDistanceMillimeter;
+    }
+    else
+    {
+        tOuterSpeedPWM = leftCarMotor.DriveSpeedPWM;
+        *aRightDistanceMillimeter = tAbsInnerDistanceMillimeter;
+        *aLeftDistanceMillimeter = tOuterDistanceMillimeter;
+    }
+    uint8_t tInnerSpeedPWM = 0;
+    if (tAbsInnerDistanceMillimeter > 0)
+    {
+        tInnerSpeedPWM = (((unsigned long)tOuterSpeedPWM * tAbsInnerDistanceMillimeter) + (tOuterDistanceMillimeter / 2))
+                / tOuterDistanceMillimeter;
+#ifndef USE_ENCODER_MOTOR_CONTROL
+        if (tInnerSpeedPWM < DEFAULT_START_SPEED_PWM)
+        {
+            // Inner wheel would not turn at all. Now it finishes first, and the turn ends with a pivot on the inner wheel.
+            tInnerSpeedPWM = DEFAULT_START_SPEED_PWM;
+        }
+#endif
+    }
+    if (aRotationDegrees >= 0)
+    {
+        *aRightSpeedPWM = tOuterSpeedPWM;
+        *aLeftSpeedPWM = tInnerSpeedPWM;
+    }
+    else
+    {
+        *aRightSpeedPWM = tInnerSpeedPWM;
+        *aLeftSpeedPWM = tOuterSpeedPWM;
+    }
+    return tInnerWheelIsReversed;
+}
+
+#if defined(USE_MOTION_PROFILE) && !defined(USE_MPU6050_IMU)
+/**
+ * Scales velocity, acceleration and jerk of the profile of the inner wheel by the ratio of the wheel distances.
+ * Then both profiles have the same shape, the wheel velocities keep their ratio also during ramp up and ramp down,
+ * and both wheels reach their targets at the same time. Must be called after both wheels are started.
+ * @param  aRotationDegrees positive -> right wheel is the outer wheel
+ */
+void CarPWMMotorControl::scaleArcInnerWheelProfile(int aRotationDegrees, unsigned int aRightDistanceMillimeter,
+                                                   unsigned int aLeftDistanceMillimeter)
+{
+    EncoderMotor *tOuterMotor = &rightCarMotor;
+    EncoderMotor *tInnerMotor = &leftCarMotor;
+    unsigned int tOuterDistanceMillimeter = aRightDistanceMillimeter;
+    unsigned int tInnerDistanceMillimeter = aLeftDistanceMillimeter;
+    if (aRotationDegrees < 0)
+    {
+        tOuterMotor = &leftCarMotor;
+        tInnerMotor = &rightCarMotor;
+        tOuterDistanceMillimeter = aLeftDistanceMillimeter;
+        tInnerDistanceMillimeter = aRightDistanceMillimeter;
+    }
+    if (tInnerDistanceMillimeter == 0 || tOuterDistanceMillimeter == 0)
+    {
+        return; // inner wheel is not started
+    }
+    unsigned int tInnerVelocity = (((unsigned long)tOuterMotor->getRequestedDriveMillimeterPerSecond() * tInnerDistanceMillimeter)
+            + (tOuterDistanceMillimeter / 2)) / tOuterDistanceMillimeter;
+    tInnerMotor->RequestedDriveSpeedPWM = EncoderMotor::getSpeedPWMForMillimeterPerSecond(tInnerVelocity);
+    tInnerMotor->RequestedDriveMillimeterPerSecond = tInnerVelocity;
+    tInnerMotor->setProfileLimitScale((((unsigned long)tInnerDistanceMillimeter * 256) + (tOuterDistanceMillimeter / 2))
+            / tOuterDistanceMillimeter);
+}
+#endif
+
+/**
+ * Each wheel drives its own distance with encoder motors, with IMU the arc ends when the requested rotation is reached.
+ * With the motion profile, the profile of the inner wheel is scaled by the ratio of the wheel distances.
+ * Without encoder and IMU, the distances are only estimated by time, and the inner wheel may not turn at all at low SpeedPWM.
+ * @param  aRadiusMillimeter radius of the path of the car center, 0 -> turn in place by startRotate()
+ * @param  aRotationDegrees positive -> right wheel is the outer wheel, i.e. turn left for forward driving
+ * @param  aRequestedDirection DIRECTION_FORWARD or DIRECTION_BACKWARD
+ */
+void CarPWMMotorControl::startArc(int aRadiusMillimeter, int aRotationDegrees, uint8_t aRequestedDirection)
+{
+    if (aRadiusMillimeter == 0)
+    {
+        startRotate(aRotationDegrees, TURN_IN_PLACE);
+        return;
+    }
+    uint8_t tRightSpeedPWM;
+    uint8_t tLeftSpeedPWM;
+    unsigned int tRightDistanceMillimeter;
+    unsigned int tLeftDistanceMillimeter;
+    bool tInnerWheelIsReversed = getArcWheelValues(aRadiusMillimeter, aRotationDegrees, &tRightSpeedPWM, &tRightDistanceMillimeter,
+            &tLeftSpeedPWM, &tLeftDistanceMillimeter);
+    uint8_t tRightDirection = aRequestedDirection;
+    uint8_t tLeftDirection = aRequestedDirection;
+    if (tInnerWheelIsReversed)
+    {
+        if (aRotationDegrees >= 0)
+        {
+            tLeftDirection = oppositeDIRECTION(aRequestedDirection);
+        }
+        else
+        {
+            tRightDirection = oppositeDIRECTION(aRequestedDirection);
+        }
+    }
+
+#ifdef DEBUG
+    Serial.print(F("Arc PWM right="));
+    Serial.print(tRightSpeedPWM);
+    Serial.print(F(" left="));
+    Serial.print(tLeftSpeedPWM);
+    Serial.print(F(" DistanceMillimeter right="));
+    Serial.print(tRightDistanceMillimeter);
+    Serial.print(F(" left="));
+    Serial.println(tLeftDistanceMillimeter);
+#endif
+
+    LOCK_MOTOR_CONTROL_TIMER_INTERRUPT();
+    checkAndHandleDirectionChange(aRequestedDirection);
+#ifdef USE_MPU6050_IMU
+    IMUData.resetCarData();
+    CarRequestedRotationDegrees = aRotationDegrees;
+    // Like for rotation, the end is detected by the IMU
+    rightCarMotor.setSpeedPWM(tRightSpeedPWM, tRightDirection);
+    leftCarMotor.setSpeedPWM(tLeftSpeedPWM, tLeftDirection);
+#else
+    rightCarMotor.startGoDistanceMillimeter(tRightSpeedPWM, tRightDistanceMillimeter, tRightDirection);
+    leftCarMotor.startGoDistanceMillimeter(tLeftSpeedPWM, tLeftDistanceMillimeter, tLeftDirection);
+#  ifdef USE_MOTION_PROFILE
+    scaleArcInnerWheelProfile(aRotationDegrees, tRightDistanceMillimeter, tLeftDistanceMillimeter);
+#  endif
+#endif
+    UNLOCK_MOTOR_CONTROL_TIMER_INTERRUPT();
+}
+
+void CarPWMMotorControl::arc(int aRadiusMillimeter, int aRotationDegrees, uint8_t aRequestedDirection, void (*aLoopCallback)(void))
+{
+    if (aRotationDegrees != 0)
+    {
+        startArc(aRadiusMillimeter, aRotationDegrees, aRequestedDirection);
+        waitUntilStopped(aLoopCallback);
+    }
+}
+
+#ifdef USE_MOTION_PROFILE
+/**
+ * Each wheel runs with the velocity of the car center plus or minus the half of the wheel speed difference for the yaw rate,
+ * which is aYawRateDegreePerSecond * FactorDegreeToMillimeter.
+ * The profile limits of the wheel with the smaller velocity change are scaled by the ratio of both changes,
+ * so the ratio of the wheel velocities and therefore the curvature of the path is kept during the transition.
+ * A wheel, which must change its direction, is stopped first and restarts from 0.
+ * @param  aVelocityMillimeterPerSecond negative -> backward
+ * @param  aYawRateDegreePerSecond positive -> turn left (counterclockwise), negative -> turn right
+ */
+void CarPWMMotorControl::setVelocityAndYawRate(int aVelocityMillimeterPerSecond, int aYawRateDegreePerSecond)
+{
+#ifdef USE_MPU6050_IMU
+    float tFactorDegreeToMillimeter = FACTOR_DEGREE_TO_MILLIMETER_DEFAULT;
+#else
+    float tFactorDegreeToMillimeter = FactorDegreeToMillimeter;
+#endif
+    int tHalfSpeedDifference = (aYawRateDegreePerSecond * tFactorDegreeToMillimeter) / 2;
+    int tVelocity[2] = { aVelocityMillimeterPerSecond + tHalfSpeedDifference, aVelocityMillimeterPerSecond - tHalfSpeedDifference };
+    EncoderMotor *tMotors[2] = { &rightCarMotor, &leftCarMotor };
+
+    LOCK_MOTOR_CONTROL_TIMER_INTERRUPT();
+    if (aVelocityMillimeterPerSecond != 0)
+    {
+        checkAndHandleDirectionChange((aVelocityMillimeterPerSecond < 0) ? DIRECTION_BACKWARD : DIRECTION_FORWARD);
+    }
+    /*
+     * Get the velocity change of each wheel. A wheel, which changes its direction or was stopped by the car direction change, starts from 0.
+     */
+    unsigned int tVelocityChange[2];
+    for (uint_fast8_t i = 0; i < 2; ++i)
+    {
+        EncoderMotor *tMotor = tMotors[i];
+        int tCurrentVelocity = 0;
+        if (tMotor->CurrentSpeedPWM > 0 && tMotor->MotorRampState != MOTOR_STATE_START)
+        {
+            tCurrentVelocity = tMotor->Profile.getVelocity();
+            if (tMotor->CurrentDirectionOrBrakeMode == DIRECTION_BACKWARD)
+            {
+                tCurrentVelocity = -tCurrentVelocity;
+            }
+            if ((tCurrentVelocity > 0 && tVelocity[i] < 0) || (tCurrentVelocity < 0 && tVelocity[i] > 0))
+            {
+                tCurrentVelocity = 0;
+            }
+        }
+        tVelocityChange[i] = abs(tVelocity[i] - tCurrentVelocity);
+    }
+    unsigned int tMaxVelocityChange = max(tVelocityChange[0], tVelocityChange[1]);
+
+#ifdef USE_MPU6050_IMU
+    // No end of rotation or distance by the IMU
+    CarRequestedRotationDegrees = 0;
+    CarRequestedDistanceMillimeter = 0;
+#endif
+    for (uint_fast8_t i = 0; i < 2; ++i)
+    {
+        EncoderMotor *tMotor = tMotors[i];
+        if (tVelocity[i] < 0)
+        {
+            tMotor->setSpeedMillimeterPerSecond(-tVelocity[i], DIRECTION_BACKWARD);
+        }
+        else
+        {
+            tMotor->setSpeedMillimeterPerSecond(tVelocity[i], DIRECTION_FORWARD);
+        }
+        if (tMaxVelocityChange > 0)
+        {
+            tMotor->setProfileLimitScale((((unsigned long)tVelocityChange[i] * 256) + (tMaxVelocityChange / 2)) / tMaxVelocityChange);
+        }
+    }
+    UNLOCK_MOTOR_CONTROL_TIMER_INTERRUPT();
+}
+#endif
+
 #ifdef USE_ENCODER_MOTOR_CONTROL
 /*
  * Get count / distance value from right motor
  */
 unsigned int CarPWMMotorControl::getDistanceCount()
 {
-    return (rightCarMotor.EncoderCount);
+    EncoderSnapshotStruct tSnapshot;
+    rightCarMotor.getEncoderSnapshot(&tSnapshot);
+    return (tSnapshot.EncoderCount);
 }
 
 unsigned int CarPWMMotorControl::getDistanceMillimeter()
@@ -858,6 +2295,8 @@ unsigned int CarPWMMotorControl::getBrakingDistanceMillimeter()
 {
 #ifdef USE_ENCODER_MOTOR_CONTROL
     return rightCarMotor.getBrakingDistanceMillimeter();
+#elif defined(USE_LEARNED_BRAKING_DISTANCE)
+    return BrakingModel.getBrakingDistanceMillimeter(CarSpeedCmPerSecondFromIMU * 10, MOTOR_BRAKE);
 #else
     unsigned int tCarSpeedCmPerSecond = CarSpeedCmPerSecondFromIMU;
     //    return (tCarSpeedCmPerSecond * tCarSpeedCmPerSecond * 100) / RAMP_DECELERATION_TIMES_2; // overflow!
@@ -865,6 +2304,27 @@ unsigned int CarPWMMotorControl::getBrakingDistanceMillimeter()
 #endif
 }
 
+#if defined(USE_MPU6050_IMU) && defined(USE_LEARNED_BRAKING_DISTANCE) && !defined(USE_ENCODER_MOTOR_CONTROL)
+/*
+ * Ends the measurement, which was started at startRampDown(), if the IMU reports standstill.
+ * If car was started again before, the measurement is discarded.
+ */
+void CarPWMMotorControl::updateBrakingDistanceMeasurement()
+{
+    if (isStopped())
+    {
+        if (CarSpeedCmPerSecondFromIMU == 0 && millis() - BrakingModel.MeasurementStartMillis > BRAKING_DISTANCE_STANDSTILL_MILLIS)
+        {
+            BrakingModel.endMeasurement(CarDistanceMillimeterFromIMU);
+        }
+    }
+    else if (rightCarMotor.MotorRampState != MOTOR_STATE_RAMP_DOWN)
+    {
+        BrakingModel.MeasurementIsRunning = false;
+    }
+}
+#endif
+
 #ifdef USE_MPU6050_IMU
 uint8_t CarPWMMotorControl::getTurnDistanceHalfDegree()
 {
@@ -0,0 +1,78 @@
+/*
+ * EncoderEventBuffer.h
+ *
+ *  Ring buffer of compact binary events, written by the encoder interrupts and read by loop().
+ *  It replaces printing in the interrupt service routines, which takes around 1 ms per line at 115200 baud
+ *  and blocks the millis() timer and other interrupts like the IR receiver.
+ *
+ *  There is only one writer at a time, since interrupts do not nest, and one reader, so no locking is required.
+ *  The writer only writes WriteIndex and the reader only writes ReadIndex, and both are single bytes.
+ *  If the buffer is full, new events are dropped and counted in NumberOfDroppedEvents.
+ *
+ *  Copyright (C) 2022  Armin Joachimsmeyer
+ *  armin.joachimsmeyer@gmail.com
+ *
+ *  This file is part of PWMMotorControl https://github.com/ArminJo/PWMMotorControl.
+ *
+ *  PWMMotorControl is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/gpl.html>.
+ */
+
+#ifndef ENCODER_EVENT_BUFFER_H_
+#define ENCODER_EVENT_BUFFER_H_
+
+#include <Arduino.h>
+#include <stdint.h>
+
+#if !defined(ENCODER_EVENT_BUFFER_SIZE)
+#define ENCODER_EVENT_BUFFER_SIZE   32 // must be a power of 2, 8 bytes per event
+#endif
+#if (ENCODER_EVENT_BUFFER_SIZE & (ENCODER_EVENT_BUFFER_SIZE - 1)) != 0 || ENCODER_EVENT_BUFFER_SIZE > 128
+#error "ENCODER_EVENT_BUFFER_SIZE must be a power of 2 and not greater than 128"
+#endif
+
+#define ENCODER_EVENT_MOTOR_RIGHT       0 // motor of ISR0
+#define ENCODER_EVENT_MOTOR_LEFT        1 // motor of ISR1
+
+#define ENCODER_EVENT_PERIOD            0 // count with a new valid period
+#define ENCODER_EVENT_COUNT             1 // count without a new period, e.g. first count after standstill or quadrature edge
+#define ENCODER_EVENT_RINGING           2 // edge is ignored, since it is too early after the last one
+#define ENCODER_EVENT_BACKWARD          3 // quadrature step against the direction of the ride
+#define ENCODER_EVENT_TICKS_REACHED     4 // count of wheelGoDistanceTicks() reached, motor is stopped
+#define ENCODER_EVENT_NUMBER_OF_TYPES   5
+
+struct EncoderEventStruct {
+    unsigned long TimestampMicros;
+    unsigned int EncoderCount; // EncoderCount after the event, or the tick counter of wheelGoDistanceTicks()
+    uint8_t Motor;             // ENCODER_EVENT_MOTOR_RIGHT or ENCODER_EVENT_MOTOR_LEFT
+    uint8_t Type;              // ENCODER_EVENT_PERIOD etc.
+};
+
+class EncoderEventBuffer {
+public:
+    EncoderEventBuffer();
+    void clear();
+    void putEvent(unsigned long aTimestampMicros, unsigned int aEncoderCount, uint8_t aMotor, uint8_t aType);
+    bool getEvent(EncoderEventStruct *aEvent);
+    void printEvents(Print *aSerial);
+
+    volatile EncoderEventStruct Events[ENCODER_EVENT_BUFFER_SIZE]; // volatile, so the event is written before WriteIndex
+    volatile uint8_t WriteIndex; // next event to write, only written by the interrupt. Not masked, so full is WriteIndex - ReadIndex == size
+    volatile uint8_t ReadIndex;  // next event to read, only written by loop()
+    volatile uint8_t NumberOfDroppedEvents; // only written by the interrupt, saturates at 0xFF
+    uint8_t PrintedNumberOfDroppedEvents; // to print only new drops
+};
+
+#endif /* ENCODER_EVENT_BUFFER_H_ */
+
+#pragma once
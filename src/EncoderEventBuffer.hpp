@@ -0,0 +1,107 @@
+/*
+ * EncoderEventBuffer.hpp
+ *
+ *  Ring buffer of encoder events, written by the encoder interrupts and read by loop().
+ *  putEvent() is called by the interrupt and takes only a few dozen cycles.
+ *  getEvent() and printEvents() are called by loop() and must not be called by an interrupt.
+ *
+ *  Copyright (C) 2022  Armin Joachimsmeyer
+ *  armin.joachimsmeyer@gmail.com
+ *
+ *  This file is part of PWMMotorControl https://github.com/ArminJo/PWMMotorControl.
+ *
+ *  PWMMotorControl is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/gpl.html>.
+ */
+#ifndef ENCODER_EVENT_BUFFER_HPP
+#define ENCODER_EVENT_BUFFER_HPP
+
+#include <Arduino.h>
+#include "EncoderEventBuffer.h"
+
+EncoderEventBuffer::EncoderEventBuffer() { // @suppress("Class members should be properly initialized")
+    WriteIndex = 0;
+    ReadIndex = 0;
+    NumberOfDroppedEvents = 0;
+    PrintedNumberOfDroppedEvents = 0;
+}
+
+/*
+ * Discard all unread events. Only ReadIndex is written, so it can be called while the interrupts are running.
+ */
+void EncoderEventBuffer::clear() {
+    ReadIndex = WriteIndex;
+}
+
+/*
+ * Called by the interrupt. Drops the event, if the buffer is full.
+ */
+void EncoderEventBuffer::putEvent(unsigned long aTimestampMicros, unsigned int aEncoderCount, uint8_t aMotor, uint8_t aType) {
+    uint8_t tWriteIndex = WriteIndex;
+    if ((uint8_t) (tWriteIndex - ReadIndex) >= ENCODER_EVENT_BUFFER_SIZE) {
+        if (NumberOfDroppedEvents < 0xFF) {
+            NumberOfDroppedEvents++;
+        }
+        return;
+    }
+    volatile EncoderEventStruct *tEvent = &Events[tWriteIndex & (ENCODER_EVENT_BUFFER_SIZE - 1)];
+    tEvent->TimestampMicros = aTimestampMicros;
+    tEvent->EncoderCount = aEncoderCount;
+    tEvent->Motor = aMotor;
+    tEvent->Type = aType;
+    WriteIndex = tWriteIndex + 1; // publish the event
+}
+
+/*
+ * @return false if buffer is empty
+ */
+bool EncoderEventBuffer::getEvent(EncoderEventStruct *aEvent) {
+    uint8_t tReadIndex = ReadIndex;
+    if (tReadIndex == WriteIndex) {
+        return false;
+    }
+    volatile EncoderEventStruct *tEvent = &Events[tReadIndex & (ENCODER_EVENT_BUFFER_SIZE - 1)];
+    aEvent->TimestampMicros = tEvent->TimestampMicros;
+    aEvent->EncoderCount = tEvent->EncoderCount;
+    aEvent->Motor = tEvent->Motor;
+    aEvent->Type = tEvent->Type;
+    ReadIndex = tReadIndex + 1; // free the entry for the interrupt
+    return true;
+}
+
+/*
+ * Prints and removes all events, one line per event, e.g. "R P 1234567 17" for a period event of the right motor
+ * at 1234567 us with an EncoderCount of 17. R or L is the motor, P, C, R, B or T the type.
+ */
+void EncoderEventBuffer::printEvents(Print *aSerial) {
+    static const char sEncoderEventTypeCharArray[ENCODER_EVENT_NUMBER_OF_TYPES] = { 'P', 'C', 'R', 'B', 'T' };
+    EncoderEventStruct tEvent;
+    while (getEvent(&tEvent)) {
+        aSerial->print(tEvent.Motor == ENCODER_EVENT_MOTOR_RIGHT ? 'R' : 'L');
+        aSerial->print(' ');
+        aSerial->print(sEncoderEventTypeCharArray[tEvent.Type]);
+        aSerial->print(' ');
+        aSerial->print(tEvent.TimestampMicros);
+        aSerial->print(' ');
+        aSerial->println(tEvent.EncoderCount);
+    }
+    uint8_t tNumberOfDroppedEvents = NumberOfDroppedEvents;
+    if (tNumberOfDroppedEvents != PrintedNumberOfDroppedEvents) {
+        PrintedNumberOfDroppedEvents = tNumberOfDroppedEvents;
+        aSerial->print(F("Dropped encoder events="));
+        aSerial->println(tNumberOfDroppedEvents);
+    }
+}
+
+#endif // #ifndef ENCODER_EVENT_BUFFER_HPP
+#pragma once
@@ -41,6 +41,43 @@
 #define ENCODER_SENSOR_TIMEOUT_MILLIS 400L // Timeout for encoder ticks if motor is running
 #define ENCODER_SENSOR_RING_MILLIS 4
 
+/*
+ * The encoder period is measured with micros() instead of millis(), which has an error of 1 ms, i.e. 10% at max speed.
+ * The periods are stored as 16 bit values in units of ENCODER_PERIOD_ARRAY_UNIT_MICROS in the average speed buffer.
+ * An edge is taken as ringing of the sensor, if it comes earlier than ENCODER_SENSOR_RING_MICROS or 1/ENCODER_SENSOR_RING_PERIOD_DIVISOR
+ * of the last period after the last edge, since the speed cannot change so much within one slot.
+ * This replaces the fixed ENCODER_SENSOR_RING_MILLIS, which limits the speed to 250 counts per second.
+ * The distance_ringing trial of extras/HostSimulation/PlantTrials.cpp with 40% ringing edges gives a mean distance error
+ * of 0.5 mm (stddev 1.3 mm) with micros() and of -5.0 mm (stddev 5.5 mm) with millis().
+ */
+//#define DO_NOT_USE_MICROS_FOR_ENCODER_PERIOD // Activate this to measure the encoder period with millis() as before.
+#if !defined(DO_NOT_USE_MICROS_FOR_ENCODER_PERIOD)
+#define USE_MICROS_FOR_ENCODER_PERIOD
+#endif
+#define ENCODER_SENSOR_RING_MICROS              500
+#define ENCODER_SENSOR_RING_PERIOD_DIVISOR      4
+#define ENCODER_PERIOD_ARRAY_UNIT_MICROS        8 // 16 bit gives 524 ms, which is more than ENCODER_SENSOR_TIMEOUT_MILLIS
+
+/*
+ * Quadrature encoder with 2 channels A and B, e.g. the hall sensor encoders of many gear motors.
+ * Each edge of both channels is decoded by a table, which gives +1, -1 or 0 for bouncing or an invalid double step.
+ * This results in 4 counts per slot, and backward movement is counted backward, independent of the direction of the motor.
+ * So rollback after a stop or pushing the car is measured correctly and EncoderPosition is the signed position of the wheel.
+ * The speed is still measured once per slot, at the edge to A and B low, so the existing speed computation and ring filter still apply.
+ * The pins are RIGHT_MOTOR_ENCODER_A_PIN + RIGHT_MOTOR_ENCODER_B_PIN for RIGHT_MOTOR_INTERRUPT and LEFT_MOTOR_ENCODER_A_PIN + LEFT_MOTOR_ENCODER_B_PIN.
+ * A must be the pin of the interrupt given at init() and defaults to 2 and 3. B is attached to its interrupt too, if it has one.
+ * If B has no external interrupt, like all other pins of the Uno, call EncoderMotor::ISR0() for the right and ISR1() for the left motor
+ * from the pin change interrupt of B and define USE_OWN_PIN_CHANGE_INTERRUPT_FOR_ENCODER_B_PIN, otherwise compiling for AVR gives an error.
+ * If counting is backward for forward movement, swap the pins of A and B.
+ */
+//#define USE_QUADRATURE_ENCODER // Activate this to use both channels of a quadrature encoder
+//#define USE_OWN_PIN_CHANGE_INTERRUPT_FOR_ENCODER_B_PIN // Activate this, if your pin change interrupt of B calls EncoderMotor::ISR0() / ISR1()
+#if defined(USE_QUADRATURE_ENCODER)
+#define ENCODER_COUNTS_PER_SLOT 4
+#else
+#define ENCODER_COUNTS_PER_SLOT 1
+#endif
+
 /*
  * Some factors depending on wheel diameter and encoder resolution
  */
@@ -55,6 +92,219 @@
  */
 #define SPEED_SCALE_VALUE ((100L * DEFAULT_CIRCUMFERENCE_MILLIMETER) / ENCODER_COUNTS_PER_FULL_ROTATION) // 1100
 
+/*
+ * Closed loop speed control for each wheel, replacing synchronizeMotor().
+ * In MOTOR_STATE_DRIVE a PI controller adjusts the PWM every SPEED_CONTROL_INTERVAL_MILLIS,
+ * so that the wheel runs at the nominal speed of RequestedDriveSpeedPWM, independent of battery voltage and motor friction.
+ * Feedback is the encoder period. Gains are in PWM per mm/s and scaled by 256 for integer arithmetic.
+ */
+//#define DO_NOT_USE_SPEED_CONTROL // Activate this to drive with the open loop PWM values as before.
+#if defined(USE_ENCODER_MOTOR_CONTROL) && !defined(DO_NOT_USE_SPEED_CONTROL)
+#define USE_SPEED_CONTROL
+#endif
+#define SPEED_CONTROL_INTERVAL_MILLIS   20
+#if !defined(SPEED_CONTROL_KP_TIMES_256)
+#define SPEED_CONTROL_KP_TIMES_256      40 // 0.16 PWM per mm/s
+#endif
+#if !defined(SPEED_CONTROL_KI_TIMES_256)
+#define SPEED_CONTROL_KI_TIMES_256      8  // 0.03 PWM per mm/s and interval
+#endif
+#define SPEED_CONTROL_INTEGRAL_LIMIT    ((256L * MAX_SPEED_PWM) / SPEED_CONTROL_KI_TIMES_256) // Integral alone can drive the full PWM range
+#define SPEED_CONTROL_MIN_PWM           DEFAULT_START_SPEED_PWM // Do not drop into the dead band at start
+#define SPEED_CONTROL_MIN_TURNING_PWM   RAMP_VALUE_MIN_SPEED_PWM // A turning motor needs less voltage than a motor at standstill
+#define SPEED_CONTROL_STALL_MILLIS      200 // If we have no encoder interrupt after start for this time, the motor is assumed to be stalled
+#if !defined(SPEED_CONTROL_ACCELERATION_FEED_FORWARD_MILLIS)
+#define SPEED_CONTROL_ACCELERATION_FEED_FORWARD_MILLIS 80 // The feed forward PWM is taken for the speed, which is reached after this time with the current acceleration
+#endif
+
+/*
+ * Jerk limited motion profile for start, stop and going a distance, replacing the linear RAMP_VALUE_DELTA ramps.
+ * The deceleration point is planned from the remaining encoder distance and the speed control follows the profile velocity.
+ */
+//#define DO_NOT_USE_MOTION_PROFILE // Activate this to use the RAMP_VALUE_DELTA ramps and getBrakingDistanceMillimeter() as before.
+#if defined(USE_SPEED_CONTROL) && !defined(DO_NOT_USE_MOTION_PROFILE) && !defined(DO_NOT_SUPPORT_RAMP)
+#define USE_MOTION_PROFILE
+#include "MotionProfile.h"
+#endif
+
+/*
+ * Measured speed to PWM table, used as feed forward value of the speed control.
+ * It is filled by CarPWMMotorControl::calibrateSpeedPWMTables() or by a PWM sweep as in the PrintMotorDiagram example,
+ * and is stored in EEPROM behind the EepromMotorInfoStruct's.
+ * As long as a direction is not calibrated, the nominal linear conversion of getSpeedPWMForMillimeterPerSecond() is used.
+ */
+//#define DO_NOT_USE_SPEED_PWM_TABLE // Activate this to save 18 bytes RAM per motor and around 600 bytes program space.
+#if defined(USE_SPEED_CONTROL) && !defined(DO_NOT_USE_SPEED_PWM_TABLE)
+#define USE_SPEED_PWM_TABLE
+#endif
+#define SPEED_PWM_TABLE_SIZE                        8   // Entries per direction
+#define SPEED_PWM_TABLE_MILLIMETER_PER_SECOND_STEP  100 // Entry n contains the PWM for n * 100 mm/s, entry 0 the PWM where the motor starts to turn
+#define SPEED_PWM_TABLE_CALIBRATION_STEP_MILLIS     20  // Time for each PWM value of the calibration sweep
+#define SPEED_PWM_TABLE_VERSION                     1   // Must be changed if EepromSpeedPWMTableStruct changes
+#define EEPROM_SPEED_PWM_TABLE_START                (EEPROM_MOTOR_INFO_MAX_NUMBER * sizeof(EepromMotorInfoStruct))
+
+/*
+ * Relay feedback autotuner for the gains of the speed control by CarPWMMotorControl::autotuneSpeedControl(), see SpeedControlAutotune.h.
+ * The gains are members of each motor, initialized with SPEED_CONTROL_KP_TIMES_256 and SPEED_CONTROL_KI_TIMES_256,
+ * and are stored in EEPROM behind the EepromMotorInfoStruct's and speed PWM tables.
+ */
+//#define USE_SPEED_CONTROL_AUTOTUNE // Activate this to enable CarPWMMotorControl::autotuneSpeedControl(). Requires 6 bytes RAM per motor.
+#if defined(USE_SPEED_CONTROL_AUTOTUNE)
+#  if !defined(USE_SPEED_CONTROL)
+#error "USE_SPEED_CONTROL_AUTOTUNE requires USE_SPEED_CONTROL"
+#  endif
+#include "SpeedControlAutotune.h"
+#endif
+#define SPEED_CONTROL_GAINS_VERSION                 1   // Must be changed if EepromSpeedControlGainsStruct changes
+#if defined(USE_SPEED_PWM_TABLE)
+#define EEPROM_SPEED_CONTROL_GAINS_START            (EEPROM_SPEED_PWM_TABLE_START + (EEPROM_MOTOR_INFO_MAX_NUMBER * sizeof(EepromSpeedPWMTableStruct)))
+#else
+#define EEPROM_SPEED_CONTROL_GAINS_START            EEPROM_SPEED_PWM_TABLE_START
+#endif
+
+/*
+ * Coupled control of both wheels of a car by CarPWMMotorControl::updateMotors(), replacing the independent control of each wheel.
+ * The difference of the distances driven by both wheels is compared with the integrated difference of their profile velocities,
+ * i.e. with the commanded yaw for straight runs or arcs and the commanded linear position for turns in place.
+ * The resulting error is split as speed correction to the speed controllers of both wheels.
+ * With USE_MPU6050_IMU the yaw of straight runs is taken from the gyroscope, which also sees different wheel circumferences and slip.
+ * The position gain is in 1/s, the velocity gain is dimensionless. Both are scaled by 16.
+ */
+//#define DO_NOT_USE_DIFFERENTIAL_DRIVE_CONTROL // Activate this to control both wheels independently as before.
+#if defined(USE_MOTION_PROFILE) && !defined(DO_NOT_USE_DIFFERENTIAL_DRIVE_CONTROL)
+#define USE_DIFFERENTIAL_DRIVE_CONTROL
+#endif
+#if !defined(DIFFERENTIAL_DRIVE_KP_TIMES_16)
+#define DIFFERENTIAL_DRIVE_KP_TIMES_16              32 // 2 mm/s correction per mm of wheel distance difference
+#endif
+#if !defined(DIFFERENTIAL_DRIVE_KV_TIMES_16)
+#define DIFFERENTIAL_DRIVE_KV_TIMES_16              0  // The speeds of both wheels are measured at different slots, so the difference is too noisy at low speeds
+#endif
+#define DIFFERENTIAL_DRIVE_MAX_CORRECTION           100 // mm/s, the correction of each wheel is the half of it
+
+/*
+ * Cars with one driver channel and one encoder for each motor, e.g. 4WD or 6WD chassis with independently driven wheels.
+ * CarPWMMotorControl then has CAR_NUMBER_OF_MOTORS_PER_SIDE - 1 follower motors for each side, which run their own speed control
+ * with the profile velocity of rightCarMotor or leftCarMotor. Distance and rotation are still measured by these 2 leading motors.
+ * A wheel, which has driven more than WHEEL_SLIP_THRESHOLD_MILLIMETER further than the wheel with the shortest distance of its side,
+ * is spinning and its velocity is reduced by WHEEL_SLIP_KP_TIMES_16 / 16 mm/s per mm excess distance, until it has grip again.
+ * Without this, CAR_HAS_4_WHEELS assumes, that the motors of each side are connected in parallel to one driver channel.
+ */
+//#define CAR_NUMBER_OF_MOTORS_PER_SIDE 2 // 2 for 4WD, 3 for 6WD
+#if defined(CAR_NUMBER_OF_MOTORS_PER_SIDE) && CAR_NUMBER_OF_MOTORS_PER_SIDE > 1
+#  if !defined(USE_MOTION_PROFILE)
+#error "CAR_NUMBER_OF_MOTORS_PER_SIDE > 1 requires USE_ENCODER_MOTOR_CONTROL with speed control and motion profile"
+#  endif
+#define USE_WHEEL_SLIP_CONTROL
+#define CAR_NUMBER_OF_FOLLOWER_MOTORS_PER_SIDE      (CAR_NUMBER_OF_MOTORS_PER_SIDE - 1)
+#endif
+#define WHEEL_SLIP_THRESHOLD_MILLIMETER             (2 * FACTOR_COUNT_TO_MILLIMETER_INTEGER_DEFAULT) // 2 encoder counts
+#if !defined(WHEEL_SLIP_KP_TIMES_16)
+#define WHEEL_SLIP_KP_TIMES_16                      64 // 4 mm/s velocity reduction per mm excess distance
+#endif
+#define WHEEL_SLIP_MAX_CORRECTION                   200 // mm/s
+
+/*
+ * Traction control for cars with IMU. Every TRACTION_CONTROL_INTERVAL_MILLIS, the encoder speed of each wheel is compared with
+ * the speed of the floor below this wheel, which is the speed of the accelerator plus or minus the half of the wheel speed
+ * difference given by the yaw rate of the gyroscope.
+ * A wheel, which is faster than the floor by more than TRACTION_CONTROL_SLIP_MILLIMETER_PER_SECOND plus 1/16 of its speed
+ * for TRACTION_CONTROL_SLIP_INTERVALS, is spinning. Its PWM is then reduced to 3/4 each interval until it has grip again,
+ * and afterwards the limit is raised by TRACTION_CONTROL_RECOVERY_PWM each interval.
+ * If the IMU sees no movement and no turn for TRACTION_CONTROL_STALL_MILLIS while the motors are driven, the car is stalled
+ * e.g. by an obstacle and is stopped. Slip and stall are reported by CarPWMMotorControl::getAndClearTractionEvents().
+ * Only active in MOTOR_STATE_RAMP_UP and MOTOR_STATE_DRIVE, since the encoder speed is too late while braking.
+ */
+//#define DO_NOT_USE_TRACTION_CONTROL // Activate this to detect blocked wheels only by ENCODER_SENSOR_TIMEOUT_MILLIS as before.
+#if defined(USE_ENCODER_MOTOR_CONTROL) && defined(USE_MPU6050_IMU) && !defined(DO_NOT_USE_TRACTION_CONTROL)
+#define USE_TRACTION_CONTROL
+#endif
+#define TRACTION_CONTROL_INTERVAL_MILLIS                20
+#define TRACTION_CONTROL_SLIP_MILLIMETER_PER_SECOND     80 // Covers the cm/s resolution and the drift of the accelerator speed
+#define TRACTION_CONTROL_SLIP_INTERVALS                 2
+#define TRACTION_CONTROL_RECOVERY_PWM                   4  // 200 PWM per second
+#define TRACTION_CONTROL_STALL_MILLIMETER_PER_SECOND    40 // Car speed and half wheel speed difference of the yaw rate must be below
+#define TRACTION_CONTROL_STALL_MILLIS                   500
+
+/*
+ * The braking distance of EncoderMotor and of CarPWMMotorControl with IMU is computed with a deceleration,
+ * which is learned from the overrun after each stop, separately for MOTOR_BRAKE and MOTOR_RELEASE and for speed bands.
+ * RAMP_DECELERATION_TIMES_2 is only the initial value, so the distance of ramps and stops adapts to the floor.
+ * With USE_MOTION_PROFILE, the motor is stopped as soon as the braking distance reaches the target,
+ * instead of driving the last millimeters with MOTION_PROFILE_MIN_VELOCITY.
+ */
+//#define DO_NOT_USE_LEARNED_BRAKING_DISTANCE // Activate this to use the constant RAMP_DECELERATION_TIMES_2 as before.
+#if (defined(USE_ENCODER_MOTOR_CONTROL) || defined(USE_MPU6050_IMU)) && !defined(DO_NOT_USE_LEARNED_BRAKING_DISTANCE)
+#define USE_LEARNED_BRAKING_DISTANCE
+#include "BrakingDistanceModel.h"
+#endif
+
+/*
+ * Identification of a first order plus deadband model of each motor and direction by CarPWMMotorControl::identifyMotorModels().
+ * The identified start and stop PWM, gain and time constant replace the hand tuned DEFAULT_START_MILLIVOLT_*,
+ * DEFAULT_MILLIMETER_PER_SECOND and RAMP_VALUE_OFFSET_MILLIVOLT. printMotorModel() prints their values for this motor
+ * and the MOTION_PROFILE_MAX_ACCELERATION, which the motor can achieve.
+ * With USE_SPEED_PWM_TABLE, the table is filled from the model.
+ * Requires 12 bytes RAM per motor and around 350 bytes of stack while identifying.
+ */
+//#define USE_MOTOR_MODEL_IDENTIFICATION // Activate this to enable CarPWMMotorControl::identifyMotorModels()
+#if defined(USE_MOTOR_MODEL_IDENTIFICATION)
+#  if !defined(USE_ENCODER_MOTOR_CONTROL)
+#error "USE_MOTOR_MODEL_IDENTIFICATION requires USE_ENCODER_MOTOR_CONTROL"
+#  endif
+#  if !defined(USE_MICROS_FOR_ENCODER_PERIOD)
+#error "USE_MOTOR_MODEL_IDENTIFICATION requires USE_MICROS_FOR_ENCODER_PERIOD, the millis() resolution is too coarse for the time constant"
+#  endif
+#include "MotorModelIdentification.h"
+#endif
+
+/*
+ * Each encoder interrupt stores an event with timestamp, motor, EncoderCount and type in EncoderMotor::EncoderEvents,
+ * instead of printing in the interrupt, which blocks other interrupts for milliseconds.
+ * Call EncoderMotor::EncoderEvents.printEvents(&Serial) in loop() to print the trace of all ticks.
+ * Requires 8 bytes of RAM per event.
+ */
+//#define USE_ENCODER_EVENT_BUFFER // Activate this to record the encoder interrupts for printing in loop()
+#if defined(USE_ENCODER_EVENT_BUFFER)
+#include "EncoderEventBuffer.h"
+#endif
+
+/*
+ * Consistent copy of the values written by handleEncoderInterrupt(), filled by getEncoderSnapshot().
+ * The interrupt increments EncoderSnapshotSequence before and after writing them. The copy is repeated,
+ * if the sequence is odd or has changed while copying. So multi byte values cannot be torn on 8 bit CPUs,
+ * and interrupts need not to be disabled.
+ */
+struct EncoderSnapshotStruct {
+    unsigned int EncoderCount;
+    unsigned int LastRideEncoderCount;
+    unsigned long LastEncoderInterruptMillis;
+#ifdef USE_MICROS_FOR_ENCODER_PERIOD
+    unsigned long LastEncoderInterruptMicros;
+    unsigned long EncoderInterruptDeltaMicros; // 0 if no valid period
+#else
+    unsigned long EncoderInterruptDeltaMillis; // 0 if no valid period
+#endif
+#ifdef SUPPORT_AVERAGE_SPEED
+    unsigned long AverageSpeedPeriodSum;     // Sum of the last AverageSpeedNumberOfPeriods periods, in units of the period array
+    uint8_t AverageSpeedNumberOfPeriods;     // 0 if no average is available
+#endif
+#ifdef USE_QUADRATURE_ENCODER
+    long EncoderPosition;
+#endif
+};
+
+struct EepromSpeedPWMTableStruct {
+    uint8_t Version;
+    uint8_t SpeedPWM[2][SPEED_PWM_TABLE_SIZE]; // [DIRECTION_FORWARD or DIRECTION_BACKWARD][speed index]
+};
+
+struct EepromSpeedControlGainsStruct {
+    uint8_t Version;
+    uint16_t KpTimes256;
+    uint16_t KiTimes256;
+};
+
 class EncoderMotor : public PWMDcMotor
 {
 public:
@@ -70,6 +320,20 @@ public:
     void init(uint8_t aForwardPin, uint8_t aBackwardPin, uint8_t aPWMPin, uint8_t aInterruptNumber);
 #endif
     
+#ifdef USE_LEARNED_BRAKING_DISTANCE
+    /*
+     * Basic motor commands, they "overwrite" PWMDCMotor functions to start the braking distance measurement if they stop the motor
+     */
+    void setSpeedPWM(int aRequestedSpeedPWM);
+    void setSpeedPWM(uint8_t aRequestedSpeedPWM, uint8_t aRequestedDirection);
+    void changeSpeedPWM(uint8_t aRequestedSpeedPWM);
+    void setSpeedPWMWithRamp(uint8_t aRequestedSpeedPWM, uint8_t aRequestedDirection);
+    void stop(uint8_t aStopMode = STOP_MODE_KEEP);
+#  ifndef USE_MOTION_PROFILE
+    void startRampDown(); // Stops immediately for DO_NOT_SUPPORT_RAMP
+#  endif
+    void checkForStopOfRunningMotor(bool aWasRunning);
+#endif
 
     /*
      * Functions for going a fixed distance, they "overwrite" PWMDCMotor functions
@@ -77,12 +341,19 @@ public:
     void startGoDistanceMillimeter(int aRequestedDistanceMillimeter); // Signed distance count
     void startGoDistanceMillimeter(unsigned int aRequestedDistanceMillimeter, uint8_t aRequestedDirection);
     void startGoDistanceMillimeter(uint8_t aRequestedSpeedPWM, unsigned int aRequestedDistanceMillimeter, uint8_t aRequestedDirection);
+    void extendGoDistanceMillimeter(uint8_t aRequestedSpeedPWM, unsigned int aAdditionalDistanceMillimeter);
     bool updateMotor();
+#ifdef USE_MOTION_PROFILE
+    void startRampDown();
+    unsigned int getRequestedDriveMillimeterPerSecond();
+    void setProfileLimitScale(uint16_t aScaleTimes256);
+    void applyProfileLimitScale();
+#endif
 
     /*
      * Functions especially for encoder motors
      */
-    void synchronizeMotor(EncoderMotor *aOtherMotorControl, unsigned int aCheckInterval); // Computes motor speed compensation value in order to go exactly straight ahead
+    void synchronizeMotor(EncoderMotor *aOtherMotorControl, unsigned int aCheckInterval); // Computes motor speed compensation value in order to go exactly straight ahead. Not required with USE_SPEED_CONTROL.
     void wheelGoDistanceTicks(int aRequestedDistanceTicks, uint8_t aRequestedSpeedPWM, uint8_t aRequestedDirection); 
 
 
@@ -95,17 +366,73 @@ public:
     void handleEncoderInterrupt();
 #endif
 
-    void attachEncoderInterrupt(uint8_t aEncoderInterruptPinNumber);
+    void attachEncoderInterrupt(uint8_t aInterruptNumber);
+    void attachEncoderInterrupt(uint8_t aInterruptNumber, EncoderMotor *aEncoderMotor);
     static void ISR0();
     static void ISR1();
+#ifdef USE_ENCODER_EVENT_BUFFER
+    void putEncoderEvent(unsigned long aTimestampMicros, uint8_t aType);
+    static EncoderEventBuffer EncoderEvents; // Events of all motors in the order of their interrupts
+#endif
+#ifdef USE_QUADRATURE_ENCODER
+    void setQuadratureEncoderPins(uint8_t aEncoderPinA, uint8_t aEncoderPinB);
+    long getEncoderPosition();
+    long getPositionMillimeter();
+#endif
 
 
+    void getEncoderSnapshot(EncoderSnapshotStruct *aSnapshot);
     uint8_t getDirection();
     unsigned int getDistanceMillimeter();
+    unsigned int getDistanceMillimeter(EncoderSnapshotStruct *aSnapshot);
     unsigned int getDistanceCentimeter();
     unsigned int getBrakingDistanceMillimeter();
+#ifdef USE_LEARNED_BRAKING_DISTANCE
+    unsigned int getBrakingDistanceMillimeter(uint8_t aStopMode);
+    unsigned int getInterpolatedDistanceMillimeter();
+    void startBrakingDistanceMeasurement(uint8_t aStopMode); // Called by stop() if motor was running
+    void updateBrakingDistanceMeasurement();
+#endif
 
     unsigned int getSpeed();
+    unsigned int getSpeedMillimeterPerSecond();
+    unsigned int getSpeedMillimeterPerSecond(EncoderSnapshotStruct *aSnapshot);
+#ifdef USE_SPEED_CONTROL
+    bool hasSpeedFeedback(EncoderSnapshotStruct *aSnapshot, unsigned long aMillis);
+    void setSpeedMillimeterPerSecond(unsigned int aRequestedSpeedMillimeterPerSecond, uint8_t aRequestedDirection);
+    void initSpeedControl();
+    static unsigned int getFeedForwardMillimeterPerSecond(unsigned int aTargetMillimeterPerSecond, int aTargetAccelerationMillimeterPerSecond2);
+    uint8_t computeSpeedControlPWM(unsigned int aTargetMillimeterPerSecond, int aTargetAccelerationMillimeterPerSecond2 = 0);
+    uint8_t getFeedForwardSpeedPWM(unsigned int aMillimeterPerSecond, uint8_t aDirection);
+#endif
+#ifdef USE_SPEED_PWM_TABLE
+    /*
+     * Sweep PWM up and then down in steps of 1 every SPEED_PWM_TABLE_CALIBRATION_STEP_MILLIS and call addSpeedPWMTableCalibrationValue() after each step.
+     * The values of both sweeps are averaged to compensate the delay of the speed.
+     */
+    void startSpeedPWMTableCalibration(uint8_t aDirection, bool aIsRampUp);
+    void addSpeedPWMTableCalibrationValue(uint8_t aSpeedPWM);
+    void endSpeedPWMTableCalibration(uint8_t aDirection);
+    void printSpeedPWMTable(Print *aSerial);
+    void readSpeedPWMTableFromEeprom(uint8_t aMotorValuesEepromStorageNumber);
+    void writeSpeedPWMTableToEeprom(uint8_t aMotorValuesEepromStorageNumber);
+#endif
+#ifdef USE_SPEED_CONTROL_AUTOTUNE
+    void setSpeedControlGains(uint16_t aKpTimes256, uint16_t aKiTimes256);
+    void updateSpeedControlAutotune(SpeedControlAutotune *aAutotune);
+    bool setSpeedControlGainsFromAutotune(SpeedControlAutotune *aAutotune);
+    void printSpeedControlGains(Print *aSerial);
+    void readSpeedControlGainsFromEeprom(uint8_t aMotorValuesEepromStorageNumber);
+    void writeSpeedControlGainsToEeprom(uint8_t aMotorValuesEepromStorageNumber);
+#endif
+#ifdef USE_MOTOR_MODEL_IDENTIFICATION
+    void addMotorModelSample(MotorModelIdentification *aIdentification);
+    unsigned int getMotorModelAcceleration(uint8_t aDirection);
+    void printMotorModel(Print *aSerial);
+#  ifdef USE_SPEED_PWM_TABLE
+    void setSpeedPWMTableFromMotorModel();
+#  endif
+#endif
 #ifdef SUPPORT_AVERAGE_SPEED
     unsigned int getAverageSpeed();
     unsigned int getAverageSpeed(uint8_t aLengthOfAverage);
@@ -146,6 +473,37 @@ public:
     EncoderMotor *NextMotorControl;
 #endif
 
+#ifdef USE_SPEED_PWM_TABLE
+    // Not reset by resetEncoderControlValues()
+    uint8_t SpeedPWMTable[2][SPEED_PWM_TABLE_SIZE]; // Entry 0 is 0 if direction is not calibrated
+    uint8_t SpeedPWMTableCalibrationIndex; // Index of next entry to fill
+    bool SpeedPWMTableCalibrationIsRampUp;
+#endif
+
+#ifdef USE_SPEED_CONTROL_AUTOTUNE
+    // Not reset by resetEncoderControlValues()
+    uint16_t SpeedControlKpTimes256;
+    uint16_t SpeedControlKiTimes256;
+    int SpeedControlIntegralLimit; // Integral alone can drive the full PWM range
+#endif
+#ifdef USE_MOTOR_MODEL_IDENTIFICATION
+    MotorModelStruct MotorModel[2]; // [DIRECTION_FORWARD or DIRECTION_BACKWARD]. Not reset by resetEncoderControlValues().
+#endif
+#ifdef USE_MOTION_PROFILE
+    MotionProfile Profile; // not reset by resetEncoderControlValues(), since it contains the limits
+#endif
+#ifdef USE_LEARNED_BRAKING_DISTANCE
+    BrakingDistanceModel BrakingModel; // not reset by resetEncoderControlValues(), since it contains the learned values
+#endif
+    volatile uint8_t EncoderSnapshotSequence; // Odd while handleEncoderInterrupt() writes values. Not reset by resetEncoderControlValues().
+#ifdef USE_QUADRATURE_ENCODER
+    // Not reset by resetEncoderControlValues(), since they reflect the state of the wheel
+    uint8_t EncoderPinA;
+    uint8_t EncoderPinB;
+    volatile uint8_t QuadratureState; // (A << 1) | B of the last interrupt
+    volatile long EncoderPosition; // Signed counts, positive is forward. 4 counts per slot.
+#endif
+
     /**************************************************************
      * Variables required for going a fixed distance with encoder
      **************************************************************/
@@ -165,16 +523,48 @@ public:
     volatile unsigned int LastRideEncoderCount; // count of last ride - from start of MOTOR_STATE_RAMP_UP to next MOTOR_STATE_RAMP_UP
     // Flag e.g. for display update control
     volatile unsigned long LastEncoderInterruptMillis; // used internal for debouncing and lock/timeout detection
+#ifdef USE_MICROS_FOR_ENCODER_PERIOD
+    volatile unsigned long LastEncoderInterruptMicros; // used internal for debouncing and speed computation
+#endif
 
     /*
      * for speed computation
      * Do not rearrange, since reset is done with memset().
      */
+#ifdef USE_MICROS_FOR_ENCODER_PERIOD
+    volatile unsigned long EncoderInterruptDeltaMicros; // Used to get speed
+#  ifdef SUPPORT_AVERAGE_SPEED
+    volatile uint16_t EncoderPeriodArray[AVERAGE_SPEED_SAMPLE_SIZE]; // store for 20 periods in units of ENCODER_PERIOD_ARRAY_UNIT_MICROS
+    volatile uint8_t PeriodArrayIndex;                               // Index of the next value to write == the oldest value to overwrite
+    volatile unsigned long PeriodArraySum;                           // Sum of all values in EncoderPeriodArray, for a fast average
+    volatile bool AverageSpeedIsValid;                               // true if 20 values are written since last timeout
+#  endif
+#else
     volatile unsigned long EncoderInterruptDeltaMillis; // Used to get speed
-#ifdef SUPPORT_AVERAGE_SPEED
+#  ifdef SUPPORT_AVERAGE_SPEED
     volatile unsigned int EncoderInterruptMillisArray[AVERAGE_SPEED_BUFFER_SIZE]; // store for 20 deltas
     volatile uint8_t MillisArrayIndex;                                            // Index of the next value to write  == the oldest value to overwrite. 0 to 20|(AVERAGE_SPEED_BUFFER_SIZE-1)
     volatile bool AverageSpeedIsValid;                                            // true if 11 values are written since last timeout
+#  endif
+#endif
+
+#ifdef USE_SPEED_CONTROL
+    int SpeedControlIntegral; // Sum of speed errors in mm/s
+    unsigned long NextSpeedControlMillis;
+#endif
+#ifdef USE_MOTION_PROFILE
+    unsigned int RequestedDriveMillimeterPerSecond; // Set by setSpeedMillimeterPerSecond(), valid as long as RequestedDriveSpeedPWM is its PWM
+    uint16_t ProfileLimitScaleTimes256; // Scale of the profile limits for the next profile start, 0 -> not set, i.e. default limits
+#endif
+#ifdef USE_DIFFERENTIAL_DRIVE_CONTROL
+    int SpeedCorrectionMillimeterPerSecond; // Added to the profile velocity, set by CarPWMMotorControl::updateDifferentialDriveControl()
+#endif
+#ifdef USE_WHEEL_SLIP_CONTROL
+    int SlipCorrectionMillimeterPerSecond; // <= 0, != 0 if wheel is spinning. Set by CarPWMMotorControl::updateFollowerMotors()
+#endif
+#ifdef USE_TRACTION_CONTROL
+    uint8_t TractionControlSpeedPWMLimit; // 0 -> no limit, else wheel is or was spinning. Set by CarPWMMotorControl::updateTractionControl()
+    uint8_t TractionControlSlipCount; // Number of consecutive intervals with slip
 #endif
 
     // do not delete it!!! It must be the last element in structure and is required for stopMotorAndReset()
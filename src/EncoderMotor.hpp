@@ -37,16 +37,56 @@
 #if defined(USE_ENCODER_MOTOR_CONTROL)
 #include "EncoderMotor.h"
 #include "PWMDcMotor.hpp"
+#ifdef USE_MOTION_PROFILE
+#include "MotionProfile.hpp"
+#endif
+#ifdef USE_LEARNED_BRAKING_DISTANCE
+#include "BrakingDistanceModel.hpp"
+#endif
+#ifdef USE_ENCODER_EVENT_BUFFER
+#include "EncoderEventBuffer.hpp"
+#endif
+#ifdef USE_SPEED_CONTROL_AUTOTUNE
+#include "SpeedControlAutotune.hpp"
+#endif
+#ifdef USE_MOTOR_MODEL_IDENTIFICATION
+#include "MotorModelIdentification.hpp"
+#endif
 
 //#define TRACE
 //#define DEBUG
 
+#ifdef USE_QUADRATURE_ENCODER
+#  if !defined(RIGHT_MOTOR_ENCODER_A_PIN)
+#define RIGHT_MOTOR_ENCODER_A_PIN   2 // INT0
+#  endif
+#  if !defined(LEFT_MOTOR_ENCODER_A_PIN)
+#define LEFT_MOTOR_ENCODER_A_PIN    3 // INT1
+#  endif
+#  if !defined(RIGHT_MOTOR_ENCODER_B_PIN) || !defined(LEFT_MOTOR_ENCODER_B_PIN)
+#error "USE_QUADRATURE_ENCODER requires RIGHT_MOTOR_ENCODER_B_PIN and LEFT_MOTOR_ENCODER_B_PIN"
+#  endif
+/*
+ * For AVR, digitalPinToInterrupt() is a macro, which can be evaluated by the preprocessor.
+ * Without an interrupt for B, we would count only the edges of A and lose the direction of the counts.
+ */
+#  if (defined(ARDUINO_ARCH_AVR) || defined(ARDUINO_ARCH_HOST)) && !defined(USE_OWN_PIN_CHANGE_INTERRUPT_FOR_ENCODER_B_PIN)
+#    if digitalPinToInterrupt(RIGHT_MOTOR_ENCODER_B_PIN) == NOT_AN_INTERRUPT || digitalPinToInterrupt(LEFT_MOTOR_ENCODER_B_PIN) == NOT_AN_INTERRUPT
+#error "Encoder B pin has no interrupt. Call EncoderMotor::ISR0() / ISR1() from its pin change interrupt and define USE_OWN_PIN_CHANGE_INTERRUPT_FOR_ENCODER_B_PIN"
+#    endif
+#  endif
+#endif
+
 EncoderMotor *sPointerForInt0ISR;
 EncoderMotor *sPointerForInt1ISR;
 
 EncoderMotor::EncoderMotor() : // @suppress("Class members should be properly initialized")
                                PWMDcMotor(), stopFlag(false)
 {
+    EncoderSnapshotSequence = 0;
+#ifdef USE_SPEED_CONTROL_AUTOTUNE
+    setSpeedControlGains(SPEED_CONTROL_KP_TIMES_256, SPEED_CONTROL_KI_TIMES_256);
+#endif
 #ifdef ENABLE_MOTOR_LIST_FUNCTIONS
     AddToMotorList();
 #endif
@@ -67,12 +107,16 @@ void EncoderMotor::init(uint8_t aMotorNumber, uint8_t aInterruptNumber)
 {
     PWMDcMotor::init(aMotorNumber); // create with the default frequency 1.6KHz
     resetEncoderControlValues();
-    attachInterrupt(aInterruptNumber);
+    attachEncoderInterrupt(aInterruptNumber);
 }
 #else
 EncoderMotor::EncoderMotor(uint8_t aForwardPin, uint8_t aBackwardPin, uint8_t aPWMPin) : // @suppress("Class members should be properly initialized")
                                                                                          PWMDcMotor(aForwardPin, aBackwardPin, aPWMPin)
 {
+    EncoderSnapshotSequence = 0;
+#ifdef USE_SPEED_CONTROL_AUTOTUNE
+    setSpeedControlGains(SPEED_CONTROL_KP_TIMES_256, SPEED_CONTROL_KI_TIMES_256);
+#endif
     resetEncoderControlValues();
 #ifdef ENABLE_MOTOR_LIST_FUNCTIONS
     AddToMotorList();
@@ -116,12 +160,43 @@ void EncoderMotor::startGoDistanceMillimeter(uint8_t aRequestedSpeedPWM, unsigne
          */
         MotorRampState = MOTOR_STATE_DRIVE; // must be set, since we may be moving until now without ramp control
         TargetDistanceMillimeter = getDistanceMillimeter() + aRequestedDistanceMillimeter;
-        PWMDcMotor::setSpeedPWM(aRequestedSpeedPWM, aRequestedDirection);
+        setSpeedPWM(aRequestedSpeedPWM, aRequestedDirection);
+#ifdef USE_SPEED_CONTROL
+        RequestedDriveSpeedPWM = aRequestedSpeedPWM; // the new target speed
+        initSpeedControl();
+#endif
+#ifdef USE_MOTION_PROFILE
+        // continue with the current speed
+        applyProfileLimitScale();
+        Profile.start(getRequestedDriveMillimeterPerSecond(), getSpeedMillimeterPerSecond());
+        NextRampChangeMillis = millis();
+#endif
     }
     LastTargetDistanceMillimeter = TargetDistanceMillimeter;
     CheckDistanceInUpdateMotor = true;
 }
 
+/*
+ * Adds aAdditionalDistanceMillimeter to the target of the running distance drive and continues with aRequestedSpeedPWM,
+ * without ramp down and ramp up in between. A ramp down, which has already started, is cancelled.
+ */
+void EncoderMotor::extendGoDistanceMillimeter(uint8_t aRequestedSpeedPWM, unsigned int aAdditionalDistanceMillimeter)
+{
+    TargetDistanceMillimeter += aAdditionalDistanceMillimeter;
+    LastTargetDistanceMillimeter = TargetDistanceMillimeter;
+    RequestedDriveSpeedPWM = aRequestedSpeedPWM;
+    if (MotorRampState == MOTOR_STATE_RAMP_DOWN)
+    {
+        MotorRampState = MOTOR_STATE_DRIVE; // the motion profile plans the deceleration for the new target at next update
+    }
+#ifndef USE_MOTION_PROFILE
+    if (MotorRampState == MOTOR_STATE_DRIVE)
+    {
+        setSpeedPWM(aRequestedSpeedPWM, CurrentDirectionOrBrakeMode);
+    }
+#endif
+}
+
 void EncoderMotor::startGoDistanceMillimeter(unsigned int aRequestedDistanceMillimeter, uint8_t aRequestedDirection)
 {
     startGoDistanceMillimeter(DriveSpeedPWM, aRequestedDistanceMillimeter, aRequestedDirection);
@@ -152,17 +227,31 @@ bool EncoderMotor::updateMotor()
     unsigned long tMillis = millis();
     uint8_t tNewSpeedPWM = CurrentSpeedPWM;
 
+#ifdef USE_LEARNED_BRAKING_DISTANCE
+    if (BrakingModel.MeasurementIsRunning)
+    {
+        updateBrakingDistanceMeasurement();
+    }
+#endif
+
     /*
      * Check if target distance is reached or encoder tick has timeout
      */
+    EncoderSnapshotStruct tSnapshot;
+    if (tNewSpeedPWM > 0 || MotorRampState != MOTOR_STATE_STOPPED)
+    {
+        getEncoderSnapshot(&tSnapshot);
+    }
     if (tNewSpeedPWM > 0)
     {
-        if (CheckDistanceInUpdateMotor && (getDistanceMillimeter() >= TargetDistanceMillimeter || tMillis > (LastEncoderInterruptMillis + ENCODER_SENSOR_TIMEOUT_MILLIS)))
+        if (CheckDistanceInUpdateMotor
+                && (getDistanceMillimeter(&tSnapshot) >= TargetDistanceMillimeter
+                        || tMillis > (tSnapshot.LastEncoderInterruptMillis + ENCODER_SENSOR_TIMEOUT_MILLIS)))
         {
             stop(MOTOR_BRAKE); // this sets MOTOR_STATE_STOPPED;
 #ifdef DEBUG
             Serial.print(PWMPin);
-            if (tMillis > (LastEncoderInterruptMillis + ENCODER_SENSOR_TIMEOUT_MILLIS))
+            if (tMillis > (tSnapshot.LastEncoderInterruptMillis + ENCODER_SENSOR_TIMEOUT_MILLIS))
             {
                 Serial.print(F(" Encoder timeout: dist="));
             }
@@ -176,11 +265,138 @@ bool EncoderMotor::updateMotor()
 #endif
             return false; // need no more calls to update()
         }
+#if defined(USE_MOTION_PROFILE) && defined(USE_LEARNED_BRAKING_DISTANCE)
+        /*
+         * Stop, if the motor will come to standstill at the target, i.e. skip driving the last millimeters with MinVelocity
+         */
+        if (CheckDistanceInUpdateMotor && MotorRampState == MOTOR_STATE_RAMP_DOWN
+                && getInterpolatedDistanceMillimeter() + getBrakingDistanceMillimeter() >= TargetDistanceMillimeter
+                && getInterpolatedDistanceMillimeter() + FACTOR_COUNT_TO_MILLIMETER_INTEGER_DEFAULT >= TargetDistanceMillimeter)
+        {
+            stop(MOTOR_BRAKE);
+            return false;
+        }
+#endif
+    }
+
+#ifdef USE_MOTION_PROFILE
+    if (MotorRampState == MOTOR_STATE_START)
+    {
+        initEncoderControlValues();
+        getEncoderSnapshot(&tSnapshot); // values were reset
+        initSpeedControl();
+        applyProfileLimitScale();
+        Profile.start(getRequestedDriveMillimeterPerSecond(), 0);
+        NextRampChangeMillis = tMillis; // compute first profile value now
+        MotorRampState = MOTOR_STATE_RAMP_UP;
     }
 
+    if (MotorRampState != MOTOR_STATE_STOPPED && tMillis >= NextRampChangeMillis)
+    {
+        NextRampChangeMillis = tMillis + MOTION_PROFILE_INTERVAL_MILLIS;
+        /*
+         * Get the profile velocity for the remaining distance.
+         * Ramp down without distance is requested by startRampDown() and ends with velocity 0.
+         */
+        unsigned int tRemainingDistanceMillimeter = MOTION_PROFILE_NO_TARGET_DISTANCE;
+        if (CheckDistanceInUpdateMotor)
+        {
+            tRemainingDistanceMillimeter = TargetDistanceMillimeter - getDistanceMillimeter(&tSnapshot); // > 0, since target reached was checked above
+#ifdef USE_LEARNED_BRAKING_DISTANCE
+            /*
+             * Plan the ramp down with the learned deceleration of the stop at the target, if the wheels cannot brake
+             * with the profile deceleration
+             */
+            uint16_t tBrakingDeceleration = BrakingModel.getDeceleration(Profile.getVelocity(), MOTOR_BRAKE);
+            Profile.MaxDeceleration = min(Profile.MaxAcceleration, tBrakingDeceleration);
+#endif
+        }
+        else if (MotorRampState == MOTOR_STATE_RAMP_DOWN)
+        {
+            tRemainingDistanceMillimeter = 0;
+        }
+        if (MotorRampState != MOTOR_STATE_RAMP_DOWN)
+        {
+            Profile.MaxVelocity = getRequestedDriveMillimeterPerSecond(); // RequestedDriveSpeedPWM may be changed while driving
+        }
+        Profile.update(tRemainingDistanceMillimeter);
+        unsigned int tVelocity = Profile.getVelocity();
+        if (tVelocity == 0 && MotorRampState == MOTOR_STATE_RAMP_DOWN)
+        {
+            stop(MOTOR_BRAKE);
+            return false;
+        }
+
+        /*
+         * Use open loop value until we have a first valid encoder period, the first interrupt after start gives no valid period.
+         * If motor does not start at all, use closed loop to increase PWM.
+         */
+        if (hasSpeedFeedback(&tSnapshot, tMillis))
+        {
+#if defined(USE_DIFFERENTIAL_DRIVE_CONTROL) || defined(USE_WHEEL_SLIP_CONTROL)
+            int tCorrectedVelocity = (int) tVelocity;
+#  ifdef USE_DIFFERENTIAL_DRIVE_CONTROL
+            tCorrectedVelocity += SpeedCorrectionMillimeterPerSecond;
+#  endif
+#  ifdef USE_WHEEL_SLIP_CONTROL
+            tCorrectedVelocity += SlipCorrectionMillimeterPerSecond;
+#  endif
+            if (tCorrectedVelocity < 0)
+            {
+                tCorrectedVelocity = 0;
+            }
+            tNewSpeedPWM = computeSpeedControlPWM(tCorrectedVelocity, Profile.Acceleration);
+#else
+            tNewSpeedPWM = computeSpeedControlPWM(tVelocity, Profile.Acceleration);
+#endif
+        }
+        else
+        {
+            tNewSpeedPWM = getFeedForwardSpeedPWM(getFeedForwardMillimeterPerSecond(tVelocity, Profile.Acceleration), LastDirection);
+            if (tNewSpeedPWM < SPEED_CONTROL_MIN_PWM)
+            {
+                tNewSpeedPWM = SPEED_CONTROL_MIN_PWM;
+            }
+        }
+
+        /*
+         * Only distance driving ends with RAMP_DOWN, otherwise a lower RequestedDriveSpeedPWM is reached in DRIVE state
+         */
+        if (MotorRampState != MOTOR_STATE_RAMP_DOWN)
+        {
+            if (Profile.State == MOTION_PROFILE_ACCELERATE)
+            {
+                MotorRampState = MOTOR_STATE_RAMP_UP;
+            }
+            else if (Profile.State == MOTION_PROFILE_DECELERATE && CheckDistanceInUpdateMotor)
+            {
+                MotorRampState = MOTOR_STATE_RAMP_DOWN;
+            }
+            else
+            {
+                MotorRampState = MOTOR_STATE_DRIVE;
+            }
+        }
+#ifdef DEBUG
+        Serial.print(PWMPin);
+        Serial.print(F(" Dist="));
+        Serial.print(getDistanceMillimeter());
+        Serial.print(F(" V="));
+        Serial.print(tVelocity);
+        Serial.print(F(" St="));
+        Serial.print(MotorRampState);
+        Serial.print(F(" Ns="));
+        Serial.println(tNewSpeedPWM);
+#endif
+    }
+#else
     if (MotorRampState == MOTOR_STATE_START)
     {
         initEncoderControlValues();
+        getEncoderSnapshot(&tSnapshot); // values were reset
+#ifdef USE_SPEED_CONTROL
+        initSpeedControl();
+#endif
 
         NextRampChangeMillis = tMillis + RAMP_INTERVAL_MILLIS;
         /*
@@ -266,6 +482,17 @@ bool EncoderMotor::updateMotor()
             Serial.println(tNewSpeedPWM);
 #endif
         }
+#ifdef USE_SPEED_CONTROL
+        /*
+         * Closed loop speed control. Start with the open loop value until we have a first valid encoder period,
+         * the first interrupt after start gives no valid period. If motor does not start at all, increase PWM.
+         */
+        else if (tMillis >= NextSpeedControlMillis && hasSpeedFeedback(&tSnapshot, tMillis))
+        {
+            NextSpeedControlMillis = tMillis + SPEED_CONTROL_INTERVAL_MILLIS;
+            tNewSpeedPWM = computeSpeedControlPWM(getMillimeterPerSecondForSpeedPWM(RequestedDriveSpeedPWM));
+        }
+#endif
     }
 
     // do not use "else if" since we must immediately check for next transition to STOPPED
@@ -294,12 +521,19 @@ bool EncoderMotor::updateMotor()
 #endif
         }
     }
+#endif // USE_MOTION_PROFILE
     // End of motor state machine
 
 #ifdef TRACE
     Serial.print(PWMPin);
     Serial.print(F(" St="));
     Serial.println(MotorRampState);
+#endif
+#ifdef USE_TRACTION_CONTROL
+    if (TractionControlSpeedPWMLimit != 0 && tNewSpeedPWM > TractionControlSpeedPWMLimit)
+    {
+        tNewSpeedPWM = TractionControlSpeedPWMLimit; // for the open loop values at start and of the RAMP_VALUE_DELTA ramps
+    }
 #endif
     if (tNewSpeedPWM != CurrentSpeedPWM)
     {
@@ -307,7 +541,7 @@ bool EncoderMotor::updateMotor()
         Serial.print(F("Ns="));
         Serial.println(tNewSpeedPWM);
 #endif
-        PWMDcMotor::setSpeedPWM(tNewSpeedPWM, CurrentDirectionOrBrakeMode);
+        setSpeedPWM(tNewSpeedPWM, CurrentDirectionOrBrakeMode);
     }
     return (CurrentSpeedPWM > 0); // current speed == 0
 }
@@ -318,6 +552,12 @@ bool EncoderMotor::updateMotor()
  */
 void EncoderMotor::synchronizeMotor(EncoderMotor *aOtherMotorControl, unsigned int aCheckInterval)
 {
+#ifdef USE_SPEED_CONTROL
+    // Each motor is already controlled to the nominal speed of its RequestedDriveSpeedPWM
+    (void)aOtherMotorControl;
+    (void)aCheckInterval;
+    return;
+#endif
     if (CurrentDirectionOrBrakeMode != DIRECTION_FORWARD || aOtherMotorControl->CurrentDirectionOrBrakeMode != DIRECTION_FORWARD)
     {
         return;
@@ -331,7 +571,7 @@ void EncoderMotor::synchronizeMotor(EncoderMotor *aOtherMotorControl, unsigned i
         if ((MotorRampState == MOTOR_STATE_STOPPED && aOtherMotorControl->MotorRampState == MOTOR_STATE_STOPPED && CurrentSpeedPWM > 0) || (MotorRampState == MOTOR_STATE_DRIVE && aOtherMotorControl->MotorRampState == MOTOR_STATE_DRIVE))
         {
             MotorControlValuesHaveChanged = false;
-            if (EncoderCount >= (aOtherMotorControl->EncoderCount + 2))
+            if (EncoderCount >= (aOtherMotorControl->EncoderCount + 2 * ENCODER_COUNTS_PER_SLOT))
             {
                 EncoderCount = aOtherMotorControl->EncoderCount;
                 /*
@@ -352,11 +592,11 @@ void EncoderMotor::synchronizeMotor(EncoderMotor *aOtherMotorControl, unsigned i
                      */
                     SpeedPWMCompensation += 2;
                     CurrentSpeedPWM -= 2;
-                    PWMDcMotor::setSpeedPWM(CurrentSpeedPWM, DIRECTION_FORWARD);
+                    setSpeedPWM(CurrentSpeedPWM, DIRECTION_FORWARD);
                     MotorControlValuesHaveChanged = true;
                 }
             }
-            else if (aOtherMotorControl->EncoderCount >= (EncoderCount + 2))
+            else if (aOtherMotorControl->EncoderCount >= (EncoderCount + 2 * ENCODER_COUNTS_PER_SLOT))
             {
                 aOtherMotorControl->EncoderCount = EncoderCount;
                 /*
@@ -366,7 +606,7 @@ void EncoderMotor::synchronizeMotor(EncoderMotor *aOtherMotorControl, unsigned i
                 {
                     SpeedPWMCompensation -= 2;
                     CurrentSpeedPWM += 2;
-                    PWMDcMotor::setSpeedPWM(CurrentSpeedPWM, DIRECTION_FORWARD);
+                    setSpeedPWM(CurrentSpeedPWM, DIRECTION_FORWARD);
                     MotorControlValuesHaveChanged = true;
                 }
                 else if (aOtherMotorControl->CurrentSpeedPWM > aOtherMotorControl->DriveSpeedPWM / 2)
@@ -384,13 +624,16 @@ void EncoderMotor::synchronizeMotor(EncoderMotor *aOtherMotorControl, unsigned i
     }
 }
 
+/*
+ * @param aRequestedDistanceTicks in encoder counts, i.e. ENCODER_COUNTS_PER_SLOT per slot, like EncoderCount
+ */
 void EncoderMotor::wheelGoDistanceTicks(int aRequestedDistanceTicks, uint8_t aRequestedSpeedPWM, uint8_t aRequestedDirection)
 {
     stopFlag = true;
     startCount = 0;
     stopCount = aRequestedDistanceTicks;
     // EncoderCount;
-    PWMDcMotor::setSpeedPWM(aRequestedSpeedPWM, aRequestedDirection);
+    setSpeedPWM(aRequestedSpeedPWM, aRequestedDirection);
 }
 
 /*************************
@@ -413,19 +656,86 @@ void EncoderMotor::initEncoderControlValues()
     EncoderCount = 0;
     // initialize for timeout detection
     LastEncoderInterruptMillis = millis() - ENCODER_SENSOR_RING_MILLIS - 1;
+#ifdef USE_MICROS_FOR_ENCODER_PERIOD
+    LastEncoderInterruptMicros = micros() - ENCODER_SENSOR_RING_MICROS - 1;
+#endif
 }
 
 /*
  * Reset EncoderInterruptDeltaMillis, EncoderInterruptMillisArray, MillisArrayIndex and AverageSpeedIsValid
+ * or EncoderInterruptDeltaMicros, EncoderPeriodArray, PeriodArrayIndex and AverageSpeedIsValid
  */
 void EncoderMotor::resetSpeedValues()
 {
-#ifdef SUPPORT_AVERAGE_SPEED
+#ifdef USE_MICROS_FOR_ENCODER_PERIOD
+#  ifdef SUPPORT_AVERAGE_SPEED
+    memset((void *)&EncoderInterruptDeltaMicros, 0,
+           ((uint8_t *)&AverageSpeedIsValid + sizeof(AverageSpeedIsValid)) - (uint8_t *)&EncoderInterruptDeltaMicros);
+#  else
+    EncoderInterruptDeltaMicros = 0;
+#  endif
+#else
+#  ifdef SUPPORT_AVERAGE_SPEED
     memset((void *)&EncoderInterruptDeltaMillis, 0,
            ((uint8_t *)&AverageSpeedIsValid + sizeof(AverageSpeedIsValid)) - (uint8_t *)&EncoderInterruptDeltaMillis);
-#else
+#  else
     EncoderInterruptDeltaMillis = 0;
+#  endif
+#endif
+}
+
+/*
+ * Copies all values written by handleEncoderInterrupt() without disabling interrupts.
+ * The copy is repeated, if an interrupt occurred while copying.
+ */
+void EncoderMotor::getEncoderSnapshot(EncoderSnapshotStruct *aSnapshot)
+{
+    uint8_t tSequence;
+    do
+    {
+        tSequence = EncoderSnapshotSequence;
+        aSnapshot->EncoderCount = EncoderCount;
+        aSnapshot->LastRideEncoderCount = LastRideEncoderCount;
+        aSnapshot->LastEncoderInterruptMillis = LastEncoderInterruptMillis;
+#ifdef USE_MICROS_FOR_ENCODER_PERIOD
+        aSnapshot->LastEncoderInterruptMicros = LastEncoderInterruptMicros;
+        aSnapshot->EncoderInterruptDeltaMicros = EncoderInterruptDeltaMicros;
+#  ifdef SUPPORT_AVERAGE_SPEED
+        aSnapshot->AverageSpeedPeriodSum = PeriodArraySum;
+        aSnapshot->AverageSpeedNumberOfPeriods = (AverageSpeedIsValid) ? AVERAGE_SPEED_SAMPLE_SIZE : PeriodArrayIndex;
+#  endif
+#else
+        aSnapshot->EncoderInterruptDeltaMillis = EncoderInterruptDeltaMillis;
+#  ifdef SUPPORT_AVERAGE_SPEED
+        /*
+         * MillisArrayIndex points to the next value to write == the oldest value to overwrite
+         */
+        int8_t tNewestIndex = MillisArrayIndex - 1;
+        uint8_t tOldestIndex = 0;
+        aSnapshot->AverageSpeedNumberOfPeriods = tNewestIndex; // here MillisArray is not completely filled and had no wrap around
+        if (AverageSpeedIsValid)
+        {
+            tOldestIndex = MillisArrayIndex;
+            if (tNewestIndex < 0)
+            {
+                // wrap around
+                tNewestIndex = AVERAGE_SPEED_BUFFER_SIZE - 1;
+            }
+            aSnapshot->AverageSpeedNumberOfPeriods = AVERAGE_SPEED_SAMPLE_SIZE;
+        }
+        else if (tNewestIndex <= 0)
+        {
+            tNewestIndex = 0;
+            aSnapshot->AverageSpeedNumberOfPeriods = 0;
+        }
+        aSnapshot->AverageSpeedPeriodSum = (unsigned int) (EncoderInterruptMillisArray[tNewestIndex]
+                - EncoderInterruptMillisArray[tOldestIndex]);
+#  endif
 #endif
+#ifdef USE_QUADRATURE_ENCODER
+        aSnapshot->EncoderPosition = EncoderPosition;
+#endif
+    } while ((tSequence & 0x01) || tSequence != EncoderSnapshotSequence);
 }
 
 uint8_t EncoderMotor::getDirection()
@@ -433,181 +743,1126 @@ uint8_t EncoderMotor::getDirection()
     return LastDirection;
 }
 
+/*
+ * Copies only LastRideEncoderCount, since this is called for each update of the motors
+ */
 unsigned int EncoderMotor::getDistanceMillimeter()
 {
-    return LastRideEncoderCount * FACTOR_COUNT_TO_MILLIMETER_INTEGER_DEFAULT;
+    EncoderSnapshotStruct tSnapshot;
+    uint8_t tSequence;
+    do
+    {
+        tSequence = EncoderSnapshotSequence;
+        tSnapshot.LastRideEncoderCount = LastRideEncoderCount;
+    } while ((tSequence & 0x01) || tSequence != EncoderSnapshotSequence);
+    return getDistanceMillimeter(&tSnapshot);
+}
+
+unsigned int EncoderMotor::getDistanceMillimeter(EncoderSnapshotStruct *aSnapshot)
+{
+#ifdef USE_QUADRATURE_ENCODER
+    return ((unsigned long) aSnapshot->LastRideEncoderCount * FACTOR_COUNT_TO_MILLIMETER_INTEGER_DEFAULT) / ENCODER_COUNTS_PER_SLOT;
+#else
+    return aSnapshot->LastRideEncoderCount * FACTOR_COUNT_TO_MILLIMETER_INTEGER_DEFAULT;
+#endif
 }
 
 unsigned int EncoderMotor::getDistanceCentimeter()
 {
-    return (LastRideEncoderCount * FACTOR_COUNT_TO_MILLIMETER_INTEGER_DEFAULT) / 10;
+    return getDistanceMillimeter() / 10;
 }
 
+/*
+ * Braking distance for the stop at target distance, which is always done with MOTOR_BRAKE
+ */
 unsigned int EncoderMotor::getBrakingDistanceMillimeter()
 {
+#ifdef USE_LEARNED_BRAKING_DISTANCE
+    return getBrakingDistanceMillimeter(MOTOR_BRAKE);
+#else
     unsigned int tSpeedCmPerSecond = getSpeed();
     //    return (tSpeedCmPerSecond * tSpeedCmPerSecond * 100) / RAMP_DECELERATION_TIMES_2; // overflow!
     return (tSpeedCmPerSecond * tSpeedCmPerSecond) / (RAMP_DECELERATION_TIMES_2 / 100);
+#endif
 }
 
+#ifdef USE_LEARNED_BRAKING_DISTANCE
 /*
- * Speed is in cm/s for a 20 slot encoder disc
- * Reset speed values after 1 second
+ * @param aStopMode MOTOR_BRAKE or MOTOR_RELEASE
  */
-unsigned int EncoderMotor::getSpeed()
+unsigned int EncoderMotor::getBrakingDistanceMillimeter(uint8_t aStopMode)
 {
-    if (millis() - LastEncoderInterruptMillis > 1000)
-    {
-        resetSpeedValues(); // Reset speed values after 1 second
-    }
-    unsigned long tEncoderInterruptDeltaMillis = EncoderInterruptDeltaMillis;
-    if (tEncoderInterruptDeltaMillis == 0)
-    {
-        return 0;
-    }
-    return (SPEED_SCALE_VALUE / tEncoderInterruptDeltaMillis);
+    return BrakingModel.getBrakingDistanceMillimeter(getSpeedMillimeterPerSecond(), aStopMode);
 }
 
-#ifdef SUPPORT_AVERAGE_SPEED
 /*
- * Speed is in cm/s for a 20 slot encoder disc
- * Average is computed over the full revolution to compensate for unequal distances of the laser cut encoder discs.
- * If we do not have 21 timestamps, average is computed over the existing ones
+ * Distance of the last encoder count plus the distance driven with the current speed since this count.
+ * The 11 mm of one count are too coarse for the braking distance.
  */
-unsigned int EncoderMotor::getAverageSpeed()
+unsigned int EncoderMotor::getInterpolatedDistanceMillimeter()
 {
-    int tAverageSpeed = 0;
-    /*
-     * First check for timeout
-     */
-    if (millis() - LastEncoderInterruptMillis > 1000)
-    {
-        resetSpeedValues(); // Reset speed values after 1 second
-    }
-    else
+#ifdef USE_QUADRATURE_ENCODER
+    // The time of the last count is not stored, so take the middle between the last and the next count
+    return getDistanceMillimeter() + (FACTOR_COUNT_TO_MILLIMETER_INTEGER_DEFAULT / (2 * ENCODER_COUNTS_PER_SLOT));
+#else
+    EncoderSnapshotStruct tSnapshot;
+    getEncoderSnapshot(&tSnapshot);
+#  ifdef USE_MICROS_FOR_ENCODER_PERIOD
+    unsigned int tDistanceSinceLastCount = ((unsigned long) getSpeedMillimeterPerSecond(&tSnapshot)
+            * (micros() - tSnapshot.LastEncoderInterruptMicros)) / MICROS_IN_ONE_SECOND;
+#  else
+    unsigned int tDistanceSinceLastCount = ((unsigned long) getSpeedMillimeterPerSecond(&tSnapshot)
+            * (millis() - tSnapshot.LastEncoderInterruptMillis)) / MILLIS_IN_ONE_SECOND;
+#  endif
+    if (tDistanceSinceLastCount >= FACTOR_COUNT_TO_MILLIMETER_INTEGER_DEFAULT)
     {
-        int8_t tMillisArrayIndex = MillisArrayIndex;
-        if (!AverageSpeedIsValid)
-        {
-            tMillisArrayIndex--;
-            if (tMillisArrayIndex > 0)
-            {
-                // here MillisArray is not completely filled and MillisArrayIndex had no wrap around
-                tAverageSpeed = (SPEED_SCALE_VALUE * tMillisArrayIndex) / (EncoderInterruptMillisArray[tMillisArrayIndex] - EncoderInterruptMillisArray[0]);
-            }
-        }
-        else
-        {
-            // tMillisArrayIndex points to the next value to write == the oldest value to overwrite
-            unsigned long tOldestEncoderInterruptMillis = EncoderInterruptMillisArray[tMillisArrayIndex];
-
-            // get index of current value
-            tMillisArrayIndex--;
-            if (tMillisArrayIndex < 0)
-            {
-                // wrap around
-                tMillisArrayIndex = AVERAGE_SPEED_BUFFER_SIZE - 1;
-            }
-            tAverageSpeed = (SPEED_SCALE_VALUE * AVERAGE_SPEED_SAMPLE_SIZE) / (EncoderInterruptMillisArray[tMillisArrayIndex] - tOldestEncoderInterruptMillis);
-        }
+        tDistanceSinceLastCount = FACTOR_COUNT_TO_MILLIMETER_INTEGER_DEFAULT - 1; // we had no new count, so we are still before it
     }
-    return tAverageSpeed;
+    return getDistanceMillimeter(&tSnapshot) + tDistanceSinceLastCount;
+#endif
 }
 
 /*
- * @param aLengthOfAverage only values from 1 to 20 are valid!
+ * Every stop of a running encoder motor passes one of the functions below, also the ones by setSpeedPWM(0) or by the ramp down.
+ * A stop by a direction change is not measured, since the motor is immediately started again.
  */
-unsigned int EncoderMotor::getAverageSpeed(uint8_t aLengthOfAverage)
+void EncoderMotor::stop(uint8_t aStopMode)
 {
-    if (!AverageSpeedIsValid && MillisArrayIndex < aLengthOfAverage)
+    if (CurrentSpeedPWM > 0)
     {
-        // cannot compute requested average
-        return 0;
-    }
-    // get index of aLengthOfAverage counts before
-    int8_t tHistoricIndex = (MillisArrayIndex - 1) - aLengthOfAverage;
-    if (tHistoricIndex < 0)
-    {
-        // wrap around
-        tHistoricIndex += AVERAGE_SPEED_BUFFER_SIZE;
+        startBrakingDistanceMeasurement(aStopMode);
     }
-    int tAverageSpeed = (SPEED_SCALE_VALUE * aLengthOfAverage) / (LastEncoderInterruptMillis - EncoderInterruptMillisArray[tHistoricIndex]);
+    PWMDcMotor::stop(aStopMode);
+}
 
-    return tAverageSpeed;
+void EncoderMotor::setSpeedPWM(int aRequestedSpeedPWM)
+{
+    bool tWasRunning = (CurrentSpeedPWM > 0);
+    PWMDcMotor::setSpeedPWM(aRequestedSpeedPWM);
+    checkForStopOfRunningMotor(tWasRunning);
 }
-#endif
 
-/*
- * Print caption for Serial Plotter
- * Space but NO println() at the end, to enable additional information to be printed
- */
-void EncoderMotor::printEncoderDataCaption(Print *aSerial)
+void EncoderMotor::setSpeedPWM(uint8_t aRequestedSpeedPWM, uint8_t aRequestedDirection)
 {
-    //    aSerial->print(F("PWM[2] Speed[cm/s] SpeedAvg.Of10[cm/s] Count[22cm/20LSB] "));
-    aSerial->print(F("PWM[2] Speed[cm/s] Distance[cm] "));
+    bool tWasRunning = (CurrentSpeedPWM > 0);
+    PWMDcMotor::setSpeedPWM(aRequestedSpeedPWM, aRequestedDirection);
+    checkForStopOfRunningMotor(tWasRunning);
 }
 
-bool EncoderMotor::printEncoderDataPeriodically(Print *aSerial, uint16_t aPeriodMillis)
+void EncoderMotor::changeSpeedPWM(uint8_t aRequestedSpeedPWM)
 {
-    static unsigned long sLastPrintMillis;
+    bool tWasRunning = (CurrentSpeedPWM > 0);
+    PWMDcMotor::changeSpeedPWM(aRequestedSpeedPWM);
+    checkForStopOfRunningMotor(tWasRunning);
+}
 
-    if ((millis() - sLastPrintMillis) >= aPeriodMillis)
-    { // print data every n ms
-        sLastPrintMillis = millis();
-        printEncoderData(aSerial);
-        return true;
-    }
-    return false;
+void EncoderMotor::setSpeedPWMWithRamp(uint8_t aRequestedSpeedPWM, uint8_t aRequestedDirection)
+{
+    bool tWasRunning = (CurrentSpeedPWM > 0);
+    PWMDcMotor::setSpeedPWMWithRamp(aRequestedSpeedPWM, aRequestedDirection);
+    checkForStopOfRunningMotor(tWasRunning);
 }
 
-void EncoderMotor::printEncoderData(Print *aSerial)
+#ifndef USE_MOTION_PROFILE
+void EncoderMotor::startRampDown()
 {
-    aSerial->print(CurrentSpeedPWM / 2); // = PWM, scale it for plotter
-    aSerial->print(" ");
-    aSerial->print(getSpeed());
-    aSerial->print(" ");
-#ifdef SUPPORT_AVERAGE_SPEED
-//    aSerial->print(getAverageSpeed(10));
-//    aSerial->print(" ");
+    bool tWasRunning = (CurrentSpeedPWM > 0);
+    PWMDcMotor::startRampDown();
+    checkForStopOfRunningMotor(tWasRunning);
+}
 #endif
-    aSerial->print(getDistanceCentimeter());
-    aSerial->print(" ");
+
+/*
+ * The encoder values are not changed by PWMDcMotor::stop(), so the measurement can be started after the stop.
+ * CurrentDirectionOrBrakeMode contains the stop mode used.
+ */
+void EncoderMotor::checkForStopOfRunningMotor(bool aWasRunning)
+{
+    if (aWasRunning && CurrentSpeedPWM == 0)
+    {
+        startBrakingDistanceMeasurement(CurrentDirectionOrBrakeMode);
+    }
 }
 
-#if defined ESP32
-void IRAM_ATTR EncoderMotor::handleEncoderInterrupt()
+/*
+ * Called by stop() for a running motor, to measure the overrun of the stop
+ * @param aStopMode STOP_MODE_KEEP (take previously defined DefaultStopMode) or MOTOR_BRAKE or MOTOR_RELEASE
+ */
+void EncoderMotor::startBrakingDistanceMeasurement(uint8_t aStopMode)
 {
-#else
-void EncoderMotor::handleEncoderInterrupt()
+    if (aStopMode == STOP_MODE_KEEP)
+    {
+        aStopMode = DefaultStopMode;
+    }
+    BrakingModel.startMeasurement(getSpeedMillimeterPerSecond(), aStopMode, getInterpolatedDistanceMillimeter());
+}
+
+/*
+ * Ends the braking distance measurement if wheel is at standstill. Called by updateMotor() before a new start resets the distance.
+ * If motor was started again before standstill, the measurement is discarded.
+ */
+void EncoderMotor::updateBrakingDistanceMeasurement()
 {
-    Serial.print("handleEncoderInterrupt");
-#endif
-    long tMillis = millis();
-    unsigned long tDeltaMillis = tMillis - LastEncoderInterruptMillis;
-    if (tDeltaMillis <= ENCODER_SENSOR_RING_MILLIS)
+    if (CurrentSpeedPWM > 0 || (MotorRampState != MOTOR_STATE_STOPPED && MotorRampState != MOTOR_STATE_START))
     {
-        // assume signal is ringing and do nothing
+        BrakingModel.MeasurementIsRunning = false;
+        return;
     }
-    else
+    EncoderSnapshotStruct tSnapshot;
+    getEncoderSnapshot(&tSnapshot);
+    unsigned long tMillis = millis();
+    if (tMillis - tSnapshot.LastEncoderInterruptMillis > BRAKING_DISTANCE_STANDSTILL_MILLIS
+            && tMillis - BrakingModel.MeasurementStartMillis > BRAKING_DISTANCE_STANDSTILL_MILLIS)
     {
-        LastEncoderInterruptMillis = tMillis;
-#ifdef SUPPORT_AVERAGE_SPEED
-        uint8_t tMillisArrayIndex = MillisArrayIndex;
-#endif
-        if (tDeltaMillis < ENCODER_SENSOR_TIMEOUT_MILLIS)
+        /*
+         * The wheel stopped somewhere before the next count. If we had no count since stop, this is between the distance at stop
+         * and the next count, otherwise we take the middle between the last and the next count.
+         */
+        unsigned int tDistanceMillimeter = getDistanceMillimeter(&tSnapshot);
+        unsigned int tStandstillDistanceMillimeter = tDistanceMillimeter
+                + (FACTOR_COUNT_TO_MILLIMETER_INTEGER_DEFAULT / (2 * ENCODER_COUNTS_PER_SLOT));
+        if (tDistanceMillimeter <= BrakingModel.MeasurementStartDistanceMillimeter)
         {
-            EncoderInterruptDeltaMillis = tDeltaMillis;
+            tStandstillDistanceMillimeter = (BrakingModel.MeasurementStartDistanceMillimeter + tDistanceMillimeter
+                    + (FACTOR_COUNT_TO_MILLIMETER_INTEGER_DEFAULT / ENCODER_COUNTS_PER_SLOT)) / 2;
         }
-        else
-        {
-            // timeout
-            EncoderInterruptDeltaMillis = 0;
-#ifdef SUPPORT_AVERAGE_SPEED
-            tMillisArrayIndex = 0;
-            AverageSpeedIsValid = false;
+        BrakingModel.endMeasurement(tStandstillDistanceMillimeter);
+    }
+}
 #endif
-        }
+
+/*
+ * Speed is in cm/s for a 20 slot encoder disc
+ * Reset speed values after 1 second
+ */
+unsigned int EncoderMotor::getSpeed()
+{
+    EncoderSnapshotStruct tSnapshot;
+    getEncoderSnapshot(&tSnapshot);
+    if (millis() - tSnapshot.LastEncoderInterruptMillis > 1000)
+    {
+        resetSpeedValues(); // Reset speed values after 1 second
+        return 0;
+    }
+#ifdef USE_MICROS_FOR_ENCODER_PERIOD
+    unsigned long tEncoderInterruptDeltaMicros = tSnapshot.EncoderInterruptDeltaMicros;
+    if (tEncoderInterruptDeltaMicros == 0)
+    {
+        return 0;
+    }
+    return ((SPEED_SCALE_VALUE * MILLIS_IN_ONE_SECOND) / tEncoderInterruptDeltaMicros);
+#else
+    unsigned long tEncoderInterruptDeltaMillis = tSnapshot.EncoderInterruptDeltaMillis;
+    if (tEncoderInterruptDeltaMillis == 0)
+    {
+        return 0;
+    }
+    return (SPEED_SCALE_VALUE / tEncoderInterruptDeltaMillis);
+#endif
+}
+
+/*
+ * Speed in mm/s from the last encoder period.
+ * If the time since the last encoder interrupt is already longer than this period, the motor decelerates
+ * and this time is taken instead, so we need not to wait for the next interrupt to detect it.
+ */
+unsigned int EncoderMotor::getSpeedMillimeterPerSecond()
+{
+    EncoderSnapshotStruct tSnapshot;
+    getEncoderSnapshot(&tSnapshot);
+    return getSpeedMillimeterPerSecond(&tSnapshot);
+}
+
+/*
+ * The snapshot must be taken before, otherwise the time since the last interrupt may be negative
+ */
+unsigned int EncoderMotor::getSpeedMillimeterPerSecond(EncoderSnapshotStruct *aSnapshot)
+{
+#ifdef USE_MICROS_FOR_ENCODER_PERIOD
+    unsigned long tEncoderInterruptDeltaMicros = aSnapshot->EncoderInterruptDeltaMicros;
+    if (tEncoderInterruptDeltaMicros == 0)
+    {
+        return 0;
+    }
+    unsigned long tMicrosSinceLastInterrupt = micros() - aSnapshot->LastEncoderInterruptMicros;
+    if (tMicrosSinceLastInterrupt > tEncoderInterruptDeltaMicros)
+    {
+        tEncoderInterruptDeltaMicros = tMicrosSinceLastInterrupt;
+    }
+    return (FACTOR_COUNT_TO_MILLIMETER_INTEGER_DEFAULT * MICROS_IN_ONE_SECOND) / tEncoderInterruptDeltaMicros;
+#else
+    unsigned long tEncoderInterruptDeltaMillis = aSnapshot->EncoderInterruptDeltaMillis;
+    if (tEncoderInterruptDeltaMillis == 0)
+    {
+        return 0;
+    }
+    unsigned long tMillisSinceLastInterrupt = millis() - aSnapshot->LastEncoderInterruptMillis;
+    if (tMillisSinceLastInterrupt > tEncoderInterruptDeltaMillis)
+    {
+        tEncoderInterruptDeltaMillis = tMillisSinceLastInterrupt;
+    }
+    return (FACTOR_COUNT_TO_MILLIMETER_INTEGER_DEFAULT * MILLIS_IN_ONE_SECOND) / tEncoderInterruptDeltaMillis;
+#endif
+}
+
+#ifdef USE_SPEED_CONTROL
+/*
+ * Starts motor with ramp and controls it to aRequestedSpeedMillimeterPerSecond in MOTOR_STATE_DRIVE
+ * With USE_MOTION_PROFILE, the profile of a running motor blends to the new speed, even if it is still ramping up or down,
+ * and the exact speed is used as profile velocity, not the speed of the rounded PWM value.
+ * Speed 0 ramps down to stop. A running motor, which must change its direction, is stopped first.
+ */
+void EncoderMotor::setSpeedMillimeterPerSecond(unsigned int aRequestedSpeedMillimeterPerSecond, uint8_t aRequestedDirection)
+{
+#ifdef USE_MOTION_PROFILE
+    if (aRequestedSpeedMillimeterPerSecond == 0)
+    {
+        startRampDown();
+        return;
+    }
+    uint8_t tRequestedSpeedPWM = getSpeedPWMForMillimeterPerSecond(aRequestedSpeedMillimeterPerSecond);
+    if (CurrentSpeedPWM > 0 && (aRequestedDirection & DIRECTION_MASK) != CurrentDirectionOrBrakeMode)
+    {
+        stop(MOTOR_BRAKE);
+    }
+    if (CurrentSpeedPWM == 0)
+    {
+        setSpeedPWMWithRamp(tRequestedSpeedPWM, aRequestedDirection);
+    }
+    else
+    {
+        RequestedDriveSpeedPWM = tRequestedSpeedPWM;
+        CheckDistanceInUpdateMotor = false;
+        if (MotorRampState == MOTOR_STATE_RAMP_DOWN)
+        {
+            MotorRampState = MOTOR_STATE_DRIVE;
+        }
+    }
+    RequestedDriveMillimeterPerSecond = aRequestedSpeedMillimeterPerSecond;
+#else
+    setSpeedPWMWithRamp(getSpeedPWMForMillimeterPerSecond(aRequestedSpeedMillimeterPerSecond), aRequestedDirection);
+#endif
+}
+
+#ifdef USE_MOTION_PROFILE
+/*
+ * Ramp down to velocity 0 with the motion profile and stop
+ */
+void EncoderMotor::startRampDown()
+{
+    if (CurrentSpeedPWM == 0)
+    {
+        return;
+    }
+    MotorRampState = MOTOR_STATE_RAMP_DOWN;
+    CheckDistanceInUpdateMotor = false;
+}
+
+/*
+ * @return the speed of setSpeedMillimeterPerSecond() or the speed of RequestedDriveSpeedPWM, if it was set by another function
+ */
+unsigned int EncoderMotor::getRequestedDriveMillimeterPerSecond()
+{
+    if (RequestedDriveMillimeterPerSecond != 0
+            && getSpeedPWMForMillimeterPerSecond(RequestedDriveMillimeterPerSecond) == RequestedDriveSpeedPWM)
+    {
+        return RequestedDriveMillimeterPerSecond;
+    }
+    return getMillimeterPerSecondForSpeedPWM(RequestedDriveSpeedPWM);
+}
+
+/*
+ * Scales acceleration, jerk and minimum velocity of the profile by aScaleTimes256 / 256, e.g. for the wheel with the smaller
+ * velocity change of a car, so that both wheels reach their new velocities at the same time.
+ * Since the profile is scale invariant, the scaled profile is the profile with the default limits multiplied by the scale.
+ * Must be called after the function, which starts the motor. Each start of the profile applies the scale and resets it,
+ * so the next start uses the default limits again. For a running profile, the scale is applied immediately.
+ * @param aScaleTimes256 1 to 256, 0 is taken as 1, since it is the result of a scale, which is rounded down
+ */
+void EncoderMotor::setProfileLimitScale(uint16_t aScaleTimes256)
+{
+    if (aScaleTimes256 == 0)
+    {
+        aScaleTimes256 = 1; // the smallest limits and not the default ones
+    }
+    ProfileLimitScaleTimes256 = aScaleTimes256;
+    if (CurrentSpeedPWM > 0 && MotorRampState != MOTOR_STATE_START)
+    {
+        applyProfileLimitScale();
+    }
+}
+
+void EncoderMotor::applyProfileLimitScale()
+{
+    uint16_t tScaleTimes256 = ProfileLimitScaleTimes256;
+    if (tScaleTimes256 == 0 || tScaleTimes256 > 256)
+    {
+        tScaleTimes256 = 256; // no scale set by setProfileLimitScale() since the last start
+    }
+    Profile.setLimits(((uint32_t) MOTION_PROFILE_MAX_ACCELERATION * tScaleTimes256) / 256,
+            ((uint32_t) MOTION_PROFILE_MAX_JERK * tScaleTimes256) / 256);
+    Profile.MinVelocity = ((uint32_t) MOTION_PROFILE_MIN_VELOCITY * tScaleTimes256) / 256;
+    ProfileLimitScaleTimes256 = 0;
+}
+#endif
+
+/*
+ * The first interrupt after start gives no valid period, so we need 2 slots for a speed value.
+ * If motor does not start at all or stalls again after the first slot, return true after SPEED_CONTROL_STALL_MILLIS
+ * to let the controller increase the PWM. Once the controller has increased the PWM, do not fall back to the lower open loop value.
+ */
+bool EncoderMotor::hasSpeedFeedback(EncoderSnapshotStruct *aSnapshot, unsigned long aMillis)
+{
+    return (aSnapshot->EncoderCount >= 2 * ENCODER_COUNTS_PER_SLOT || SpeedControlIntegral > 0
+            || aMillis - aSnapshot->LastEncoderInterruptMillis > SPEED_CONTROL_STALL_MILLIS);
+}
+
+void EncoderMotor::initSpeedControl()
+{
+    SpeedControlIntegral = 0;
+    NextSpeedControlMillis = millis() + SPEED_CONTROL_INTERVAL_MILLIS;
+}
+
+/*
+ * The motor follows a PWM change with its mechanical time constant, so the feed forward value for an accelerating target
+ * is taken for the speed, which is reached after SPEED_CONTROL_ACCELERATION_FEED_FORWARD_MILLIS with this acceleration.
+ * Without it, the speed lags behind the target while accelerating and the integral has to catch up.
+ */
+unsigned int EncoderMotor::getFeedForwardMillimeterPerSecond(unsigned int aTargetMillimeterPerSecond,
+        int aTargetAccelerationMillimeterPerSecond2)
+{
+    long tFeedForwardMillimeterPerSecond = aTargetMillimeterPerSecond
+            + ((long)aTargetAccelerationMillimeterPerSecond2 * SPEED_CONTROL_ACCELERATION_FEED_FORWARD_MILLIS) / MILLIS_IN_ONE_SECOND;
+    if (tFeedForwardMillimeterPerSecond < 0)
+    {
+        tFeedForwardMillimeterPerSecond = 0;
+    }
+    return tFeedForwardMillimeterPerSecond;
+}
+
+/*
+ * PI controller with the PWM of aTargetMillimeterPerSecond as feed forward value.
+ * The integral is only updated if the output is not clipped, to avoid windup at start or if wheels are blocked or spinning.
+ * At the lower limit, it is still increased, so that a motor, which does not start at SPEED_CONTROL_MIN_PWM, gets more PWM.
+ * As long as the motor is turning, the lower limit is SPEED_CONTROL_MIN_TURNING_PWM, so it can follow low speeds,
+ * e.g. of the inner wheel of an arc or of the end of a ramp.
+ * @param aTargetAccelerationMillimeterPerSecond2 - Acceleration of the target speed, e.g. of the motion profile. Only used for the feed forward value.
+ * @return new PWM value between SPEED_CONTROL_MIN_PWM and MAX_SPEED_PWM
+ */
+uint8_t EncoderMotor::computeSpeedControlPWM(unsigned int aTargetMillimeterPerSecond, int aTargetAccelerationMillimeterPerSecond2)
+{
+#ifdef USE_SPEED_CONTROL_AUTOTUNE
+    uint16_t tKpTimes256 = SpeedControlKpTimes256;
+    uint16_t tKiTimes256 = SpeedControlKiTimes256;
+    int tIntegralLimit = SpeedControlIntegralLimit;
+#else
+    const uint16_t tKpTimes256 = SPEED_CONTROL_KP_TIMES_256;
+    const uint16_t tKiTimes256 = SPEED_CONTROL_KI_TIMES_256;
+    const int tIntegralLimit = SPEED_CONTROL_INTEGRAL_LIMIT;
+#endif
+    EncoderSnapshotStruct tSnapshot;
+    getEncoderSnapshot(&tSnapshot);
+    uint8_t tMinSpeedPWM = SPEED_CONTROL_MIN_PWM;
+    if (tSnapshot.EncoderCount >= 2 * ENCODER_COUNTS_PER_SLOT && millis() - tSnapshot.LastEncoderInterruptMillis < SPEED_CONTROL_STALL_MILLIS)
+    {
+        tMinSpeedPWM = SPEED_CONTROL_MIN_TURNING_PWM;
+    }
+    unsigned int tSpeed = 0; // without a count since start, the speed is from the period of the last ride
+    if (tSnapshot.EncoderCount > 0)
+    {
+        tSpeed = getSpeedMillimeterPerSecond(&tSnapshot);
+    }
+    int tSpeedError = (int)aTargetMillimeterPerSecond - (int)tSpeed;
+    int tNewIntegral = SpeedControlIntegral + tSpeedError;
+    if (tNewIntegral > tIntegralLimit)
+    {
+        tNewIntegral = tIntegralLimit;
+    }
+    else if (tNewIntegral < -tIntegralLimit)
+    {
+        tNewIntegral = -tIntegralLimit;
+    }
+    long tProportionalSpeedPWM = getFeedForwardSpeedPWM(
+            getFeedForwardMillimeterPerSecond(aTargetMillimeterPerSecond, aTargetAccelerationMillimeterPerSecond2), LastDirection)
+            + ((long)tSpeedError * tKpTimes256) / 256;
+    long tSpeedPWM = tProportionalSpeedPWM + ((long)tNewIntegral * tKiTimes256) / 256;
+#ifdef USE_TRACTION_CONTROL
+    uint8_t tMaxSpeedPWM = MAX_SPEED_PWM;
+    if (TractionControlSpeedPWMLimit != 0)
+    {
+        tMaxSpeedPWM = TractionControlSpeedPWMLimit; // no windup while the PWM of a spinning wheel is reduced
+    }
+    if (tSpeedPWM > tMaxSpeedPWM)
+    {
+        tSpeedPWM = tMaxSpeedPWM;
+    }
+#else
+    if (tSpeedPWM > MAX_SPEED_PWM)
+    {
+        tSpeedPWM = MAX_SPEED_PWM;
+    }
+#endif
+    else if (tSpeedPWM < tMinSpeedPWM)
+    {
+        tSpeedPWM = tMinSpeedPWM;
+        if (tSpeedError > 0)
+        {
+            /*
+             * Continue from the integral, which gives tMinSpeedPWM, otherwise a motor, which does not start at a low target speed,
+             * needs longer than ENCODER_SENSOR_TIMEOUT_MILLIS to get more PWM
+             */
+            long tIntegralAtMinSpeedPWM = ((tMinSpeedPWM - tProportionalSpeedPWM) * 256) / max(tKiTimes256, (uint16_t)1);
+            if (tNewIntegral < tIntegralAtMinSpeedPWM)
+            {
+                tNewIntegral = min(tIntegralAtMinSpeedPWM, (long)tIntegralLimit);
+            }
+            SpeedControlIntegral = tNewIntegral;
+        }
+    }
+    else
+    {
+        SpeedControlIntegral = tNewIntegral;
+    }
+    return tSpeedPWM;
+}
+
+/*
+ * @return PWM from speed PWM table if calibrated, else the nominal PWM
+ */
+uint8_t EncoderMotor::getFeedForwardSpeedPWM(unsigned int aMillimeterPerSecond, uint8_t aDirection)
+{
+#ifdef USE_SPEED_PWM_TABLE
+    uint8_t *tSpeedPWMTable = SpeedPWMTable[aDirection & DIRECTION_MASK];
+    if (tSpeedPWMTable[0] != 0)
+    {
+        if (aMillimeterPerSecond == 0)
+        {
+            return 0;
+        }
+        /*
+         * Interpolate between 2 entries, above the last entry extrapolate the last segment
+         */
+        uint8_t tIndex = aMillimeterPerSecond / SPEED_PWM_TABLE_MILLIMETER_PER_SECOND_STEP;
+        if (tIndex > SPEED_PWM_TABLE_SIZE - 2)
+        {
+            tIndex = SPEED_PWM_TABLE_SIZE - 2;
+        }
+        unsigned int tRemainder = aMillimeterPerSecond - (tIndex * SPEED_PWM_TABLE_MILLIMETER_PER_SECOND_STEP);
+        unsigned long tSpeedPWM = tSpeedPWMTable[tIndex]
+                + ((unsigned long)(tSpeedPWMTable[tIndex + 1] - tSpeedPWMTable[tIndex]) * tRemainder) / SPEED_PWM_TABLE_MILLIMETER_PER_SECOND_STEP;
+        if (tSpeedPWM > MAX_SPEED_PWM)
+        {
+            tSpeedPWM = MAX_SPEED_PWM;
+        }
+        return tSpeedPWM;
+    }
+#endif
+    return getSpeedPWMForMillimeterPerSecond(aMillimeterPerSecond);
+}
+#endif
+
+#ifdef USE_SPEED_PWM_TABLE
+/*
+ * Clears the table of aDirection at start of ramp up
+ */
+void EncoderMotor::startSpeedPWMTableCalibration(uint8_t aDirection, bool aIsRampUp)
+{
+    SpeedPWMTableCalibrationIsRampUp = aIsRampUp;
+    if (aIsRampUp)
+    {
+        memset(SpeedPWMTable[aDirection & DIRECTION_MASK], 0, SPEED_PWM_TABLE_SIZE);
+        SpeedPWMTableCalibrationIndex = 0;
+    }
+    else
+    {
+        SpeedPWMTableCalibrationIndex = SPEED_PWM_TABLE_SIZE - 1;
+    }
+}
+
+/*
+ * Ramp up stores the first PWM, where the speed of an entry is reached.
+ * Ramp down averages an entry with the last PWM, where its speed was not yet undershot.
+ * @param aSpeedPWM - the PWM set for the current direction SPEED_PWM_TABLE_CALIBRATION_STEP_MILLIS before
+ */
+void EncoderMotor::addSpeedPWMTableCalibrationValue(uint8_t aSpeedPWM)
+{
+    uint8_t *tSpeedPWMTable = SpeedPWMTable[LastDirection];
+    unsigned int tSpeed = getSpeedMillimeterPerSecond();
+    if (SpeedPWMTableCalibrationIsRampUp)
+    {
+        while (SpeedPWMTableCalibrationIndex < SPEED_PWM_TABLE_SIZE
+                && tSpeed >= SpeedPWMTableCalibrationIndex * SPEED_PWM_TABLE_MILLIMETER_PER_SECOND_STEP && tSpeed > 0)
+        {
+            tSpeedPWMTable[SpeedPWMTableCalibrationIndex++] = aSpeedPWM;
+        }
+    }
+    else
+    {
+        // Entry 0 is not averaged, since the motor stops at a lower PWM than it starts
+        while (SpeedPWMTableCalibrationIndex > 0 && tSpeed < SpeedPWMTableCalibrationIndex * SPEED_PWM_TABLE_MILLIMETER_PER_SECOND_STEP)
+        {
+            uint8_t tRampUpSpeedPWM = tSpeedPWMTable[SpeedPWMTableCalibrationIndex];
+            if (tRampUpSpeedPWM != 0)
+            {
+                tSpeedPWMTable[SpeedPWMTableCalibrationIndex] = (tRampUpSpeedPWM + aSpeedPWM + 1) / 2;
+            }
+            SpeedPWMTableCalibrationIndex--;
+        }
+    }
+}
+
+/*
+ * Make table monotonic and set entries for speeds not reached to MAX_SPEED_PWM
+ */
+void EncoderMotor::endSpeedPWMTableCalibration(uint8_t aDirection)
+{
+    uint8_t *tSpeedPWMTable = SpeedPWMTable[aDirection & DIRECTION_MASK];
+    if (tSpeedPWMTable[0] == 0)
+    {
+        return; // motor did not move
+    }
+    for (uint_fast8_t i = 1; i < SPEED_PWM_TABLE_SIZE; ++i)
+    {
+        if (tSpeedPWMTable[i] == 0)
+        {
+            tSpeedPWMTable[i] = MAX_SPEED_PWM;
+        }
+        else if (tSpeedPWMTable[i] < tSpeedPWMTable[i - 1])
+        {
+            tSpeedPWMTable[i] = tSpeedPWMTable[i - 1];
+        }
+    }
+}
+
+void EncoderMotor::printSpeedPWMTable(Print *aSerial)
+{
+    for (uint_fast8_t tDirection = DIRECTION_FORWARD; tDirection <= DIRECTION_BACKWARD; ++tDirection)
+    {
+        aSerial->print(sMotorModeCharArray[tDirection]);
+        aSerial->print(F(" SpeedPWMTable="));
+        for (uint_fast8_t i = 0; i < SPEED_PWM_TABLE_SIZE; ++i)
+        {
+            aSerial->print(SpeedPWMTable[tDirection][i]);
+            aSerial->print(' ');
+        }
+        aSerial->println();
+    }
+}
+
+#if defined(E2END)
+/*
+ * Tables are stored behind the EepromMotorInfoStruct's. Table is only read, if version matches.
+ */
+void EncoderMotor::readSpeedPWMTableFromEeprom(uint8_t aMotorValuesEepromStorageNumber)
+{
+    EepromSpeedPWMTableStruct tEepromSpeedPWMTable;
+#if defined(_STM32_DEF_)
+    EEPROM.get(EEPROM_SPEED_PWM_TABLE_START + (aMotorValuesEepromStorageNumber * sizeof(EepromSpeedPWMTableStruct)),
+               tEepromSpeedPWMTable);
+#else
+    eeprom_read_block((void *)&tEepromSpeedPWMTable,
+                      (void *)(EEPROM_SPEED_PWM_TABLE_START + (aMotorValuesEepromStorageNumber * sizeof(EepromSpeedPWMTableStruct))),
+                      sizeof(EepromSpeedPWMTableStruct));
+#endif
+    if (tEepromSpeedPWMTable.Version == SPEED_PWM_TABLE_VERSION)
+    {
+        memcpy(SpeedPWMTable, tEepromSpeedPWMTable.SpeedPWM, sizeof(SpeedPWMTable));
+    }
+}
+
+void EncoderMotor::writeSpeedPWMTableToEeprom(uint8_t aMotorValuesEepromStorageNumber)
+{
+    EepromSpeedPWMTableStruct tEepromSpeedPWMTable;
+    tEepromSpeedPWMTable.Version = SPEED_PWM_TABLE_VERSION;
+    memcpy(tEepromSpeedPWMTable.SpeedPWM, SpeedPWMTable, sizeof(SpeedPWMTable));
+#if defined(_STM32_DEF_)
+    EEPROM.put(EEPROM_SPEED_PWM_TABLE_START + (aMotorValuesEepromStorageNumber * sizeof(EepromSpeedPWMTableStruct)),
+               tEepromSpeedPWMTable);
+#else
+    // update saves EEPROM write cycles, if calibration is repeated
+    eeprom_update_block((void *)&tEepromSpeedPWMTable,
+                        (void *)(EEPROM_SPEED_PWM_TABLE_START + (aMotorValuesEepromStorageNumber * sizeof(EepromSpeedPWMTableStruct))),
+                        sizeof(EepromSpeedPWMTableStruct));
+#endif
+}
+#endif // defined(E2END)
+#endif // USE_SPEED_PWM_TABLE
+
+#ifdef USE_SPEED_CONTROL_AUTOTUNE
+/*
+ * The integral limit is computed here, since the division is too expensive for each speed control step
+ * @param aKiTimes256 0 is taken as 1, i.e. the smallest integral gain, like SpeedControlAutotune::computeGains() does
+ */
+void EncoderMotor::setSpeedControlGains(uint16_t aKpTimes256, uint16_t aKiTimes256)
+{
+    if (aKiTimes256 == 0)
+    {
+        aKiTimes256 = 1;
+    }
+    SpeedControlKpTimes256 = aKpTimes256;
+    SpeedControlKiTimes256 = aKiTimes256;
+    long tIntegralLimit = (256L * MAX_SPEED_PWM) / aKiTimes256;
+    if (tIntegralLimit > 0x3FFF)
+    {
+        tIntegralLimit = 0x3FFF; // The integral plus a speed error must fit into an int
+    }
+    SpeedControlIntegralLimit = tIntegralLimit;
+}
+
+/*
+ * Passes the current speed to aAutotune and sets the returned PWM. Must be called every SPEED_CONTROL_INTERVAL_MILLIS.
+ */
+void EncoderMotor::updateSpeedControlAutotune(SpeedControlAutotune *aAutotune)
+{
+    setSpeedPWM(aAutotune->update(getSpeedMillimeterPerSecond(), millis()), LastDirection);
+}
+
+/*
+ * @return false if the oscillation was not finished, gains are not changed then
+ */
+bool EncoderMotor::setSpeedControlGainsFromAutotune(SpeedControlAutotune *aAutotune)
+{
+    uint16_t tKpTimes256, tKiTimes256;
+    if (!aAutotune->computeGains(&tKpTimes256, &tKiTimes256))
+    {
+        return false;
+    }
+    setSpeedControlGains(tKpTimes256, tKiTimes256);
+    return true;
+}
+
+/*
+ * Prints e.g. "SpeedControl KpTimes256=40 KiTimes256=8"
+ */
+void EncoderMotor::printSpeedControlGains(Print *aSerial)
+{
+    aSerial->print(F("SpeedControl KpTimes256="));
+    aSerial->print(SpeedControlKpTimes256);
+    aSerial->print(F(" KiTimes256="));
+    aSerial->println(SpeedControlKiTimes256);
+}
+
+#if defined(E2END)
+/*
+ * Gains are stored behind the speed PWM tables. Gains are only read, if version matches.
+ */
+void EncoderMotor::readSpeedControlGainsFromEeprom(uint8_t aMotorValuesEepromStorageNumber)
+{
+    EepromSpeedControlGainsStruct tEepromSpeedControlGains;
+#if defined(_STM32_DEF_)
+    EEPROM.get(EEPROM_SPEED_CONTROL_GAINS_START + (aMotorValuesEepromStorageNumber * sizeof(EepromSpeedControlGainsStruct)),
+               tEepromSpeedControlGains);
+#else
+    eeprom_read_block((void *)&tEepromSpeedControlGains,
+                      (void *)(EEPROM_SPEED_CONTROL_GAINS_START + (aMotorValuesEepromStorageNumber * sizeof(EepromSpeedControlGainsStruct))),
+                      sizeof(EepromSpeedControlGainsStruct));
+#endif
+    if (tEepromSpeedControlGains.Version == SPEED_CONTROL_GAINS_VERSION && tEepromSpeedControlGains.KiTimes256 != 0)
+    {
+        setSpeedControlGains(tEepromSpeedControlGains.KpTimes256, tEepromSpeedControlGains.KiTimes256);
+    }
+}
+
+void EncoderMotor::writeSpeedControlGainsToEeprom(uint8_t aMotorValuesEepromStorageNumber)
+{
+    EepromSpeedControlGainsStruct tEepromSpeedControlGains;
+    tEepromSpeedControlGains.Version = SPEED_CONTROL_GAINS_VERSION;
+    tEepromSpeedControlGains.KpTimes256 = SpeedControlKpTimes256;
+    tEepromSpeedControlGains.KiTimes256 = SpeedControlKiTimes256;
+#if defined(_STM32_DEF_)
+    EEPROM.put(EEPROM_SPEED_CONTROL_GAINS_START + (aMotorValuesEepromStorageNumber * sizeof(EepromSpeedControlGainsStruct)),
+               tEepromSpeedControlGains);
+#else
+    eeprom_update_block((void *)&tEepromSpeedControlGains,
+                        (void *)(EEPROM_SPEED_CONTROL_GAINS_START + (aMotorValuesEepromStorageNumber * sizeof(EepromSpeedControlGainsStruct))),
+                        sizeof(EepromSpeedControlGainsStruct));
+#endif
+}
+#endif // defined(E2END)
+#endif // USE_SPEED_CONTROL_AUTOTUNE
+
+#ifdef USE_MOTOR_MODEL_IDENTIFICATION
+/*
+ * Passes the last encoder period to aIdentification, which ignores it, if it was already added
+ */
+void EncoderMotor::addMotorModelSample(MotorModelIdentification *aIdentification)
+{
+    EncoderSnapshotStruct tSnapshot;
+    getEncoderSnapshot(&tSnapshot);
+    aIdentification->addSample(tSnapshot.LastEncoderInterruptMicros, tSnapshot.EncoderInterruptDeltaMicros);
+}
+
+/*
+ * @return Acceleration in mm/s^2 with MAX_SPEED_PWM at the speed of DriveSpeedPWM, 0 if model is not identified
+ */
+unsigned int EncoderMotor::getMotorModelAcceleration(uint8_t aDirection)
+{
+    MotorModelStruct *tModel = &MotorModel[aDirection & DIRECTION_MASK];
+    if (tModel->StartSpeedPWM == 0 || tModel->TimeConstantMillis == 0)
+    {
+        return 0;
+    }
+    // Scaled by 1/8 to avoid overflow
+    unsigned long tAcceleration = ((unsigned long) tModel->GainTimes256 * (MAX_SPEED_PWM - DriveSpeedPWM) * (MILLIS_IN_ONE_SECOND / 8))
+            / ((unsigned long) tModel->TimeConstantMillis * (256 / 8));
+    return (tAcceleration > 0xFFFF) ? 0xFFFF : tAcceleration;
+}
+
+/*
+ * Prints the model and the values of the macros, which are tuned by hand without model, e.g.
+ * "F StartPWM=84 StopPWM=50 Gain=6.66 TimeConstant=80 DEFAULT_START_MILLIVOLT=1713 DEFAULT_MILLIMETER_PER_SECOND=320
+ *  RAMP_VALUE_OFFSET_MILLIVOLT=1713 MOTION_PROFILE_MAX_ACCELERATION=6535"
+ * Gain is in mm/s per PWM and TimeConstant in ms.
+ * RAMP_VALUE_OFFSET_MILLIVOLT is the voltage, which starts the motor with at least half of RAMP_DECELERATION_TIMES_2.
+ * MOTION_PROFILE_MAX_ACCELERATION is the half of the acceleration, which the motor can achieve at DriveSpeedPWM.
+ * It is only a limit of the motor, the grip of the tires may require a lower value.
+ */
+void EncoderMotor::printMotorModel(Print *aSerial)
+{
+    for (uint_fast8_t tDirection = DIRECTION_FORWARD; tDirection <= DIRECTION_BACKWARD; ++tDirection)
+    {
+        MotorModelStruct *tModel = &MotorModel[tDirection];
+        aSerial->print(sMotorModeCharArray[tDirection]);
+        if (tModel->StartSpeedPWM == 0)
+        {
+            aSerial->println(F(" motor model not identified"));
+            continue;
+        }
+        aSerial->print(F(" StartPWM="));
+        aSerial->print(tModel->StartSpeedPWM);
+        aSerial->print(F(" StopPWM="));
+        aSerial->print(tModel->StopSpeedPWM);
+        aSerial->print(F(" Gain="));
+        aSerial->print(tModel->GainTimes256 / 256.0);
+        aSerial->print(F(" TimeConstant="));
+        aSerial->print(tModel->TimeConstantMillis);
+        aSerial->print(F(" DEFAULT_START_MILLIVOLT="));
+        aSerial->print(((long) tModel->StartSpeedPWM * FULL_BRIDGE_OUTPUT_MILLIVOLT) / MAX_SPEED_PWM);
+        aSerial->print(F(" DEFAULT_MILLIMETER_PER_SECOND="));
+        int tDriveSpeedPWMAboveStop = DEFAULT_DRIVE_SPEED_PWM - tModel->StopSpeedPWM;
+        aSerial->print((long) tModel->GainTimes256 * (tDriveSpeedPWMAboveStop > 0 ? tDriveSpeedPWMAboveStop : 0) / 256);
+        uint16_t tRampSpeedPWM = tModel->StopSpeedPWM
+                + ((unsigned long) (RAMP_DECELERATION_TIMES_2 / 2) * tModel->TimeConstantMillis * 256)
+                        / ((unsigned long) tModel->GainTimes256 * MILLIS_IN_ONE_SECOND);
+        if (tRampSpeedPWM < tModel->StartSpeedPWM)
+        {
+            tRampSpeedPWM = tModel->StartSpeedPWM;
+        }
+        else if (tRampSpeedPWM > MAX_SPEED_PWM)
+        {
+            tRampSpeedPWM = MAX_SPEED_PWM;
+        }
+        aSerial->print(F(" RAMP_VALUE_OFFSET_MILLIVOLT="));
+        aSerial->print(((long) tRampSpeedPWM * FULL_BRIDGE_OUTPUT_MILLIVOLT) / MAX_SPEED_PWM);
+        aSerial->print(F(" MOTION_PROFILE_MAX_ACCELERATION="));
+        aSerial->println(getMotorModelAcceleration(tDirection) / 2);
+    }
+}
+
+#  ifdef USE_SPEED_PWM_TABLE
+/*
+ * Entry 0 is StartSpeedPWM, the other entries are the PWM of the speed line. Directions, which are not identified, are not changed.
+ */
+void EncoderMotor::setSpeedPWMTableFromMotorModel()
+{
+    for (uint_fast8_t tDirection = DIRECTION_FORWARD; tDirection <= DIRECTION_BACKWARD; ++tDirection)
+    {
+        MotorModelStruct *tModel = &MotorModel[tDirection];
+        if (tModel->StartSpeedPWM == 0)
+        {
+            continue;
+        }
+        SpeedPWMTable[tDirection][0] = tModel->StartSpeedPWM;
+        for (uint_fast8_t i = 1; i < SPEED_PWM_TABLE_SIZE; ++i)
+        {
+            unsigned long tSpeedPWM = tModel->StopSpeedPWM
+                    + ((unsigned long) i * SPEED_PWM_TABLE_MILLIMETER_PER_SECOND_STEP * 256 + tModel->GainTimes256 / 2) / tModel->GainTimes256;
+            if (tSpeedPWM > MAX_SPEED_PWM)
+            {
+                tSpeedPWM = MAX_SPEED_PWM;
+            }
+            // Keep it monotonic, as the table of endSpeedPWMTableCalibration()
+            SpeedPWMTable[tDirection][i] = (tSpeedPWM < SpeedPWMTable[tDirection][i - 1]) ? SpeedPWMTable[tDirection][i - 1] : tSpeedPWM;
+        }
+    }
+}
+#  endif
+#endif // USE_MOTOR_MODEL_IDENTIFICATION
+
+#ifdef SUPPORT_AVERAGE_SPEED
+/*
+ * Speed is in cm/s for a 20 slot encoder disc
+ * Average is computed over the full revolution to compensate for unequal distances of the laser cut encoder discs.
+ * If we do not have 21 timestamps, average is computed over the existing ones
+ */
+unsigned int EncoderMotor::getAverageSpeed()
+{
+    EncoderSnapshotStruct tSnapshot;
+    getEncoderSnapshot(&tSnapshot);
+    /*
+     * First check for timeout
+     */
+    if (millis() - tSnapshot.LastEncoderInterruptMillis > 1000)
+    {
+        resetSpeedValues(); // Reset speed values after 1 second
+        return 0;
+    }
+    if (tSnapshot.AverageSpeedNumberOfPeriods == 0)
+    {
+        return 0;
+    }
+#ifdef USE_MICROS_FOR_ENCODER_PERIOD
+    return ((SPEED_SCALE_VALUE * (MILLIS_IN_ONE_SECOND / ENCODER_PERIOD_ARRAY_UNIT_MICROS)) * tSnapshot.AverageSpeedNumberOfPeriods)
+            / tSnapshot.AverageSpeedPeriodSum;
+#else
+    return (SPEED_SCALE_VALUE * tSnapshot.AverageSpeedNumberOfPeriods) / tSnapshot.AverageSpeedPeriodSum;
+#endif
+}
+
+/*
+ * @param aLengthOfAverage only values from 1 to 20 are valid!
+ */
+unsigned int EncoderMotor::getAverageSpeed(uint8_t aLengthOfAverage)
+{
+    uint8_t tSequence;
+#ifdef USE_MICROS_FOR_ENCODER_PERIOD
+    unsigned long tSumOfPeriods;
+    do
+    {
+        tSequence = EncoderSnapshotSequence;
+        if ((!AverageSpeedIsValid && PeriodArrayIndex < aLengthOfAverage) || aLengthOfAverage == 0)
+        {
+            // cannot compute requested average
+            return 0;
+        }
+        tSumOfPeriods = 0;
+        int8_t tPeriodArrayIndex = PeriodArrayIndex;
+        for (uint_fast8_t i = 0; i < aLengthOfAverage; ++i)
+        {
+            tPeriodArrayIndex--;
+            if (tPeriodArrayIndex < 0)
+            {
+                // wrap around
+                tPeriodArrayIndex = AVERAGE_SPEED_SAMPLE_SIZE - 1;
+            }
+            tSumOfPeriods += EncoderPeriodArray[tPeriodArrayIndex];
+        }
+    } while ((tSequence & 0x01) || tSequence != EncoderSnapshotSequence);
+    return ((SPEED_SCALE_VALUE * (MILLIS_IN_ONE_SECOND / ENCODER_PERIOD_ARRAY_UNIT_MICROS)) * aLengthOfAverage) / tSumOfPeriods;
+#else
+    unsigned int tPeriodMillis;
+    do
+    {
+        tSequence = EncoderSnapshotSequence;
+        if (!AverageSpeedIsValid && MillisArrayIndex < aLengthOfAverage)
+        {
+            // cannot compute requested average
+            return 0;
+        }
+        // get index of aLengthOfAverage counts before
+        int8_t tHistoricIndex = (MillisArrayIndex - 1) - aLengthOfAverage;
+        if (tHistoricIndex < 0)
+        {
+            // wrap around
+            tHistoricIndex += AVERAGE_SPEED_BUFFER_SIZE;
+        }
+        tPeriodMillis = LastEncoderInterruptMillis - EncoderInterruptMillisArray[tHistoricIndex];
+    } while ((tSequence & 0x01) || tSequence != EncoderSnapshotSequence);
+    return (SPEED_SCALE_VALUE * aLengthOfAverage) / tPeriodMillis;
+#endif
+}
+#endif
+
+/*
+ * Print caption for Serial Plotter
+ * Space but NO println() at the end, to enable additional information to be printed
+ */
+void EncoderMotor::printEncoderDataCaption(Print *aSerial)
+{
+    //    aSerial->print(F("PWM[2] Speed[cm/s] SpeedAvg.Of10[cm/s] Count[22cm/20LSB] "));
+    aSerial->print(F("PWM[2] Speed[cm/s] Distance[cm] "));
+}
+
+bool EncoderMotor::printEncoderDataPeriodically(Print *aSerial, uint16_t aPeriodMillis)
+{
+    static unsigned long sLastPrintMillis;
+
+    if ((millis() - sLastPrintMillis) >= aPeriodMillis)
+    { // print data every n ms
+        sLastPrintMillis = millis();
+        printEncoderData(aSerial);
+        return true;
+    }
+    return false;
+}
+
+void EncoderMotor::printEncoderData(Print *aSerial)
+{
+    aSerial->print(CurrentSpeedPWM / 2); // = PWM, scale it for plotter
+    aSerial->print(" ");
+    aSerial->print(getSpeed());
+    aSerial->print(" ");
 #ifdef SUPPORT_AVERAGE_SPEED
+//    aSerial->print(getAverageSpeed(10));
+//    aSerial->print(" ");
+#endif
+    aSerial->print(getDistanceCentimeter());
+    aSerial->print(" ");
+}
+
+#ifdef USE_QUADRATURE_ENCODER
+/*
+ * Index is (old state << 2) | new state, with state = (A << 1) | B.
+ * Forward sequence is 00 -> 10 -> 11 -> 01 -> 00, i.e. A leads B.
+ */
+static const int8_t sQuadratureStepTable[16] = { 0, -1, 1, 0, 1, 0, 0, -1, -1, 0, 0, 1, 0, 1, -1, 0 };
+
+#endif
+
+#ifdef USE_ENCODER_EVENT_BUFFER
+EncoderEventBuffer EncoderMotor::EncoderEvents;
+
+/*
+ * Called by handleEncoderInterrupt() after the values are updated, so the event contains the new EncoderCount
+ */
+void EncoderMotor::putEncoderEvent(unsigned long aTimestampMicros, uint8_t aType)
+{
+    EncoderEvents.putEvent(aTimestampMicros, EncoderCount,
+            (this == sPointerForInt1ISR) ? ENCODER_EVENT_MOTOR_LEFT : ENCODER_EVENT_MOTOR_RIGHT, aType);
+}
+#endif
+
+#if defined ESP32
+void IRAM_ATTR EncoderMotor::handleEncoderInterrupt()
+{
+#else
+void EncoderMotor::handleEncoderInterrupt()
+{
+#endif
+#ifdef USE_QUADRATURE_ENCODER
+    uint8_t tNewQuadratureState = (digitalRead(EncoderPinA) << 1) | digitalRead(EncoderPinB);
+    int8_t tStep = sQuadratureStepTable[(QuadratureState << 2) | tNewQuadratureState];
+    QuadratureState = tNewQuadratureState;
+    if (tStep == 0)
+    {
+        return; // Other channel or invalid double step
+    }
+    EncoderSnapshotSequence++; // odd -> values are changing
+    EncoderPosition += tStep;
+    if (LastDirection == DIRECTION_BACKWARD)
+    {
+        tStep = -tStep;
+    }
+    SensorValuesHaveChanged = true;
+    if (tStep < 0)
+    {
+        // Wheel turns against the direction of the ride, e.g. by rollback after stop or bouncing of the edge
+        if (EncoderCount > 0)
+        {
+            EncoderCount--;
+        }
+        if (LastRideEncoderCount > 0)
+        {
+            LastRideEncoderCount--;
+        }
+        EncoderSnapshotSequence++;
+#  ifdef USE_ENCODER_EVENT_BUFFER
+        putEncoderEvent(micros(), ENCODER_EVENT_BACKWARD);
+#  endif
+        return;
+    }
+    EncoderCount++;
+    LastRideEncoderCount++;
+    if (tNewQuadratureState != 0)
+    {
+        EncoderSnapshotSequence++;
+#  ifdef USE_ENCODER_EVENT_BUFFER
+        putEncoderEvent(micros(), ENCODER_EVENT_COUNT);
+#  endif
+        return; // Speed is measured only once per slot
+    }
+#else
+    EncoderSnapshotSequence++; // odd -> values are changing
+#endif
+#ifdef USE_MICROS_FOR_ENCODER_PERIOD
+    unsigned long tMicros = micros();
+    unsigned long tDeltaMicros = tMicros - LastEncoderInterruptMicros;
+    unsigned long tRingingMicros = EncoderInterruptDeltaMicros / ENCODER_SENSOR_RING_PERIOD_DIVISOR;
+    if (tRingingMicros < ENCODER_SENSOR_RING_MICROS)
+    {
+        tRingingMicros = ENCODER_SENSOR_RING_MICROS;
+    }
+    if (tDeltaMicros <= tRingingMicros)
+    {
+        // assume signal is ringing and do nothing
+#  ifdef USE_ENCODER_EVENT_BUFFER
+        putEncoderEvent(tMicros, ENCODER_EVENT_RINGING);
+#  endif
+    }
+    else
+    {
+        LastEncoderInterruptMicros = tMicros;
+        LastEncoderInterruptMillis = millis();
+        if (tDeltaMicros < ENCODER_SENSOR_TIMEOUT_MILLIS * MILLIS_IN_ONE_SECOND)
+        {
+            EncoderInterruptDeltaMicros = tDeltaMicros;
+#  ifdef SUPPORT_AVERAGE_SPEED
+            uint8_t tPeriodArrayIndex = PeriodArrayIndex;
+            uint16_t tPeriod = tDeltaMicros / ENCODER_PERIOD_ARRAY_UNIT_MICROS;
+            PeriodArraySum = (PeriodArraySum - EncoderPeriodArray[tPeriodArrayIndex]) + tPeriod;
+            EncoderPeriodArray[tPeriodArrayIndex++] = tPeriod;
+            if (tPeriodArrayIndex >= AVERAGE_SPEED_SAMPLE_SIZE)
+            {
+                tPeriodArrayIndex = 0;
+                AverageSpeedIsValid = true;
+            }
+            PeriodArrayIndex = tPeriodArrayIndex;
+#  endif
+        }
+        else
+        {
+            // timeout
+            resetSpeedValues();
+        }
+#  ifndef USE_QUADRATURE_ENCODER
+        EncoderCount++;
+        LastRideEncoderCount++;
+        SensorValuesHaveChanged = true;
+#  endif
+#  ifdef USE_ENCODER_EVENT_BUFFER
+        putEncoderEvent(tMicros, (EncoderInterruptDeltaMicros == 0) ? ENCODER_EVENT_COUNT : ENCODER_EVENT_PERIOD);
+#  endif
+    }
+#else // USE_MICROS_FOR_ENCODER_PERIOD
+    long tMillis = millis();
+    unsigned long tDeltaMillis = tMillis - LastEncoderInterruptMillis;
+    if (tDeltaMillis <= ENCODER_SENSOR_RING_MILLIS)
+    {
+        // assume signal is ringing and do nothing
+#  ifdef USE_ENCODER_EVENT_BUFFER
+        putEncoderEvent(micros(), ENCODER_EVENT_RINGING);
+#  endif
+    }
+    else
+    {
+        LastEncoderInterruptMillis = tMillis;
+#  ifdef SUPPORT_AVERAGE_SPEED
+        uint8_t tMillisArrayIndex = MillisArrayIndex;
+#  endif
+        if (tDeltaMillis < ENCODER_SENSOR_TIMEOUT_MILLIS)
+        {
+            EncoderInterruptDeltaMillis = tDeltaMillis;
+        }
+        else
+        {
+            // timeout
+            EncoderInterruptDeltaMillis = 0;
+#  ifdef SUPPORT_AVERAGE_SPEED
+            tMillisArrayIndex = 0;
+            AverageSpeedIsValid = false;
+#  endif
+        }
+#  ifdef SUPPORT_AVERAGE_SPEED
         EncoderInterruptMillisArray[tMillisArrayIndex++] = tMillis;
         if (tMillisArrayIndex >= AVERAGE_SPEED_BUFFER_SIZE)
         {
@@ -615,12 +1870,19 @@ void EncoderMotor::handleEncoderInterrupt()
             AverageSpeedIsValid = true;
         }
         MillisArrayIndex = tMillisArrayIndex;
-#endif
+#  endif
 
+#  ifndef USE_QUADRATURE_ENCODER
         EncoderCount++;
         LastRideEncoderCount++;
         SensorValuesHaveChanged = true;
+#  endif
+#  ifdef USE_ENCODER_EVENT_BUFFER
+        putEncoderEvent(micros(), (EncoderInterruptDeltaMillis == 0) ? ENCODER_EVENT_COUNT : ENCODER_EVENT_PERIOD);
+#  endif
     }
+#endif // USE_MICROS_FOR_ENCODER_PERIOD
+    EncoderSnapshotSequence++; // even -> values are consistent
 }
 
 /******************************************************************************************
@@ -628,10 +1890,11 @@ void EncoderMotor::handleEncoderInterrupt()
  *****************************************************************************************/
 /*
  * Enable both interrupts INT0/D2 or INT1/D3
+ * aInterruptNumber is an interrupt number like RIGHT_MOTOR_INTERRUPT, not a pin number
  */
 void EncoderMotor::attachEncoderInterrupt(uint8_t aInterruptNumber)
 {
-    attachEncoderInterrupt(digitalPinToInterrupt(aInterruptNumber), this);
+    attachEncoderInterrupt(aInterruptNumber, this);
 }
 
 /***************************************************
@@ -641,50 +1904,109 @@ void EncoderMotor::attachEncoderInterrupt(uint8_t aInterruptNumber)
  * Attaches INT0 or INT1 interrupt to this EncoderMotor
  * Interrupt is enabled on rising edges
  * We can not use both edges since the on and off times of the opto interrupter are too different
+ * With USE_QUADRATURE_ENCODER the interrupts of both channels are enabled on both edges
  * aInterruptNumber can be one of INT0 (at pin D2) or INT1 (at pin D3) for Atmega328
  */
-void EncoderMotor::attachEncoderInterrupt(uint8_t aInterruptNumber, EncoderMotor *ptr)
+void EncoderMotor::attachEncoderInterrupt(uint8_t aInterruptNumber, EncoderMotor *aEncoderMotor)
 {
-    Serial.print("attachEncoderInterrupt: ");
+#ifdef DEBUG
+    Serial.print(F("attachEncoderInterrupt: "));
     Serial.println(aInterruptNumber);
+#endif
 
+#ifdef USE_QUADRATURE_ENCODER
     if (aInterruptNumber == RIGHT_MOTOR_INTERRUPT)
     {
-        sPointerForInt0ISR = ptr;
+        sPointerForInt0ISR = aEncoderMotor;
+        aEncoderMotor->setQuadratureEncoderPins(RIGHT_MOTOR_ENCODER_A_PIN, RIGHT_MOTOR_ENCODER_B_PIN);
+        attachInterrupt(aInterruptNumber, ISR0, CHANGE);
+        if (digitalPinToInterrupt(RIGHT_MOTOR_ENCODER_B_PIN) != NOT_AN_INTERRUPT)
+        {
+            attachInterrupt(digitalPinToInterrupt(RIGHT_MOTOR_ENCODER_B_PIN), ISR0, CHANGE);
+        }
+    }
+    else if (aInterruptNumber == LEFT_MOTOR_INTERRUPT)
+    {
+        sPointerForInt1ISR = aEncoderMotor;
+        aEncoderMotor->setQuadratureEncoderPins(LEFT_MOTOR_ENCODER_A_PIN, LEFT_MOTOR_ENCODER_B_PIN);
+        attachInterrupt(aInterruptNumber, ISR1, CHANGE);
+        if (digitalPinToInterrupt(LEFT_MOTOR_ENCODER_B_PIN) != NOT_AN_INTERRUPT)
+        {
+            attachInterrupt(digitalPinToInterrupt(LEFT_MOTOR_ENCODER_B_PIN), ISR1, CHANGE);
+        }
+    }
+#else
+    if (aInterruptNumber == RIGHT_MOTOR_INTERRUPT)
+    {
+        sPointerForInt0ISR = aEncoderMotor;
         attachInterrupt(aInterruptNumber, ISR0, RISING);
     }
     else if (aInterruptNumber == LEFT_MOTOR_INTERRUPT)
     {
-        sPointerForInt1ISR = ptr;
+        sPointerForInt1ISR = aEncoderMotor;
         attachInterrupt(aInterruptNumber, ISR1, RISING);
     }
+#endif
+}
+
+#ifdef USE_QUADRATURE_ENCODER
+/*
+ * Sets the pins of both channels and reads their initial state. Called by attachEncoderInterrupt().
+ * EncoderPosition is not changed.
+ */
+void EncoderMotor::setQuadratureEncoderPins(uint8_t aEncoderPinA, uint8_t aEncoderPinB)
+{
+    EncoderPinA = aEncoderPinA;
+    EncoderPinB = aEncoderPinB;
+    pinMode(aEncoderPinA, INPUT_PULLUP); // for open collector outputs of hall sensors
+    pinMode(aEncoderPinB, INPUT_PULLUP);
+    QuadratureState = (digitalRead(aEncoderPinA) << 1) | digitalRead(aEncoderPinB);
 }
 
+/*
+ * @return signed position in counts, positive is forward
+ */
+long EncoderMotor::getEncoderPosition()
+{
+    noInterrupts(); // a long is not read atomically on 8 bit CPUs
+    long tEncoderPosition = EncoderPosition;
+    interrupts();
+    return tEncoderPosition;
+}
+
+long EncoderMotor::getPositionMillimeter()
+{
+    return (getEncoderPosition() * FACTOR_COUNT_TO_MILLIMETER_INTEGER_DEFAULT) / ENCODER_COUNTS_PER_SLOT;
+}
+#endif
+
 void EncoderMotor::ISR0()
 {
-    Serial.print("Right Interrupt: ");
+    unsigned int tEncoderCount = sPointerForInt0ISR->EncoderCount;
     sPointerForInt0ISR->handleEncoderInterrupt();
-    Serial.println(sPointerForInt0ISR->startCount);
-    sPointerForInt0ISR->startCount++;
-     if (sPointerForInt0ISR->stopFlag && sPointerForInt0ISR->startCount >= sPointerForInt0ISR->stopCount)
+    sPointerForInt0ISR->startCount += sPointerForInt0ISR->EncoderCount - tEncoderCount; // No ringing, no edge of the other channel, backward steps are subtracted
+    if (sPointerForInt0ISR->stopFlag && (int) sPointerForInt0ISR->startCount >= (int) sPointerForInt0ISR->stopCount)
     {
         sPointerForInt0ISR->stopFlag = false;
-        Serial.println("Right Wheel Stop!");
         sPointerForInt0ISR->stop(MOTOR_BRAKE);
+#ifdef USE_ENCODER_EVENT_BUFFER
+        EncoderEvents.putEvent(micros(), sPointerForInt0ISR->startCount, ENCODER_EVENT_MOTOR_RIGHT, ENCODER_EVENT_TICKS_REACHED);
+#endif
     }
 }
 
 void EncoderMotor::ISR1()
 {
-    Serial.print("Left Interrupt: ");
+    unsigned int tEncoderCount = sPointerForInt1ISR->EncoderCount;
     sPointerForInt1ISR->handleEncoderInterrupt();
-    Serial.println(sPointerForInt1ISR->startCount);
-    sPointerForInt1ISR->startCount++;
-    if (sPointerForInt1ISR->stopFlag && sPointerForInt1ISR->startCount >= sPointerForInt1ISR->stopCount)
+    sPointerForInt1ISR->startCount += sPointerForInt1ISR->EncoderCount - tEncoderCount; // No ringing, no edge of the other channel, backward steps are subtracted
+    if (sPointerForInt1ISR->stopFlag && (int) sPointerForInt1ISR->startCount >= (int) sPointerForInt1ISR->stopCount)
     {
         sPointerForInt1ISR->stopFlag = false;
-        Serial.println("Left Wheel Stop!");
         sPointerForInt1ISR->stop(MOTOR_BRAKE);
+#ifdef USE_ENCODER_EVENT_BUFFER
+        EncoderEvents.putEvent(micros(), sPointerForInt1ISR->startCount, ENCODER_EVENT_MOTOR_LEFT, ENCODER_EVENT_TICKS_REACHED);
+#endif
     }
 }
 
@@ -0,0 +1,186 @@
+/*
+ * FastPWMDcMotor.h
+ *
+ *  DC motor with the basic motor commands of PWMDcMotor, whose driver type and pins are template parameters.
+ *  The driver is a class with only static functions, so the output path is compiled for exactly this driver and these pins.
+ *  With FullBridgeMotorDriver the direction pins are written by direct port access on AVR,
+ *  with PCA9685MotorDriver direction and PWM are written by one I2C transaction.
+ *  Motors with different driver types can be used in one sketch, which is not possible with USE_ADAFRUIT_MOTOR_SHIELD and PWMDcMotor.
+ *
+ *  Usage:
+ *  FastPWMDcMotor<FullBridgeMotorDriver<RIGHT_MOTOR_FORWARD_PIN, RIGHT_MOTOR_BACKWARD_PIN, RIGHT_MOTOR_PWM_PIN> > RightMotor;
+ *  FastPWMDcMotor<PCA9685MotorDriver<1> > LeftMotor; // requires #include "PCA9685MotorDriver.h"
+ *
+ *  A driver class must have the static functions:
+ *  void init();
+ *  void write(uint8_t aMotorDriverMode, uint8_t aSpeedPWM); // aMotorDriverMode is DIRECTION_FORWARD, DIRECTION_BACKWARD, MOTOR_BRAKE or MOTOR_RELEASE
+ *
+ *  PWMDcMotor.hpp must be included by the sketch as usual, since the battery voltage compensation of PWMDcMotor is used.
+ *  The motors are not in the motor list of PWMDcMotor, so a new battery voltage is applied at their next PWM change.
+ *
+ *  Copyright (C) 2022  Armin Joachimsmeyer
+ *  armin.joachimsmeyer@gmail.com
+ *
+ *  This file is part of PWMMotorControl https://github.com/ArminJo/PWMMotorControl.
+ *
+ *  PWMMotorControl is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/gpl.html>.
+ */
+
+#ifndef FAST_PWM_DC_MOTOR_H_
+#define FAST_PWM_DC_MOTOR_H_
+
+#include <Arduino.h>
+#include "PWMDcMotor.h"
+#include "digitalWriteFast.h"
+
+#if defined(ESP32)
+#include "analogWrite.h" // from e.g. ESP32Servo library
+#endif
+
+/*
+ * L298 or TB6612 breakout board with 2 direction pins and one PWM pin for each motor
+ */
+template<uint8_t tForwardPin, uint8_t tBackwardPin, uint8_t tPWMPin>
+class FullBridgeMotorDriver {
+public:
+    static void init() {
+        pinModeFast(tForwardPin, OUTPUT);
+        pinModeFast(tBackwardPin, OUTPUT);
+        pinMode(tPWMPin, OUTPUT);
+    }
+
+    static void write(uint8_t aMotorDriverMode, uint8_t aSpeedPWM) {
+        if (aSpeedPWM == 0) {
+            analogWrite(tPWMPin, 0); // First set PWM to 0 then disable driver
+        }
+        switch (aMotorDriverMode) {
+        case DIRECTION_FORWARD:
+            digitalWriteFast(tBackwardPin, LOW); // take low first to avoid 'break'
+            digitalWriteFast(tForwardPin, HIGH);
+            break;
+        case DIRECTION_BACKWARD:
+            digitalWriteFast(tForwardPin, LOW); // take low first to avoid 'break'
+            digitalWriteFast(tBackwardPin, HIGH);
+            break;
+        case MOTOR_BRAKE:
+            digitalWriteFast(tForwardPin, HIGH);
+            digitalWriteFast(tBackwardPin, HIGH);
+            break;
+        default: // MOTOR_RELEASE
+            digitalWriteFast(tForwardPin, LOW);
+            digitalWriteFast(tBackwardPin, LOW);
+            break;
+        }
+        if (aSpeedPWM != 0) {
+            analogWrite(tPWMPin, aSpeedPWM);
+        }
+    }
+};
+
+template<class tMotorDriver>
+class FastPWMDcMotor {
+public:
+    void init() {
+        tMotorDriver::init();
+        DefaultStopMode = DEFAULT_STOP_MODE;
+        SpeedPWMCompensation = 0;
+        CurrentSpeedPWM = 0;
+        LastDirection = DIRECTION_FORWARD;
+        stop(DEFAULT_STOP_MODE);
+    }
+
+    /*
+     * Like PWMDcMotor::setSpeedPWM(), subtracts SpeedPWMCompensation from aRequestedSpeedPWM,
+     * but writes this compensated value and only if direction or PWM changed
+     */
+    void setSpeedPWM(uint8_t aRequestedSpeedPWM, uint8_t aRequestedDirection) {
+        if (aRequestedSpeedPWM <= SpeedPWMCompensation) {
+            stop(STOP_MODE_KEEP);
+            return;
+        }
+        uint8_t tCompensatedSpeedPWM = aRequestedSpeedPWM - SpeedPWMCompensation;
+        aRequestedDirection &= DIRECTION_MASK;
+        if (CurrentDirectionOrBrakeMode != aRequestedDirection && CurrentSpeedPWM != 0) {
+            stop(MOTOR_BRAKE); // Direction change requested but motor still running -> first stop motor
+        }
+        if (CurrentDirectionOrBrakeMode != aRequestedDirection || CurrentSpeedPWM != tCompensatedSpeedPWM) {
+            CurrentDirectionOrBrakeMode = aRequestedDirection;
+            LastDirection = aRequestedDirection;
+            CurrentSpeedPWM = tCompensatedSpeedPWM;
+            PWMDcMotor::MotorPWMHasChanged = true;
+            tMotorDriver::write(aRequestedDirection, PWMDcMotor::getOutputSpeedPWM(tCompensatedSpeedPWM));
+        }
+    }
+
+    /*
+     * Signed speed
+     */
+    void setSpeedPWM(int aRequestedSpeedPWM) {
+        if (aRequestedSpeedPWM < 0) {
+            setSpeedPWM((uint8_t) -aRequestedSpeedPWM, DIRECTION_BACKWARD);
+        } else {
+            setSpeedPWM((uint8_t) aRequestedSpeedPWM, DIRECTION_FORWARD);
+        }
+    }
+
+    /*
+     * Keeps direction and sets new speed only if not stopped
+     */
+    void changeSpeedPWM(uint8_t aRequestedSpeedPWM) {
+        if (!isStopped()) {
+            setSpeedPWM(aRequestedSpeedPWM, CurrentDirectionOrBrakeMode);
+        }
+    }
+
+    /*
+     * @param aStopMode STOP_MODE_KEEP (take previously defined DefaultStopMode) or MOTOR_BRAKE or MOTOR_RELEASE
+     */
+    void stop(uint8_t aStopMode = STOP_MODE_KEEP) {
+        if (aStopMode == STOP_MODE_KEEP) {
+            aStopMode = DefaultStopMode;
+        }
+        CurrentSpeedPWM = 0;
+        CurrentDirectionOrBrakeMode = ForceStopMODE(aStopMode);
+        PWMDcMotor::MotorPWMHasChanged = true;
+        tMotorDriver::write(CurrentDirectionOrBrakeMode, 0);
+    }
+
+    /*
+     * @param aStopMode MOTOR_BRAKE or MOTOR_RELEASE. Used for speed == 0 or STOP_MODE_KEEP.
+     */
+    void setStopMode(uint8_t aStopMode) {
+        DefaultStopMode = ForceStopMODE(aStopMode);
+    }
+
+    /*
+     * The new value is applied at the next PWM change
+     */
+    void setSpeedPWMCompensation(uint8_t aSpeedPWMCompensation) {
+        SpeedPWMCompensation = aSpeedPWMCompensation;
+    }
+
+    bool isStopped() {
+        return (CurrentSpeedPWM == 0);
+    }
+
+    uint8_t CurrentSpeedPWM; // stopped if CurrentSpeedPWM == 0. Requested PWM minus SpeedPWMCompensation, without battery voltage compensation.
+    uint8_t SpeedPWMCompensation; // Subtracted from the requested PWM, e.g. to drive a car straight
+    uint8_t CurrentDirectionOrBrakeMode; // DIRECTION_FORWARD, DIRECTION_BACKWARD, if motor stopped, then: MOTOR_BRAKE, MOTOR_RELEASE
+    uint8_t LastDirection; // DIRECTION_FORWARD or DIRECTION_BACKWARD
+    uint8_t DefaultStopMode; // used for PWM == 0 and STOP_MODE_KEEP
+};
+
+#endif /* FAST_PWM_DC_MOTOR_H_ */
+
+#pragma once
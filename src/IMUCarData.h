@@ -109,6 +109,7 @@ public:
 
     void doAutoOffset();
     void calculateSpeedAndTurnOffsets();
+    void setSpeedAndTurnOffsets(int16_t aAcceleratorForwardOffset, int16_t aGyroscopePanOffset);
 
     void printSpeedAndTurnOffsets(Print *aSerial);
 
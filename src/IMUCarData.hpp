@@ -315,6 +315,9 @@ bool IMUCarData::readCarDataFromMPU6050Fifo() {
         tFifoCount -= tReceivedCount;
 
     } // while tFifoCount >= FIFO_CHUNK_SIZE
+    if (tReadChunckCount == 0) {
+        return false; // no complete chunk in FIFO yet, avoid division by zero below
+    }
     sCountOfUndisturbedFifoChunks += tReadChunckCount;
     // compute average of read values
     AcceleratorForward.Word = tAcceleratorForward / (int32_t) tReadChunckCount;
@@ -372,13 +375,15 @@ void IMUCarData::doAutoOffset() {
              * Do we have enough samples for auto offset?
              */
             if (sCountOfUndisturbedFifoChunks >= NUMBER_OF_OFFSET_CALIBRATION_SAMPLES) {
-                if (abs(Speed.Long - sSpeedSnapshot) > sCountOfUndisturbedFifoChunks) {
+                // Use a copy, since sCountOfUndisturbedFifoChunks is reset by the accelerator offset adjustment
+                int16_t tCountOfUndisturbedFifoChunks = sCountOfUndisturbedFifoChunks;
+                if (abs(Speed.Long - sSpeedSnapshot) > tCountOfUndisturbedFifoChunks) {
                     // difference is higher than 1 per sample, so adjust accelerator offset
-                    AcceleratorForwardOffset += (Speed.Long - sSpeedSnapshot) / sCountOfUndisturbedFifoChunks;
+                    AcceleratorForwardOffset += (Speed.Long - sSpeedSnapshot) / tCountOfUndisturbedFifoChunks;
                     OffsetsHaveChanged = true;
 #ifdef AUTO_OFFSET_DEBUG
                     // just to show in Arduino Plotter - 5 for each accelerator offset increment
-                    AcceleratorForward.Word = 64 * 5 * ((Speed.Long - sSpeedSnapshot) / sCountOfUndisturbedFifoChunks);
+                    AcceleratorForward.Word = 64 * 5 * ((Speed.Long - sSpeedSnapshot) / tCountOfUndisturbedFifoChunks);
 #endif
                     sSpeedSnapshot = 0;
                     Speed.Long = 0;
@@ -387,13 +392,13 @@ void IMUCarData::doAutoOffset() {
                     sCountOfUndisturbedFifoChunks = 0; // reset count
                 }
 
-                if (abs(TurnAngle.Long - sTurnSnapshot) > sCountOfUndisturbedFifoChunks) {
+                if (abs(TurnAngle.Long - sTurnSnapshot) > tCountOfUndisturbedFifoChunks) {
                     // adjust gyroscope offset and reset gyroscope to last value
-                    GyroscopePanOffset += (TurnAngle.Long - sTurnSnapshot) / sCountOfUndisturbedFifoChunks;
+                    GyroscopePanOffset += (TurnAngle.Long - sTurnSnapshot) / tCountOfUndisturbedFifoChunks;
                     OffsetsHaveChanged = true;
 #ifdef AUTO_OFFSET_DEBUG
                     // just to show in Arduino Plotter - 5 for each gyroscope offset increment
-                    GyroscopePan.Word = 5 * 256 * ((TurnAngle.Long - sTurnSnapshot) / sCountOfUndisturbedFifoChunks);
+                    GyroscopePan.Word = 5 * 256 * ((TurnAngle.Long - sTurnSnapshot) / tCountOfUndisturbedFifoChunks);
 #endif
                     TurnAngle.Long = sTurnSnapshot;
 
@@ -429,6 +434,20 @@ void IMUCarData::calculateSpeedAndTurnOffsets() {
     resetCarData();
 }
 
+/*
+ * Sets offsets e.g. read from EEPROM, which replace the initial offset acquisition.
+ * They are still adjusted by doAutoOffset(), since the gyroscope offset changes in the first seconds after power up.
+ */
+void IMUCarData::setSpeedAndTurnOffsets(int16_t aAcceleratorForwardOffset, int16_t aGyroscopePanOffset) {
+    AcceleratorForwardOffset = aAcceleratorForwardOffset;
+    GyroscopePanOffset = aGyroscopePanOffset;
+    OffsetsHaveChanged = true;
+    sCountOfUndisturbedFifoChunks = 0;
+    sSpeedSnapshot = 0;
+    sTurnSnapshot = 0;
+    resetCarData(); // Speed and TurnAngle were used as accumulator for the initial offsets
+}
+
 void IMUCarData::printSpeedAndTurnOffsets(Print *aSerial) {
     aSerial->print(F("Speed offset="));
     aSerial->print(AcceleratorForwardOffset);
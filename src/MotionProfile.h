@@ -0,0 +1,82 @@
+/*
+ * MotionProfile.h
+ *
+ *  Jerk limited (S-curve) velocity profile for driving a fixed distance or for ramping to a new speed.
+ *  The profile is computed online every MOTION_PROFILE_INTERVAL_MILLIS with integer arithmetic.
+ *  The deceleration point is planned from the remaining distance, which is given by the caller at each update,
+ *  so distance errors of the motor are compensated.
+ *
+ *  Velocity is in mm/s, acceleration in mm/s^2 and jerk in mm/s^3.
+ *
+ *  Copyright (C) 2022  Armin Joachimsmeyer
+ *  armin.joachimsmeyer@gmail.com
+ *
+ *  This file is part of PWMMotorControl https://github.com/ArminJo/PWMMotorControl.
+ *
+ *  PWMMotorControl is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/gpl.html>.
+ */
+
+#ifndef MOTION_PROFILE_H_
+#define MOTION_PROFILE_H_
+
+#include <stdint.h>
+
+#define MOTION_PROFILE_INTERVAL_MILLIS  20
+#define MOTION_PROFILE_UPDATES_PER_SECOND (1000 / MOTION_PROFILE_INTERVAL_MILLIS)
+#define MOTION_PROFILE_NO_TARGET_DISTANCE 0xFFFF // Ramp to MaxVelocity and keep it
+
+/*
+ * Default limits. I measured 2500 mm/s^2 with spinning wheels and 3500 mm/s^2 with blocking wheels on varnished wood.
+ */
+#if !defined(MOTION_PROFILE_MAX_ACCELERATION)
+#define MOTION_PROFILE_MAX_ACCELERATION 2000 // mm/s^2, for acceleration and deceleration
+#endif
+#if !defined(MOTION_PROFILE_MAX_JERK)
+#define MOTION_PROFILE_MAX_JERK         30000 // mm/s^3, maximum acceleration is reached after 67 ms
+#endif
+#if !defined(MOTION_PROFILE_MIN_VELOCITY)
+#define MOTION_PROFILE_MIN_VELOCITY     100 // mm/s, velocity for the last millimeters to target, to avoid stopping before target
+#endif
+
+/*
+ * Velocity profile states
+ */
+#define MOTION_PROFILE_CONSTANT     0
+#define MOTION_PROFILE_ACCELERATE   1
+#define MOTION_PROFILE_DECELERATE   2
+
+class MotionProfile {
+public:
+    MotionProfile();
+    void setLimits(uint16_t aMaxAccelerationMillimeterPerSecond2, uint16_t aMaxJerkMillimeterPerSecond3);
+    void start(uint16_t aMaxVelocityMillimeterPerSecond, uint16_t aStartVelocityMillimeterPerSecond);
+    void update(uint16_t aRemainingDistanceMillimeter);
+    uint16_t getVelocity();
+
+    uint16_t MaxVelocity;           // mm/s, may be changed while running
+    uint16_t MinVelocity;           // mm/s, is kept until the remaining distance is 0
+    uint16_t MaxAcceleration;       // mm/s^2
+    uint16_t MaxDeceleration;       // mm/s^2, <= MaxAcceleration, e.g. if the wheels cannot brake with MaxAcceleration
+    uint16_t MaxJerk;               // mm/s^3
+
+    long VelocityTimes16;           // mm/s * 16, to keep the small velocity changes of one interval
+    int Acceleration;               // mm/s^2
+    uint8_t State;                  // MOTION_PROFILE_CONSTANT, MOTION_PROFILE_ACCELERATE or MOTION_PROFILE_DECELERATE
+};
+
+uint16_t integerSquareRoot(uint32_t aValue);
+
+#endif /* MOTION_PROFILE_H_ */
+
+#pragma once
@@ -0,0 +1,159 @@
+/*
+ * MotionProfile.hpp
+ *
+ *  Jerk limited (S-curve) velocity profile generator.
+ *
+ *  Every update computes the highest velocity which still allows to stop within the remaining distance
+ *  with the acceleration limit, reduced by the distance needed to build up the deceleration with the jerk limit.
+ *  The acceleration is then moved towards this velocity with the jerk limit.
+ *  Since the remaining distance is measured again at each update, the deceleration point adapts to the real motion.
+ *
+ *  Copyright (C) 2022  Armin Joachimsmeyer
+ *  armin.joachimsmeyer@gmail.com
+ *
+ *  This file is part of PWMMotorControl https://github.com/ArminJo/PWMMotorControl.
+ *
+ *  PWMMotorControl is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/gpl.html>.
+ */
+#ifndef MOTION_PROFILE_HPP
+#define MOTION_PROFILE_HPP
+
+#include <Arduino.h>
+#include "MotionProfile.h"
+
+MotionProfile::MotionProfile() { // @suppress("Class members should be properly initialized")
+    MinVelocity = MOTION_PROFILE_MIN_VELOCITY;
+    setLimits(MOTION_PROFILE_MAX_ACCELERATION, MOTION_PROFILE_MAX_JERK);
+    start(0, 0);
+}
+
+void MotionProfile::setLimits(uint16_t aMaxAccelerationMillimeterPerSecond2, uint16_t aMaxJerkMillimeterPerSecond3) {
+    MaxAcceleration = aMaxAccelerationMillimeterPerSecond2;
+    MaxDeceleration = aMaxAccelerationMillimeterPerSecond2;
+    MaxJerk = aMaxJerkMillimeterPerSecond3;
+}
+
+void MotionProfile::start(uint16_t aMaxVelocityMillimeterPerSecond, uint16_t aStartVelocityMillimeterPerSecond) {
+    MaxVelocity = aMaxVelocityMillimeterPerSecond;
+    VelocityTimes16 = (long) aStartVelocityMillimeterPerSecond * 16;
+    Acceleration = 0;
+    State = MOTION_PROFILE_CONSTANT;
+}
+
+uint16_t MotionProfile::getVelocity() {
+    return VelocityTimes16 / 16;
+}
+
+/*
+ * Must be called every MOTION_PROFILE_INTERVAL_MILLIS
+ * @param aRemainingDistanceMillimeter - MOTION_PROFILE_NO_TARGET_DISTANCE to ramp to MaxVelocity and keep it,
+ *                                       0 to ramp down to velocity 0
+ */
+void MotionProfile::update(uint16_t aRemainingDistanceMillimeter) {
+    uint16_t tVelocity = getVelocity();
+
+    /*
+     * Compute the velocity we want to have now
+     */
+    uint16_t tTargetVelocity = MaxVelocity;
+    if (aRemainingDistanceMillimeter == 0) {
+        tTargetVelocity = 0;
+    } else if (aRemainingDistanceMillimeter != MOTION_PROFILE_NO_TARGET_DISTANCE) {
+        /*
+         * Subtract the distance driven while the deceleration is built up (v * a / 2j)
+         * and the distance driven until the next update.
+         */
+        long tBrakingDistance = aRemainingDistanceMillimeter
+                - ((long) tVelocity * ((500L * MaxDeceleration) / MaxJerk + MOTION_PROFILE_INTERVAL_MILLIS)) / 1000;
+        if (tBrakingDistance < 0) {
+            tBrakingDistance = 0;
+        }
+        uint16_t tBrakingVelocity = integerSquareRoot(2L * MaxDeceleration * tBrakingDistance);
+        if (tTargetVelocity > tBrakingVelocity) {
+            tTargetVelocity = tBrakingVelocity;
+        }
+        if (tTargetVelocity < MinVelocity) {
+            tTargetVelocity = MinVelocity;
+        }
+    }
+
+    /*
+     * Compute the acceleration we want to have now. It is the acceleration, which can be reduced to 0
+     * with the jerk limit until the target velocity is reached.
+     */
+    int tVelocityError = (int) tTargetVelocity - (int) tVelocity;
+    int tTargetAcceleration = (tVelocityError < 0) ? MaxDeceleration : MaxAcceleration;
+    uint16_t tJerkLimitedAcceleration = integerSquareRoot(2L * MaxJerk * abs(tVelocityError));
+    if (tTargetAcceleration > (int) tJerkLimitedAcceleration) {
+        tTargetAcceleration = tJerkLimitedAcceleration;
+    }
+    if (tVelocityError < 0) {
+        tTargetAcceleration = -tTargetAcceleration;
+    }
+
+    /*
+     * Change acceleration with jerk limit and integrate velocity
+     */
+    int tAccelerationDelta = ((long) MaxJerk * MOTION_PROFILE_INTERVAL_MILLIS) / 1000;
+    if (tTargetAcceleration > Acceleration + tAccelerationDelta) {
+        Acceleration += tAccelerationDelta;
+    } else if (tTargetAcceleration < Acceleration - tAccelerationDelta) {
+        Acceleration -= tAccelerationDelta;
+    } else {
+        Acceleration = tTargetAcceleration;
+    }
+    VelocityTimes16 += ((long) Acceleration * (16 * MOTION_PROFILE_INTERVAL_MILLIS)) / 1000;
+
+    /*
+     * Do not overshoot the target velocity. This happens only at the end of a transition, where the acceleration is small.
+     */
+    long tTargetVelocityTimes16 = (long) tTargetVelocity * 16;
+    if ((tVelocityError >= 0 && VelocityTimes16 > tTargetVelocityTimes16)
+            || (tVelocityError <= 0 && VelocityTimes16 < tTargetVelocityTimes16)) {
+        VelocityTimes16 = tTargetVelocityTimes16;
+        Acceleration = 0;
+    }
+
+    if (Acceleration > 0) {
+        State = MOTION_PROFILE_ACCELERATE;
+    } else if (Acceleration < 0 || tTargetVelocity < MaxVelocity) {
+        State = MOTION_PROFILE_DECELERATE;
+    } else {
+        State = MOTION_PROFILE_CONSTANT;
+    }
+}
+
+/*
+ * Bitwise integer square root, 16 iterations
+ */
+uint16_t integerSquareRoot(uint32_t aValue) {
+    uint32_t tResult = 0;
+    uint32_t tBit = 1UL << 30;
+    while (tBit > aValue) {
+        tBit >>= 2;
+    }
+    while (tBit != 0) {
+        if (aValue >= tResult + tBit) {
+            aValue -= tResult + tBit;
+            tResult = (tResult >> 1) + tBit;
+        } else {
+            tResult >>= 1;
+        }
+        tBit >>= 2;
+    }
+    return tResult;
+}
+
+#endif // #ifndef MOTION_PROFILE_HPP
+#pragma once
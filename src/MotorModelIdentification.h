@@ -0,0 +1,108 @@
+/*
+ * MotorModelIdentification.h
+ *
+ *  Identification of a first order plus deadband model of one motor and direction from PWM steps.
+ *  Model: a stopped motor starts at StartSpeedPWM, a turning motor runs with speed = Gain * (PWM - StopSpeedPWM)
+ *  and follows a PWM change with the mechanical time constant TimeConstantMillis.
+ *
+ *  1. StartSpeedPWM is searched by bisection. Each probe sets the PWM to the stopped motor and checks for an encoder count.
+ *  2. The PWM is increased in MOTOR_MODEL_NUMBER_OF_STEPS steps from StartSpeedPWM to the maximum PWM.
+ *     The speed of each encoder period is stored with the time of the middle of the period in a RAM buffer.
+ *  3. End speed and time constant of each step are the least squares fit of the integrated first order equation to the samples.
+ *     It requires no settled speed, so the buffer must only cover the first part of the step.
+ *     If the fit is not possible, e.g. for the low speed of the first step, the end speed is the average of the speeds
+ *     after MOTOR_MODEL_RECORD_MILLIS.
+ *  4. Gain and StopSpeedPWM are the straight line through the end speeds of all steps with a speed.
+ *
+ *  The steps must be small enough, that the acceleration is limited by the motor and not by the grip of the tires.
+ *  Velocity is in mm/s, as measured by the encoder.
+ *
+ *  Copyright (C) 2022  Armin Joachimsmeyer
+ *  armin.joachimsmeyer@gmail.com
+ *
+ *  This file is part of PWMMotorControl https://github.com/ArminJo/PWMMotorControl.
+ *
+ *  PWMMotorControl is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/gpl.html>.
+ */
+
+#ifndef MOTOR_MODEL_IDENTIFICATION_H_
+#define MOTOR_MODEL_IDENTIFICATION_H_
+
+#include <stdint.h>
+
+#define MOTOR_MODEL_START_PROBE_MILLIS      300 // The motor must have moved one encoder slot within this time
+#define MOTOR_MODEL_STANDSTILL_MILLIS       500 // Time after stop(MOTOR_BRAKE) to be sure, that the motor stands still
+#define MOTOR_MODEL_NUMBER_OF_STEPS         6   // Including the first step from standstill to StartSpeedPWM
+#define MOTOR_MODEL_STEP_MILLIS             500 // Must be at least 5 time constants
+#define MOTOR_MODEL_RECORD_MILLIS           250 // Samples are recorded in the first 250 ms of a step, the rest is averaged
+#define MOTOR_MODEL_SAMPLE_BUFFER_SIZE      32  // 4 bytes per sample, enough for 250 ms at 128 encoder periods per second
+#define MOTOR_MODEL_SAMPLE_TIME_UNIT_MICROS ENCODER_PERIOD_ARRAY_UNIT_MICROS // 16 bit gives 524 ms
+
+/*
+ * The identified model of one direction. StartSpeedPWM is 0 if not identified.
+ */
+struct MotorModelStruct {
+    uint8_t StartSpeedPWM;      // Lowest PWM, which starts a stopped motor
+    uint8_t StopSpeedPWM;       // Highest PWM, at which a turning motor stops. Speed is 0 at this PWM.
+    uint16_t GainTimes256;      // mm/s per PWM, scaled by 256
+    uint16_t TimeConstantMillis;
+};
+
+struct MotorModelSampleStruct {
+    uint16_t Time;              // Middle of the encoder period after start of step, in units of MOTOR_MODEL_SAMPLE_TIME_UNIT_MICROS
+    uint16_t SpeedMillimeterPerSecond; // Speed of the encoder period
+};
+
+class MotorModelIdentification {
+public:
+    void startStartSpeedPWMSearch(uint8_t aMaxSpeedPWM);
+    uint8_t getStartProbeSpeedPWM();
+    void addStartProbeResult(bool aMotorHasMoved);
+
+    uint8_t getStepSpeedPWM(uint8_t aStepIndex);
+    void startStep(uint8_t aStepIndex, unsigned long aStartMicros);
+    void addSample(unsigned long aEncoderInterruptMicros, unsigned long aEncoderInterruptDeltaMicros);
+    void endStep();
+    void computeModel(MotorModelStruct *aModel);
+
+    uint8_t MaxSpeedPWM; // Highest PWM, which is not limited by the battery voltage compensation
+
+    /*
+     * Bisection of StartSpeedPWM
+     */
+    uint8_t StartSearchLowSpeedPWM;     // Highest PWM, which did not move the motor
+    uint8_t StartSearchHighSpeedPWM;    // Lowest PWM, which moved the motor. Result of search.
+
+    /*
+     * Values of the running step
+     */
+    uint8_t StepIndex;
+    unsigned long StepStartMicros;
+    unsigned long LastEncoderInterruptMicros; // To store each encoder period only once
+    MotorModelSampleStruct Samples[MOTOR_MODEL_SAMPLE_BUFFER_SIZE];
+    uint8_t NumberOfSamples;
+    unsigned long SteadyStateSpeedSum;
+    uint16_t SteadyStateNumberOfSpeeds;
+
+    /*
+     * Results of all steps
+     */
+    uint16_t StepEndSpeed[MOTOR_MODEL_NUMBER_OF_STEPS]; // mm/s
+    unsigned long TimeConstantSum;      // ms
+    uint8_t NumberOfTimeConstants;
+};
+
+#endif /* MOTOR_MODEL_IDENTIFICATION_H_ */
+
+#pragma once
@@ -0,0 +1,214 @@
+/*
+ * MotorModelIdentification.hpp
+ *
+ *  Search of StartSpeedPWM, recording of the step responses and fit of the model.
+ *  The owner sets the PWM values returned by getStartProbeSpeedPWM() and getStepSpeedPWM() to the motor
+ *  and calls addSample() for each new encoder period while a step is running.
+ *
+ *  Copyright (C) 2022  Armin Joachimsmeyer
+ *  armin.joachimsmeyer@gmail.com
+ *
+ *  This file is part of PWMMotorControl https://github.com/ArminJo/PWMMotorControl.
+ *
+ *  PWMMotorControl is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/gpl.html>.
+ */
+#ifndef MOTOR_MODEL_IDENTIFICATION_HPP
+#define MOTOR_MODEL_IDENTIFICATION_HPP
+
+#include <Arduino.h>
+#include "MotorModelIdentification.h"
+
+/*
+ * @param aMaxSpeedPWM Highest PWM for search and steps. Higher values must result in a higher output voltage.
+ */
+void MotorModelIdentification::startStartSpeedPWMSearch(uint8_t aMaxSpeedPWM) {
+    MaxSpeedPWM = aMaxSpeedPWM;
+    StartSearchLowSpeedPWM = 0;
+    StartSearchHighSpeedPWM = aMaxSpeedPWM; // Assume that the motor moves with full PWM
+}
+
+/*
+ * @return PWM for the next probe, 0 if search is finished
+ */
+uint8_t MotorModelIdentification::getStartProbeSpeedPWM() {
+    if (StartSearchHighSpeedPWM - StartSearchLowSpeedPWM <= 1) {
+        return 0;
+    }
+    return (StartSearchLowSpeedPWM + StartSearchHighSpeedPWM) / 2;
+}
+
+void MotorModelIdentification::addStartProbeResult(bool aMotorHasMoved) {
+    uint8_t tSpeedPWM = getStartProbeSpeedPWM();
+    if (tSpeedPWM == 0) {
+        return;
+    }
+    if (aMotorHasMoved) {
+        StartSearchHighSpeedPWM = tSpeedPWM;
+    } else {
+        StartSearchLowSpeedPWM = tSpeedPWM;
+    }
+}
+
+/*
+ * Steps are equally spaced from StartSpeedPWM to MaxSpeedPWM
+ */
+uint8_t MotorModelIdentification::getStepSpeedPWM(uint8_t aStepIndex) {
+    return StartSearchHighSpeedPWM
+            + ((unsigned int) (MaxSpeedPWM - StartSearchHighSpeedPWM) * aStepIndex) / (MOTOR_MODEL_NUMBER_OF_STEPS - 1);
+}
+
+/*
+ * @param aStartMicros the time when the PWM of the step was set
+ */
+void MotorModelIdentification::startStep(uint8_t aStepIndex, unsigned long aStartMicros) {
+    if (aStepIndex == 0) {
+        TimeConstantSum = 0;
+        NumberOfTimeConstants = 0;
+    }
+    StepIndex = aStepIndex;
+    StepStartMicros = aStartMicros;
+    LastEncoderInterruptMicros = aStartMicros;
+    NumberOfSamples = 0;
+    SteadyStateSpeedSum = 0;
+    SteadyStateNumberOfSpeeds = 0;
+}
+
+/*
+ * Stores the speed of a new encoder period. Periods, which started before the step, are ignored.
+ * @param aEncoderInterruptMicros time of the encoder interrupt at the end of the period
+ */
+void MotorModelIdentification::addSample(unsigned long aEncoderInterruptMicros, unsigned long aEncoderInterruptDeltaMicros) {
+    if (aEncoderInterruptMicros == LastEncoderInterruptMicros || aEncoderInterruptDeltaMicros == 0) {
+        return;
+    }
+    LastEncoderInterruptMicros = aEncoderInterruptMicros;
+    if ((long) (aEncoderInterruptMicros - aEncoderInterruptDeltaMicros - StepStartMicros) < 0) {
+        return;
+    }
+    unsigned long tMicros = aEncoderInterruptMicros - (aEncoderInterruptDeltaMicros / 2) - StepStartMicros;
+    unsigned int tSpeed = (FACTOR_COUNT_TO_MILLIMETER_INTEGER_DEFAULT * MICROS_IN_ONE_SECOND) / aEncoderInterruptDeltaMicros;
+
+    if (tMicros >= MOTOR_MODEL_RECORD_MILLIS * 1000L) {
+        SteadyStateSpeedSum += tSpeed;
+        SteadyStateNumberOfSpeeds++;
+    } else if (NumberOfSamples < MOTOR_MODEL_SAMPLE_BUFFER_SIZE) {
+        Samples[NumberOfSamples].Time = tMicros / MOTOR_MODEL_SAMPLE_TIME_UNIT_MICROS;
+        Samples[NumberOfSamples].SpeedMillimeterPerSecond = tSpeed;
+        NumberOfSamples++;
+    }
+}
+
+/*
+ * Computes the end speed and the time constant of the step.
+ * The samples must fulfill the integrated first order equation v(t) - v(t1) = ((vEnd - v(t1)) * (t - t1) - integral(v - v(t1))) / tau,
+ * where t1 is the time of the first sample and the integral is from t1 to t. The least squares fit of this equation
+ * gives end speed and time constant independent of the speed before the step, which may not be settled.
+ * The average of the end of the step is only taken as end speed, if the fit is not possible.
+ * The time constant of the first step is not used, since the start from standstill includes the break away of the motor.
+ */
+void MotorModelIdentification::endStep() {
+    uint16_t tEndSpeed = 0;
+    if (SteadyStateNumberOfSpeeds > 0) {
+        tEndSpeed = SteadyStateSpeedSum / SteadyStateNumberOfSpeeds;
+    }
+    StepEndSpeed[StepIndex] = tEndSpeed;
+    if (NumberOfSamples < 3) {
+        return;
+    }
+
+    float tFirstSpeed = Samples[0].SpeedMillimeterPerSecond;
+    float tIntegral = 0; // integral(v - v(t1)) with speed linear between 2 samples
+    float tSumTimeSquare = 0;
+    float tSumTimeTimesIntegral = 0;
+    float tSumIntegralSquare = 0;
+    float tSumTimeTimesSpeed = 0;
+    float tSumIntegralTimesSpeed = 0;
+    for (uint_fast8_t i = 1; i < NumberOfSamples; ++i) {
+        float tTime = (Samples[i].Time - Samples[0].Time) * (MOTOR_MODEL_SAMPLE_TIME_UNIT_MICROS / 1000.0); // ms
+        float tSpeed = Samples[i].SpeedMillimeterPerSecond - tFirstSpeed;
+        tIntegral += ((Samples[i - 1].SpeedMillimeterPerSecond - tFirstSpeed) + tSpeed) / 2
+                * ((Samples[i].Time - Samples[i - 1].Time) * (MOTOR_MODEL_SAMPLE_TIME_UNIT_MICROS / 1000.0));
+        tSumTimeSquare += tTime * tTime;
+        tSumTimeTimesIntegral += tTime * tIntegral;
+        tSumIntegralSquare += tIntegral * tIntegral;
+        tSumTimeTimesSpeed += tTime * tSpeed;
+        tSumIntegralTimesSpeed += tIntegral * tSpeed;
+    }
+    /*
+     * Solve speed = a * time - b * integral, b is 1 / tau and a / b is vEnd - v(t1)
+     */
+    float tDeterminant = tSumTimeSquare * tSumIntegralSquare - tSumTimeTimesIntegral * tSumTimeTimesIntegral;
+    if (tDeterminant <= 0) {
+        return;
+    }
+    float tA = (tSumIntegralSquare * tSumTimeTimesSpeed - tSumTimeTimesIntegral * tSumIntegralTimesSpeed) / tDeterminant;
+    float tB = (tSumTimeTimesIntegral * tSumTimeTimesSpeed - tSumTimeSquare * tSumIntegralTimesSpeed) / tDeterminant;
+    if (tB <= 0 || tA <= 0) {
+        return;
+    }
+    StepEndSpeed[StepIndex] = tFirstSpeed + (tA / tB) + 0.5;
+    if (StepIndex > 0) {
+        TimeConstantSum += (1.0 / tB) + 0.5;
+        NumberOfTimeConstants++;
+    }
+}
+
+/*
+ * Least squares fit of the end speeds of all steps for Gain and StopSpeedPWM and average of the time constants.
+ * Steps without end speed are skipped. Model is not identified, if less than 2 steps have an end speed.
+ */
+void MotorModelIdentification::computeModel(MotorModelStruct *aModel) {
+    memset(aModel, 0, sizeof(MotorModelStruct));
+    if (NumberOfTimeConstants == 0) {
+        return;
+    }
+    uint8_t tNumberOfSpeeds = 0;
+    float tSumSpeedPWM = 0;
+    float tSumSpeed = 0;
+    float tSumSpeedPWMSquare = 0;
+    float tSumSpeedPWMTimesSpeed = 0;
+    for (uint_fast8_t i = 0; i < MOTOR_MODEL_NUMBER_OF_STEPS; ++i) {
+        if (StepEndSpeed[i] == 0) {
+            continue;
+        }
+        tNumberOfSpeeds++;
+        float tSpeedPWM = getStepSpeedPWM(i);
+        tSumSpeedPWM += tSpeedPWM;
+        tSumSpeed += StepEndSpeed[i];
+        tSumSpeedPWMSquare += tSpeedPWM * tSpeedPWM;
+        tSumSpeedPWMTimesSpeed += tSpeedPWM * StepEndSpeed[i];
+    }
+    float tDenominator = tNumberOfSpeeds * tSumSpeedPWMSquare - tSumSpeedPWM * tSumSpeedPWM;
+    if (tNumberOfSpeeds < 2 || tDenominator <= 0) {
+        return;
+    }
+    float tGain = (tNumberOfSpeeds * tSumSpeedPWMTimesSpeed - tSumSpeedPWM * tSumSpeed) / tDenominator;
+    if (tGain <= 0) {
+        return;
+    }
+    float tStopSpeedPWM = (tSumSpeedPWM - tSumSpeed / tGain) / tNumberOfSpeeds;
+    if (tStopSpeedPWM < 0) {
+        tStopSpeedPWM = 0;
+    } else if (tStopSpeedPWM > StartSearchHighSpeedPWM) {
+        tStopSpeedPWM = StartSearchHighSpeedPWM;
+    }
+
+    aModel->StartSpeedPWM = StartSearchHighSpeedPWM;
+    aModel->StopSpeedPWM = tStopSpeedPWM + 0.5;
+    aModel->GainTimes256 = tGain * 256 + 0.5;
+    aModel->TimeConstantMillis = (TimeConstantSum + NumberOfTimeConstants / 2) / NumberOfTimeConstants;
+}
+
+#endif // #ifndef MOTOR_MODEL_IDENTIFICATION_HPP
+#pragma once
@@ -0,0 +1,110 @@
+/*
+ * PCA9685MotorDriver.h
+ *
+ *  Driver class for FastPWMDcMotor for the PCA9685 and TB6612 of the Adafruit Motor Shield V2.
+ *  The 3 PCA9685 channels of each motor are adjacent, so the 2 direction channels and the PWM channel
+ *  are written by one I2C transaction of 13 bytes with the auto increment of the PCA9685.
+ *  The own library for Adafruit Motor Shield of PWMDcMotor needs one transaction for each channel.
+ *
+ *  Copyright (C) 2022  Armin Joachimsmeyer
+ *  armin.joachimsmeyer@gmail.com
+ *
+ *  This file is part of PWMMotorControl https://github.com/ArminJo/PWMMotorControl.
+ *
+ *  PWMMotorControl is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/gpl.html>.
+ */
+
+#ifndef PCA9685_MOTOR_DRIVER_H_
+#define PCA9685_MOTOR_DRIVER_H_
+
+#include <Arduino.h>
+#include <Wire.h>
+#include "PWMDcMotor.h"
+
+/*
+ * Channels of the Adafruit Motor Shield V2
+ * Motor 1: PWM 8,  IN2 9,  IN1 10
+ * Motor 2: IN1 11, IN2 12, PWM 13
+ * Motor 3: PWM 2,  IN2 3,  IN1 4
+ * Motor 4: IN1 5,  IN2 6,  PWM 7
+ * IN1 is high for forward, IN2 for backward.
+ */
+template<uint8_t tMotorNumber, uint8_t tI2CAddress = PCA9685_DEFAULT_ADDRESS>
+class PCA9685MotorDriver {
+public:
+    static const uint8_t FirstChannel = (tMotorNumber == 1) ? 8 : ((tMotorNumber == 2) ? 11 : ((tMotorNumber == 3) ? 2 : 5));
+    static const bool PWMChannelIsFirst = (tMotorNumber == 1 || tMotorNumber == 3);
+
+    /*
+     * Resets all PCA9685 on the bus and sets them to 1600 Hz with auto increment
+     */
+    static void init() {
+        Wire.begin();
+        Wire.setClock(400000);
+#if defined (ARDUINO_ARCH_AVR) // Other platforms do not have this new function
+        Wire.setWireTimeout(5000); // Sets timeout to 5 ms. default is 25 ms.
+#endif
+        Wire.beginTransmission(PCA9685_GENERAL_CALL_ADDRESS);
+        Wire.write(PCA9685_SOFTWARE_RESET);
+        Wire.endTransmission(true);
+        writeRegister(PCA9685_MODE1_REGISTER, _BV(PCA9685_MODE_1_SLEEP)); // go to sleep
+        writeRegister(PCA9685_PRESCALE_REGISTER, PCA9685_PRESCALER_FOR_1600_HZ); // set the prescaler
+        delay(2); // > 500 us before the restart bit according to datasheet
+        writeRegister(PCA9685_MODE1_REGISTER, _BV(PCA9685_MODE_1_RESTART) | _BV(PCA9685_MODE_1_AUTOINCREMENT)); // reset sleep and enable auto increment
+    }
+
+    static void write(uint8_t aMotorDriverMode, uint8_t aSpeedPWM) {
+        bool tIN1IsHigh = (aMotorDriverMode == DIRECTION_FORWARD || aMotorDriverMode == MOTOR_BRAKE);
+        bool tIN2IsHigh = (aMotorDriverMode == DIRECTION_BACKWARD || aMotorDriverMode == MOTOR_BRAKE);
+        Wire.beginTransmission(tI2CAddress);
+        Wire.write(PCA9685_FIRST_PWM_REGISTER + 4 * FirstChannel);
+        if (PWMChannelIsFirst) {
+            writeChannel(0, 16 * aSpeedPWM);
+            writePinChannel(tIN2IsHigh);
+            writePinChannel(tIN1IsHigh);
+        } else {
+            writePinChannel(tIN1IsHigh);
+            writePinChannel(tIN2IsHigh);
+            writeChannel(0, 16 * aSpeedPWM);
+        }
+        Wire.endTransmission(true);
+    }
+
+private:
+    static void writeRegister(uint8_t aRegister, uint8_t aData) {
+        Wire.beginTransmission(tI2CAddress);
+        Wire.write(aRegister);
+        Wire.write(aData);
+        Wire.endTransmission(true);
+    }
+
+    static void writeChannel(uint16_t aOn, uint16_t aOff) {
+        Wire.write(aOn);
+        Wire.write(aOn >> 8);
+        Wire.write(aOff);
+        Wire.write(aOff >> 8);
+    }
+
+    static void writePinChannel(bool aSetToOn) {
+        if (aSetToOn) {
+            writeChannel(4096, 0); // full on
+        } else {
+            writeChannel(0, 0);
+        }
+    }
+};
+
+#endif /* PCA9685_MOTOR_DRIVER_H_ */
+
+#pragma once
@@ -45,6 +45,7 @@
 // The change log is at the bottom of the file
 
 #define MILLIS_IN_ONE_SECOND 1000L
+#define MICROS_IN_ONE_SECOND 1000000L
 
 /*
  * Activate this, if you have encoder interrupts attached at pin 2 and 3
@@ -112,6 +113,15 @@
 #define FULL_BRIDGE_OUTPUT_MILLIVOLT        (FULL_BRIDGE_INPUT_MILLIVOLT - FULL_BRIDGE_LOSS_MILLIVOLT)
 #endif
 
+/*
+ * Battery voltage compensation. If the measured motor supply voltage is given by PWMDcMotor::setVINMillivolt() e.g. every 2 seconds,
+ * the PWM output is scaled, so that the motor gets the same voltage as with FULL_BRIDGE_INPUT_MILLIVOLT.
+ * The scale factor is computed at setVINMillivolt(), so no division is required for the PWM output.
+ */
+#define VIN_COMPENSATION_FILTER_SHIFT       2   // New VIN value has a weight of 1/4
+#define VIN_COMPENSATION_FACTOR_MIN         64  // 0.5 * 128
+#define VIN_COMPENSATION_FACTOR_MAX         256 // 2 * 128. Must not be bigger, since output is computed with 16 bit
+
 #define DEFAULT_START_MILLIVOLT_MOSFET      1000 // Voltage where motors start to turn
 #define DEFAULT_START_MILLIVOLT_L298        1700 // For L298 the start voltage is higher (because of a higher ESR of the L298 bridge?)
 #define DEFAULT_DRIVE_MILLIVOLT             2000 // Drive voltage -motors default speed- is 2.0 volt
@@ -174,10 +184,7 @@
 extern char sMotorModeCharArray[4];
 #endif
 
-#ifdef USE_ADAFRUIT_MOTOR_SHIELD
-#include <Wire.h>
-#  ifdef USE_OWN_LIBRARY_FOR_ADAFRUIT_MOTOR_SHIELD
-// some PCA9685 specific constants
+// some PCA9685 specific constants, used by the own library for Adafruit Motor Shield and by PCA9685MotorDriver.h
 #define PCA9685_DEFAULT_ADDRESS      0x60
 #define PCA9685_GENERAL_CALL_ADDRESS 0x00
 #define PCA9685_SOFTWARE_RESET          6
@@ -191,16 +198,19 @@ extern char sMotorModeCharArray[4];
 
 #define PCA9685_PRESCALER_FOR_1600_HZ ((25000000L /(4096L * 1600))-1) // = 3 at 1600 Hz
 
-#  else
+#ifdef USE_ADAFRUIT_MOTOR_SHIELD
+#include <Wire.h>
+#  if !defined(USE_OWN_LIBRARY_FOR_ADAFRUIT_MOTOR_SHIELD)
 #include <Adafruit_MotorShield.h>
 #define CONVERSION_FOR_ADAFRUIT_API 1
-#  endif // USE_OWN_LIBRARY_FOR_ADAFRUIT_MOTOR_SHIELD
+#  endif // !defined(USE_OWN_LIBRARY_FOR_ADAFRUIT_MOTOR_SHIELD)
 #endif // USE_ADAFRUIT_MOTOR_SHIELD
 
 struct EepromMotorInfoStruct {
     uint8_t DriveSpeedPWM;
     uint8_t SpeedPWMCompensation;
 };
+#define EEPROM_MOTOR_INFO_MAX_NUMBER    4 // Number of EepromMotorInfoStruct's at start of EEPROM. Other EEPROM blocks start behind them.
 
 /*
  * Ramp control
@@ -214,6 +224,7 @@ struct EepromMotorInfoStruct {
 class PWMDcMotor {
 public:
     PWMDcMotor();
+    ~PWMDcMotor(); // Removes motor from the list of all motors, required for local or temporary motor objects
 
 #ifdef USE_ADAFRUIT_MOTOR_SHIELD
     void init(uint8_t aMotorNumber);
@@ -241,6 +252,7 @@ public:
     void setSpeedPWMWithRamp(uint8_t aRequestedSpeedPWM, uint8_t aRequestedDirection);
 
     void setSpeedPWMCompensation(uint8_t aSpeedPWMCompensation);
+    static void setVINMillivolt(uint16_t aVINMillivolt); // Rewrites the PWM output of all running motors if the scale factor changes
 
     void start(uint8_t aRequestedDirection);
     void stop(uint8_t aStopMode = STOP_MODE_KEEP); // STOP_MODE_KEEP (take previously defined DefaultStopMode) or MOTOR_BRAKE or MOTOR_RELEASE
@@ -285,11 +297,21 @@ public:
     void printValues(Print *aSerial);
     static void printSettings(Print *aSerial);
 
+    /*
+     * Nominal conversion, assuming speed is linear to PWM with DEFAULT_MILLIMETER_PER_SECOND at DEFAULT_DRIVE_SPEED_PWM
+     */
+    static unsigned int getMillimeterPerSecondForSpeedPWM(uint8_t aSpeedPWM);
+    static uint8_t getSpeedPWMForMillimeterPerSecond(unsigned int aMillimeterPerSecond);
+
     /*
      * Internal functions
      */
     void setMotorDriverMode(uint8_t cmd);
     bool checkAndHandleDirectionChange(uint8_t aRequestedDirection);
+    void writeSpeedPWM(uint8_t aSpeedPWM);
+    static uint8_t getOutputSpeedPWM(uint8_t aSpeedPWM); // Scales for the battery voltage, used by FastPWMDcMotor too
+    void addToMotorList();
+    void removeFromMotorList();
 
 #if ! defined(USE_ADAFRUIT_MOTOR_SHIELD) || defined(USE_OWN_LIBRARY_FOR_ADAFRUIT_MOTOR_SHIELD)
     uint8_t PWMPin;     // PWM output pin / PCA9685 channel of Adafruit Motor Shield
@@ -322,6 +344,20 @@ public:
     uint8_t LastDirection; // Used for speed and distance. Contains  DIRECTION_FORWARD, DIRECTION_BACKWARD but not MOTOR_BRAKE, MOTOR_RELEASE.
     static bool MotorPWMHasChanged;
 
+    static uint16_t VINMillivolt;                   // Filtered motor supply voltage, 0 if not yet set
+    static uint16_t VINCompensationFactorTimes128;  // FULL_BRIDGE_OUTPUT_MILLIVOLT / (VINMillivolt - FULL_BRIDGE_LOSS_MILLIVOLT)
+    static PWMDcMotor *sMotorListStart; // Root pointer to list of all motors, to rewrite their output if VINCompensationFactorTimes128 changes
+    PWMDcMotor *NextMotor;
+
+private:
+    /*
+     * Not implemented, since a copy would share NextMotor with the original and would not be in the list of all motors
+     */
+    PWMDcMotor(const PWMDcMotor&);
+    PWMDcMotor& operator=(const PWMDcMotor&);
+
+public:
+
     bool CheckDistanceInUpdateMotor;
 
     /*
@@ -63,8 +63,12 @@ volatile bool PWMDcMotor::SensorValuesHaveChanged; // true if encoder count and
 #endif
 bool PWMDcMotor::MotorControlValuesHaveChanged; // true if DefaultStopMode, DriveSpeedPWM or SpeedPWMCompensation have changed
 bool PWMDcMotor::MotorPWMHasChanged;              // true if CurrentSpeedPWM has changed
+uint16_t PWMDcMotor::VINMillivolt;
+uint16_t PWMDcMotor::VINCompensationFactorTimes128 = 128; // No compensation until setVINMillivolt() is called
+PWMDcMotor *PWMDcMotor::sMotorListStart = NULL;
 
 PWMDcMotor::PWMDcMotor() { // @suppress("Class members should be properly initialized")
+    addToMotorList();
 }
 
 #ifdef USE_ADAFRUIT_MOTOR_SHIELD
@@ -151,6 +155,7 @@ void PWMDcMotor::init(uint8_t aMotorNumber) {
  * @param aBackwardPin the pin, which is high if direction is backward
  */
 PWMDcMotor::PWMDcMotor(uint8_t aForwardPin, uint8_t aBackwardPin, uint8_t aPWMPin) {
+    addToMotorList();
     init(aForwardPin, aBackwardPin, aPWMPin);
 }
 
@@ -175,6 +180,30 @@ void PWMDcMotor::init(uint8_t aForwardPin, uint8_t aBackwardPin, uint8_t aPWMPin
 
 #endif // USE_ADAFRUIT_MOTOR_SHIELD
 
+/*
+ * All motors are chained by their constructor, so setVINMillivolt() can rewrite their PWM output
+ */
+void PWMDcMotor::addToMotorList() {
+    NextMotor = sMotorListStart;
+    sMotorListStart = this;
+}
+
+void PWMDcMotor::removeFromMotorList() {
+    PWMDcMotor **tLink = &sMotorListStart;
+    while (*tLink != NULL) {
+        if (*tLink == this) {
+            *tLink = NextMotor;
+            break;
+        }
+        tLink = &(*tLink)->NextMotor;
+    }
+    NextMotor = NULL;
+}
+
+PWMDcMotor::~PWMDcMotor() {
+    removeFromMotorList();
+}
+
 /*
  *  @brief  Control the DC motor driver direction and stop mode
  *  @param  aMotorDriverMode The mode can be FORWARD, BACKWARD (BRAKE motor connection are shortened) or RELEASE ( motor connections are high impedance)
@@ -285,15 +314,67 @@ void PWMDcMotor::setSpeedPWM(uint8_t aRequestedSpeedPWM, uint8_t aRequestedDirec
             Serial.println(CurrentSpeedPWM);
 #endif
             MotorPWMHasChanged = true;
+            writeSpeedPWM(aRequestedSpeedPWM);
+        }
+    }
+}
+
+/*
+ * @return aSpeedPWM scaled for the current battery voltage, clipped to MAX_SPEED_PWM
+ */
+uint8_t PWMDcMotor::getOutputSpeedPWM(uint8_t aSpeedPWM) {
+    uint16_t tOutputSpeedPWM = ((uint16_t) aSpeedPWM * VINCompensationFactorTimes128) >> 7;
+    if (tOutputSpeedPWM > MAX_SPEED_PWM) {
+        tOutputSpeedPWM = MAX_SPEED_PWM;
+    }
+    return tOutputSpeedPWM;
+}
+
+/*
+ * Scales aSpeedPWM for the current battery voltage and writes it to the motor driver
+ */
+void PWMDcMotor::writeSpeedPWM(uint8_t aSpeedPWM) {
+    uint8_t tOutputSpeedPWM = getOutputSpeedPWM(aSpeedPWM);
 #ifdef USE_ADAFRUIT_MOTOR_SHIELD
 #  ifdef USE_OWN_LIBRARY_FOR_ADAFRUIT_MOTOR_SHIELD
-            PCA9685SetPWM(PWMPin, 0, 16 * aRequestedSpeedPWM);
+    PCA9685SetPWM(PWMPin, 0, 16 * tOutputSpeedPWM);
 #  else
-            Adafruit_MotorShield_DcMotor->setSpeedPWM(aRequestedSpeedPWM);
+    Adafruit_MotorShield_DcMotor->setSpeedPWM(tOutputSpeedPWM);
 #  endif
 #else
-            analogWrite(PWMPin, aRequestedSpeedPWM);
+    analogWrite(PWMPin, tOutputSpeedPWM);
 #endif
+}
+
+/*
+ * Filters aVINMillivolt and computes the scale factor for the PWM output.
+ * The first call after reset takes the value unfiltered.
+ * If the factor changes, the output of all running motors is rewritten, otherwise a motor running with constant PWM
+ * would not be compensated until its next PWM change.
+ */
+void PWMDcMotor::setVINMillivolt(uint16_t aVINMillivolt) {
+    if (VINMillivolt == 0) {
+        VINMillivolt = aVINMillivolt;
+    } else {
+        VINMillivolt += ((int16_t) (aVINMillivolt - VINMillivolt)) >> VIN_COMPENSATION_FILTER_SHIFT;
+    }
+    uint16_t tFactor = VIN_COMPENSATION_FACTOR_MAX;
+    if (VINMillivolt > FULL_BRIDGE_LOSS_MILLIVOLT) {
+        uint32_t tFactorLong = (FULL_BRIDGE_OUTPUT_MILLIVOLT * 128UL) / (VINMillivolt - FULL_BRIDGE_LOSS_MILLIVOLT);
+        if (tFactorLong < VIN_COMPENSATION_FACTOR_MAX) {
+            tFactor = tFactorLong;
+        }
+    }
+    if (tFactor < VIN_COMPENSATION_FACTOR_MIN) {
+        tFactor = VIN_COMPENSATION_FACTOR_MIN;
+    }
+    if (VINCompensationFactorTimes128 != tFactor) {
+        VINCompensationFactorTimes128 = tFactor;
+        for (PWMDcMotor *tMotor = sMotorListStart; tMotor != NULL; tMotor = tMotor->NextMotor) {
+            if (!tMotor->isStopped()) {
+                // CurrentSpeedPWM is the requested PWM minus SpeedPWMCompensation
+                tMotor->writeSpeedPWM(tMotor->CurrentSpeedPWM + tMotor->SpeedPWMCompensation);
+            }
         }
     }
 }
@@ -447,6 +528,7 @@ void PWMDcMotor::setSpeedPWMWithRamp(uint8_t aRequestedSpeedPWM, uint8_t aReques
         /*
          * motor is running, -> just change speed
          */
+        RequestedDriveSpeedPWM = aRequestedSpeedPWM; // required as target for speed control of EncoderMotor
         setSpeedPWM(aRequestedSpeedPWM, aRequestedDirection);
     }
     // else ramp is in mode MOTOR_STATE_RAMP_UP -> do nothing, let the ramp go on
@@ -730,7 +812,8 @@ void PWMDcMotor::writeMotorValuesToEeprom(uint8_t aMotorValuesEepromStorageNumbe
     tEepromMotorInfo.DriveSpeedPWM = DriveSpeedPWM;
     tEepromMotorInfo.SpeedPWMCompensation = SpeedPWMCompensation;
 
-    eeprom_write_block((void*) &tEepromMotorInfo, (void*) ((aMotorValuesEepromStorageNumber) * sizeof(EepromMotorInfoStruct)),
+    // update saves EEPROM write cycles, if values are stored again unchanged
+    eeprom_update_block((void*) &tEepromMotorInfo, (void*) ((aMotorValuesEepromStorageNumber) * sizeof(EepromMotorInfoStruct)),
             sizeof(EepromMotorInfoStruct));
 }
 #endif
@@ -749,6 +832,22 @@ void PWMDcMotor::printValues(Print *aSerial) {
     aSerial->println();
 }
 
+/*
+ * Nominal conversion, assuming speed is linear to PWM with DEFAULT_MILLIMETER_PER_SECOND at DEFAULT_DRIVE_SPEED_PWM
+ */
+unsigned int PWMDcMotor::getMillimeterPerSecondForSpeedPWM(uint8_t aSpeedPWM) {
+    return ((unsigned long) aSpeedPWM * DEFAULT_MILLIMETER_PER_SECOND) / DEFAULT_DRIVE_SPEED_PWM;
+}
+
+uint8_t PWMDcMotor::getSpeedPWMForMillimeterPerSecond(unsigned int aMillimeterPerSecond) {
+    unsigned long tSpeedPWM = ((unsigned long) aMillimeterPerSecond * DEFAULT_DRIVE_SPEED_PWM + (DEFAULT_MILLIMETER_PER_SECOND / 2))
+            / DEFAULT_MILLIMETER_PER_SECOND;
+    if (tSpeedPWM > MAX_SPEED_PWM) {
+        tSpeedPWM = MAX_SPEED_PWM;
+    }
+    return tSpeedPWM;
+}
+
 const char StringNot[] PROGMEM = { " not" };
 const char StringDefined[] PROGMEM = { " defined" };
 
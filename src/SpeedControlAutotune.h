@@ -0,0 +1,87 @@
+/*
+ * SpeedControlAutotune.h
+ *
+ *  Relay feedback autotuner for the PI speed control of one wheel.
+ *  The PWM is switched between BiasSpeedPWM + SPEED_CONTROL_AUTOTUNE_RELAY_PWM and BiasSpeedPWM - SPEED_CONTROL_AUTOTUNE_RELAY_PWM,
+ *  whenever the speed crosses the setpoint, which results in a steady oscillation of the speed around the setpoint.
+ *  The ultimate gain Ku = 4 * relay PWM / (pi * speed amplitude) and the ultimate period Tu of this oscillation
+ *  give the PI gains Kp = 0.3 * Ku and Ti = 0.45 * Tu. Compared with the Ziegler-Nichols rule Kp = 0.45 * Ku and Ti = 0.83 * Tu,
+ *  the lower Kp avoids the overshoot at start, which is caused by the long first encoder periods,
+ *  and the shorter Ti removes the remaining speed error faster, see extras/HostSimulation/AutotuneTrials.cpp.
+ *  With Ti = 0.4 * Tu, the start settles slower than with the default gains, if the differential drive control is active.
+ *
+ *  The speed is sampled every SPEED_CONTROL_INTERVAL_MILLIS like in the speed control, so the delay
+ *  of the encoder period measurement is part of the oscillation and is considered by the gains.
+ *  BiasSpeedPWM is adjusted after each cycle to the average PWM of the cycle, so that an inaccurate
+ *  feed forward value does not result in an asymmetric oscillation.
+ *
+ *  Copyright (C) 2022  Armin Joachimsmeyer
+ *  armin.joachimsmeyer@gmail.com
+ *
+ *  This file is part of PWMMotorControl https://github.com/ArminJo/PWMMotorControl.
+ *
+ *  PWMMotorControl is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/gpl.html>.
+ */
+
+#ifndef SPEED_CONTROL_AUTOTUNE_H_
+#define SPEED_CONTROL_AUTOTUNE_H_
+
+#include <stdint.h>
+
+#define SPEED_CONTROL_AUTOTUNE_RELAY_PWM                        20  // Amplitude of the relay output
+#define SPEED_CONTROL_AUTOTUNE_HYSTERESIS_MILLIMETER_PER_SECOND 10  // Against switching by the noise of the encoder period
+#define SPEED_CONTROL_AUTOTUNE_SKIPPED_CYCLES                   2   // Cycles until the oscillation is settled
+#define SPEED_CONTROL_AUTOTUNE_MEASURED_CYCLES                  4   // Cycles averaged for Ku and Tu
+#define SPEED_CONTROL_AUTOTUNE_SETTLE_MILLIS                    500 // Time with BiasSpeedPWM before the relay starts
+#define SPEED_CONTROL_AUTOTUNE_TIMEOUT_MILLIS                   6000 // Maximum time for all cycles
+/*
+ * Tuning rule Kp = SPEED_CONTROL_AUTOTUNE_KP_FACTOR * Ku and Ti = SPEED_CONTROL_AUTOTUNE_TI_FACTOR * Tu
+ */
+#if !defined(SPEED_CONTROL_AUTOTUNE_KP_FACTOR)
+#define SPEED_CONTROL_AUTOTUNE_KP_FACTOR                        0.3
+#endif
+#if !defined(SPEED_CONTROL_AUTOTUNE_TI_FACTOR)
+#define SPEED_CONTROL_AUTOTUNE_TI_FACTOR                        0.45
+#endif
+
+class SpeedControlAutotune {
+public:
+    void start(unsigned int aSetpointMillimeterPerSecond, uint8_t aBiasSpeedPWM, unsigned long aMillis);
+    uint8_t update(unsigned int aSpeedMillimeterPerSecond, unsigned long aMillis);
+    bool isFinished();
+    bool computeGains(uint16_t *aKpTimes256, uint16_t *aKiTimes256);
+
+    unsigned int SetpointMillimeterPerSecond;
+    uint8_t BiasSpeedPWM;           // Average PWM of the last cycle
+    bool RelayIsHigh;
+
+    /*
+     * Values of the running cycle. A cycle starts with switching the relay to high.
+     */
+    uint8_t NumberOfCycles;         // Completed cycles including the skipped ones
+    unsigned long CycleStartMillis;
+    unsigned long SwitchToLowMillis;
+    unsigned int CycleMaxSpeed;
+    unsigned int CycleMinSpeed;
+
+    /*
+     * Sums of the measured cycles
+     */
+    unsigned long PeriodSumMillis;
+    unsigned long PeakToPeakSum;    // mm/s
+};
+
+#endif /* SPEED_CONTROL_AUTOTUNE_H_ */
+
+#pragma once
@@ -0,0 +1,148 @@
+/*
+ * SpeedControlAutotune.hpp
+ *
+ *  Relay oscillation and computation of the PI gains.
+ *  The owner sets the PWM returned by update() every SPEED_CONTROL_INTERVAL_MILLIS to the motor
+ *  until isFinished() returns true or SPEED_CONTROL_AUTOTUNE_TIMEOUT_MILLIS are over.
+ *
+ *  Copyright (C) 2022  Armin Joachimsmeyer
+ *  armin.joachimsmeyer@gmail.com
+ *
+ *  This file is part of PWMMotorControl https://github.com/ArminJo/PWMMotorControl.
+ *
+ *  PWMMotorControl is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/gpl.html>.
+ */
+#ifndef SPEED_CONTROL_AUTOTUNE_HPP
+#define SPEED_CONTROL_AUTOTUNE_HPP
+
+#include <Arduino.h>
+#include "SpeedControlAutotune.h"
+
+/*
+ * @param aBiasSpeedPWM PWM for the setpoint, e.g. the feed forward value. The motor should run with it for SPEED_CONTROL_AUTOTUNE_SETTLE_MILLIS.
+ */
+void SpeedControlAutotune::start(unsigned int aSetpointMillimeterPerSecond, uint8_t aBiasSpeedPWM, unsigned long aMillis) {
+    SetpointMillimeterPerSecond = aSetpointMillimeterPerSecond;
+    // Keep the low PWM out of the dead band
+    if (aBiasSpeedPWM < SPEED_CONTROL_MIN_PWM + SPEED_CONTROL_AUTOTUNE_RELAY_PWM) {
+        aBiasSpeedPWM = SPEED_CONTROL_MIN_PWM + SPEED_CONTROL_AUTOTUNE_RELAY_PWM;
+    } else if (aBiasSpeedPWM > MAX_SPEED_PWM - SPEED_CONTROL_AUTOTUNE_RELAY_PWM) {
+        aBiasSpeedPWM = MAX_SPEED_PWM - SPEED_CONTROL_AUTOTUNE_RELAY_PWM;
+    }
+    BiasSpeedPWM = aBiasSpeedPWM;
+    RelayIsHigh = true;
+    NumberOfCycles = 0;
+    CycleStartMillis = aMillis;
+    SwitchToLowMillis = aMillis;
+    CycleMaxSpeed = 0;
+    CycleMinSpeed = 0xFFFF;
+    PeriodSumMillis = 0;
+    PeakToPeakSum = 0;
+}
+
+bool SpeedControlAutotune::isFinished() {
+    return NumberOfCycles >= SPEED_CONTROL_AUTOTUNE_SKIPPED_CYCLES + SPEED_CONTROL_AUTOTUNE_MEASURED_CYCLES;
+}
+
+/*
+ * Must be called every SPEED_CONTROL_INTERVAL_MILLIS.
+ * The first cycle starts with a high relay, so the speed must be below the setpoint at start.
+ * @return PWM to set, BiasSpeedPWM if finished
+ */
+uint8_t SpeedControlAutotune::update(unsigned int aSpeedMillimeterPerSecond, unsigned long aMillis) {
+    if (isFinished()) {
+        return BiasSpeedPWM;
+    }
+    if (aSpeedMillimeterPerSecond > CycleMaxSpeed) {
+        CycleMaxSpeed = aSpeedMillimeterPerSecond;
+    }
+    if (aSpeedMillimeterPerSecond < CycleMinSpeed) {
+        CycleMinSpeed = aSpeedMillimeterPerSecond;
+    }
+
+    if (RelayIsHigh) {
+        if (aSpeedMillimeterPerSecond > SetpointMillimeterPerSecond + SPEED_CONTROL_AUTOTUNE_HYSTERESIS_MILLIMETER_PER_SECOND) {
+            RelayIsHigh = false;
+            SwitchToLowMillis = aMillis;
+        }
+    } else if (aSpeedMillimeterPerSecond + SPEED_CONTROL_AUTOTUNE_HYSTERESIS_MILLIMETER_PER_SECOND < SetpointMillimeterPerSecond) {
+        /*
+         * End of cycle
+         */
+        RelayIsHigh = true;
+        unsigned int tPeriodMillis = aMillis - CycleStartMillis;
+        if (NumberOfCycles >= SPEED_CONTROL_AUTOTUNE_SKIPPED_CYCLES) {
+            PeriodSumMillis += tPeriodMillis;
+            PeakToPeakSum += CycleMaxSpeed - CycleMinSpeed;
+        }
+        NumberOfCycles++;
+
+        /*
+         * The average PWM of the cycle is the PWM for the setpoint
+         */
+        int tHighMinusLowMillis = (int) (SwitchToLowMillis - CycleStartMillis) - (int) (aMillis - SwitchToLowMillis);
+        int tBiasSpeedPWM = BiasSpeedPWM
+                + ((long) SPEED_CONTROL_AUTOTUNE_RELAY_PWM * tHighMinusLowMillis) / (int) tPeriodMillis;
+        if (tBiasSpeedPWM < SPEED_CONTROL_MIN_PWM + SPEED_CONTROL_AUTOTUNE_RELAY_PWM) {
+            tBiasSpeedPWM = SPEED_CONTROL_MIN_PWM + SPEED_CONTROL_AUTOTUNE_RELAY_PWM;
+        } else if (tBiasSpeedPWM > MAX_SPEED_PWM - SPEED_CONTROL_AUTOTUNE_RELAY_PWM) {
+            tBiasSpeedPWM = MAX_SPEED_PWM - SPEED_CONTROL_AUTOTUNE_RELAY_PWM;
+        }
+        BiasSpeedPWM = tBiasSpeedPWM;
+
+        CycleStartMillis = aMillis;
+        CycleMaxSpeed = aSpeedMillimeterPerSecond;
+        CycleMinSpeed = aSpeedMillimeterPerSecond;
+    }
+
+    if (isFinished()) {
+        return BiasSpeedPWM;
+    }
+    return (RelayIsHigh ? BiasSpeedPWM + SPEED_CONTROL_AUTOTUNE_RELAY_PWM : BiasSpeedPWM - SPEED_CONTROL_AUTOTUNE_RELAY_PWM);
+}
+
+/*
+ * PI gains from the ultimate gain and period. The hysteresis is considered by the describing function
+ * of a relay with hysteresis, Ku = 4 * d / (pi * sqrt(a^2 - e^2)).
+ * @return false if oscillation was not finished, gains are not changed then
+ */
+bool SpeedControlAutotune::computeGains(uint16_t *aKpTimes256, uint16_t *aKiTimes256) {
+    if (!isFinished()) {
+        return false;
+    }
+    float tAmplitude = PeakToPeakSum / (2.0 * SPEED_CONTROL_AUTOTUNE_MEASURED_CYCLES); // mm/s
+    float tAmplitudeSquare = (tAmplitude * tAmplitude)
+            - (SPEED_CONTROL_AUTOTUNE_HYSTERESIS_MILLIMETER_PER_SECOND * SPEED_CONTROL_AUTOTUNE_HYSTERESIS_MILLIMETER_PER_SECOND);
+    if (tAmplitudeSquare <= 0) {
+        return false;
+    }
+    float tUltimateGain = (4.0 * SPEED_CONTROL_AUTOTUNE_RELAY_PWM) / (PI * sqrt(tAmplitudeSquare)); // PWM per mm/s
+    float tUltimatePeriodMillis = (float) PeriodSumMillis / SPEED_CONTROL_AUTOTUNE_MEASURED_CYCLES;
+
+    float tKpTimes256 = SPEED_CONTROL_AUTOTUNE_KP_FACTOR * 256 * tUltimateGain;
+    // Ki is per SPEED_CONTROL_INTERVAL_MILLIS, Ki = Kp * interval / Ti
+    float tKiTimes256 = (tKpTimes256 * SPEED_CONTROL_INTERVAL_MILLIS) / (SPEED_CONTROL_AUTOTUNE_TI_FACTOR * tUltimatePeriodMillis);
+    if (tKpTimes256 > 0xFFFF || tKiTimes256 > 0xFFFF) {
+        return false;
+    }
+    *aKpTimes256 = tKpTimes256 + 0.5;
+    *aKiTimes256 = tKiTimes256 + 0.5;
+    if (*aKiTimes256 == 0) {
+        *aKiTimes256 = 1;
+    }
+    return true;
+}
+
+#endif // #ifndef SPEED_CONTROL_AUTOTUNE_HPP
+#pragma once